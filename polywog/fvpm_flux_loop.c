@@ -0,0 +1,296 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "core/timer.h"
+#include "polywog/fvpm_flux_loop.h"
+#include "polywog/pair_loop_threads.h"
+
+struct fvpm_flux_loop_t
+{
+  neighbor_pairing_t* pairing;
+  int num_comp, num_points;
+  int block_size;
+  bool reconcile_ghosts;
+
+  void* context;
+  void (*compute)(void* context, real_t t, int i, int j, real_t* Ui, real_t* Uj,
+                  vector_t* beta_ij, real_t* F);
+  void (*compute_batch)(void* context, real_t t, fvpm_pair_block_t* block,
+                        int num_components, real_t* U, real_t* F);
+  void (*dtor)(void* context);
+
+  // Accumulation buffers for threads other than the first (which 
+  // accumulates directly into the output array).
+  pair_loop_buffers_t bufs;
+};
+
+fvpm_flux_loop_t* fvpm_flux_loop_new(neighbor_pairing_t* pairing,
+                                     int num_components,
+                                     void* context,
+                                     void (*compute)(void* context, real_t t,
+                                                     int i, int j,
+                                                     real_t* Ui, real_t* Uj,
+                                                     vector_t* beta_ij,
+                                                     real_t* F),
+                                     void (*dtor)(void* context))
+{
+  ASSERT(num_components > 0);
+  ASSERT(compute != NULL);
+
+  fvpm_flux_loop_t* loop = polymec_malloc(sizeof(fvpm_flux_loop_t));
+  loop->pairing = pairing;
+  loop->num_comp = num_components;
+  loop->num_points = pair_loop_num_points(pairing);
+  loop->block_size = 512;
+  loop->reconcile_ghosts = false;
+  loop->context = context;
+  loop->compute = compute;
+  loop->compute_batch = NULL;
+  loop->dtor = dtor;
+  pair_loop_buffers_init(&loop->bufs, sizeof(real_t) * num_components);
+  return loop;
+}
+
+void fvpm_flux_loop_free(fvpm_flux_loop_t* loop)
+{
+  pair_loop_buffers_free(&loop->bufs);
+  if ((loop->context != NULL) && (loop->dtor != NULL))
+    loop->dtor(loop->context);
+  polymec_free(loop);
+}
+
+void fvpm_flux_loop_set_batch_compute(fvpm_flux_loop_t* loop,
+                                      void (*compute_batch)(void* context, real_t t,
+                                                            fvpm_pair_block_t* block,
+                                                            int num_components,
+                                                            real_t* U,
+                                                            real_t* F))
+{
+  loop->compute_batch = compute_batch;
+}
+
+void fvpm_flux_loop_set_pairing(fvpm_flux_loop_t* loop,
+                                neighbor_pairing_t* pairing)
+{
+  loop->pairing = pairing;
+  loop->num_points = pair_loop_num_points(pairing);
+}
+
+void fvpm_flux_loop_set_block_size(fvpm_flux_loop_t* loop, int block_size)
+{
+  ASSERT(block_size > 0);
+  loop->block_size = block_size;
+}
+
+void fvpm_flux_loop_set_reconciles_ghosts(fvpm_flux_loop_t* loop, 
+                                          bool reconcile)
+{
+  loop->reconcile_ghosts = reconcile;
+}
+
+int fvpm_flux_loop_num_points(fvpm_flux_loop_t* loop)
+{
+  return loop->num_points;
+}
+
+// Computes the fluxes for a gathered block of pairs and accumulates them.
+static void compute_fluxes(fvpm_flux_loop_t* loop,
+                           real_t t,
+                           fvpm_pair_block_t* block,
+                           real_t* U,
+                           real_t* flux_sums)
+{
+  int nc = loop->num_comp;
+  real_t F[FVPM_PAIR_BLOCK_MAX_SIZE*nc];
+  memset(F, 0, sizeof(real_t) * FVPM_PAIR_BLOCK_MAX_SIZE * nc);
+  if (loop->compute_batch != NULL)
+    loop->compute_batch(loop->context, t, block, nc, U, F);
+  else
+  {
+    real_t Fp[nc];
+    for (int p = 0; p < block->num_pairs; ++p)
+    {
+      int i = block->i[p], j = block->j[p];
+      vector_t beta_ij = {.x = block->beta_x[p], 
+                          .y = block->beta_y[p], 
+                          .z = block->beta_z[p]};
+      memset(Fp, 0, sizeof(real_t) * nc);
+      loop->compute(loop->context, t, i, j, &U[nc*i], &U[nc*j], &beta_ij, Fp);
+      for (int c = 0; c < nc; ++c)
+        F[FVPM_PAIR_BLOCK_MAX_SIZE*c+p] = Fp[c];
+    }
+  }
+
+  for (int c = 0; c < nc; ++c)
+  {
+    for (int p = 0; p < block->num_pairs; ++p)
+    {
+      real_t Fpc = F[FVPM_PAIR_BLOCK_MAX_SIZE*c+p];
+      flux_sums[nc*block->i[p]+c] += Fpc;
+      flux_sums[nc*block->j[p]+c] -= Fpc;
+    }
+  }
+}
+
+static void compute_block(fvpm_flux_loop_t* loop,
+                          real_t t,
+                          int begin, int end,
+                          vector_t* betas,
+                          real_t* U,
+                          real_t* flux_sums)
+{
+  fvpm_pair_block_t block;
+  block.num_pairs = 0;
+  for (int k = begin; k < end; ++k)
+  {
+    // Pairs with no interparticle area exchange nothing.
+    vector_t* beta = &betas[k];
+    if ((beta->x == 0.0) && (beta->y == 0.0) && (beta->z == 0.0))
+      continue;
+
+    int p = block.num_pairs;
+    neighbor_pairing_get(loop->pairing, k, &block.i[p], &block.j[p], NULL);
+    block.beta_x[p] = beta->x;
+    block.beta_y[p] = beta->y;
+    block.beta_z[p] = beta->z;
+    ++block.num_pairs;
+    if (block.num_pairs == FVPM_PAIR_BLOCK_MAX_SIZE)
+    {
+      compute_fluxes(loop, t, &block, U, flux_sums);
+      block.num_pairs = 0;
+    }
+  }
+  if (block.num_pairs > 0)
+    compute_fluxes(loop, t, &block, U, flux_sums);
+}
+
+// Sends the flux sums for ghost points to the processes that own them, 
+// adds them to the sums for the corresponding points there, and zeros them.
+// This reverses the direction of the pairing's exchanger, whose receive 
+// indices are ghost points and whose send indices are the owned points 
+// they represent.
+static void reconcile_ghost_sums(fvpm_flux_loop_t* loop, real_t* flux_sums)
+{
+  exchanger_t* ex = loop->pairing->ex;
+  int num_sends = exchanger_num_receives(ex);
+  int num_receives = exchanger_num_sends(ex);
+  if ((num_sends == 0) && (num_receives == 0))
+    return;
+
+  START_FUNCTION_TIMER();
+  MPI_Comm comm = exchanger_comm(ex);
+  int nc = loop->num_comp;
+  real_t* send_bufs[MAX(num_sends, 1)];
+  real_t* receive_bufs[MAX(num_receives, 1)];
+  int* receive_indices[MAX(num_receives, 1)];
+  int receive_sizes[MAX(num_receives, 1)];
+  MPI_Request requests[MAX(num_sends + num_receives, 1)];
+  int r = 0;
+
+  // Post receives for the sums of our points that are ghosts elsewhere.
+  int pos = 0, proc, num_indices, *indices, n = 0;
+  while (exchanger_next_send(ex, &pos, &proc, &indices, &num_indices))
+  {
+    receive_bufs[n] = polymec_malloc(sizeof(real_t) * nc * MAX(num_indices, 1));
+    receive_indices[n] = indices;
+    receive_sizes[n] = num_indices;
+    MPI_Irecv(receive_bufs[n], nc * num_indices, MPI_REAL_T, proc, 0, comm, 
+              &requests[r++]);
+    ++n;
+  }
+
+  // Send the sums of our ghost points to their owners.
+  pos = 0, n = 0;
+  while (exchanger_next_receive(ex, &pos, &proc, &indices, &num_indices))
+  {
+    send_bufs[n] = polymec_malloc(sizeof(real_t) * nc * MAX(num_indices, 1));
+    for (int k = 0; k < num_indices; ++k)
+    {
+      for (int c = 0; c < nc; ++c)
+      {
+        send_bufs[n][nc*k+c] = flux_sums[nc*indices[k]+c];
+        flux_sums[nc*indices[k]+c] = 0.0;
+      }
+    }
+    MPI_Isend(send_bufs[n], nc * num_indices, MPI_REAL_T, proc, 0, comm, 
+              &requests[r++]);
+    ++n;
+  }
+  MPI_Waitall(r, requests, MPI_STATUSES_IGNORE);
+
+  // Add the received sums to our points.
+  for (int m = 0; m < num_receives; ++m)
+  {
+    for (int k = 0; k < receive_sizes[m]; ++k)
+    {
+      for (int c = 0; c < nc; ++c)
+        flux_sums[nc*receive_indices[m][k]+c] += receive_bufs[m][nc*k+c];
+    }
+    polymec_free(receive_bufs[m]);
+  }
+  for (int m = 0; m < num_sends; ++m)
+    polymec_free(send_bufs[m]);
+  STOP_FUNCTION_TIMER();
+}
+
+void fvpm_flux_loop_compute(fvpm_flux_loop_t* loop,
+                            real_t t,
+                            vector_t* betas,
+                            int num_points,
+                            real_t* U,
+                            real_t* flux_sums)
+{
+  ASSERT(num_points >= loop->num_points);
+  START_FUNCTION_TIMER();
+  pair_loop_buffers_reserve(&loop->bufs, loop->num_points);
+
+  int N = loop->num_points, nc = loop->num_comp;
+  int num_pairs = loop->pairing->num_pairs;
+  int block_size = loop->block_size;
+  int num_blocks = (num_pairs + block_size - 1) / block_size;
+  int num_threads = 1;
+
+#pragma omp parallel
+  {
+#pragma omp master
+    num_threads = pair_loop_team_size();
+
+    // Each thread zeros its own buffer and accumulates into it. The first 
+    // thread zeros all of the caller's flux sums.
+    int tid = pair_loop_thread_index();
+    real_t* thread_sums = (tid == 0) ? flux_sums : loop->bufs.bufs[tid];
+    memset(thread_sums, 0, sizeof(real_t) * nc * ((tid == 0) ? num_points : N));
+
+#pragma omp for schedule(dynamic)
+    for (int b = 0; b < num_blocks; ++b)
+    {
+      int begin = b * block_size;
+      int end = MIN(num_pairs, begin + block_size);
+      compute_block(loop, t, begin, end, betas, U, thread_sums);
+    }
+  }
+
+  // Reduce the contributions from the other threads.
+  if (num_threads > 1)
+  {
+#pragma omp parallel for
+    for (int i = 0; i < N; ++i)
+    {
+      for (int tid = 1; tid < num_threads; ++tid)
+      {
+        real_t* thread_sums = loop->bufs.bufs[tid];
+        for (int c = 0; c < nc; ++c)
+          flux_sums[nc*i+c] += thread_sums[nc*i+c];
+      }
+    }
+  }
+
+  if (loop->reconcile_ghosts)
+    reconcile_ghost_sums(loop, flux_sums);
+  STOP_FUNCTION_TIMER();
+}
+
@@ -0,0 +1,121 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef POLYWOG_FVPM_FLUX_LOOP_H
+#define POLYWOG_FVPM_FLUX_LOOP_H
+
+#include "model/neighbor_pairing.h"
+
+// The FVPM flux loop assembles the conservative pairwise fluxes of a Finite 
+// Volume Particle Method calculation. For each pair (i, j) of a neighbor 
+// pairing, it evaluates a numerical flux F_ij dotted with the interparticle
+// area vector beta_ij (see fvpm_interparticle_area.h), and adds F_ij to the
+// flux sum for i and -F_ij to that of j, so that whatever leaves i enters j.
+// If polywog is built with OpenMP, blocks of pairs are distributed among
+// threads, each of which accumulates into its own buffer, so no atomic 
+// updates are needed. These buffers are summed when the loop is finished.
+typedef struct fvpm_flux_loop_t fvpm_flux_loop_t;
+
+// This is the maximum number of pairs in a block of pairs handed to the 
+// batch flux function of an FVPM flux loop.
+#define FVPM_PAIR_BLOCK_MAX_SIZE 16
+
+// A block of pairs holds the data needed to evaluate the fluxes of several 
+// pairs (i, j) at once, in structure-of-arrays form. Only the first 
+// num_pairs entries of each array are meaningful.
+typedef struct
+{
+  int num_pairs;
+
+  // Indices of the points in each pair.
+  int i[FVPM_PAIR_BLOCK_MAX_SIZE], j[FVPM_PAIR_BLOCK_MAX_SIZE];
+
+  // Components of the interparticle area vectors beta_ij.
+  real_t beta_x[FVPM_PAIR_BLOCK_MAX_SIZE], 
+         beta_y[FVPM_PAIR_BLOCK_MAX_SIZE], 
+         beta_z[FVPM_PAIR_BLOCK_MAX_SIZE];
+} fvpm_pair_block_t;
+
+// Creates a flux loop over the pairs in the given neighbor pairing, for a 
+// solution with the given number of components per point. The given flux 
+// function computes the numerical flux F (with num_components components) 
+// from point i to point j at time t, dotted with the interparticle area 
+// vector beta_ij, given the solution vectors Ui and Uj. The loop does not 
+// assert ownership over the pairing, but the context is destroyed with the 
+// given destructor (if non-NULL) when the loop is.
+fvpm_flux_loop_t* fvpm_flux_loop_new(neighbor_pairing_t* pairing,
+                                     int num_components,
+                                     void* context,
+                                     void (*compute)(void* context, real_t t,
+                                                     int i, int j,
+                                                     real_t* Ui, real_t* Uj,
+                                                     vector_t* beta_ij,
+                                                     real_t* F),
+                                     void (*dtor)(void* context));
+
+// Destroys the given flux loop.
+void fvpm_flux_loop_free(fvpm_flux_loop_t* loop);
+
+// Gives the flux loop a function that computes the fluxes of a whole block 
+// of pairs at once, given the time t, the solution U for all points (in 
+// point-major order with num_components components), and the block of pair 
+// data. The fluxes are placed in F in component-major order: the flux of 
+// component c for the pth pair in the block is stored in 
+// F[FVPM_PAIR_BLOCK_MAX_SIZE*c + p]. F is zeroed before the function is 
+// called. The scalar flux function is used if no batch function is given.
+void fvpm_flux_loop_set_batch_compute(fvpm_flux_loop_t* loop,
+                                      void (*compute_batch)(void* context, real_t t,
+                                                            fvpm_pair_block_t* block,
+                                                            int num_components,
+                                                            real_t* U,
+                                                            real_t* F));
+
+// Sets the neighbor pairing whose pairs are traversed by the loop. This must
+// be called whenever the pairs in the loop's pairing change.
+void fvpm_flux_loop_set_pairing(fvpm_flux_loop_t* loop,
+                                neighbor_pairing_t* pairing);
+
+// Sets the number of pairs in a block, which is the unit of work that is
+// handed to a thread. By default, this is 512.
+void fvpm_flux_loop_set_block_size(fvpm_flux_loop_t* loop, int block_size);
+
+// Determines whether the flux sums accumulated for ghost points are sent 
+// back to the processes that own them (through the pairing's exchanger) and
+// added to the sums there. This is appropriate only when each pair that 
+// spans two processes appears in the pairing on just one of them. Pairings 
+// produced by partition_point_cloud_with_neighbors (and sph_neighbor_list) 
+// contain such pairs on both processes, so each process already computes 
+// the full flux sums for its own points, and reconciling the ghost sums 
+// would count those fluxes twice. By default, ghost sums are not 
+// reconciled.
+void fvpm_flux_loop_set_reconciles_ghosts(fvpm_flux_loop_t* loop, 
+                                          bool reconcile);
+
+// Returns the number of points (locally-owned and ghost) spanned by the 
+// pairs in the loop's pairing and by its exchanger. Arrays of point data 
+// handed to fvpm_flux_loop_compute must be at least this long.
+int fvpm_flux_loop_num_points(fvpm_flux_loop_t* loop);
+
+// Assembles the fluxes at time t, given the interparticle area vectors 
+// betas (indexed by pair, as computed by 
+// fvpm_interparticle_area_compute_pairs) and the solution U (in point-major 
+// order) for num_points points (locally-owned and ghost), which must be at 
+// least fvpm_flux_loop_num_points(loop). The sum of the fluxes for each 
+// point is placed in flux_sums (also in point-major order, with room for 
+// num_points points), which is zeroed first:
+//   flux_sums_i = sum_j F_ij, where F_ji = -F_ij.
+// If ghost sums are reconciled, the sums for ghost points are added to 
+// those of the points they represent on other processes, and then zeroed.
+void fvpm_flux_loop_compute(fvpm_flux_loop_t* loop,
+                            real_t t,
+                            vector_t* betas,
+                            int num_points,
+                            real_t* U,
+                            real_t* flux_sums);
+
+#endif
+
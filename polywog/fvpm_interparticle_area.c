@@ -5,6 +5,7 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+#include "core/timer.h"
 #include "polywog/fvpm_interparticle_area.h"
 
 struct fvpm_interparticle_area_t 
@@ -13,12 +14,267 @@ struct fvpm_interparticle_area_t
   real_t* extents;
   real_t overlap;
   point_spacing_estimator_t* dx_estimator;
+
+  // Computes beta_ij given the positions and extents of i and j, treating 
+  // them as an isolated pair.
+  void (*compute)(point_t* xi, real_t hi, point_t* xj, real_t hj, vector_t* beta_ij);
+
+  // Computes beta_ij given the positions and extents of all points, and the 
+  // indices of the points whose supports may overlap those of i and j, or 
+  // NULL if the isolated pair formula is used for pairs, too. work is 
+  // created by work_new for neighborhoods of up to a given size, and freed 
+  // by work_free.
+  void (*compute_in_neighborhood)(point_t* x, real_t* h, int i, int j, 
+                                  int* neighbors, int num_neighbors, 
+                                  void* work, vector_t* beta_ij);
+  void* (*work_new)(int max_neighbors);
+  void (*work_free)(void* work);
+
+  // Cached area vectors, along with the pairs, positions, and extents for 
+  // which they were computed.
+  int num_pairs, num_points;
+  int* pairs;
+  point_t* x;
+  real_t* h;
+  vector_t* betas;
 };
 
-fvpm_interparticle_area_t* sphere_fvpm_interparticle_area_new(point_cloud_t* cloud,
+// Spheres of radius h intersect in a lens bounded by a circle of radius a. 
+// The boundary of each sphere within the other is a spherical cap whose 
+// area vector is pi * a**2 along the line between the centers.
+static void sphere_compute(point_t* xi, real_t hi, 
+                           point_t* xj, real_t hj, 
+                           vector_t* beta_ij)
+{
+  vector_t e_ij;
+  point_displacement(xi, xj, &e_ij);
+  real_t d = vector_mag(&e_ij);
+  if ((d == 0.0) || (d >= hi + hj) || (d <= fabs(hi - hj)))
+  {
+    beta_ij->x = beta_ij->y = beta_ij->z = 0.0;
+    return;
+  }
+
+  // Distance from x_i to the plane of the intersection circle.
+  real_t s = 0.5 * (d*d + hi*hi - hj*hj) / d;
+  real_t a2 = hi*hi - s*s;
+  real_t factor = M_PI * a2 / d;
+  beta_ij->x = factor * e_ij.x;
+  beta_ij->y = factor * e_ij.y;
+  beta_ij->z = factor * e_ij.z;
+}
+
+// Cubes of side h intersect in a box. Each face of the box lies on the 
+// boundary of one (or, if the faces coincide, both) of the cubes. 
+static void cube_compute(point_t* xi, real_t hi, 
+                         point_t* xj, real_t hj, 
+                         vector_t* beta_ij)
+{
+  real_t lo_i[3] = {xi->x - 0.5*hi, xi->y - 0.5*hi, xi->z - 0.5*hi};
+  real_t hi_i[3] = {xi->x + 0.5*hi, xi->y + 0.5*hi, xi->z + 0.5*hi};
+  real_t lo_j[3] = {xj->x - 0.5*hj, xj->y - 0.5*hj, xj->z - 0.5*hj};
+  real_t hi_j[3] = {xj->x + 0.5*hj, xj->y + 0.5*hj, xj->z + 0.5*hj};
+
+  // Find the extent of the box along each axis.
+  real_t L[3];
+  for (int d = 0; d < 3; ++d)
+  {
+    L[d] = MIN(hi_i[d], hi_j[d]) - MAX(lo_i[d], lo_j[d]);
+    if (L[d] <= 0.0)
+    {
+      beta_ij->x = beta_ij->y = beta_ij->z = 0.0;
+      return;
+    }
+  }
+
+  // Sum the contributions of the faces normal to each axis to 
+  // (S_i - S_j) / 2. Faces shared by both cubes cancel.
+  real_t beta[3];
+  for (int d = 0; d < 3; ++d)
+  {
+    real_t A = L[(d+1)%3] * L[(d+2)%3];
+    beta[d] = 0.0;
+
+    // The lower face has its outward normal along -e_d.
+    if (lo_i[d] > lo_j[d])
+      beta[d] -= 0.5 * A;
+    else if (lo_j[d] > lo_i[d])
+      beta[d] += 0.5 * A;
+
+    // The upper face has its outward normal along +e_d.
+    if (hi_i[d] < hi_j[d])
+      beta[d] += 0.5 * A;
+    else if (hi_j[d] < hi_i[d])
+      beta[d] -= 0.5 * A;
+  }
+  beta_ij->x = beta[0];
+  beta_ij->y = beta[1];
+  beta_ij->z = beta[2];
+}
+
+// Work space for cube_compute_in_neighborhood for neighborhoods of up to 
+// max_neighbors points.
+typedef struct
+{
+  int* covers;
+  real_t *u, *v;
+} cube_work_t;
+
+static void* cube_work_new(int max_neighbors)
+{
+  cube_work_t* work = polymec_malloc(sizeof(cube_work_t));
+  work->covers = polymec_malloc(sizeof(int) * MAX(max_neighbors, 1));
+  work->u = polymec_malloc(sizeof(real_t) * (2*max_neighbors + 2));
+  work->v = polymec_malloc(sizeof(real_t) * (2*max_neighbors + 2));
+  return work;
+}
+
+static void cube_work_free(void* work)
+{
+  cube_work_t* w = work;
+  polymec_free(w->covers);
+  polymec_free(w->u);
+  polymec_free(w->v);
+  polymec_free(w);
+}
+
+static int real_cmp(const void* l, const void* r)
+{
+  real_t a = *((const real_t*)l), b = *((const real_t*)r);
+  return (a < b) ? -1 : (a > b) ? 1 : 0;
+}
+
+// Sorts the n coordinates in u and removes duplicates, returning the number 
+// that remain.
+static int sort_breakpoints(real_t* u, int n)
+{
+  qsort(u, n, sizeof(real_t), real_cmp);
+  int m = 1;
+  for (int k = 1; k < n; ++k)
+  {
+    if (u[k] > u[m-1])
+      u[m++] = u[k];
+  }
+  return m;
+}
+
+// Adds sign times the integral of n_a / (sigma_in * sigma_out) over the part 
+// of the boundary of cube a across which the support of b continues to 
+// beta. Here, n_a is the outward normal of cube a, and sigma_in and 
+// sigma_out are the numbers of supports covering a point just inside and 
+// just outside of cube a. This is the contribution of the faces of a to 
+// beta_ab (sign = 1) or beta_ba (sign = -1). Every face is split into 
+// rectangles on which sigma_in and sigma_out are constant, so the integral 
+// is exact.
+static void add_cube_face_terms(point_t* x, real_t* h, int a, int b, 
+                                int* neighbors, int num_neighbors, 
+                                cube_work_t* work, real_t sign, 
+                                real_t* beta)
+{
+  real_t lo_a[3] = {x[a].x - 0.5*h[a], x[a].y - 0.5*h[a], x[a].z - 0.5*h[a]};
+  real_t hi_a[3] = {x[a].x + 0.5*h[a], x[a].y + 0.5*h[a], x[a].z + 0.5*h[a]};
+  real_t lo_b[3] = {x[b].x - 0.5*h[b], x[b].y - 0.5*h[b], x[b].z - 0.5*h[b]};
+  real_t hi_b[3] = {x[b].x + 0.5*h[b], x[b].y + 0.5*h[b], x[b].z + 0.5*h[b]};
+  for (int d = 0; d < 3; ++d)
+  {
+    int d1 = (d+1)%3, d2 = (d+2)%3;
+
+    // The part of each face within cube b.
+    real_t u1 = MAX(lo_a[d1], lo_b[d1]), u2 = MIN(hi_a[d1], hi_b[d1]);
+    real_t v1 = MAX(lo_a[d2], lo_b[d2]), v2 = MIN(hi_a[d2], hi_b[d2]);
+    if ((u1 >= u2) || (v1 >= v2)) continue;
+
+    for (int s = -1; s <= 1; s += 2)
+    {
+      // The support of b must straddle the face.
+      real_t p = (s < 0) ? lo_a[d] : hi_a[d];
+      if ((p <= lo_b[d]) || (p >= hi_b[d])) continue;
+
+      // Find the other cubes that touch this part of the face, and the 
+      // breakpoints of sigma along it.
+      int num_covers = 0, nu = 0, nv = 0;
+      real_t* u = work->u;
+      real_t* v = work->v;
+      u[nu++] = u1; u[nu++] = u2;
+      v[nv++] = v1; v[nv++] = v2;
+      for (int n = 0; n < num_neighbors; ++n)
+      {
+        int k = neighbors[n];
+        if ((k == a) || (k == b)) continue;
+        real_t* xk = (real_t*)&x[k];
+        real_t lo_k = xk[d] - 0.5*h[k], hi_k = xk[d] + 0.5*h[k];
+        real_t lo_k1 = xk[d1] - 0.5*h[k], hi_k1 = xk[d1] + 0.5*h[k];
+        real_t lo_k2 = xk[d2] - 0.5*h[k], hi_k2 = xk[d2] + 0.5*h[k];
+        if ((p < lo_k) || (p > hi_k) || 
+            (hi_k1 <= u1) || (lo_k1 >= u2) || 
+            (hi_k2 <= v1) || (lo_k2 >= v2))
+          continue;
+        work->covers[num_covers++] = k;
+        if (lo_k1 > u1) u[nu++] = lo_k1;
+        if (hi_k1 < u2) u[nu++] = hi_k1;
+        if (lo_k2 > v1) v[nv++] = lo_k2;
+        if (hi_k2 < v2) v[nv++] = hi_k2;
+      }
+      nu = sort_breakpoints(u, nu);
+      nv = sort_breakpoints(v, nv);
+
+      // Integrate over the rectangles between the breakpoints. a and b cover 
+      // the inside of the face, and b (only) covers the outside.
+      real_t integral = 0.0;
+      for (int m = 0; m < nu-1; ++m)
+      {
+        real_t cu = 0.5 * (u[m] + u[m+1]);
+        for (int n = 0; n < nv-1; ++n)
+        {
+          real_t cv = 0.5 * (v[n] + v[n+1]);
+          int sigma_in = 2, sigma_out = 1;
+          for (int c = 0; c < num_covers; ++c)
+          {
+            int k = work->covers[c];
+            real_t* xk = (real_t*)&x[k];
+            if ((fabs(cu - xk[d1]) >= 0.5*h[k]) || (fabs(cv - xk[d2]) >= 0.5*h[k]))
+              continue;
+            real_t lo_k = xk[d] - 0.5*h[k], hi_k = xk[d] + 0.5*h[k];
+            bool lo_inside = (s < 0) ? (lo_k <= p) : (lo_k < p);
+            bool hi_inside = (s < 0) ? (p < hi_k) : (p <= hi_k);
+            bool lo_outside = (s < 0) ? (lo_k < p) : (lo_k <= p);
+            bool hi_outside = (s < 0) ? (p <= hi_k) : (p < hi_k);
+            if (lo_inside && hi_inside) ++sigma_in;
+            if (lo_outside && hi_outside) ++sigma_out;
+          }
+          integral += (u[m+1] - u[m]) * (v[n+1] - v[n]) / (sigma_in * sigma_out);
+        }
+      }
+      beta[d] += sign * s * integral;
+    }
+  }
+}
+
+// Within the neighborhood of a pair, the partition of unity at a point is 
+// shared by all the cubes that cover it. Following Quinlan et al, beta_ij is 
+// then a sum of integrals over the faces of cubes i and j across which the 
+// partition of unity functions of i and j jump. For an isolated pair, this 
+// reduces to cube_compute.
+static void cube_compute_in_neighborhood(point_t* x, real_t* h, int i, int j, 
+                                         int* neighbors, int num_neighbors, 
+                                         void* work, vector_t* beta_ij)
+{
+  real_t beta[3] = {0.0, 0.0, 0.0};
+  add_cube_face_terms(x, h, i, j, neighbors, num_neighbors, work, 1.0, beta);
+  add_cube_face_terms(x, h, j, i, neighbors, num_neighbors, work, -1.0, beta);
+  beta_ij->x = beta[0];
+  beta_ij->y = beta[1];
+  beta_ij->z = beta[2];
+}
+
+static fvpm_interparticle_area_t* fvpm_interparticle_area_new(point_cloud_t* cloud,
                                                               real_t* extents,
                                                               real_t overlap_parameter,
-                                                              point_spacing_estimator_t* dx_estimator)
+                                                              point_spacing_estimator_t* dx_estimator,
+                                                              void (*compute)(point_t*, real_t, point_t*, real_t, vector_t*),
+                                                              void (*compute_in_neighborhood)(point_t*, real_t*, int, int, int*, int, void*, vector_t*),
+                                                              void* (*work_new)(int),
+                                                              void (*work_free)(void*))
 {
   ASSERT(overlap_parameter > 0.0);
 
@@ -27,27 +283,51 @@ fvpm_interparticle_area_t* sphere_fvpm_interparticle_area_new(point_cloud_t* clo
   area->extents = extents;
   area->overlap = overlap_parameter;
   area->dx_estimator = dx_estimator;
+  area->compute = compute;
+  area->compute_in_neighborhood = compute_in_neighborhood;
+  area->work_new = work_new;
+  area->work_free = work_free;
+  area->num_pairs = -1;
+  area->num_points = 0;
+  area->pairs = NULL;
+  area->x = NULL;
+  area->h = NULL;
+  area->betas = NULL;
   return area;
 }
 
+fvpm_interparticle_area_t* sphere_fvpm_interparticle_area_new(point_cloud_t* cloud,
+                                                              real_t* extents,
+                                                              real_t overlap_parameter,
+                                                              point_spacing_estimator_t* dx_estimator)
+{
+  return fvpm_interparticle_area_new(cloud, extents, overlap_parameter, 
+                                     dx_estimator, sphere_compute, 
+                                     NULL, NULL, NULL);
+}
+
 fvpm_interparticle_area_t* cube_fvpm_interparticle_area_new(point_cloud_t* cloud,
                                                             real_t* extents,
                                                             real_t overlap_parameter,
                                                             point_spacing_estimator_t* dx_estimator)
 {
-  ASSERT(overlap_parameter > 0.0);
-
-  fvpm_interparticle_area_t* area = polymec_malloc(sizeof(fvpm_interparticle_area_t));
-  area->points = cloud;
-  area->extents = extents;
-  area->overlap = overlap_parameter;
-  area->dx_estimator = dx_estimator;
-  return area;
+  return fvpm_interparticle_area_new(cloud, extents, overlap_parameter, 
+                                     dx_estimator, cube_compute, 
+                                     cube_compute_in_neighborhood, 
+                                     cube_work_new, cube_work_free);
 }
 
 void fvpm_interparticle_area_free(fvpm_interparticle_area_t* area)
 {
   area->dx_estimator = NULL;
+  if (area->pairs != NULL)
+    polymec_free(area->pairs);
+  if (area->x != NULL)
+    polymec_free(area->x);
+  if (area->h != NULL)
+    polymec_free(area->h);
+  if (area->betas != NULL)
+    polymec_free(area->betas);
   polymec_free(area);
 }
 
@@ -55,5 +335,111 @@ void fvpm_interparticle_area_compute(fvpm_interparticle_area_t* area,
                                      int i, int j,
                                      vector_t* beta_ij)
 {
+  point_t* x = area->points->points;
+  area->compute(&x[i], area->extents[i], &x[j], area->extents[j], beta_ij);
+}
+
+// Returns true if the cached area vectors were computed for the given 
+// pairing and the current positions and extents of the points.
+static bool cache_is_valid(fvpm_interparticle_area_t* area,
+                           neighbor_pairing_t* pairing)
+{
+  int N = area->points->num_points + area->points->num_ghosts;
+  return ((pairing->num_pairs == area->num_pairs) && 
+          (N == area->num_points) && 
+          (memcmp(pairing->pairs, area->pairs, sizeof(int) * 2 * pairing->num_pairs) == 0) &&
+          (memcmp(area->points->points, area->x, sizeof(point_t) * N) == 0) &&
+          (memcmp(area->extents, area->h, sizeof(real_t) * N) == 0));
+}
+
+void fvpm_interparticle_area_compute_pairs(fvpm_interparticle_area_t* area,
+                                           neighbor_pairing_t* pairing,
+                                           vector_t* betas)
+{
+  START_FUNCTION_TIMER();
+  int num_pairs = pairing->num_pairs;
+  if (!cache_is_valid(area, pairing))
+  {
+    // Take a snapshot of the pairs, positions, and extents.
+    int N = area->points->num_points + area->points->num_ghosts;
+    if (num_pairs != area->num_pairs)
+    {
+      area->pairs = polymec_realloc(area->pairs, sizeof(int) * 2 * MAX(num_pairs, 1));
+      area->betas = polymec_realloc(area->betas, sizeof(vector_t) * MAX(num_pairs, 1));
+      area->num_pairs = num_pairs;
+    }
+    if (N != area->num_points)
+    {
+      area->x = polymec_realloc(area->x, sizeof(point_t) * MAX(N, 1));
+      area->h = polymec_realloc(area->h, sizeof(real_t) * MAX(N, 1));
+      area->num_points = N;
+    }
+    memcpy(area->pairs, pairing->pairs, sizeof(int) * 2 * num_pairs);
+    memcpy(area->x, area->points->points, sizeof(point_t) * N);
+    memcpy(area->h, area->extents, sizeof(real_t) * N);
+
+    // Each pair is evaluated once, since beta_ji = -beta_ij.
+    point_t* x = area->x;
+    real_t* h = area->h;
+    if (area->compute_in_neighborhood == NULL)
+    {
+#pragma omp parallel for
+      for (int k = 0; k < num_pairs; ++k)
+      {
+        int i = area->pairs[2*k], j = area->pairs[2*k+1];
+        area->compute(&x[i], h[i], &x[j], h[j], &area->betas[k]);
+      }
+    }
+    else
+    {
+      // Gather the neighbors of each point. Every support that overlaps 
+      // those of both i and j overlaps that of a locally-owned one of them, 
+      // so we use its neighborhood.
+      int* offsets = polymec_malloc(sizeof(int) * (N+1));
+      memset(offsets, 0, sizeof(int) * (N+1));
+      for (int k = 0; k < num_pairs; ++k)
+      {
+        ++offsets[area->pairs[2*k]+1];
+        ++offsets[area->pairs[2*k+1]+1];
+      }
+      int max_neighbors = 0;
+      for (int i = 0; i < N; ++i)
+      {
+        max_neighbors = MAX(max_neighbors, offsets[i+1]);
+        offsets[i+1] += offsets[i];
+      }
+      int* neighbors = polymec_malloc(sizeof(int) * MAX(offsets[N], 1));
+      int* counts = polymec_malloc(sizeof(int) * MAX(N, 1));
+      memset(counts, 0, sizeof(int) * MAX(N, 1));
+      for (int k = 0; k < num_pairs; ++k)
+      {
+        int i = area->pairs[2*k], j = area->pairs[2*k+1];
+        neighbors[offsets[i] + counts[i]++] = j;
+        neighbors[offsets[j] + counts[j]++] = i;
+      }
+      polymec_free(counts);
+
+      int num_points = area->points->num_points;
+#pragma omp parallel
+      {
+        void* work = area->work_new(max_neighbors);
+#pragma omp for
+        for (int k = 0; k < num_pairs; ++k)
+        {
+          int i = area->pairs[2*k], j = area->pairs[2*k+1];
+          int c = (i < num_points) ? i : j;
+          area->compute_in_neighborhood(x, h, i, j, 
+                                        &neighbors[offsets[c]], 
+                                        offsets[c+1] - offsets[c], 
+                                        work, &area->betas[k]);
+        }
+        area->work_free(work);
+      }
+      polymec_free(neighbors);
+      polymec_free(offsets);
+    }
+  }
+  memcpy(betas, area->betas, sizeof(vector_t) * num_pairs);
+  STOP_FUNCTION_TIMER();
 }
 
@@ -13,8 +13,29 @@
 #include "model/point_spacing_estimator.h"
 
 // This class computes interparticle areas (denoted as beta_ij in the FVPM
-// literature, e.g. Quinlan et al / CPC 185 (2014) 1554. It exactly integrates
-// 
+// literature, e.g. Quinlan et al / CPC 185 (2014) 1554), using top-hat 
+// kernels whose supports are spheres or axis-aligned cubes. The interparticle
+// area vector points from i toward j, and is antisymmetric: beta_ji = -beta_ij.
+//
+// For cubes, beta_ij is computed exactly from the partition of unity shared 
+// by all the cubes that overlap those of i and j, integrating over the faces 
+// of the cubes of i and j on rectangles on which the number of overlapping 
+// cubes is constant. This requires the neighborhoods of the points, so it is 
+// done only by fvpm_interparticle_area_compute_pairs, and the resulting 
+// areas satisfy sum_j beta_ij = 0 for any particle i whose support lies 
+// within the union of the supports of its neighbors.
+//
+// For spheres, and for individual pairs of cubes, beta_ij is computed as 
+// though i and j were an isolated pair, sharing the partition of unity 
+// equally within the intersection of their supports. This is exact only for 
+// an isolated pair, and is otherwise an approximation. For spheres, 
+// beta_ij = pi * a**2 * e_ij, where a is the radius of the circle in which 
+// the spheres intersect and e_ij is the unit vector from x_i to x_j. For 
+// cubes, beta_ij = (S_i - S_j) / 2, where S_i is the sum of the (outward)
+// area vectors of the faces of the intersection of the cubes that lie on 
+// the boundary of cube i. Particles with no boundary intersection 
+// (including a particle whose support lies entirely within that of another)
+// have vanishing interparticle areas.
 typedef struct fvpm_interparticle_area_t fvpm_interparticle_area_t;
 
 // Creates an object to compute interparticle areas for a distribution of 
@@ -41,9 +62,21 @@ fvpm_interparticle_area_t* cube_fvpm_interparticle_area_new(point_cloud_t* cloud
 void fvpm_interparticle_area_free(fvpm_interparticle_area_t* area);
 
 // Computes the interparticle area vector beta_ij for the given nodes i and j, 
-// placing the components into beta_ij.
+// treated as an isolated pair, placing the components into beta_ij.
 void fvpm_interparticle_area_compute(fvpm_interparticle_area_t* area, 
                                      int i, int j,
                                      vector_t* beta_ij);
 
+// Computes the interparticle area vectors for all the pairs (i, j) in the 
+// given neighbor pairing, placing beta_ij for the kth pair into betas[k] 
+// (and implying beta_ji = -betas[k]). For cubes, the pairing must contain 
+// every pair of points whose supports overlap (and have a locally-owned 
+// point), since these define the neighborhoods of the points. The pairs are 
+// evaluated in parallel. The area vectors are cached, and are only 
+// recomputed when the pairs, the positions of the points in the cloud, or 
+// their extents have changed since the last call.
+void fvpm_interparticle_area_compute_pairs(fvpm_interparticle_area_t* area,
+                                           neighbor_pairing_t* pairing,
+                                           vector_t* betas);
+
 #endif
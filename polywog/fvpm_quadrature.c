@@ -5,6 +5,7 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+#include "core/timer.h"
 #include "integrators/gauss_rules.h"
 #include "polywog/fvpm_quadrature.h"
 
@@ -42,8 +43,8 @@ static void fvpm_simple_free(void* context)
 
 static inline void get_cubes(fvpm_simple_t* fvpm, int i, int j, bbox_t* boxi, bbox_t* boxj)
 {
-  // Construct the two cubes and the intersection of their surfaces. This can 
-  // be a point, a line segment, or a rectangular plane segment.
+  // Construct the two cubes. Their intersection can be empty, a point, a 
+  // line segment, a rectangular plane segment, or a box.
   point_t* xi = &fvpm->cloud->points[i];
   real_t hi = fvpm->extents[i];
   real_t Li = fvpm->ratio * hi;
@@ -65,35 +66,127 @@ static inline void get_cubes(fvpm_simple_t* fvpm, int i, int j, bbox_t* boxi, bb
   boxj->z2 = xj->z + 0.5*Lj;
 }
 
-static int cube_surf_num_quad_points(void* context, int k)
+// Computes the intersection of the cubes for the kth pair.
+static void get_cube_intersection(fvpm_simple_t* fvpm, int k, bbox_t* box_int)
 {
-  fvpm_simple_t* fvpm = context;
   int i, j;
   neighbor_pairing_get(fvpm->pairing, k, &i, &j, NULL);
-  bbox_t boxi, boxj, box_int;
-  get_cubes(fvpm, i, j, &boxi, &boxj);
+  bbox_t boxi, boxj;
   get_cubes(fvpm, i, j, &boxi, &boxj);
-  bbox_intersect_bbox(&boxi, &boxj, &box_int);
+  bbox_intersect_bbox(&boxi, &boxj, box_int);
+}
+
+// Maps the Gauss-Legendre points and weights on [-1, 1] to [a, b].
+static inline void map_gauss_rule(int N, real_t* gauss_pts, real_t* gauss_wts, 
+                                  real_t a, real_t b, 
+                                  real_t* pts, real_t* wts)
+{
+  for (int n = 0; n < N; ++n)
+  {
+    pts[n] = 0.5 * ((b - a) * gauss_pts[n] + (b + a));
+    wts[n] = 0.5 * (b - a) * gauss_wts[n];
+  }
+}
+
+// Places a tensor-product Gauss rule on the face of the given box that is 
+// normal to the given axis (0, 1, 2 for x, y, z) at the given coordinate, 
+// with the given normal vector.
+static void get_face_quad(int N, real_t* gauss_pts, real_t* gauss_wts, 
+                          bbox_t* box, int axis, real_t coord, vector_t* normal,
+                          point_t* points, real_t* weights, vector_t* normals)
+{
+  real_t lo[3] = {box->x1, box->y1, box->z1};
+  real_t hi[3] = {box->x2, box->y2, box->z2};
+  int a1 = (axis + 1) % 3, a2 = (axis + 2) % 3;
+  real_t p1[N], w1[N], p2[N], w2[N];
+  map_gauss_rule(N, gauss_pts, gauss_wts, lo[a1], hi[a1], p1, w1);
+  map_gauss_rule(N, gauss_pts, gauss_wts, lo[a2], hi[a2], p2, w2);
+  int q = 0;
+  for (int n1 = 0; n1 < N; ++n1)
+  {
+    for (int n2 = 0; n2 < N; ++n2, ++q)
+    {
+      real_t x[3];
+      x[axis] = coord;
+      x[a1] = p1[n1];
+      x[a2] = p2[n2];
+      points[q].x = x[0];
+      points[q].y = x[1];
+      points[q].z = x[2];
+      weights[q] = w1[n1] * w2[n2];
+      normals[q] = *normal;
+    }
+  }
+}
+
+// The surface of the intersection of two cubes is the boundary of the 
+// intersection box, whose 6 faces each get an N x N Gauss rule. If the cubes
+// only touch on a plane segment, that segment gets a single N x N rule.
+static int cube_surf_num_quad_points(void* context, int k)
+{
+  fvpm_simple_t* fvpm = context;
+  bbox_t box_int;
+  get_cube_intersection(fvpm, k, &box_int);
   if (bbox_is_empty_set(&box_int) || bbox_is_point(&box_int) || bbox_is_line(&box_int))
     return 0;
-  else
+  else if (bbox_is_plane(&box_int))
     return fvpm->N * fvpm->N;
+  else
+    return 6 * fvpm->N * fvpm->N;
 }
 
 static void cube_surf_get_quad(void* context, int k, point_t* points, real_t* weights, vector_t* normals)
 {
   fvpm_simple_t* fvpm = context;
-  real_t gauss_pts[fvpm->N], gauss_wts[fvpm->N];
-  get_gauss_legendre_points(fvpm->N, gauss_wts, gauss_wts);
+  int N = fvpm->N;
+  real_t gauss_pts[N], gauss_wts[N];
+  get_gauss_legendre_points(N, gauss_pts, gauss_wts);
 
   // Get the bounding boxes for the kth pair.
   int i, j;
+  neighbor_pairing_get(fvpm->pairing, k, &i, &j, NULL);
   bbox_t boxi, boxj, box_int;
   get_cubes(fvpm, i, j, &boxi, &boxj);
   bbox_intersect_bbox(&boxi, &boxj, &box_int);
   ASSERT(!bbox_is_empty_set(&box_int) && !bbox_is_point(&box_int) && !bbox_is_line(&box_int));
 
-  // FIXME: It remains to implement the quadrature for this rule.
+  real_t lo[3] = {box_int.x1, box_int.y1, box_int.z1};
+  real_t hi[3] = {box_int.x2, box_int.y2, box_int.z2};
+  if (bbox_is_plane(&box_int))
+  {
+    // The normal of the plane segment points from i toward j.
+    int axis = (lo[0] == hi[0]) ? 0 : (lo[1] == hi[1]) ? 1 : 2;
+    point_t* xi = &fvpm->cloud->points[i];
+    point_t* xj = &fvpm->cloud->points[j];
+    real_t dx[3] = {xj->x - xi->x, xj->y - xi->y, xj->z - xi->z};
+    vector_t n = {.x = 0.0, .y = 0.0, .z = 0.0};
+    real_t sign = (dx[axis] >= 0.0) ? 1.0 : -1.0;
+    if (axis == 0) n.x = sign;
+    else if (axis == 1) n.y = sign;
+    else n.z = sign;
+    get_face_quad(N, gauss_pts, gauss_wts, &box_int, axis, lo[axis], &n, 
+                  points, weights, normals);
+  }
+  else
+  {
+    // Traverse the faces of the box with their outward normals.
+    int q = 0;
+    for (int axis = 0; axis < 3; ++axis)
+    {
+      for (int side = 0; side < 2; ++side)
+      {
+        vector_t n = {.x = 0.0, .y = 0.0, .z = 0.0};
+        real_t sign = (side == 0) ? -1.0 : 1.0;
+        if (axis == 0) n.x = sign;
+        else if (axis == 1) n.y = sign;
+        else n.z = sign;
+        real_t coord = (side == 0) ? lo[axis] : hi[axis];
+        get_face_quad(N, gauss_pts, gauss_wts, &box_int, axis, coord, &n, 
+                      &points[q], &weights[q], &normals[q]);
+        q += N*N;
+      }
+    }
+  }
 }
 
 surface_integral_t* fvpm_cube_surface_integral_new(point_cloud_t* cloud,
@@ -115,12 +208,8 @@ surface_integral_t* fvpm_cube_surface_integral_new(point_cloud_t* cloud,
 static int cube_vol_num_quad_points(void* context, int k)
 {
   fvpm_simple_t* fvpm = context;
-  int i, j;
-  neighbor_pairing_get(fvpm->pairing, k, &i, &j, NULL);
-  bbox_t boxi, boxj, box_int;
-  get_cubes(fvpm, i, j, &boxi, &boxj);
-  get_cubes(fvpm, i, j, &boxi, &boxj);
-  bbox_intersect_bbox(&boxi, &boxj, &box_int);
+  bbox_t box_int;
+  get_cube_intersection(fvpm, k, &box_int);
   if (bbox_is_empty_set(&box_int) || bbox_is_point(&box_int) || bbox_is_line(&box_int) || bbox_is_plane(&box_int))
     return 0;
   else
@@ -130,17 +219,34 @@ static int cube_vol_num_quad_points(void* context, int k)
 static void cube_vol_get_quad(void* context, int k, point_t* points, real_t* weights)
 {
   fvpm_simple_t* fvpm = context;
-  real_t gauss_pts[fvpm->N], gauss_wts[fvpm->N];
-  get_gauss_legendre_points(fvpm->N, gauss_wts, gauss_wts);
+  int N = fvpm->N;
+  real_t gauss_pts[N], gauss_wts[N];
+  get_gauss_legendre_points(N, gauss_pts, gauss_wts);
 
-  // Get the bounding boxes for the kth pair.
-  int i, j;
-  bbox_t boxi, boxj, box_int;
-  get_cubes(fvpm, i, j, &boxi, &boxj);
-  bbox_intersect_bbox(&boxi, &boxj, &box_int);
+  // Get the intersection of the cubes for the kth pair.
+  bbox_t box_int;
+  get_cube_intersection(fvpm, k, &box_int);
   ASSERT(!bbox_is_empty_set(&box_int) && !bbox_is_point(&box_int) && !bbox_is_line(&box_int) && !bbox_is_plane(&box_int));
 
-  // FIXME: It remains to implement the quadrature for this rule.
+  // Use a tensor product of Gauss rules over the box.
+  real_t px[N], wx[N], py[N], wy[N], pz[N], wz[N];
+  map_gauss_rule(N, gauss_pts, gauss_wts, box_int.x1, box_int.x2, px, wx);
+  map_gauss_rule(N, gauss_pts, gauss_wts, box_int.y1, box_int.y2, py, wy);
+  map_gauss_rule(N, gauss_pts, gauss_wts, box_int.z1, box_int.z2, pz, wz);
+  int q = 0;
+  for (int a = 0; a < N; ++a)
+  {
+    for (int b = 0; b < N; ++b)
+    {
+      for (int c = 0; c < N; ++c, ++q)
+      {
+        points[q].x = px[a];
+        points[q].y = py[b];
+        points[q].z = pz[c];
+        weights[q] = wx[a] * wy[b] * wz[c];
+      }
+    }
+  }
 }
 
 volume_integral_t* fvpm_cube_volume_integral_new(point_cloud_t* cloud,
@@ -159,35 +265,138 @@ volume_integral_t* fvpm_cube_volume_integral_new(point_cloud_t* cloud,
   return volume_integral_new(name, fvpm, vtable);
 }
 
-static int sphere_surf_num_quad_points(void* context, int k)
+// A spherical cap is the part of a sphere (with the given center and 
+// radius) lying beyond the plane at the given distance (base) from its 
+// center along the given unit axis.
+typedef struct
+{
+  point_t center;
+  real_t radius, base;
+  vector_t axis, t1, t2;
+} cap_t;
+
+// Constructs a cap, along with two unit vectors t1 and t2 that complete an
+// orthonormal frame with its axis.
+static void cap_init(cap_t* cap, point_t* center, real_t radius, 
+                     vector_t* axis, real_t base)
+{
+  cap->center = *center;
+  cap->radius = radius;
+  cap->base = base;
+  cap->axis = *axis;
+
+  // Cross the axis with the coordinate direction least aligned with it.
+  vector_t e = {.x = 0.0, .y = 0.0, .z = 0.0};
+  if ((fabs(axis->x) <= fabs(axis->y)) && (fabs(axis->x) <= fabs(axis->z)))
+    e.x = 1.0;
+  else if (fabs(axis->y) <= fabs(axis->z))
+    e.y = 1.0;
+  else
+    e.z = 1.0;
+  vector_cross(axis, &e, &cap->t1);
+  vector_normalize(&cap->t1);
+  vector_cross(axis, &cap->t1, &cap->t2);
+}
+
+// Decomposes the intersection of the spheres for the kth pair into two 
+// spherical caps, returning 2, or returns 0 if the spheres don't overlap. 
+// If the spheres intersect in a lens, the caps are the parts of sphere i 
+// and sphere j that lie on either side of the plane of their intersection. 
+// If one sphere lies within the other, the caps are the two halves of the 
+// smaller sphere.
+static int get_caps(fvpm_simple_t* fvpm, int k, cap_t* caps)
 {
-  fvpm_simple_t* fvpm = context;
   int i, j;
   neighbor_pairing_get(fvpm->pairing, k, &i, &j, NULL);
-  bbox_t boxi, boxj, box_int;
-  get_cubes(fvpm, i, j, &boxi, &boxj);
-  get_cubes(fvpm, i, j, &boxi, &boxj);
-  bbox_intersect_bbox(&boxi, &boxj, &box_int);
-  if (bbox_is_empty_set(&box_int) || bbox_is_point(&box_int) || bbox_is_line(&box_int))
+  point_t* xi = &fvpm->cloud->points[i];
+  point_t* xj = &fvpm->cloud->points[j];
+  real_t ri = fvpm->ratio * fvpm->extents[i];
+  real_t rj = fvpm->ratio * fvpm->extents[j];
+  vector_t e;
+  point_displacement(xi, xj, &e);
+  real_t d = vector_mag(&e);
+  if (d >= ri + rj)
     return 0;
+
+  if (d > 0.0)
+    vector_scale(&e, 1.0/d);
   else
-    return fvpm->N * fvpm->N;
+  {
+    e.x = 1.0;
+    e.y = e.z = 0.0;
+  }
+  vector_t minus_e = {.x = -e.x, .y = -e.y, .z = -e.z};
+
+  if (d <= fabs(ri - rj))
+  {
+    point_t* x = (ri < rj) ? xi : xj;
+    real_t r = MIN(ri, rj);
+    cap_init(&caps[0], x, r, &e, 0.0);
+    cap_init(&caps[1], x, r, &minus_e, 0.0);
+  }
+  else
+  {
+    real_t si = 0.5 * (d*d + ri*ri - rj*rj) / d;
+    cap_init(&caps[0], xi, ri, &e, si);
+    cap_init(&caps[1], xj, rj, &minus_e, d - si);
+  }
+  return 2;
+}
+
+// Computes the point on the given cap at the given axial coordinate z, 
+// distance rho from the axis, and azimuthal angle phi.
+static inline void cap_point(cap_t* cap, real_t z, real_t rho, real_t phi, point_t* x)
+{
+  real_t c = rho * cos(phi), s = rho * sin(phi);
+  x->x = cap->center.x + z * cap->axis.x + c * cap->t1.x + s * cap->t2.x;
+  x->y = cap->center.y + z * cap->axis.y + c * cap->t1.y + s * cap->t2.y;
+  x->z = cap->center.z + z * cap->axis.z + c * cap->t1.z + s * cap->t2.z;
+}
+
+// The surface of the intersection of two spheres consists of two spherical
+// caps, each of which gets a Gauss rule in the cosine of the polar angle 
+// (in which the area element is uniform) and N equally-spaced azimuthal 
+// points.
+static int sphere_surf_num_quad_points(void* context, int k)
+{
+  fvpm_simple_t* fvpm = context;
+  cap_t caps[2];
+  return get_caps(fvpm, k, caps) * fvpm->N * fvpm->N;
 }
 
 static void sphere_surf_get_quad(void* context, int k, point_t* points, real_t* weights, vector_t* normals)
 {
   fvpm_simple_t* fvpm = context;
-  real_t gauss_pts[fvpm->N], gauss_wts[fvpm->N];
-  get_gauss_legendre_points(fvpm->N, gauss_wts, gauss_wts);
+  int N = fvpm->N;
+  real_t gauss_pts[N], gauss_wts[N];
+  get_gauss_legendre_points(N, gauss_pts, gauss_wts);
 
-  // Get the bounding boxes for the kth pair.
-  int i, j;
-  bbox_t boxi, boxj, box_int;
-  get_cubes(fvpm, i, j, &boxi, &boxj);
-  bbox_intersect_bbox(&boxi, &boxj, &box_int);
-  ASSERT(!bbox_is_empty_set(&box_int) && !bbox_is_point(&box_int) && !bbox_is_line(&box_int));
+  // Get the caps for the kth pair.
+  cap_t caps[2];
+  int num_caps = get_caps(fvpm, k, caps);
+  ASSERT(num_caps == 2);
 
-  // FIXME: It remains to implement the quadrature for this rule.
+  int q = 0;
+  real_t dphi = 2.0 * M_PI / N;
+  for (int c = 0; c < num_caps; ++c)
+  {
+    cap_t* cap = &caps[c];
+    real_t r = cap->radius;
+    real_t mu[N], wmu[N];
+    map_gauss_rule(N, gauss_pts, gauss_wts, cap->base / r, 1.0, mu, wmu);
+    for (int a = 0; a < N; ++a)
+    {
+      real_t rho = r * sqrt(MAX(0.0, 1.0 - mu[a]*mu[a]));
+      for (int b = 0; b < N; ++b, ++q)
+      {
+        real_t phi = (b + 0.5) * dphi;
+        cap_point(cap, r * mu[a], rho, phi, &points[q]);
+        weights[q] = r * r * wmu[a] * dphi;
+        point_displacement(&cap->center, &points[q], &normals[q]);
+        vector_scale(&normals[q], 1.0/r);
+      }
+    }
+  }
 }
 
 surface_integral_t* fvpm_sphere_surface_integral_new(point_cloud_t* cloud,
@@ -201,40 +410,58 @@ surface_integral_t* fvpm_sphere_surface_integral_new(point_cloud_t* cloud,
                                     .get_quadrature = sphere_surf_get_quad,
                                     .dtor = fvpm_simple_free};
   char name[1025];
-  snprintf(name, 1024, "FVPM sphere surface integral (N = %d, side/extent = %g)", 
+  snprintf(name, 1024, "FVPM sphere surface integral (N = %d, radius/extent = %g)", 
            num_points, radius_to_extent_ratio);
   return surface_integral_new(name, fvpm, vtable);
 }
 
+// The intersection of two spheres consists of two spherical cap segments, 
+// each of which gets a Gauss rule along its axis, a Gauss rule in the 
+// square of the distance from the axis (in which the volume element is 
+// uniform), and N equally-spaced azimuthal points.
 static int sphere_vol_num_quad_points(void* context, int k)
 {
   fvpm_simple_t* fvpm = context;
-  int i, j;
-  neighbor_pairing_get(fvpm->pairing, k, &i, &j, NULL);
-  bbox_t boxi, boxj, box_int;
-  get_cubes(fvpm, i, j, &boxi, &boxj);
-  get_cubes(fvpm, i, j, &boxi, &boxj);
-  bbox_intersect_bbox(&boxi, &boxj, &box_int);
-  if (bbox_is_empty_set(&box_int) || bbox_is_point(&box_int) || bbox_is_line(&box_int) || bbox_is_plane(&box_int))
-    return 0;
-  else
-    return fvpm->N * fvpm->N * fvpm->N;
+  cap_t caps[2];
+  return get_caps(fvpm, k, caps) * fvpm->N * fvpm->N * fvpm->N;
 }
 
 static void sphere_vol_get_quad(void* context, int k, point_t* points, real_t* weights)
 {
   fvpm_simple_t* fvpm = context;
-  real_t gauss_pts[fvpm->N], gauss_wts[fvpm->N];
-  get_gauss_legendre_points(fvpm->N, gauss_wts, gauss_wts);
+  int N = fvpm->N;
+  real_t gauss_pts[N], gauss_wts[N];
+  get_gauss_legendre_points(N, gauss_pts, gauss_wts);
 
-  // Get the bounding boxes for the kth pair.
-  int i, j;
-  bbox_t boxi, boxj, box_int;
-  get_cubes(fvpm, i, j, &boxi, &boxj);
-  bbox_intersect_bbox(&boxi, &boxj, &box_int);
-  ASSERT(!bbox_is_empty_set(&box_int) && !bbox_is_point(&box_int) && !bbox_is_line(&box_int) && !bbox_is_plane(&box_int));
+  // Get the caps for the kth pair.
+  cap_t caps[2];
+  int num_caps = get_caps(fvpm, k, caps);
+  ASSERT(num_caps == 2);
 
-  // FIXME: It remains to implement the quadrature for this rule.
+  int q = 0;
+  real_t dphi = 2.0 * M_PI / N;
+  for (int c = 0; c < num_caps; ++c)
+  {
+    cap_t* cap = &caps[c];
+    real_t r = cap->radius;
+    real_t z[N], wz[N];
+    map_gauss_rule(N, gauss_pts, gauss_wts, cap->base, r, z, wz);
+    for (int a = 0; a < N; ++a)
+    {
+      real_t u[N], wu[N];
+      map_gauss_rule(N, gauss_pts, gauss_wts, 0.0, MAX(0.0, r*r - z[a]*z[a]), u, wu);
+      for (int b = 0; b < N; ++b)
+      {
+        real_t rho = sqrt(u[b]);
+        for (int n = 0; n < N; ++n, ++q)
+        {
+          real_t phi = (n + 0.5) * dphi;
+          cap_point(cap, z[a], rho, phi, &points[q]);
+          weights[q] = 0.5 * wz[a] * wu[b] * dphi;
+        }
+      }
+    }
+  }
 }
 
 volume_integral_t* fvpm_sphere_volume_integral_new(point_cloud_t* cloud,
@@ -245,11 +472,129 @@ volume_integral_t* fvpm_sphere_volume_integral_new(point_cloud_t* cloud,
 {
   fvpm_simple_t* fvpm = fvpm_simple_new(cloud, pairing, extents, num_points, radius_to_extent_ratio);
   volume_integral_vtable vtable = {.num_quad_points = sphere_vol_num_quad_points,
-                                    .get_quadrature = sphere_vol_get_quad,
-                                    .dtor = fvpm_simple_free};
+                                   .get_quadrature = sphere_vol_get_quad,
+                                   .dtor = fvpm_simple_free};
   char name[1025];
-  snprintf(name, 1024, "FVPM sphere volume integral (N = %d, side/extent = %g)", 
+  snprintf(name, 1024, "FVPM sphere volume integral (N = %d, radius/extent = %g)", 
            num_points, radius_to_extent_ratio);
   return volume_integral_new(name, fvpm, vtable);
 }
 
+// Allocates a set of pair rules with offsets for the given numbers of 
+// quadrature points for each pair.
+static fvpm_pair_rules_t* pair_rules_new(int num_pairs, int* num_quad_points, bool with_normals)
+{
+  fvpm_pair_rules_t* rules = polymec_malloc(sizeof(fvpm_pair_rules_t));
+  rules->num_pairs = num_pairs;
+  rules->offsets = polymec_malloc(sizeof(size_t) * (num_pairs + 1));
+  rules->offsets[0] = 0;
+  for (int k = 0; k < num_pairs; ++k)
+    rules->offsets[k+1] = rules->offsets[k] + (size_t)num_quad_points[k];
+  size_t num_points = MAX(rules->offsets[num_pairs], 1);
+  rules->points = polymec_malloc(sizeof(point_t) * num_points);
+  rules->weights = polymec_malloc(sizeof(real_t) * num_points);
+  rules->normals = with_normals ? polymec_malloc(sizeof(vector_t) * num_points) : NULL;
+  return rules;
+}
+
+fvpm_pair_rules_t* fvpm_pair_rules_from_surface_integral(surface_integral_t* integral,
+                                                         int num_pairs)
+{
+  START_FUNCTION_TIMER();
+  int* num_quad_points = polymec_malloc(sizeof(int) * MAX(num_pairs, 1));
+  for (int k = 0; k < num_pairs; ++k)
+  {
+    surface_integral_set_domain(integral, k);
+    num_quad_points[k] = surface_integral_num_points(integral);
+  }
+  fvpm_pair_rules_t* rules = pair_rules_new(num_pairs, num_quad_points, true);
+  for (int k = 0; k < num_pairs; ++k)
+  {
+    if (num_quad_points[k] > 0)
+    {
+      size_t offset = rules->offsets[k];
+      surface_integral_set_domain(integral, k);
+      surface_integral_get_quadrature(integral, &rules->points[offset], 
+                                      &rules->weights[offset], 
+                                      &rules->normals[offset]);
+    }
+  }
+  polymec_free(num_quad_points);
+  STOP_FUNCTION_TIMER();
+  return rules;
+}
+
+fvpm_pair_rules_t* fvpm_pair_rules_from_volume_integral(volume_integral_t* integral,
+                                                        int num_pairs)
+{
+  START_FUNCTION_TIMER();
+  int* num_quad_points = polymec_malloc(sizeof(int) * MAX(num_pairs, 1));
+  for (int k = 0; k < num_pairs; ++k)
+  {
+    volume_integral_set_domain(integral, k);
+    num_quad_points[k] = volume_integral_num_points(integral);
+  }
+  fvpm_pair_rules_t* rules = pair_rules_new(num_pairs, num_quad_points, false);
+  for (int k = 0; k < num_pairs; ++k)
+  {
+    if (num_quad_points[k] > 0)
+    {
+      size_t offset = rules->offsets[k];
+      volume_integral_set_domain(integral, k);
+      volume_integral_get_quadrature(integral, &rules->points[offset], 
+                                     &rules->weights[offset]);
+    }
+  }
+  polymec_free(num_quad_points);
+  STOP_FUNCTION_TIMER();
+  return rules;
+}
+
+void fvpm_pair_rules_free(fvpm_pair_rules_t* rules)
+{
+  polymec_free(rules->offsets);
+  polymec_free(rules->points);
+  polymec_free(rules->weights);
+  if (rules->normals != NULL)
+    polymec_free(rules->normals);
+  polymec_free(rules);
+}
+
+static int pair_rules_num_quad_points(void* context, int k)
+{
+  fvpm_pair_rules_t* rules = context;
+  return (int)(rules->offsets[k+1] - rules->offsets[k]);
+}
+
+static void pair_rules_get_surf_quad(void* context, int k, point_t* points, real_t* weights, vector_t* normals)
+{
+  fvpm_pair_rules_t* rules = context;
+  size_t offset = rules->offsets[k], n = rules->offsets[k+1] - offset;
+  memcpy(points, &rules->points[offset], sizeof(point_t) * n);
+  memcpy(weights, &rules->weights[offset], sizeof(real_t) * n);
+  memcpy(normals, &rules->normals[offset], sizeof(vector_t) * n);
+}
+
+static void pair_rules_get_vol_quad(void* context, int k, point_t* points, real_t* weights)
+{
+  fvpm_pair_rules_t* rules = context;
+  size_t offset = rules->offsets[k], n = rules->offsets[k+1] - offset;
+  memcpy(points, &rules->points[offset], sizeof(point_t) * n);
+  memcpy(weights, &rules->weights[offset], sizeof(real_t) * n);
+}
+
+surface_integral_t* fvpm_pair_rules_surface_integral_new(fvpm_pair_rules_t* rules)
+{
+  ASSERT(rules->normals != NULL);
+  surface_integral_vtable vtable = {.num_quad_points = pair_rules_num_quad_points,
+                                    .get_quadrature = pair_rules_get_surf_quad};
+  return surface_integral_new("FVPM precomputed surface integral", rules, vtable);
+}
+
+volume_integral_t* fvpm_pair_rules_volume_integral_new(fvpm_pair_rules_t* rules)
+{
+  volume_integral_vtable vtable = {.num_quad_points = pair_rules_num_quad_points,
+                                   .get_quadrature = pair_rules_get_vol_quad};
+  return volume_integral_new("FVPM precomputed volume integral", rules, vtable);
+}
+
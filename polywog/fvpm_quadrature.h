@@ -31,7 +31,10 @@
 // pairs of cubes whose extents are defined by the ratio of its side to the 
 // extent associated with a subdomain. The rule is associated with the given 
 // point cloud, neighbor pairing, and (scalar) subdomain extents field, and 
-// has the given number of points on a side.
+// has the given number of points on a side. The surface is the boundary of 
+// the box in which the cubes intersect, with outward normals, or, if the 
+// cubes touch only on a face, that face, with its normal pointing from the 
+// first point in the pair to the second.
 surface_integral_t* fvpm_cube_surface_integral_new(point_cloud_t* cloud,
                                                    neighbor_pairing_t* pairing,
                                                    real_t* extents,
@@ -53,7 +56,10 @@ volume_integral_t* fvpm_cube_volume_integral_new(point_cloud_t* cloud,
 // pairs of spheres whose extents are defined by the ratio of its radius to 
 // the extent associated with a subdomain. The rule is associated with the 
 // given point cloud, neighbor pairing, and (scalar) subdomain extents field, 
-// and has the given number of azimuthal points.
+// and has the given number of azimuthal points. The surface is the boundary
+// of the lens in which the spheres intersect (or of the smaller sphere, if 
+// one contains the other), with outward normals, and consists of two 
+// spherical caps, each with the given number of polar points.
 surface_integral_t* fvpm_sphere_surface_integral_new(point_cloud_t* cloud,
                                                      neighbor_pairing_t* pairing,
                                                      real_t* extents,
@@ -64,11 +70,49 @@ surface_integral_t* fvpm_sphere_surface_integral_new(point_cloud_t* cloud,
 // spheres whose extents are defined by the ratio of its radius to the extent 
 // associated with a subdomain. The rule is associated with the given point 
 // cloud, neighbor pairing, and (scalar) subdomain extents field, and has the 
-// given number of radial points.
+// given number of radial points (and the same numbers of axial and azimuthal
+// points).
 volume_integral_t* fvpm_sphere_volume_integral_new(point_cloud_t* cloud,
                                                    neighbor_pairing_t* pairing,
                                                    real_t* extents,
                                                    int num_points,
                                                    real_t radius_to_extent_ratio);
 
+// Since the above rules must otherwise be regenerated every time they are 
+// evaluated, conservative FVPM schemes whose points don't move (or move 
+// rarely) can precompute the rules for every pair at once. A set of 
+// precomputed pair rules stores these in flat arrays: the quadrature points
+// and weights (and normals, for surface rules) for the kth pair occupy 
+// indices offsets[k] through offsets[k+1]-1. The offsets are 64-bit, since 
+// the total number of quadrature points can exceed the range of an int.
+typedef struct
+{
+  int num_pairs;
+  size_t* offsets;
+  point_t* points;
+  real_t* weights;
+  vector_t* normals; // NULL for volume rules
+} fvpm_pair_rules_t;
+
+// Precomputes the rules of the given surface integral for the given number
+// of pairs. The integral is not consumed.
+fvpm_pair_rules_t* fvpm_pair_rules_from_surface_integral(surface_integral_t* integral,
+                                                         int num_pairs);
+
+// Precomputes the rules of the given volume integral for the given number
+// of pairs. The integral is not consumed.
+fvpm_pair_rules_t* fvpm_pair_rules_from_volume_integral(volume_integral_t* integral,
+                                                        int num_pairs);
+
+// Destroys the given set of precomputed pair rules.
+void fvpm_pair_rules_free(fvpm_pair_rules_t* rules);
+
+// Creates a surface integral that serves the given precomputed surface 
+// rules, which it borrows.
+surface_integral_t* fvpm_pair_rules_surface_integral_new(fvpm_pair_rules_t* rules);
+
+// Creates a volume integral that serves the given precomputed volume rules,
+// which it borrows.
+volume_integral_t* fvpm_pair_rules_volume_integral_new(fvpm_pair_rules_t* rules);
+
 #endif
@@ -17,33 +17,60 @@ struct gmls_functional_t
   void* context;
   gmls_functional_vtable vtable;
 
-  // Quadrature rules.
-  volume_integral_t* volume_quad_rule;
-  surface_integral_t* surface_quad_rule;
+  // Quadrature rules, in order of increasing cost. Only one of these arrays
+  // is non-NULL.
+  int num_rules;
+  volume_integral_t** volume_quad_rules;
+  surface_integral_t** surface_quad_rules;
+
+  // If there is more than one rule, the tolerance used to select one for 
+  // each subdomain, and the index of the rule selected for each of the 
+  // first num_selected subdomains (-1 if none has been selected yet).
+  real_t tolerance;
+  int num_selected;
+  int* selected_rules;
 
   int num_comp;
 };
 
-gmls_functional_t* volume_gmls_functional_new(const char* name,
+static gmls_functional_t* gmls_functional_new(const char* name,
                                               void* context,
                                               gmls_functional_vtable vtable,
                                               int num_components,
-                                              volume_integral_t* quad_rule)
-            
+                                              int num_rules,
+                                              real_t tolerance)
 {
   ASSERT(vtable.eval_integrands != NULL);
   ASSERT(num_components > 0);
+  ASSERT(num_rules > 0);
+  ASSERT((num_rules == 1) || (tolerance > 0.0));
 
   gmls_functional_t* functional = polymec_malloc(sizeof(gmls_functional_t));
   functional->name = string_dup(name);
   functional->context = context;
   functional->vtable = vtable;
-  functional->volume_quad_rule = quad_rule;
-  functional->surface_quad_rule = NULL;
   functional->num_comp = num_components;
+  functional->num_rules = num_rules;
+  functional->volume_quad_rules = NULL;
+  functional->surface_quad_rules = NULL;
+  functional->tolerance = tolerance;
+  functional->num_selected = 0;
+  functional->selected_rules = NULL;
   return functional;
 }
 
+gmls_functional_t* volume_gmls_functional_new(const char* name,
+                                              void* context,
+                                              gmls_functional_vtable vtable,
+                                              int num_components,
+                                              volume_integral_t* quad_rule)
+            
+{
+  return adaptive_volume_gmls_functional_new(name, context, vtable, 
+                                             num_components, 1, &quad_rule, 
+                                             0.0);
+}
+
 gmls_functional_t* surface_gmls_functional_new(const char* name,
                                                void* context,
                                                gmls_functional_vtable vtable,
@@ -51,16 +78,40 @@ gmls_functional_t* surface_gmls_functional_new(const char* name,
                                                surface_integral_t* quad_rule)
             
 {
-  ASSERT(vtable.eval_integrands != NULL);
-  ASSERT(num_components > 0);
+  return adaptive_surface_gmls_functional_new(name, context, vtable, 
+                                              num_components, 1, &quad_rule, 
+                                              0.0);
+}
 
-  gmls_functional_t* functional = polymec_malloc(sizeof(gmls_functional_t));
-  functional->name = string_dup(name);
-  functional->context = context;
-  functional->vtable = vtable;
-  functional->num_comp = num_components;
-  functional->volume_quad_rule = NULL;
-  functional->surface_quad_rule = quad_rule;
+gmls_functional_t* adaptive_volume_gmls_functional_new(const char* name,
+                                                       void* context,
+                                                       gmls_functional_vtable vtable,
+                                                       int num_components,
+                                                       int num_rules,
+                                                       volume_integral_t** quad_rules,
+                                                       real_t tolerance)
+{
+  gmls_functional_t* functional = gmls_functional_new(name, context, vtable, 
+                                                      num_components, 
+                                                      num_rules, tolerance);
+  functional->volume_quad_rules = polymec_malloc(sizeof(volume_integral_t*) * num_rules);
+  memcpy(functional->volume_quad_rules, quad_rules, sizeof(volume_integral_t*) * num_rules);
+  return functional;
+}
+
+gmls_functional_t* adaptive_surface_gmls_functional_new(const char* name,
+                                                        void* context,
+                                                        gmls_functional_vtable vtable,
+                                                        int num_components,
+                                                        int num_rules,
+                                                        surface_integral_t** quad_rules,
+                                                        real_t tolerance)
+{
+  gmls_functional_t* functional = gmls_functional_new(name, context, vtable, 
+                                                      num_components, 
+                                                      num_rules, tolerance);
+  functional->surface_quad_rules = polymec_malloc(sizeof(surface_integral_t*) * num_rules);
+  memcpy(functional->surface_quad_rules, quad_rules, sizeof(surface_integral_t*) * num_rules);
   return functional;
 }
 
@@ -68,6 +119,12 @@ void gmls_functional_free(gmls_functional_t* functional)
 {
   if ((functional->context != NULL) && (functional->vtable.dtor != NULL))
     functional->vtable.dtor(functional->context);
+  if (functional->volume_quad_rules != NULL)
+    polymec_free(functional->volume_quad_rules);
+  if (functional->surface_quad_rules != NULL)
+    polymec_free(functional->surface_quad_rules);
+  if (functional->selected_rules != NULL)
+    polymec_free(functional->selected_rules);
   polymec_free(functional->name);
   polymec_free(functional);
 }
@@ -123,40 +180,129 @@ static void compute_integral(gmls_functional_t* functional,
   STOP_FUNCTION_TIMER();
 }
 
-void gmls_functional_compute(gmls_functional_t* functional,
-                             int i,
-                             real_t t,
-                             multicomp_poly_basis_t* poly_basis,
-                             real_t* solution,
-                             real_t* lambdas)
+// Computes the functionals on the ith subdomain using the rth quadrature 
+// rule.
+static void compute_with_rule(gmls_functional_t* functional,
+                              int r,
+                              int i,
+                              real_t t,
+                              multicomp_poly_basis_t* poly_basis,
+                              real_t* solution,
+                              real_t* lambdas)
 {
-  START_FUNCTION_TIMER();
-  if (functional->surface_quad_rule != NULL)
+  if (functional->surface_quad_rules != NULL)
   {
-    surface_integral_set_domain(functional->surface_quad_rule, i);
-    int num_quad_points = surface_integral_num_points(functional->surface_quad_rule);
+    surface_integral_t* rule = functional->surface_quad_rules[r];
+    surface_integral_set_domain(rule, i);
+    int num_quad_points = surface_integral_num_points(rule);
     point_t quad_points[num_quad_points];
     real_t quad_weights[num_quad_points];
     vector_t quad_normals[num_quad_points];
-    surface_integral_get_quadrature(functional->surface_quad_rule, quad_points, quad_weights, quad_normals);
+    surface_integral_get_quadrature(rule, quad_points, quad_weights, quad_normals);
     compute_integral(functional, t, poly_basis, solution,
                      quad_points, quad_weights, quad_normals, num_quad_points, 
                      lambdas);
   }
   else
   {
-    volume_integral_set_domain(functional->volume_quad_rule, i);
-    int num_quad_points = volume_integral_num_points(functional->volume_quad_rule);
+    volume_integral_t* rule = functional->volume_quad_rules[r];
+    volume_integral_set_domain(rule, i);
+    int num_quad_points = volume_integral_num_points(rule);
     point_t quad_points[num_quad_points];
     real_t quad_weights[num_quad_points];
-    volume_integral_get_quadrature(functional->volume_quad_rule, quad_points, quad_weights);
+    volume_integral_get_quadrature(rule, quad_points, quad_weights);
     compute_integral(functional, t, poly_basis, solution, 
                      quad_points, quad_weights, NULL, num_quad_points, 
                      lambdas);
   }
+}
+
+// Returns true if the functionals computed with a lower-order rule agree 
+// with those computed with a higher-order rule to within the given relative
+// tolerance.
+static bool functionals_agree(int n, real_t* lambdas_lo, real_t* lambdas_hi, 
+                              real_t tolerance)
+{
+  real_t max_diff = 0.0, max_mag = 0.0;
+  for (int k = 0; k < n; ++k)
+  {
+    max_diff = MAX(max_diff, fabs(lambdas_hi[k] - lambdas_lo[k]));
+    max_mag = MAX(max_mag, fabs(lambdas_hi[k]));
+  }
+  return (max_diff <= tolerance * max_mag);
+}
+
+void gmls_functional_compute(gmls_functional_t* functional,
+                             int i,
+                             real_t t,
+                             multicomp_poly_basis_t* poly_basis,
+                             real_t* solution,
+                             real_t* lambdas)
+{
+  START_FUNCTION_TIMER();
+  if (functional->num_rules == 1)
+  {
+    compute_with_rule(functional, 0, i, t, poly_basis, solution, lambdas);
+    STOP_FUNCTION_TIMER();
+    return;
+  }
+
+  // Make room for the selected rule for this subdomain.
+  if (i >= functional->num_selected)
+  {
+    int num_selected = MAX(i + 1, 2 * functional->num_selected);
+    functional->selected_rules = polymec_realloc(functional->selected_rules, 
+                                                 sizeof(int) * num_selected);
+    for (int j = functional->num_selected; j < num_selected; ++j)
+      functional->selected_rules[j] = -1;
+    functional->num_selected = num_selected;
+  }
+
+  int r = functional->selected_rules[i];
+  if (r != -1)
+    compute_with_rule(functional, r, i, t, poly_basis, solution, lambdas);
+  else
+  {
+    // Compare each rule with the next, and select the first one that 
+    // agrees with its successor (or the last one, if none do). We use the 
+    // functionals computed with the selected rule, so that they don't 
+    // change in later assemblies.
+    int num_comp = functional->num_comp;
+    int n = num_comp * multicomp_poly_basis_dim(poly_basis) * num_comp;
+    real_t lambdas_hi[n];
+    compute_with_rule(functional, 0, i, t, poly_basis, solution, lambdas);
+    r = functional->num_rules - 1;
+    for (int k = 0; k < functional->num_rules - 1; ++k)
+    {
+      compute_with_rule(functional, k+1, i, t, poly_basis, solution, lambdas_hi);
+      if (functionals_agree(n, lambdas, lambdas_hi, functional->tolerance))
+      {
+        r = k;
+        break;
+      }
+      memcpy(lambdas, lambdas_hi, sizeof(real_t) * n);
+    }
+    functional->selected_rules[i] = r;
+  }
   STOP_FUNCTION_TIMER();
 }
 
+int gmls_functional_quad_rule(gmls_functional_t* functional, int i)
+{
+  if (functional->num_rules == 1)
+    return 0;
+  else if (i < functional->num_selected)
+    return functional->selected_rules[i];
+  else
+    return -1;
+}
+
+void gmls_functional_reset_quad_rules(gmls_functional_t* functional)
+{
+  for (int i = 0; i < functional->num_selected; ++i)
+    functional->selected_rules[i] = -1;
+}
+
 void gmls_functional_eval_integrands(gmls_functional_t* functional,
                                      real_t t,
                                      multicomp_poly_basis_t* poly_basis,
@@ -71,6 +71,34 @@ gmls_functional_t* surface_gmls_functional_new(const char* name,
                                                gmls_functional_vtable vtable,
                                                int num_components,
                                                surface_integral_t* quad_rule);
+
+// Creates a generalized MLS functional with the given name, context, virtual
+// table, and number of components, that selects one of the given volume 
+// integral rules for each subdomain. The rules must be given in order of 
+// increasing cost (and accuracy). The first time the functional is computed
+// on a subdomain, it is computed with successive rules until two successive 
+// rules agree to within the given relative tolerance, and the cheaper of 
+// these two rules is selected for that subdomain and used thereafter. If no
+// two rules agree, the last rule is selected. The functional does not 
+// consume the rules, but it does copy the array quad_rules.
+gmls_functional_t* adaptive_volume_gmls_functional_new(const char* name,
+                                                       void* context,
+                                                       gmls_functional_vtable vtable,
+                                                       int num_components,
+                                                       int num_rules,
+                                                       volume_integral_t** quad_rules,
+                                                       real_t tolerance);
+
+// Creates a generalized MLS functional that selects one of the given surface
+// integral rules for each subdomain, as in 
+// adaptive_volume_gmls_functional_new.
+gmls_functional_t* adaptive_surface_gmls_functional_new(const char* name,
+                                                        void* context,
+                                                        gmls_functional_vtable vtable,
+                                                        int num_components,
+                                                        int num_rules,
+                                                        surface_integral_t** quad_rules,
+                                                        real_t tolerance);
  
 // Destroys the given GMLS functional.
 void gmls_functional_free(gmls_functional_t* functional);
@@ -89,7 +117,10 @@ void* gmls_functional_context(gmls_functional_t* functional);
 // given multi-component polynomial basis. The values are placed in the 
 // lambdas array such that, if lambdas is interpreted as a 3D array, 
 // lambdas[i][j][k] is the kth functional component of the jth basis vector 
-// for the ith solution component.
+// for the ith solution component. This function must be called serially 
+// (not from several threads at once): it sets the domains of the 
+// functional's quadrature rules, and an adaptive functional records the rule
+// it selects for each subdomain.
 void gmls_functional_compute(gmls_functional_t* functional,
                              int i,
                              real_t t,
@@ -97,6 +128,17 @@ void gmls_functional_compute(gmls_functional_t* functional,
                              real_t* solution,
                              real_t* lambdas);
 
+// Returns the index of the quadrature rule used to compute the functional on
+// the ith subdomain, or -1 if a rule has not yet been selected for it. 
+// Functionals with a single rule always return 0.
+int gmls_functional_quad_rule(gmls_functional_t* functional, int i);
+
+// Discards the quadrature rules selected for all subdomains, so that they 
+// are selected anew the next time the functional is computed on each. This 
+// should be called when the subdomains change (for example, when their 
+// points move).
+void gmls_functional_reset_quad_rules(gmls_functional_t* functional);
+
 // Evaluates the integrands applied to the polynomials within the polynomial 
 // basis at time t on the point x, with the normal vector n (if the functional 
 // is defined at the boundary of the subdomain). The value of the solution may 
@@ -72,6 +72,30 @@ int gmls_matrix_num_coeffs(gmls_matrix_t* matrix, int i)
   return matrix->num_comp * matrix->num_comp * matrix->vtable.num_nodes(matrix->context, i);
 }
 
+void gmls_matrix_split_subdomains(gmls_matrix_t* matrix,
+                                  int num_subdomains,
+                                  int num_owned,
+                                  int_array_t* interior,
+                                  int_array_t* boundary)
+{
+  for (int i = 0; i < num_subdomains; ++i)
+  {
+    int num_nodes = matrix->vtable.num_nodes(matrix->context, i);
+    int nodes[num_nodes];
+    matrix->vtable.get_nodes(matrix->context, i, nodes);
+    bool has_ghosts = false;
+    for (int n = 0; n < num_nodes; ++n)
+    {
+      if (nodes[n] >= num_owned)
+      {
+        has_ghosts = true;
+        break;
+      }
+    }
+    int_array_append(has_ghosts ? boundary : interior, i);
+  }
+}
+
 static void get_neighborhood(gmls_matrix_t* matrix, 
                              int i,
                              point_t* xi, 
@@ -113,6 +113,21 @@ void gmls_matrix_free(gmls_matrix_t* matrix);
 // node in the GMLS approximation.
 int gmls_matrix_num_coeffs(gmls_matrix_t* matrix, int i);
 
+// Sorts the first num_subdomains subdomains of the given GMLS matrix into 
+// interior subdomains, whose nodes are all locally owned (with indices less 
+// than num_owned), and boundary subdomains, which involve at least one ghost
+// node. The indices of these subdomains are appended to the given arrays. 
+// This allows the assembly of the interior subdomains to overlap with an 
+// exchange of ghost data: start the exchange (e.g. with 
+// stencil_start_exchange), compute the coefficients for the interior 
+// subdomains, finish the exchange, and then compute the coefficients for the
+// boundary subdomains.
+void gmls_matrix_split_subdomains(gmls_matrix_t* matrix,
+                                  int num_subdomains,
+                                  int num_owned,
+                                  int_array_t* interior,
+                                  int_array_t* boundary);
+
 // Evaluates the coefficients of the GMLS matrix for the solution components 
 // at node i, using the given functional evaluated at time t. The indices 
 // of the rows and columns for these coefficients are placed into the given 
@@ -286,3 +286,735 @@ volume_integral_t* mlpg_sphere_volume_integral_new(point_cloud_t* cloud,
            num_points, radius_to_extent_ratio);
   return volume_integral_new(name, mlpg, vtable);
 }
+
+// A reference rule holds the points and weights of a quadrature rule on 
+// a reference domain (the cube [-1, 1]^3, its surface, or the surface of the
+// unit sphere), which are mapped to the subdomain of each point.
+typedef struct
+{
+  point_cloud_t* cloud;
+  real_t* extents;
+  real_t ratio;
+  int degree;
+
+  // The factor by which the extent of a subdomain (times ratio) is 
+  // multiplied to map the reference domain to it: 1/2 for cubes of side 
+  // L, 1 for spheres of radius R.
+  real_t scale;
+
+  int num_points, capacity;
+  point_t* points;
+  real_t* weights;
+  vector_t* normals;
+} mlpg_ref_t;
+
+static mlpg_ref_t* mlpg_ref_new(point_cloud_t* cloud,
+                                real_t* extents,
+                                int degree,
+                                real_t ratio,
+                                real_t scale)
+{
+  ASSERT(degree >= 0);
+  ASSERT(ratio > 0.0);
+
+  mlpg_ref_t* ref = polymec_malloc(sizeof(mlpg_ref_t));
+  ref->cloud = cloud;
+  ref->extents = extents;
+  ref->ratio = ratio;
+  ref->degree = degree;
+  ref->scale = scale;
+  ref->num_points = 0;
+  ref->capacity = 0;
+  ref->points = NULL;
+  ref->weights = NULL;
+  ref->normals = NULL;
+  return ref;
+}
+
+static void mlpg_ref_free(void* context)
+{
+  mlpg_ref_t* ref = context;
+  polymec_free(ref->points);
+  polymec_free(ref->weights);
+  polymec_free(ref->normals);
+  polymec_free(ref);
+}
+
+static void mlpg_ref_add_point(mlpg_ref_t* ref, 
+                               real_t x, real_t y, real_t z, 
+                               real_t w, 
+                               vector_t* normal)
+{
+  if (ref->num_points == ref->capacity)
+  {
+    ref->capacity = MAX(16, 2 * ref->capacity);
+    ref->points = polymec_realloc(ref->points, sizeof(point_t) * ref->capacity);
+    ref->weights = polymec_realloc(ref->weights, sizeof(real_t) * ref->capacity);
+    ref->normals = polymec_realloc(ref->normals, sizeof(vector_t) * ref->capacity);
+  }
+  int n = ref->num_points++;
+  ref->points[n].x = x;
+  ref->points[n].y = y;
+  ref->points[n].z = z;
+  ref->weights[n] = w;
+  if (normal != NULL)
+    ref->normals[n] = *normal;
+  else
+  {
+    ref->normals[n].x = x;
+    ref->normals[n].y = y;
+    ref->normals[n].z = z;
+  }
+}
+
+// Adds all the distinct points obtained by permuting the coordinates of 
+// (a, b, c) and flipping their signs, each with the weight w. These points 
+// are normal to the unit sphere if (a, b, c) lies on it.
+static void mlpg_ref_add_orbit(mlpg_ref_t* ref, real_t a, real_t b, real_t c, real_t w)
+{
+  static const int perms[6][3] = {{0, 1, 2}, {0, 2, 1}, {1, 0, 2}, 
+                                  {1, 2, 0}, {2, 0, 1}, {2, 1, 0}};
+  real_t v[3] = {a, b, c};
+  int first = ref->num_points;
+  for (int p = 0; p < 6; ++p)
+  {
+    for (int s = 0; s < 8; ++s)
+    {
+      real_t x[3];
+      for (int d = 0; d < 3; ++d)
+        x[d] = ((s >> d) & 1) ? -v[perms[p][d]] : v[perms[p][d]];
+      bool found = false;
+      for (int n = first; n < ref->num_points; ++n)
+      {
+        if ((ref->points[n].x == x[0]) && (ref->points[n].y == x[1]) && 
+            (ref->points[n].z == x[2]))
+        {
+          found = true;
+          break;
+        }
+      }
+      if (!found)
+        mlpg_ref_add_point(ref, x[0], x[1], x[2], w, NULL);
+    }
+  }
+}
+
+// Builds a rule on [-1, 1]^3 that is exact for polynomials of the ref's 
+// degree. Fully symmetric rules (Stroud's Cn 3-1 and Hammer and Stroud's 
+// 14-point rule) are used through degree 5, and tensor products of Gauss 
+// rules beyond that.
+static void build_cube_volume_rule(mlpg_ref_t* ref)
+{
+  if (ref->degree <= 1)
+    mlpg_ref_add_point(ref, 0.0, 0.0, 0.0, 8.0, NULL);
+  else if (ref->degree <= 3)
+    mlpg_ref_add_orbit(ref, 1.0, 0.0, 0.0, 8.0/6.0);
+  else if (ref->degree <= 5)
+  {
+    mlpg_ref_add_orbit(ref, sqrt(19.0/30.0), 0.0, 0.0, 320.0/361.0);
+    real_t s = sqrt(19.0/33.0);
+    mlpg_ref_add_orbit(ref, s, s, s, 121.0/361.0);
+  }
+  else
+  {
+    int N = (ref->degree + 2) / 2;
+    real_t pts[N], wts[N];
+    get_gauss_legendre_points(N, pts, wts);
+    for (int i = 0; i < N; ++i)
+      for (int j = 0; j < N; ++j)
+        for (int k = 0; k < N; ++k)
+          mlpg_ref_add_point(ref, pts[i], pts[j], pts[k], wts[i]*wts[j]*wts[k], NULL);
+  }
+}
+
+// Builds a rule on [-1, 1]^2 that is exact for polynomials of the given 
+// degree, placing its points in (u, v) and its weights in w, and returning 
+// the number of points. Radon's 7-point rule is used for degree 5, Stroud's
+// 12-point C2 7-1 rule for degree 7, and tensor products of Gauss rules 
+// otherwise.
+static int get_square_rule(int degree, real_t* u, real_t* v, real_t* w)
+{
+  int n = 0;
+  if (degree <= 1)
+  {
+    u[n] = 0.0, v[n] = 0.0, w[n++] = 4.0;
+  }
+  else if ((degree == 4) || (degree == 5))
+  {
+    real_t r = sqrt(14.0/15.0), s = sqrt(3.0/5.0), t = sqrt(1.0/3.0);
+    u[n] = 0.0, v[n] = 0.0, w[n++] = 8.0/7.0;
+    u[n] = 0.0, v[n] = r, w[n++] = 20.0/63.0;
+    u[n] = 0.0, v[n] = -r, w[n++] = 20.0/63.0;
+    for (int sx = -1; sx <= 1; sx += 2)
+      for (int sy = -1; sy <= 1; sy += 2)
+        u[n] = sx*s, v[n] = sy*t, w[n++] = 5.0/9.0;
+  }
+  else if ((degree == 6) || (degree == 7))
+  {
+    real_t sqrt583 = sqrt(583.0);
+    real_t r = sqrt(6.0/7.0);
+    real_t s = sqrt((114.0 - 3.0*sqrt583)/287.0);
+    real_t t = sqrt((114.0 + 3.0*sqrt583)/287.0);
+    real_t w1 = 4.0 * 49.0/810.0;
+    real_t w2 = 4.0 * (178981.0 + 2769.0*sqrt583)/1888920.0;
+    real_t w3 = 4.0 * (178981.0 - 2769.0*sqrt583)/1888920.0;
+    u[n] = r, v[n] = 0.0, w[n++] = w1;
+    u[n] = -r, v[n] = 0.0, w[n++] = w1;
+    u[n] = 0.0, v[n] = r, w[n++] = w1;
+    u[n] = 0.0, v[n] = -r, w[n++] = w1;
+    for (int sx = -1; sx <= 1; sx += 2)
+    {
+      for (int sy = -1; sy <= 1; sy += 2)
+      {
+        u[n] = sx*s, v[n] = sy*s, w[n++] = w2;
+        u[n] = sx*t, v[n] = sy*t, w[n++] = w3;
+      }
+    }
+  }
+  else
+  {
+    int N = (degree + 2) / 2;
+    real_t pts[N], wts[N];
+    get_gauss_legendre_points(N, pts, wts);
+    for (int i = 0; i < N; ++i)
+      for (int j = 0; j < N; ++j)
+        u[n] = pts[i], v[n] = pts[j], w[n++] = wts[i]*wts[j];
+  }
+  return n;
+}
+
+// Builds a rule on the surface of [-1, 1]^3 by placing a square rule on 
+// each of its faces.
+static void build_cube_surface_rule(mlpg_ref_t* ref)
+{
+  int max_n = MAX(12, ((ref->degree + 2) / 2) * ((ref->degree + 2) / 2));
+  real_t u[max_n], v[max_n], w[max_n];
+  int n = get_square_rule(ref->degree, u, v, w);
+  for (int axis = 0; axis < 3; ++axis)
+  {
+    for (int side = -1; side <= 1; side += 2)
+    {
+      vector_t normal = {.x = 0.0, .y = 0.0, .z = 0.0};
+      if (axis == 0) normal.x = 1.0 * side;
+      else if (axis == 1) normal.y = 1.0 * side;
+      else normal.z = 1.0 * side;
+      for (int q = 0; q < n; ++q)
+      {
+        real_t x[3];
+        x[axis] = 1.0 * side;
+        x[(axis+1)%3] = u[q];
+        x[(axis+2)%3] = v[q];
+        mlpg_ref_add_point(ref, x[0], x[1], x[2], w[q], &normal);
+      }
+    }
+  }
+}
+
+// Builds a rule on the unit sphere, using Lebedev's rules (with 6, 14, 26, 
+// 38, and 50 points) through degree 11, and a product of a Gauss rule in 
+// the cosine of the polar angle and equally-spaced azimuthal points beyond.
+static void build_sphere_surface_rule(mlpg_ref_t* ref)
+{
+  real_t four_pi = 4.0 * M_PI;
+  real_t a2 = 1.0/sqrt(2.0), a3 = 1.0/sqrt(3.0);
+  int degree = ref->degree;
+  if (degree <= 3)
+    mlpg_ref_add_orbit(ref, 1.0, 0.0, 0.0, four_pi/6.0);
+  else if (degree <= 5)
+  {
+    mlpg_ref_add_orbit(ref, 1.0, 0.0, 0.0, four_pi/15.0);
+    mlpg_ref_add_orbit(ref, a3, a3, a3, four_pi*3.0/40.0);
+  }
+  else if (degree <= 7)
+  {
+    mlpg_ref_add_orbit(ref, 1.0, 0.0, 0.0, four_pi/21.0);
+    mlpg_ref_add_orbit(ref, 0.0, a2, a2, four_pi*4.0/105.0);
+    mlpg_ref_add_orbit(ref, a3, a3, a3, four_pi*9.0/280.0);
+  }
+  else if (degree <= 9)
+  {
+    mlpg_ref_add_orbit(ref, 1.0, 0.0, 0.0, four_pi/105.0);
+    mlpg_ref_add_orbit(ref, a3, a3, a3, four_pi*9.0/280.0);
+    mlpg_ref_add_orbit(ref, 0.4597008433809831, 0.8880738339771153, 0.0, four_pi/35.0);
+  }
+  else if (degree <= 11)
+  {
+    real_t l = 1.0/sqrt(11.0), m = 3.0/sqrt(11.0);
+    mlpg_ref_add_orbit(ref, 1.0, 0.0, 0.0, four_pi*4.0/315.0);
+    mlpg_ref_add_orbit(ref, 0.0, a2, a2, four_pi*64.0/2835.0);
+    mlpg_ref_add_orbit(ref, a3, a3, a3, four_pi*27.0/1280.0);
+    mlpg_ref_add_orbit(ref, l, l, m, four_pi*14641.0/725760.0);
+  }
+  else
+  {
+    int N = (degree + 2) / 2, M = degree + 1;
+    real_t mu[N], wts[N];
+    get_gauss_legendre_points(N, mu, wts);
+    for (int i = 0; i < N; ++i)
+    {
+      real_t rho = sqrt(1.0 - mu[i]*mu[i]);
+      for (int j = 0; j < M; ++j)
+      {
+        real_t phi = 2.0 * M_PI * j / M;
+        mlpg_ref_add_point(ref, rho * cos(phi), rho * sin(phi), mu[i], 
+                           2.0 * M_PI * wts[i] / M, NULL);
+      }
+    }
+  }
+}
+
+static int ref_num_quad_points(void* context, int i)
+{
+  mlpg_ref_t* ref = context;
+  return ref->num_points;
+}
+
+static void ref_cube_vol_get_quad(void* context, int i, point_t* points, real_t* weights)
+{
+  mlpg_ref_t* ref = context;
+  point_t* xi = &ref->cloud->points[i];
+  real_t half = ref->scale * ref->ratio * ref->extents[i];
+  real_t J = half * half * half;
+  for (int q = 0; q < ref->num_points; ++q)
+  {
+    points[q].x = xi->x + half * ref->points[q].x;
+    points[q].y = xi->y + half * ref->points[q].y;
+    points[q].z = xi->z + half * ref->points[q].z;
+    weights[q] = J * ref->weights[q];
+  }
+}
+
+static void ref_surf_get_quad(void* context, int i, point_t* points, real_t* weights, vector_t* normals)
+{
+  mlpg_ref_t* ref = context;
+  point_t* xi = &ref->cloud->points[i];
+  real_t scale = ref->scale * ref->ratio * ref->extents[i];
+  real_t J = scale * scale;
+  for (int q = 0; q < ref->num_points; ++q)
+  {
+    points[q].x = xi->x + scale * ref->points[q].x;
+    points[q].y = xi->y + scale * ref->points[q].y;
+    points[q].z = xi->z + scale * ref->points[q].z;
+    weights[q] = J * ref->weights[q];
+    normals[q] = ref->normals[q];
+  }
+}
+
+volume_integral_t* mlpg_cube_symmetric_volume_integral_new(point_cloud_t* cloud,
+                                                           real_t* extents,
+                                                           int degree,
+                                                           real_t side_to_extent_ratio)
+{
+  mlpg_ref_t* ref = mlpg_ref_new(cloud, extents, degree, side_to_extent_ratio, 0.5);
+  build_cube_volume_rule(ref);
+  volume_integral_vtable vtable = {.num_quad_points = ref_num_quad_points,
+                                   .get_quadrature = ref_cube_vol_get_quad,
+                                   .dtor = mlpg_ref_free};
+  char name[1025];
+  snprintf(name, 1024, "MLPG symmetric cube volume integral (degree = %d, side/extent = %g)", 
+           degree, side_to_extent_ratio);
+  return volume_integral_new(name, ref, vtable);
+}
+
+surface_integral_t* mlpg_cube_symmetric_surface_integral_new(point_cloud_t* cloud,
+                                                             real_t* extents,
+                                                             int degree,
+                                                             real_t side_to_extent_ratio)
+{
+  mlpg_ref_t* ref = mlpg_ref_new(cloud, extents, degree, side_to_extent_ratio, 0.5);
+  build_cube_surface_rule(ref);
+  surface_integral_vtable vtable = {.num_quad_points = ref_num_quad_points,
+                                    .get_quadrature = ref_surf_get_quad,
+                                    .dtor = mlpg_ref_free};
+  char name[1025];
+  snprintf(name, 1024, "MLPG symmetric cube surface integral (degree = %d, side/extent = %g)", 
+           degree, side_to_extent_ratio);
+  return surface_integral_new(name, ref, vtable);
+}
+
+surface_integral_t* mlpg_sphere_lebedev_surface_integral_new(point_cloud_t* cloud,
+                                                             real_t* extents,
+                                                             int degree,
+                                                             real_t radius_to_extent_ratio)
+{
+  mlpg_ref_t* ref = mlpg_ref_new(cloud, extents, degree, radius_to_extent_ratio, 1.0);
+  build_sphere_surface_rule(ref);
+  surface_integral_vtable vtable = {.num_quad_points = ref_num_quad_points,
+                                    .get_quadrature = ref_surf_get_quad,
+                                    .dtor = mlpg_ref_free};
+  char name[1025];
+  snprintf(name, 1024, "MLPG Lebedev sphere surface integral (degree = %d, radius/extent = %g)", 
+           degree, radius_to_extent_ratio);
+  return surface_integral_new(name, ref, vtable);
+}
+
+
+// The number of segments on which an implicit function is sampled along a 
+// line when a cube is clipped to it, and the maximum number of intervals of
+// the line that can lie within the domain.
+#define CLIP_NUM_SAMPLES 8
+#define CLIP_MAX_INTERVALS (CLIP_NUM_SAMPLES/2 + 1)
+
+// A clipped rule clips the cube about each point to a domain, and builds 
+// its quadrature rule for the cube when it is first needed. The rule is 
+// kept until that of another cube is needed, or until the point or its 
+// extent changes.
+typedef struct
+{
+  point_cloud_t* cloud;
+  real_t* extents;
+  int N;
+  real_t ratio; 
+
+  // The domain is the intersection of a bounding box (if has_domain is 
+  // true) and the region in which an implicit function is negative (if 
+  // boundary is non-NULL).
+  bool has_domain;
+  bbox_t domain;
+  sp_func_t* boundary;
+
+  // Builds the rule for the ith cube.
+  void (*build)(void* context, int i);
+
+  // The rule for the ith cube, centered at x with extent h.
+  int i;
+  point_t x;
+  real_t h;
+  int num_points, capacity;
+  point_t* points;
+  real_t* weights;
+  vector_t* normals;
+} mlpg_clipped_t;
+
+static mlpg_clipped_t* mlpg_clipped_new(point_cloud_t* cloud,
+                                        real_t* extents,
+                                        int num_points,
+                                        real_t ratio,
+                                        bbox_t* domain,
+                                        sp_func_t* boundary,
+                                        void (*build)(void* context, int i))
+{
+  ASSERT(num_points > 0);
+  ASSERT(ratio > 0.0);
+  ASSERT((boundary == NULL) || (sp_func_num_comp(boundary) == 1));
+
+  mlpg_clipped_t* clip = polymec_malloc(sizeof(mlpg_clipped_t));
+  clip->cloud = cloud;
+  clip->extents = extents;
+  clip->N = num_points;
+  clip->ratio = ratio;
+  clip->has_domain = (domain != NULL);
+  if (domain != NULL)
+    clip->domain = *domain;
+  clip->boundary = boundary;
+  clip->build = build;
+  clip->i = -1;
+  clip->num_points = 0;
+  clip->capacity = 0;
+  clip->points = NULL;
+  clip->weights = NULL;
+  clip->normals = NULL;
+  return clip;
+}
+
+static void mlpg_clipped_free(void* context)
+{
+  mlpg_clipped_t* clip = context;
+  polymec_free(clip->points);
+  polymec_free(clip->weights);
+  polymec_free(clip->normals);
+  polymec_free(clip);
+}
+
+static void mlpg_clipped_add_point(mlpg_clipped_t* clip, real_t* x, real_t w, 
+                                   vector_t* normal)
+{
+  if (clip->num_points == clip->capacity)
+  {
+    clip->capacity = MAX(16, 2 * clip->capacity);
+    clip->points = polymec_realloc(clip->points, sizeof(point_t) * clip->capacity);
+    clip->weights = polymec_realloc(clip->weights, sizeof(real_t) * clip->capacity);
+    clip->normals = polymec_realloc(clip->normals, sizeof(vector_t) * clip->capacity);
+  }
+  int n = clip->num_points++;
+  clip->points[n].x = x[0];
+  clip->points[n].y = x[1];
+  clip->points[n].z = x[2];
+  clip->weights[n] = w;
+  if (normal != NULL)
+    clip->normals[n] = *normal;
+}
+
+// Computes the lower and upper corners of the ith cube, clipped to the 
+// domain's bounding box, returning false if nothing of it is left.
+static bool get_clipped_cube(mlpg_clipped_t* clip, int i, real_t* lo, real_t* hi)
+{
+  point_t* xi = &clip->cloud->points[i];
+  real_t L = clip->ratio * clip->extents[i];
+  real_t x[3] = {xi->x, xi->y, xi->z};
+  for (int d = 0; d < 3; ++d)
+  {
+    lo[d] = x[d] - 0.5*L;
+    hi[d] = x[d] + 0.5*L;
+  }
+  if (clip->has_domain)
+  {
+    bbox_t* D = &clip->domain;
+    real_t dlo[3] = {D->x1, D->y1, D->z1}, dhi[3] = {D->x2, D->y2, D->z2};
+    for (int d = 0; d < 3; ++d)
+    {
+      lo[d] = MAX(lo[d], dlo[d]);
+      hi[d] = MIN(hi[d], dhi[d]);
+    }
+  }
+  return ((hi[0] > lo[0]) && (hi[1] > lo[1]) && (hi[2] > lo[2]));
+}
+
+static real_t eval_on_segment(sp_func_t* boundary, real_t* x1, real_t* x2, real_t s)
+{
+  point_t x = {.x = x1[0] + s * (x2[0] - x1[0]),
+               .y = x1[1] + s * (x2[1] - x1[1]),
+               .z = x1[2] + s * (x2[2] - x1[2])};
+  real_t phi;
+  sp_func_eval(boundary, &x, &phi);
+  return phi;
+}
+
+// Finds the intervals [s1, s2] of the segment x1 + s * (x2 - x1), 0 <= s <= 1,
+// on which the given implicit function is negative, returning the number of
+// intervals. The function is sampled on CLIP_NUM_SAMPLES segments, and the 
+// roots between samples of different signs are found by bisection. If the 
+// function is NULL, the whole segment is returned.
+static int clip_segment(sp_func_t* boundary, real_t* x1, real_t* x2, 
+                        real_t* s1, real_t* s2)
+{
+  if (boundary == NULL)
+  {
+    s1[0] = 0.0, s2[0] = 1.0;
+    return 1;
+  }
+
+  int n = 0;
+  real_t s_prev = 0.0, phi_prev = eval_on_segment(boundary, x1, x2, 0.0);
+  bool inside = (phi_prev < 0.0);
+  if (inside)
+    s1[0] = 0.0;
+  for (int k = 1; k <= CLIP_NUM_SAMPLES; ++k)
+  {
+    real_t s = 1.0 * k / CLIP_NUM_SAMPLES;
+    real_t phi = eval_on_segment(boundary, x1, x2, s);
+    if ((phi < 0.0) != inside)
+    {
+      // Bisect to find the root.
+      real_t a = s_prev, b = s, phi_a = phi_prev;
+      while (b - a > 1e-12)
+      {
+        real_t m = 0.5 * (a + b);
+        real_t phi_m = eval_on_segment(boundary, x1, x2, m);
+        if ((phi_m < 0.0) == (phi_a < 0.0))
+          a = m, phi_a = phi_m;
+        else
+          b = m;
+      }
+      real_t root = 0.5 * (a + b);
+      if (inside)
+        s2[n++] = root;
+      else
+        s1[n] = root;
+      inside = !inside;
+    }
+    s_prev = s;
+    phi_prev = phi;
+  }
+  if (inside)
+    s2[n++] = 1.0;
+  return n;
+}
+
+// Builds an N x N x N rule on the ith clipped cube. The cube is clipped to 
+// the implicit function along the lines of the rule in z, and each interval
+// of these lines within the domain gets its own N-point Gauss rule.
+static void build_clipped_volume_rule(void* context, int i)
+{
+  mlpg_clipped_t* clip = context;
+  real_t lo[3], hi[3];
+  if (!get_clipped_cube(clip, i, lo, hi))
+    return;
+
+  int N = clip->N;
+  real_t gauss_pts[N], gauss_wts[N];
+  get_gauss_legendre_points(N, gauss_pts, gauss_wts);
+  real_t c[3], h[3];
+  for (int d = 0; d < 3; ++d)
+  {
+    c[d] = 0.5 * (lo[d] + hi[d]);
+    h[d] = 0.5 * (hi[d] - lo[d]);
+  }
+
+  for (int ii = 0; ii < N; ++ii)
+  {
+    for (int jj = 0; jj < N; ++jj)
+    {
+      real_t x1[3] = {c[0] + h[0] * gauss_pts[ii], c[1] + h[1] * gauss_pts[jj], lo[2]};
+      real_t x2[3] = {x1[0], x1[1], hi[2]};
+      real_t s1[CLIP_MAX_INTERVALS], s2[CLIP_MAX_INTERVALS];
+      int num_intervals = clip_segment(clip->boundary, x1, x2, s1, s2);
+      for (int k = 0; k < num_intervals; ++k)
+      {
+        real_t z1 = lo[2] + s1[k] * (hi[2] - lo[2]);
+        real_t z2 = lo[2] + s2[k] * (hi[2] - lo[2]);
+        real_t cz = 0.5 * (z1 + z2), hz = 0.5 * (z2 - z1);
+        for (int kk = 0; kk < N; ++kk)
+        {
+          real_t x[3] = {x1[0], x1[1], cz + hz * gauss_pts[kk]};
+          real_t w = gauss_wts[ii] * gauss_wts[jj] * gauss_wts[kk] * h[0] * h[1] * hz;
+          mlpg_clipped_add_point(clip, x, w, NULL);
+        }
+      }
+    }
+  }
+}
+
+// Builds an N x N rule on each face of the ith clipped cube, omitting the 
+// faces that lie on the boundary of the domain's bounding box. Each face is
+// clipped to the implicit function along the lines of its rule, as in 
+// build_clipped_volume_rule.
+static void build_clipped_surface_rule(void* context, int i)
+{
+  mlpg_clipped_t* clip = context;
+  real_t lo[3], hi[3];
+  if (!get_clipped_cube(clip, i, lo, hi))
+    return;
+
+  int N = clip->N;
+  real_t gauss_pts[N], gauss_wts[N];
+  get_gauss_legendre_points(N, gauss_pts, gauss_wts);
+  real_t c[3], h[3];
+  for (int d = 0; d < 3; ++d)
+  {
+    c[d] = 0.5 * (lo[d] + hi[d]);
+    h[d] = 0.5 * (hi[d] - lo[d]);
+  }
+  bbox_t* D = &clip->domain;
+  real_t dlo[3] = {D->x1, D->y1, D->z1}, dhi[3] = {D->x2, D->y2, D->z2};
+
+  for (int a = 0; a < 3; ++a)
+  {
+    int u = (a+1)%3, v = (a+2)%3;
+    for (int side = -1; side <= 1; side += 2)
+    {
+      real_t coord = (side < 0) ? lo[a] : hi[a];
+      if (clip->has_domain && (coord == ((side < 0) ? dlo[a] : dhi[a])))
+        continue;
+      vector_t normal = {.x = 0.0, .y = 0.0, .z = 0.0};
+      if (a == 0) normal.x = 1.0 * side;
+      else if (a == 1) normal.y = 1.0 * side;
+      else normal.z = 1.0 * side;
+
+      for (int ii = 0; ii < N; ++ii)
+      {
+        real_t x1[3], x2[3];
+        x1[a] = x2[a] = coord;
+        x1[u] = x2[u] = c[u] + h[u] * gauss_pts[ii];
+        x1[v] = lo[v];
+        x2[v] = hi[v];
+        real_t s1[CLIP_MAX_INTERVALS], s2[CLIP_MAX_INTERVALS];
+        int num_intervals = clip_segment(clip->boundary, x1, x2, s1, s2);
+        for (int k = 0; k < num_intervals; ++k)
+        {
+          real_t v1 = lo[v] + s1[k] * (hi[v] - lo[v]);
+          real_t v2 = lo[v] + s2[k] * (hi[v] - lo[v]);
+          real_t cv = 0.5 * (v1 + v2), hv = 0.5 * (v2 - v1);
+          for (int kk = 0; kk < N; ++kk)
+          {
+            real_t x[3];
+            x[a] = coord;
+            x[u] = x1[u];
+            x[v] = cv + hv * gauss_pts[kk];
+            real_t w = gauss_wts[ii] * gauss_wts[kk] * h[u] * hv;
+            mlpg_clipped_add_point(clip, x, w, &normal);
+          }
+        }
+      }
+    }
+  }
+}
+
+static void mlpg_clipped_set_cube(mlpg_clipped_t* clip, int i)
+{
+  // The points and their extents can move between integrals, so we 
+  // rebuild the rule whenever the cube itself has changed.
+  point_t* xi = &clip->cloud->points[i];
+  real_t hi = clip->extents[i];
+  if ((i != clip->i) || (xi->x != clip->x.x) || (xi->y != clip->x.y) || 
+      (xi->z != clip->x.z) || (hi != clip->h))
+  {
+    clip->num_points = 0;
+    clip->build(clip, i);
+    clip->i = i;
+    clip->x = *xi;
+    clip->h = hi;
+  }
+}
+
+static int clipped_num_quad_points(void* context, int i)
+{
+  mlpg_clipped_t* clip = context;
+  mlpg_clipped_set_cube(clip, i);
+  return clip->num_points;
+}
+
+static void clipped_vol_get_quad(void* context, int i, point_t* points, real_t* weights)
+{
+  mlpg_clipped_t* clip = context;
+  mlpg_clipped_set_cube(clip, i);
+  memcpy(points, clip->points, sizeof(point_t) * clip->num_points);
+  memcpy(weights, clip->weights, sizeof(real_t) * clip->num_points);
+}
+
+static void clipped_surf_get_quad(void* context, int i, point_t* points, real_t* weights, vector_t* normals)
+{
+  mlpg_clipped_t* clip = context;
+  mlpg_clipped_set_cube(clip, i);
+  memcpy(points, clip->points, sizeof(point_t) * clip->num_points);
+  memcpy(weights, clip->weights, sizeof(real_t) * clip->num_points);
+  memcpy(normals, clip->normals, sizeof(vector_t) * clip->num_points);
+}
+
+volume_integral_t* mlpg_clipped_cube_volume_integral_new(point_cloud_t* cloud,
+                                                         real_t* extents,
+                                                         int num_points,
+                                                         real_t side_to_extent_ratio,
+                                                         bbox_t* domain,
+                                                         sp_func_t* boundary)
+{
+  mlpg_clipped_t* clip = mlpg_clipped_new(cloud, extents, num_points, 
+                                          side_to_extent_ratio, domain, 
+                                          boundary, build_clipped_volume_rule);
+  volume_integral_vtable vtable = {.num_quad_points = clipped_num_quad_points,
+                                   .get_quadrature = clipped_vol_get_quad,
+                                   .dtor = mlpg_clipped_free};
+  char name[1025];
+  snprintf(name, 1024, "MLPG clipped cube volume integral (N = %d, side/extent = %g)", 
+           num_points, side_to_extent_ratio);
+  return volume_integral_new(name, clip, vtable);
+}
+
+surface_integral_t* mlpg_clipped_cube_surface_integral_new(point_cloud_t* cloud,
+                                                           real_t* extents,
+                                                           int num_points,
+                                                           real_t side_to_extent_ratio,
+                                                           bbox_t* domain,
+                                                           sp_func_t* boundary)
+{
+  mlpg_clipped_t* clip = mlpg_clipped_new(cloud, extents, num_points, 
+                                          side_to_extent_ratio, domain, 
+                                          boundary, build_clipped_surface_rule);
+  surface_integral_vtable vtable = {.num_quad_points = clipped_num_quad_points,
+                                    .get_quadrature = clipped_surf_get_quad,
+                                    .dtor = mlpg_clipped_free};
+  char name[1025];
+  snprintf(name, 1024, "MLPG clipped cube surface integral (N = %d, side/extent = %g)", 
+           num_points, side_to_extent_ratio);
+  return surface_integral_new(name, clip, vtable);
+}
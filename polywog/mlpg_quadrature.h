@@ -9,6 +9,7 @@
 #define POLYWOG_MLPG_QUADRATURE_H
 
 #include "core/point_cloud.h"
+#include "core/sp_func.h"
 #include "integrators/volume_integral.h"
 #include "integrators/surface_integral.h"
 
@@ -52,4 +53,74 @@ volume_integral_t* mlpg_sphere_volume_integral_new(point_cloud_t* cloud,
                                                    int num_points,
                                                    real_t radius_to_extent_ratio);
 
+// The following rules are exact for polynomials up to a given degree, and 
+// use far fewer points than the tensor-product rules above for the low 
+// degrees typical of MLPG functionals. Each maps a fixed reference rule to 
+// the subdomain of each point, so its points are computed only once.
+
+// This quadrature rule computes volume integrals over cubes (defined as for 
+// mlpg_cube_volume_integral_new) that is exact for polynomials of the given
+// degree, using fully symmetric rules with 1, 6, or 14 points through 
+// degree 5 (vs 27 points for a 3 x 3 x 3 Gauss rule), and tensor-product 
+// Gauss rules beyond.
+volume_integral_t* mlpg_cube_symmetric_volume_integral_new(point_cloud_t* cloud,
+                                                           real_t* extents,
+                                                           int degree,
+                                                           real_t side_to_extent_ratio);
+
+// This quadrature rule computes surface integrals over cubes (defined as 
+// for mlpg_cube_surface_integral_new) that is exact for polynomials of the
+// given degree, using symmetric rules on each face with 1, 4, 7 (Radon), or
+// 12 (Stroud) points through degree 7, and tensor-product Gauss rules 
+// beyond.
+surface_integral_t* mlpg_cube_symmetric_surface_integral_new(point_cloud_t* cloud,
+                                                             real_t* extents,
+                                                             int degree,
+                                                             real_t side_to_extent_ratio);
+
+// This quadrature rule computes surface integrals over spheres (defined as 
+// for mlpg_sphere_surface_integral_new) that is exact for polynomials of 
+// the given degree, using Lebedev rules with 6, 14, 26, 38, or 50 points 
+// through degree 11, and a product of Gauss rules in the cosine of the polar
+// angle with equally-spaced azimuthal points beyond.
+surface_integral_t* mlpg_sphere_lebedev_surface_integral_new(point_cloud_t* cloud,
+                                                             real_t* extents,
+                                                             int degree,
+                                                             real_t radius_to_extent_ratio);
+
+// The following rules clip the cube about each point to a domain, so that 
+// cubes near the domain's boundary have no quadrature points outside it. 
+// The domain is the intersection of a bounding box and the region in which 
+// an implicit function (with a single component) is negative; either of 
+// these may be NULL. Cubes are clipped exactly to the bounding box. They 
+// are clipped to the implicit function along the lines of their rules, 
+// each interval of which within the domain gets its own Gauss rule, so the
+// number of quadrature points varies from cube to cube. The implicit 
+// function is sampled at 8 intervals along each line to find its roots, so
+// features of the domain much smaller than a cube may be missed. The rules
+// do not assert ownership over the implicit function.
+
+// This quadrature rule computes volume integrals over cubes (defined as for
+// mlpg_cube_volume_integral_new) clipped to the given domain, using 
+// num_points Gauss points along each axis.
+volume_integral_t* mlpg_clipped_cube_volume_integral_new(point_cloud_t* cloud,
+                                                         real_t* extents,
+                                                         int num_points,
+                                                         real_t side_to_extent_ratio,
+                                                         bbox_t* domain,
+                                                         sp_func_t* boundary);
+
+// This quadrature rule computes surface integrals over the boundaries of 
+// cubes (defined as for mlpg_cube_surface_integral_new) clipped to the 
+// given domain, using num_points Gauss points along each axis of a face. 
+// Only the parts of these boundaries that lie within the domain are 
+// included: the parts on the domain's boundary, where boundary conditions 
+// are imposed, are omitted.
+surface_integral_t* mlpg_clipped_cube_surface_integral_new(point_cloud_t* cloud,
+                                                           real_t* extents,
+                                                           int num_points,
+                                                           real_t side_to_extent_ratio,
+                                                           bbox_t* domain,
+                                                           sp_func_t* boundary);
+
 #endif
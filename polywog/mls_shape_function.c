@@ -23,12 +23,33 @@ typedef struct
   point_t* xj;
   real_t* hj;
 
+  // Tokens for the exchanges of ghost points and smoothing lengths, which 
+  // are finished when a neighborhood first needs ghost data.
+  bool exchange_pending;
+  int points_token, h_token;
+
+  // has_ghosts[i] is true if the neighborhood of point i includes ghost 
+  // points.
+  bool* has_ghosts;
+
   real_t* basis;
   real_t* basis_ddx;
   real_t* basis_ddy;
   real_t* basis_ddz;
 } mls_t;
 
+// Finishes the exchange of ghost data begun in the constructor, if needed.
+static void mls_finish_exchange(void* context)
+{
+  mls_t* mls = context;
+  if (mls->exchange_pending)
+  {
+    stencil_finish_exchange(mls->neighborhoods, mls->points_token);
+    stencil_finish_exchange(mls->neighborhoods, mls->h_token);
+    mls->exchange_pending = false;
+  }
+}
+
 static int mls_neighborhood_size(void* context, int i)
 {
   mls_t* mls = context;
@@ -38,6 +59,8 @@ static int mls_neighborhood_size(void* context, int i)
 static void mls_get_neighborhood_points(void* context, int i, point_t* points)
 {
   mls_t* mls = context;
+  if (mls->has_ghosts[i])
+    mls_finish_exchange(mls);
   int pos = 0, j, k = 0;
   points[k++] = mls->domain->points[i];
   while (stencil_next(mls->neighborhoods, i, &pos, &j, NULL))
@@ -48,7 +71,9 @@ static void mls_set_neighborhood(void* context, int i)
 {
   mls_t* mls = context;
 
-  // Extract the points.
+  // Extract the points, making sure any ghost points have arrived.
+  if (mls->has_ghosts[i])
+    mls_finish_exchange(mls);
   mls->N = stencil_size(mls->neighborhoods, i);
   int pos = 0, j, k = 0;
   while (stencil_next(mls->neighborhoods, i, &pos, &j, NULL))
@@ -217,6 +242,7 @@ static void mls_compute(void* context,
 static void mls_dtor(void* context)
 {
   mls_t* mls = context;
+  mls_finish_exchange(mls);
   mls->P = NULL;
   polymec_free(mls->basis);
   polymec_free(mls->basis_ddx);
@@ -224,6 +250,7 @@ static void mls_dtor(void* context)
   polymec_free(mls->basis_ddz);
   polymec_free(mls->xj);
   polymec_free(mls->hj);
+  polymec_free(mls->has_ghosts);
   polymec_free(mls);
 }
 
@@ -254,21 +281,39 @@ shape_function_t* mls_shape_function_new(int polynomial_degree,
   mls->basis_ddy = NULL;
   mls->basis_ddz = NULL;
 
-  // Count up the maximum neighborhood size and allocate storage.
+  // Count up the maximum neighborhood size and allocate storage, and find 
+  // the neighborhoods that include ghost points.
   int max_neighborhood_size = -1;
+  mls->has_ghosts = polymec_malloc(sizeof(bool) * MAX(mls->domain->num_points, 1));
   for (int i = 0; i < mls->domain->num_points; ++i)
+  {
     max_neighborhood_size = MAX(max_neighborhood_size, stencil_size(mls->neighborhoods, i));
+    mls->has_ghosts[i] = false;
+    int pos = 0, j;
+    while (stencil_next(mls->neighborhoods, i, &pos, &j, NULL))
+    {
+      if (j >= mls->domain->num_points)
+      {
+        mls->has_ghosts[i] = true;
+        break;
+      }
+    }
+  }
   mls->xj = polymec_malloc(sizeof(point_t) * max_neighborhood_size);
   mls->hj = polymec_malloc(sizeof(real_t) * max_neighborhood_size);
 
-  // Make sure our ghost points are consistent.
-  stencil_exchange(mls->neighborhoods, mls->domain->points, 3, 0, MPI_REAL_T);
-  stencil_exchange(mls->neighborhoods, mls->smoothing_lengths, 1, 0, MPI_REAL_T);
+  // Begin making our ghost points consistent. We only wait for the ghost 
+  // data when a neighborhood that includes ghost points is first used, so 
+  // that neighborhoods of interior points can be processed in the meantime.
+  mls->points_token = stencil_start_exchange(mls->neighborhoods, mls->domain->points, 3, 0, MPI_REAL_T);
+  mls->h_token = stencil_start_exchange(mls->neighborhoods, mls->smoothing_lengths, 1, 1, MPI_REAL_T);
+  mls->exchange_pending = true;
 
   shape_function_vtable vtable = {.neighborhood_size = mls_neighborhood_size,
                                   .get_neighborhood_points = mls_get_neighborhood_points,
                                   .set_neighborhood = mls_set_neighborhood,
                                   .compute = mls_compute,
+                                  .finish_exchange = mls_finish_exchange,
                                   .dtor = mls_dtor};
   char name[1024];
   snprintf(name, 1023, "MLS shape function (p = %d)", polynomial_degree);
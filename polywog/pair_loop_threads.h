@@ -0,0 +1,126 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef POLYWOG_PAIR_LOOP_THREADS_H
+#define POLYWOG_PAIR_LOOP_THREADS_H
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#include "model/neighbor_pairing.h"
+
+// This file contains internal helpers shared by the threaded pair loops
+// (sph_pair_loop and fvpm_flux_loop). It is not part of polywog's API.
+
+// Returns the maximum number of threads in a parallel region.
+static inline int pair_loop_max_num_threads()
+{
+#ifdef _OPENMP
+  return omp_get_max_threads();
+#else
+  return 1;
+#endif
+}
+
+// Returns the index of the calling thread within its team.
+static inline int pair_loop_thread_index()
+{
+#ifdef _OPENMP
+  return omp_get_thread_num();
+#else
+  return 0;
+#endif
+}
+
+// Returns the number of threads in the calling thread's team.
+static inline int pair_loop_team_size()
+{
+#ifdef _OPENMP
+  return omp_get_num_threads();
+#else
+  return 1;
+#endif
+}
+
+// Returns the number of points (locally-owned and ghost) spanned by the
+// pairs in the given pairing and by the indices of its exchanger.
+static inline int pair_loop_num_points(neighbor_pairing_t* pairing)
+{
+  int max_index = -1, pos = 0, i, j;
+  while (neighbor_pairing_next(pairing, &pos, &i, &j, NULL))
+    max_index = MAX(max_index, MAX(i, j));
+
+  int proc, num_indices, *indices;
+  pos = 0;
+  while (exchanger_next_send(pairing->ex, &pos, &proc, &indices, &num_indices))
+  {
+    for (int k = 0; k < num_indices; ++k)
+      max_index = MAX(max_index, indices[k]);
+  }
+  pos = 0;
+  while (exchanger_next_receive(pairing->ex, &pos, &proc, &indices, &num_indices))
+  {
+    for (int k = 0; k < num_indices; ++k)
+      max_index = MAX(max_index, indices[k]);
+  }
+  return max_index + 1;
+}
+
+// Accumulation buffers for threads other than the first (which accumulates
+// directly into an output array). Each buffer has room for num_points
+// points, with point_size bytes per point.
+typedef struct
+{
+  size_t point_size;
+  int num_threads, num_points;
+  void** bufs;
+} pair_loop_buffers_t;
+
+// Initializes a set of thread buffers with the given number of bytes per
+// point. No buffers are allocated until pair_loop_buffers_reserve is called.
+static inline void pair_loop_buffers_init(pair_loop_buffers_t* buffers,
+                                          size_t point_size)
+{
+  buffers->point_size = point_size;
+  buffers->num_threads = 0;
+  buffers->num_points = 0;
+  buffers->bufs = NULL;
+}
+
+// Frees the given thread buffers.
+static inline void pair_loop_buffers_free(pair_loop_buffers_t* buffers)
+{
+  for (int t = 1; t < buffers->num_threads; ++t)
+    polymec_free(buffers->bufs[t]);
+  if (buffers->bufs != NULL)
+    polymec_free(buffers->bufs);
+  buffers->bufs = NULL;
+  buffers->num_threads = 0;
+  buffers->num_points = 0;
+}
+
+// Makes sure that there is a buffer with room for the given number of
+// points for each thread (other than the first) in a parallel region.
+static inline void pair_loop_buffers_reserve(pair_loop_buffers_t* buffers,
+                                             int num_points)
+{
+  int num_threads = pair_loop_max_num_threads();
+  if ((num_threads == buffers->num_threads) &&
+      (num_points <= buffers->num_points))
+    return;
+
+  pair_loop_buffers_free(buffers);
+  buffers->num_threads = num_threads;
+  buffers->num_points = num_points;
+  buffers->bufs = polymec_malloc(sizeof(void*) * num_threads);
+  buffers->bufs[0] = NULL;
+  for (int t = 1; t < num_threads; ++t)
+    buffers->bufs[t] = polymec_malloc(buffers->point_size * MAX(num_points, 1));
+}
+
+#endif
@@ -5,6 +5,8 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+#include "core/timer.h"
+#include "core/kd_tree.h"
 #include "core/partition_point_cloud.h"
 #include "polywog/partition_point_cloud_with_neighbors.h"
 
@@ -14,221 +16,1204 @@ extern int64_t* partition_graph(adj_graph_t* global_graph,
                                 int* weights, 
                                 real_t imbalance_tol);
 
-static void neighbor_pairing_distribute(neighbor_pairing_t** neighbors,
-                                        MPI_Comm comm,
-                                        int64_t* global_partition,
-                                        int num_indices)
+#if POLYMEC_HAVE_MPI
+
+// Computes the distribution of n items in contiguous chunks among nprocs 
+// processes: process p gets the items in [dist[p], dist[p+1]).
+static void get_chunks(int64_t n, int nprocs, int64_t* dist)
+{
+  for (int p = 0; p <= nprocs; ++p)
+    dist[p] = p * n / nprocs;
+}
+
+// Returns the process that owns the given index, given the distribution of 
+// indices among the processes.
+static int find_owner(int64_t* dist, int nprocs, int64_t i)
+{
+  ASSERT(i >= dist[0]);
+  ASSERT(i < dist[nprocs]);
+  int lo = 0, hi = nprocs;
+  while (hi - lo > 1)
+  {
+    int mid = (lo + hi) / 2;
+    if (dist[mid] <= i)
+      lo = mid;
+    else
+      hi = mid;
+  }
+  return lo;
+}
+
+static int int64_cmp(const void* l, const void* r)
+{
+  int64_t a = *((const int64_t*)l), b = *((const int64_t*)r);
+  return (a < b) ? -1 : (a > b) ? 1 : 0;
+}
+
+// Sends send_counts[p] items of the given type from send_buf (which is 
+// grouped by process) to each process p, returning a newly-allocated buffer 
+// containing the items received from all processes (also grouped by 
+// process). The number of items received from each process is stored in 
+// recv_counts, and the total in num_received.
+static void* alltoallv(MPI_Comm comm, void* send_buf, int* send_counts,
+                       MPI_Datatype type, size_t type_size, 
+                       int* recv_counts, int* num_received)
+{
+  int nprocs;
+  MPI_Comm_size(comm, &nprocs);
+  MPI_Alltoall(send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT, comm);
+  int send_displs[nprocs], recv_displs[nprocs];
+  send_displs[0] = recv_displs[0] = 0;
+  for (int p = 1; p < nprocs; ++p)
+  {
+    send_displs[p] = send_displs[p-1] + send_counts[p-1];
+    recv_displs[p] = recv_displs[p-1] + recv_counts[p-1];
+  }
+  *num_received = recv_displs[nprocs-1] + recv_counts[nprocs-1];
+  void* recv_buf = polymec_malloc(type_size * MAX(*num_received, 1));
+  MPI_Alltoallv(send_buf, send_counts, send_displs, type, 
+                recv_buf, recv_counts, recv_displs, type, comm);
+  return recv_buf;
+}
+
+// Creates and commits an MPI datatype for contiguous records of the given 
+// number of elements of the given type. Messages made of such records are 
+// counted in records, so that their counts and displacements don't overflow
+// an int as they would if they were counted in elements (or bytes). The 
+// type must be freed with MPI_Type_free.
+static MPI_Datatype record_type_new(int num_elements, MPI_Datatype element_type)
+{
+  MPI_Datatype type;
+  MPI_Type_contiguous(num_elements, element_type, &type);
+  MPI_Type_commit(&type);
+  return type;
+}
+
+// Given a directory of values distributed among processes in chunks (so 
+// that this process has the values for indices in [dist[rank], 
+// dist[rank+1])), returns a newly-allocated array containing the values for 
+// the given n indices, which are looked up on the processes that own them.
+static int64_t* look_up_indices(MPI_Comm comm, int64_t* dist, int64_t* values,
+                                int n, int* indices)
 {
   int nprocs, rank;
   MPI_Comm_size(comm, &nprocs);
   MPI_Comm_rank(comm, &rank);
 
-  // Make sure we're all here.
-  MPI_Barrier(comm);
+  // Group the indices by the processes that own their values, keeping track 
+  // of the position of each index in the query.
+  int send_counts[nprocs], offsets[nprocs];
+  memset(send_counts, 0, sizeof(int) * nprocs);
+  int* pos = polymec_malloc(sizeof(int) * MAX(n, 1));
+  for (int k = 0; k < n; ++k)
+  {
+    pos[k] = find_owner(dist, nprocs, indices[k]);
+    ++send_counts[pos[k]];
+  }
+  offsets[0] = 0;
+  for (int p = 1; p < nprocs; ++p)
+    offsets[p] = offsets[p-1] + send_counts[p-1];
+  int* queries = polymec_malloc(sizeof(int) * MAX(n, 1));
+  for (int k = 0; k < n; ++k)
+  {
+    pos[k] = offsets[pos[k]]++;
+    queries[pos[k]] = indices[k];
+  }
+
+  // Answer the queries we receive, and send the answers back.
+  int recv_counts[nprocs], num_queries;
+  int* received = alltoallv(comm, queries, send_counts, MPI_INT, sizeof(int),
+                            recv_counts, &num_queries);
+  polymec_free(queries);
+  int64_t* answers = polymec_malloc(sizeof(int64_t) * MAX(num_queries, 1));
+  for (int q = 0; q < num_queries; ++q)
+    answers[q] = values[received[q] - dist[rank]];
+  polymec_free(received);
+  int num_answers;
+  int64_t* replies = alltoallv(comm, answers, recv_counts, MPI_INT64_T, 
+                               sizeof(int64_t), send_counts, &num_answers);
+  ASSERT(num_answers == n);
+  polymec_free(answers);
+
+  int64_t* results = polymec_malloc(sizeof(int64_t) * MAX(n, 1));
+  for (int k = 0; k < n; ++k)
+    results[k] = replies[pos[k]];
+  polymec_free(replies);
+  polymec_free(pos);
+  return results;
+}
+
+// Given a set of pairs of global indices (and, if has_weights is true, their
+// weights) on this process, routes each pair to the process(es) owning its 
+// indices according to vtx_dist, and creates a neighbor pairing for the 
+// points on this process. The owned points on each process are numbered 
+// consecutively in order of their global indices, and are followed by its 
+// ghost points, also in order of their global indices. The number of ghosts
+// is stored in num_ghosts. This consumes the given pairs and weights.
+static neighbor_pairing_t* neighbor_pairing_from_global_pairs(MPI_Comm comm,
+                                                              const char* name,
+                                                              int64_t* vtx_dist,
+                                                              int num_pairs,
+                                                              int64_t* pairs,
+                                                              bool has_weights,
+                                                              real_t* weights,
+                                                              int* num_ghosts)
+{
+  int nprocs, rank;
+  MPI_Comm_size(comm, &nprocs);
+  MPI_Comm_rank(comm, &rank);
+
+  // Route each pair to the owners of its points.
+  int send_counts[nprocs], offsets[nprocs];
+  memset(send_counts, 0, sizeof(int) * nprocs);
+  for (int k = 0; k < num_pairs; ++k)
+  {
+    int pi = find_owner(vtx_dist, nprocs, pairs[2*k]);
+    int pj = find_owner(vtx_dist, nprocs, pairs[2*k+1]);
+    ++send_counts[pi];
+    if (pj != pi)
+      ++send_counts[pj];
+  }
+  offsets[0] = 0;
+  for (int p = 1; p < nprocs; ++p)
+    offsets[p] = offsets[p-1] + send_counts[p-1];
+  int num_sent = offsets[nprocs-1] + send_counts[nprocs-1];
+  int64_t* send_pairs = polymec_malloc(sizeof(int64_t) * 2 * MAX(num_sent, 1));
+  real_t* send_weights = has_weights ? polymec_malloc(sizeof(real_t) * MAX(num_sent, 1)) : NULL;
+  for (int k = 0; k < num_pairs; ++k)
+  {
+    int procs[2] = {find_owner(vtx_dist, nprocs, pairs[2*k]), 
+                    find_owner(vtx_dist, nprocs, pairs[2*k+1])};
+    for (int l = 0; l < ((procs[1] != procs[0]) ? 2 : 1); ++l)
+    {
+      int m = offsets[procs[l]]++;
+      send_pairs[2*m]   = pairs[2*k];
+      send_pairs[2*m+1] = pairs[2*k+1];
+      if (has_weights)
+        send_weights[m] = weights[k];
+    }
+  }
+  polymec_free(pairs);
+  if (weights != NULL)
+    polymec_free(weights);
+
+  // Each pair is sent as a single record, so the counts are in pairs.
+  int recv_counts[nprocs], num_local_pairs;
+  MPI_Datatype pair_type = record_type_new(2, MPI_INT64_T);
+  int64_t* recv_pairs = alltoallv(comm, send_pairs, send_counts, pair_type,
+                                  2 * sizeof(int64_t), recv_counts, 
+                                  &num_local_pairs);
+  MPI_Type_free(&pair_type);
+  polymec_free(send_pairs);
+  int num_indices = 2 * num_local_pairs;
+  real_t* local_weights = NULL;
+  if (has_weights)
+  {
+    int num_received;
+    local_weights = alltoallv(comm, send_weights, send_counts, MPI_REAL_T, 
+                              sizeof(real_t), recv_counts, &num_received);
+    ASSERT(num_received == num_local_pairs);
+    polymec_free(send_weights);
+  }
+
+  // Find our ghost points.
+  int64_t first = vtx_dist[rank];
+  int num_owned = (int)(vtx_dist[rank+1] - first);
+  int64_t* ghosts = polymec_malloc(sizeof(int64_t) * MAX(num_indices, 1));
+  int ng = 0;
+  for (int k = 0; k < num_indices; ++k)
+  {
+    if ((recv_pairs[k] < first) || (recv_pairs[k] >= first + num_owned))
+      ghosts[ng++] = recv_pairs[k];
+  }
+  qsort(ghosts, ng, sizeof(int64_t), int64_cmp);
+  int num_unique = 0;
+  for (int g = 0; g < ng; ++g)
+  {
+    if ((num_unique == 0) || (ghosts[g] != ghosts[num_unique-1]))
+      ghosts[num_unique++] = ghosts[g];
+  }
+  ng = num_unique;
+
+  // Express the pairs in terms of local indices.
+  int* local_pairs = polymec_malloc(sizeof(int) * MAX(num_indices, 1));
+  for (int k = 0; k < num_indices; ++k)
+  {
+    int64_t i = recv_pairs[k];
+    if ((i >= first) && (i < first + num_owned))
+      local_pairs[k] = (int)(i - first);
+    else
+    {
+      int64_t* g = bsearch(&i, ghosts, ng, sizeof(int64_t), int64_cmp);
+      ASSERT(g != NULL);
+      local_pairs[k] = num_owned + (int)(g - ghosts);
+    }
+  }
+  polymec_free(recv_pairs);
+
+  // Our ghosts are grouped by their owners, from whom we receive them. 
+  // Their owners learn which of their points to send us.
+  exchanger_t* ex = exchanger_new(comm);
+  int request_counts[nprocs];
+  memset(request_counts, 0, sizeof(int) * nprocs);
+  for (int g = 0; g < ng; ++g)
+    ++request_counts[find_owner(vtx_dist, nprocs, ghosts[g])];
+  for (int p = 0, g = 0; p < nprocs; ++p)
+  {
+    if (request_counts[p] > 0)
+    {
+      int* indices = polymec_malloc(sizeof(int) * request_counts[p]);
+      for (int k = 0; k < request_counts[p]; ++k, ++g)
+        indices[k] = num_owned + g;
+      exchanger_set_receive(ex, p, indices, request_counts[p], false);
+    }
+  }
+  int requested_counts[nprocs], num_requested;
+  int64_t* requested = alltoallv(comm, ghosts, request_counts, MPI_INT64_T, 
+                                 sizeof(int64_t), requested_counts, 
+                                 &num_requested);
+  polymec_free(ghosts);
+  for (int p = 0, r = 0; p < nprocs; ++p)
+  {
+    if (requested_counts[p] > 0)
+    {
+      int* indices = polymec_malloc(sizeof(int) * requested_counts[p]);
+      for (int k = 0; k < requested_counts[p]; ++k, ++r)
+        indices[k] = (int)(requested[r] - first);
+      exchanger_set_send(ex, p, indices, requested_counts[p], false);
+    }
+  }
+  polymec_free(requested);
+
+  *num_ghosts = ng;
+  return neighbor_pairing_new(name, num_local_pairs, local_pairs, 
+                              local_weights, ex);
+}
 
+// Distributes the global neighbor pairing on rank 0 to the processes on the 
+// given communicator according to the given global partition vector, 
+// replacing it with the local pairing on each process and returning the 
+// number of ghost points on this process. This assumes that 
+// distribute_point_cloud places the points on each process in order of 
+// their global indices. Rank 0 hands out the pairs and the local indices 
+// of the points in contiguous chunks, and the processes sort out the rest 
+// amongst themselves.
+static int neighbor_pairing_distribute(neighbor_pairing_t** neighbors,
+                                       MPI_Comm comm,
+                                       int64_t* global_partition,
+                                       int num_indices)
+{
+  START_FUNCTION_TIMER();
+  int nprocs, rank;
+  MPI_Comm_size(comm, &nprocs);
+  MPI_Comm_rank(comm, &rank);
+
+  // Share the numbers of indices and pairs, and the name of the pairing.
   neighbor_pairing_t* global_pairing = *neighbors;
-  neighbor_pairing_t* local_pairing = NULL;
-  uint64_t vtx_dist[nprocs+1];
+  int64_t sizes[3] = {0, 0, 0};
+  char name[1025];
   if (rank == 0)
   {
-    // Take stock of how many indices we'll have per process.
-    int num_indices_p[nprocs];
-    memset(num_indices_p, 0, sizeof(int) * nprocs);
+    sizes[0] = num_indices;
+    sizes[1] = global_pairing->num_pairs;
+    sizes[2] = (global_pairing->weights != NULL);
+    strncpy(name, global_pairing->name, 1024);
+    name[1024] = '\0';
+  }
+  MPI_Bcast(sizes, 3, MPI_INT64_T, 0, comm);
+  MPI_Bcast(name, 1025, MPI_CHAR, 0, comm);
+  int64_t num_global_pairs = sizes[1];
+  bool has_weights = (sizes[2] != 0);
+
+  // Construct the distribution of indices ("vertices") for the partitioning,
+  // and the new global index of each point, which numbers the points on 
+  // each process consecutively.
+  int64_t vtx_dist[nprocs+1];
+  int64_t* new_indices = NULL;
+  if (rank == 0)
+  {
+    int64_t num_indices_p[nprocs];
+    memset(num_indices_p, 0, sizeof(int64_t) * nprocs);
     for (int i = 0; i < num_indices; ++i)
       num_indices_p[global_partition[i]]++;
-
-    // Construct the distribution of indices ("vertices") for the partitioning.
     vtx_dist[0] = 0;
     for (int p = 0; p < nprocs; ++p)
       vtx_dist[p+1] = vtx_dist[p] + num_indices_p[p];
 
-    // Now we create representations of pairings for each process. Since the 
-    // ordering of nodes (i, j) within a pair is unpredictable, we construct 
-    // them all simultaneously.
-    int num_pairs[nprocs];
-    int_array_t* pairs[nprocs];
-    real_array_t* weights[nprocs];
-    int_ptr_unordered_map_t* sends[nprocs];
-    int_ptr_unordered_map_t* receives[nprocs];
-    int ghost_indices[nprocs];
-    memset(num_pairs, 0, sizeof(int) * nprocs);
-    memset(pairs, 0, sizeof(int*) * nprocs);
-    memset(weights, 0, sizeof(real_t*) * nprocs);
-    memset(sends, 0, sizeof(int_ptr_unordered_map_t*) * nprocs);
-    memset(receives, 0, sizeof(int_ptr_unordered_map_t*) * nprocs);
-    memset(ghost_indices, 0, sizeof(int) * nprocs);
-    int pos = 0, i, j;
-    real_t w;
-    while (neighbor_pairing_next(global_pairing, &pos, &i, &j, &w))
+    int64_t next_index[nprocs];
+    memcpy(next_index, vtx_dist, sizeof(int64_t) * nprocs);
+    new_indices = polymec_malloc(sizeof(int64_t) * MAX(num_indices, 1));
+    for (int i = 0; i < num_indices; ++i)
+      new_indices[i] = next_index[global_partition[i]]++;
+  }
+  MPI_Bcast(vtx_dist, nprocs+1, MPI_INT64_T, 0, comm);
+
+  // Hand out the new indices in chunks. Together, these form a directory 
+  // that maps the original index of each point to its new index.
+  int64_t index_dist[nprocs+1];
+  get_chunks(sizes[0], nprocs, index_dist);
+  int counts[nprocs], displs[nprocs];
+  for (int p = 0; p < nprocs; ++p)
+  {
+    counts[p] = (int)(index_dist[p+1] - index_dist[p]);
+    displs[p] = (int)index_dist[p];
+  }
+  int64_t* my_new_indices = polymec_malloc(sizeof(int64_t) * MAX(counts[rank], 1));
+  MPI_Scatterv(new_indices, counts, displs, MPI_INT64_T, 
+               my_new_indices, counts[rank], MPI_INT64_T, 0, comm);
+  if (new_indices != NULL)
+    polymec_free(new_indices);
+
+  // Hand out the pairs (and their weights) in chunks.
+  int64_t pair_dist[nprocs+1];
+  get_chunks(num_global_pairs, nprocs, pair_dist);
+  for (int p = 0; p < nprocs; ++p)
+  {
+    counts[p] = (int)(pair_dist[p+1] - pair_dist[p]);
+    displs[p] = (int)pair_dist[p];
+  }
+  int num_pairs = counts[rank];
+  real_t* weights = NULL;
+  if (has_weights)
+  {
+    weights = polymec_malloc(sizeof(real_t) * MAX(num_pairs, 1));
+    MPI_Scatterv((rank == 0) ? global_pairing->weights : NULL, counts, displs, 
+                 MPI_REAL_T, weights, num_pairs, MPI_REAL_T, 0, comm);
+  }
+  MPI_Datatype pair_type = record_type_new(2, MPI_INT);
+  int* pairs = polymec_malloc(sizeof(int) * 2 * MAX(num_pairs, 1));
+  MPI_Scatterv((rank == 0) ? global_pairing->pairs : NULL, counts, displs, 
+               pair_type, pairs, num_pairs, pair_type, 0, comm);
+  MPI_Type_free(&pair_type);
+  if (global_pairing != NULL)
+    neighbor_pairing_free(global_pairing);
+
+  // Translate the pairs to the new indices.
+  int64_t* new_pairs = look_up_indices(comm, index_dist, my_new_indices, 
+                                       2*num_pairs, pairs);
+  polymec_free(pairs);
+  polymec_free(my_new_indices);
+
+  // Route the pairs to their processes.
+  int num_ghosts;
+  *neighbors = neighbor_pairing_from_global_pairs(comm, name, vtx_dist, 
+                                                  num_pairs, new_pairs, 
+                                                  has_weights, weights, 
+                                                  &num_ghosts);
+  STOP_FUNCTION_TIMER();
+  return num_ghosts;
+}
+
+// Recursive coordinate bisection of a set of points distributed among the 
+// processes on a communicator. The parts [0, nprocs) are bisected 
+// recursively, each range of n parts being split into floor(n/2) and 
+// n - floor(n/2) parts. Since every process knows this tree, the cuts for 
+// all the ranges at a given level are computed together, with one reduction 
+// per bisection step.
+typedef struct
+{
+  int lo, hi; // parts [lo, hi)
+  int axis;
+  real_t cut, cut_lo, cut_hi;
+  real_t target, weight_below;
+  bool done;
+} rcb_range_t;
+
+// The maximum number of bisection steps used to find each cut.
+#define RCB_MAX_STEPS 50
+
+static real_t point_coord(point_t* x, int axis)
+{
+  return (axis == 0) ? x->x : (axis == 1) ? x->y : x->z;
+}
+
+// Returns a newly-allocated array containing the part (process) to which 
+// each of the given points (with the given weights, or unit weights if 
+// weights is NULL) is assigned by recursive coordinate bisection. The 
+// weight below each cut is brought to within imbalance_tol of its target, 
+// relative to the weight of a single part, or as close as can be managed 
+// in RCB_MAX_STEPS steps.
+static int* rcb_partition(MPI_Comm comm, int num_points, point_t* points,
+                          real_t* weights, real_t imbalance_tol)
+{
+  START_FUNCTION_TIMER();
+  int nprocs;
+  MPI_Comm_size(comm, &nprocs);
+
+  // Each point starts out in the range containing all parts, which is 
+  // identified by its first part.
+  int* parts = polymec_malloc(sizeof(int) * MAX(num_points, 1));
+  int* range_of_part = polymec_malloc(sizeof(int) * nprocs);
+  for (int i = 0; i < num_points; ++i)
+    parts[i] = 0;
+  rcb_range_t ranges[nprocs];
+  int num_ranges = 1;
+  ranges[0].lo = 0;
+  ranges[0].hi = nprocs;
+
+  while (true)
+  {
+    // Find the ranges to be bisected at this level.
+    int num_split = 0;
+    for (int r = 0; r < num_ranges; ++r)
+    {
+      if (ranges[r].hi - ranges[r].lo > 1)
+        ranges[num_split++] = ranges[r];
+    }
+    if (num_split == 0)
+      break;
+    num_ranges = num_split;
+    for (int p = 0; p < nprocs; ++p)
+      range_of_part[p] = -1;
+    for (int r = 0; r < num_ranges; ++r)
+      range_of_part[ranges[r].lo] = r;
+
+    // Compute the bounding box and total weight of the points in each range.
+    // Points in ranges that are not being split have already found their 
+    // parts.
+    real_t extents[6*num_ranges], weight[num_ranges];
+    for (int r = 0; r < num_ranges; ++r)
+    {
+      for (int d = 0; d < 6; ++d)
+        extents[6*r+d] = -REAL_MAX;
+      weight[r] = 0.0;
+    }
+    for (int i = 0; i < num_points; ++i)
     {
-      // Find the processes containing i and j.
-      ASSERT(i >= vtx_dist[0]);
-      ASSERT(i < vtx_dist[nprocs]);
-      int pi = 0, pj = 0;
-      while (vtx_dist[pi+1] < i) ++pi;
-      while (vtx_dist[pj+1] < j) ++pj;
-
-      // Deposit pairs in each of pi's and pj's arrays.
-      if (pairs[pi] == NULL)
-        pairs[pi] = int_array_new();
-      int_array_append(pairs[pi], i);
-      int_array_append(pairs[pi], j);
-      if (pairs[pj] == NULL)
-        pairs[pj] = int_array_new();
-      int_array_append(pairs[pj], j);
-      int_array_append(pairs[pj], i);
-
-      // Deposit weights, if we're into that sort of thing.
-      if (global_pairing->weights != NULL)
+      int r = range_of_part[parts[i]];
+      if (r == -1) continue;
+      for (int d = 0; d < 3; ++d)
       {
-        if (weights[pi] == NULL)
-          weights[pi] = real_array_new();
-        real_array_append(weights[pi], w);
-        if (weights[pj] == NULL)
-          weights[pj] = real_array_new();
-        real_array_append(weights[pj], w);
+        real_t x = point_coord(&points[i], d);
+        extents[6*r+d] = MAX(extents[6*r+d], -x);
+        extents[6*r+3+d] = MAX(extents[6*r+3+d], x);
       }
+      weight[r] += (weights != NULL) ? weights[i] : 1.0;
+    }
+    MPI_Allreduce(MPI_IN_PLACE, extents, 6*num_ranges, MPI_REAL_T, MPI_MAX, comm);
+    MPI_Allreduce(MPI_IN_PLACE, weight, num_ranges, MPI_REAL_T, MPI_SUM, comm);
 
-      // Set exchanger entries.
-      if (pi != pj)
+    // Bisect each range along its longest axis.
+    for (int r = 0; r < num_ranges; ++r)
+    {
+      rcb_range_t* range = &ranges[r];
+      int n = range->hi - range->lo;
+      range->axis = 0;
+      real_t max_length = -REAL_MAX;
+      for (int d = 0; d < 3; ++d)
       {
-        // Processes i and j must each have send/receive entries for this guy.
-
-        // pi sends i to pj.
-        if (sends[pi] == NULL)
-          sends[pi] = int_ptr_unordered_map_new();
-        int_array_t** send_indices_p = (int_array_t**)int_ptr_unordered_map_get(sends[pi], pj);
-        if (send_indices_p == NULL)
+        real_t length = extents[6*r+3+d] + extents[6*r+d];
+        if (length > max_length)
         {
-          int_array_t* send_indices = int_array_new();
-          int_ptr_unordered_map_insert_with_v_dtor(sends[pi], pj, send_indices, DTOR(int_array_free));
-          send_indices_p = &send_indices;
+          max_length = length;
+          range->axis = d;
         }
-        int_array_append(*send_indices_p, i);
+      }
+      range->cut_lo = -extents[6*r+range->axis];
+      range->cut_hi = extents[6*r+3+range->axis];
+      range->target = weight[r] * (n/2) / n;
+      range->done = (weight[r] == 0.0);
+      range->cut = 0.5 * (range->cut_lo + range->cut_hi);
+    }
+    for (int step = 0; step < RCB_MAX_STEPS; ++step)
+    {
+      real_t weight_below[num_ranges];
+      memset(weight_below, 0, sizeof(real_t) * num_ranges);
+      for (int i = 0; i < num_points; ++i)
+      {
+        int r = range_of_part[parts[i]];
+        if ((r == -1) || ranges[r].done) continue;
+        if (point_coord(&points[i], ranges[r].axis) < ranges[r].cut)
+          weight_below[r] += (weights != NULL) ? weights[i] : 1.0;
+      }
+      MPI_Allreduce(MPI_IN_PLACE, weight_below, num_ranges, MPI_REAL_T, MPI_SUM, comm);
 
-        // pj sends j to pi.
-        if (sends[pj] == NULL)
-          sends[pj] = int_ptr_unordered_map_new();
-        send_indices_p = (int_array_t**)int_ptr_unordered_map_get(sends[pj], pi);
-        if (send_indices_p == NULL)
+      bool all_done = true;
+      for (int r = 0; r < num_ranges; ++r)
+      {
+        rcb_range_t* range = &ranges[r];
+        if (range->done) continue;
+        int n = range->hi - range->lo;
+        real_t tol = imbalance_tol * weight[r] / n;
+        if (fabs(weight_below[r] - range->target) <= tol)
+          range->done = true;
+        else
         {
-          int_array_t* send_indices = int_array_new();
-          int_ptr_unordered_map_insert_with_v_dtor(sends[pj], pi, send_indices, DTOR(int_array_free));
-          send_indices_p = &send_indices;
+          if (weight_below[r] < range->target)
+            range->cut_lo = range->cut;
+          else
+            range->cut_hi = range->cut;
+          range->cut = 0.5 * (range->cut_lo + range->cut_hi);
+          all_done = false;
         }
-        int_array_append(*send_indices_p, j);
+      }
+      if (all_done)
+        break;
+    }
 
-        // pi gets j from pj.
-        if (receives[pi] == NULL)
-          receives[pi] = int_ptr_unordered_map_new();
-        int_array_t** recv_indices_p = (int_array_t**)int_ptr_unordered_map_get(receives[pi], pj);
-        if (recv_indices_p == NULL)
-        {
-          int_array_t* recv_indices = int_array_new();
-          int_ptr_unordered_map_insert_with_v_dtor(receives[pi], pj, recv_indices, DTOR(int_array_free));
-          recv_indices_p = &recv_indices;
-        }
-        int_array_append(*recv_indices_p, ghost_indices[pi]++);
+    // Assign the points to the halves of their ranges, and replace each 
+    // range with its halves.
+    for (int i = 0; i < num_points; ++i)
+    {
+      int r = range_of_part[parts[i]];
+      if (r == -1) continue;
+      rcb_range_t* range = &ranges[r];
+      if (point_coord(&points[i], range->axis) >= range->cut)
+        parts[i] = range->lo + (range->hi - range->lo)/2;
+    }
+    for (int r = 0; r < num_split; ++r)
+    {
+      int mid = ranges[r].lo + (ranges[r].hi - ranges[r].lo)/2;
+      ranges[num_ranges].lo = mid;
+      ranges[num_ranges].hi = ranges[r].hi;
+      ranges[r].hi = mid;
+      ++num_ranges;
+    }
+  }
 
-        // pj gets i from pi.
-        if (receives[pj] == NULL)
-          receives[pj] = int_ptr_unordered_map_new();
-        recv_indices_p = (int_array_t**)int_ptr_unordered_map_get(receives[pj], pi);
-        if (recv_indices_p == NULL)
-        {
-          int_array_t* recv_indices = int_array_new();
-          int_ptr_unordered_map_insert_with_v_dtor(receives[pj], pi, recv_indices, DTOR(int_array_free));
-          recv_indices_p = &recv_indices;
-        }
-        int_array_append(*recv_indices_p, ghost_indices[pj]++);
-      }
+  polymec_free(range_of_part);
+  STOP_FUNCTION_TIMER();
+  return parts;
+}
+
+// Migrates the given num_owned points (and their values for the fields in 
+// the given set, if any) to the processes given by parts, packing everything 
+// bound for a process into one message. On each process, the points that 
+// stay come first (in their previous order), followed by those that arrive,
+// in order of the processes they come from. The number of points on this 
+// process is stored in num_new_points, and the points are stored in a 
+// newly-allocated array in new_points. The fields are replaced in place. 
+// The new distribution of points is stored in new_dist, and the new global 
+// index of each of the given points in new_ids. Returns the number of points
+// that left this process.
+static int migrate_points(MPI_Comm comm, 
+                          int num_owned, 
+                          point_t* points, 
+                          int* parts,
+                          point_field_set_t* fields,
+                          int* num_new_points, 
+                          point_t** new_points, 
+                          int64_t* new_dist, 
+                          int64_t* new_ids)
+{
+  START_FUNCTION_TIMER();
+  int nprocs, rank;
+  MPI_Comm_size(comm, &nprocs);
+  MPI_Comm_rank(comm, &rank);
+
+  // Figure out where the points go, and tell each process where its points 
+  // start on each of the others.
+  int send_counts[nprocs], recv_counts[nprocs];
+  memset(send_counts, 0, sizeof(int) * nprocs);
+  for (int i = 0; i < num_owned; ++i)
+    ++send_counts[parts[i]];
+  MPI_Alltoall(send_counts, 1, MPI_INT, recv_counts, 1, MPI_INT, comm);
+  int first_from[nprocs], first_to[nprocs];
+  int num_new_owned = recv_counts[rank];
+  first_from[rank] = 0;
+  for (int p = 0; p < nprocs; ++p)
+  {
+    if (p == rank) continue;
+    first_from[p] = num_new_owned;
+    num_new_owned += recv_counts[p];
+  }
+  MPI_Alltoall(first_from, 1, MPI_INT, first_to, 1, MPI_INT, comm);
+  int64_t num_new_owned64 = num_new_owned;
+  new_dist[0] = 0;
+  MPI_Allgather(&num_new_owned64, 1, MPI_INT64_T, &new_dist[1], 1, MPI_INT64_T, comm);
+  for (int p = 1; p <= nprocs; ++p)
+    new_dist[p] += new_dist[p-1];
+
+  // Compute the new global indices of our points.
+  int next[nprocs];
+  memcpy(next, first_to, sizeof(int) * nprocs);
+  for (int i = 0; i < num_owned; ++i)
+    new_ids[i] = new_dist[parts[i]] + next[parts[i]]++;
+
+  // Pack the points that leave, and their fields, into one message for 
+  // each process. The field values of the points that stay are set aside,
+  // since the fields are resized before they are unpacked.
+  size_t field_size = (fields != NULL) ? point_field_set_record_size(fields) : 0;
+  size_t record_size = sizeof(point_t) + field_size;
+  int record_counts[nprocs];
+  size_t offsets[nprocs];
+  for (int p = 0; p < nprocs; ++p)
+    record_counts[p] = (p == rank) ? 0 : send_counts[p];
+  offsets[0] = 0;
+  for (int p = 1; p < nprocs; ++p)
+    offsets[p] = offsets[p-1] + record_size * record_counts[p-1];
+  int num_stay = send_counts[rank];
+  int num_moved = num_owned - num_stay;
+  char* send_buf = polymec_malloc(MAX(num_moved * record_size, 1));
+  char* stay_buf = polymec_malloc(MAX(num_stay * field_size, 1));
+  point_t* new_x = polymec_malloc(sizeof(point_t) * MAX(num_new_owned, 1));
+  for (int i = 0, k = 0; i < num_owned; ++i)
+  {
+    int p = parts[i];
+    if (p == rank) 
+    {
+      new_x[k] = points[i];
+      if (fields != NULL)
+        point_field_set_pack(fields, i, &stay_buf[field_size*k]);
+      ++k;
     }
+    else
+    {
+      char* record = &send_buf[offsets[p]];
+      memcpy(record, &points[i], sizeof(point_t));
+      if (fields != NULL)
+        point_field_set_pack(fields, i, record + sizeof(point_t));
+      offsets[p] += record_size;
+    }
+  }
+  MPI_Datatype record_type = record_type_new((int)record_size, MPI_BYTE);
+  int recv_record_counts[nprocs], num_records;
+  char* recv_buf = alltoallv(comm, send_buf, record_counts, record_type, 
+                             record_size, recv_record_counts, &num_records);
+  MPI_Type_free(&record_type);
+  polymec_free(send_buf);
 
-    // Now we create the pairings and ship them to the various processes.
-    serializer_t* ser = neighbor_pairing_serializer();
-    byte_array_t* bytes = byte_array_new();
-    for (int p = 0; p < nprocs; ++p)
+  // Unpack the points that stay and those that arrive.
+  if (fields != NULL)
+  {
+    point_field_set_resize(fields, num_new_owned);
+    for (int k = 0; k < num_stay; ++k)
+      point_field_set_unpack(fields, k, &stay_buf[field_size*k]);
+  }
+  polymec_free(stay_buf);
+  char* record = recv_buf;
+  for (int p = 0; p < nprocs; ++p)
+  {
+    if (p == rank) continue;
+    for (int k = first_from[p]; k < first_from[p] + recv_counts[p]; ++k)
     {
-      // Share the vertex distribution with process p.
-      MPI_Send(vtx_dist, nprocs+1, MPI_UINT64_T, p, p, comm);
+      memcpy(&new_x[k], record, sizeof(point_t));
+      if (fields != NULL)
+        point_field_set_unpack(fields, k, record + sizeof(point_t));
+      record += record_size;
+    }
+  }
+  polymec_free(recv_buf);
 
-      // Set up the exchanger for process p's pairing.
-      exchanger_t* ex = exchanger_new_with_rank(comm, p);
-      if (sends[p] != NULL)
-      {
-        exchanger_set_sends(ex, sends[p]);
-        int_ptr_unordered_map_free(sends[p]);
-      }
-      if (receives[p] != NULL)
-      {
-        exchanger_set_receives(ex, receives[p]);
-        int_ptr_unordered_map_free(receives[p]);
-      }
+  *num_new_points = num_new_owned;
+  *new_points = new_x;
+  STOP_FUNCTION_TIMER();
+  return num_moved;
+}
+
+static int string_cmp(const void* l, const void* r)
+{
+  const char* const* ls = l;
+  const char* const* rs = r;
+  return strcmp(*ls, *rs);
+}
+
+// Returns a newly-allocated, sorted array of the names of the tags that 
+// appear in the given tagger on any process on the given communicator, 
+// storing their number in num_tags. The names are stored (separated by 
+// null characters) in a newly-allocated buffer, stored in name_buf.
+static char** gather_tag_names(MPI_Comm comm, tagger_t* tags, 
+                               int* num_tags, char** name_buf)
+{
+  int nprocs;
+  MPI_Comm_size(comm, &nprocs);
+
+  // Concatenate our tag names.
+  int pos = 0, length = 0;
+  char* tag_name;
+  int* tag;
+  size_t tag_size;
+  while (tagger_next_tag(tags, &pos, &tag_name, &tag, &tag_size))
+    length += (int)strlen(tag_name) + 1;
+  char* names = polymec_malloc(sizeof(char) * MAX(length, 1));
+  pos = 0, length = 0;
+  while (tagger_next_tag(tags, &pos, &tag_name, &tag, &tag_size))
+  {
+    strcpy(&names[length], tag_name);
+    length += (int)strlen(tag_name) + 1;
+  }
 
-      // NOTE: The neighbor pairings consume the array data we've generated, 
-      // NOTE: so we call *_array_release_data_and_free() below to give it to 
-      // NOTE: them. 
-      neighbor_pairing_t* p_pairing = neighbor_pairing_new(global_pairing->name, num_pairs[p],
-                                                           pairs[p]->data, weights[p]->data, ex);
-      int_array_release_data_and_free(pairs[p]);
-      real_array_release_data_and_free(weights[p]);
+  // Gather everyone's names.
+  int lengths[nprocs], displs[nprocs];
+  MPI_Allgather(&length, 1, MPI_INT, lengths, 1, MPI_INT, comm);
+  displs[0] = 0;
+  for (int p = 1; p < nprocs; ++p)
+    displs[p] = displs[p-1] + lengths[p-1];
+  int total_length = displs[nprocs-1] + lengths[nprocs-1];
+  char* all_names = polymec_malloc(sizeof(char) * MAX(total_length, 1));
+  MPI_Allgatherv(names, length, MPI_CHAR, all_names, lengths, displs, 
+                 MPI_CHAR, comm);
+  polymec_free(names);
 
-      if (p == 0)
+  // Sort them and weed out duplicates.
+  int n = 0;
+  for (int k = 0; k < total_length; ++k)
+  {
+    if (all_names[k] == '\0')
+      ++n;
+  }
+  char** tag_names = polymec_malloc(sizeof(char*) * MAX(n, 1));
+  for (int k = 0, t = 0; t < n; ++t)
+  {
+    tag_names[t] = &all_names[k];
+    k += (int)strlen(&all_names[k]) + 1;
+  }
+  qsort(tag_names, n, sizeof(char*), string_cmp);
+  int num_unique = 0;
+  for (int t = 0; t < n; ++t)
+  {
+    if ((num_unique == 0) || (strcmp(tag_names[t], tag_names[num_unique-1]) != 0))
+      tag_names[num_unique++] = tag_names[t];
+  }
+
+  *num_tags = num_unique;
+  *name_buf = all_names;
+  return tag_names;
+}
+
+// The tags to which the points of a cloud belong, recorded in a field of 
+// bits (one for each tag on any process) so that they travel with the 
+// points when they migrate.
+typedef struct
+{
+  int num_tags, stride;
+  char** names;
+  char* name_buf;
+  int* bits;
+} tag_bits_t;
+
+// Records the tags of the locally-owned points in the given cloud, and 
+// adds the resulting field to the given set. Ghost points are dropped from 
+// the tags.
+static void tag_bits_init(tag_bits_t* tb, point_cloud_t* cloud, 
+                          point_field_set_t* fields)
+{
+  int num_owned = cloud->num_points;
+  tb->names = gather_tag_names(cloud->comm, cloud->tags, &tb->num_tags, 
+                               &tb->name_buf);
+  tb->stride = (tb->num_tags + 31) / 32;
+  tb->bits = NULL;
+  if (tb->num_tags == 0) return;
+
+  tb->bits = polymec_malloc(sizeof(int) * tb->stride * MAX(num_owned, 1));
+  memset(tb->bits, 0, sizeof(int) * tb->stride * num_owned);
+  for (int t = 0; t < tb->num_tags; ++t)
+  {
+    size_t tag_size;
+    int* tag = tagger_tag(cloud->tags, tb->names[t], &tag_size);
+    if (tag == NULL) continue;
+    for (size_t k = 0; k < tag_size; ++k)
+    {
+      if (tag[k] < num_owned)
+        tb->bits[tb->stride*tag[k] + t/32] |= (int)(1u << (t % 32));
+    }
+  }
+  point_field_set_add_ints(fields, &tb->bits, tb->stride);
+}
+
+// Rebuilds the tags of the given cloud from the bits of its (migrated) 
+// locally-owned points, and frees the bits.
+static void tag_bits_finish(tag_bits_t* tb, point_cloud_t* cloud)
+{
+  for (int t = 0; t < tb->num_tags; ++t)
+  {
+    int bit = (int)(1u << (t % 32));
+    size_t tag_size = 0;
+    for (int i = 0; i < cloud->num_points; ++i)
+    {
+      if (tb->bits[tb->stride*i + t/32] & bit)
+        ++tag_size;
+    }
+    tagger_delete_tag(cloud->tags, tb->names[t]);
+    int* tag = tagger_create_tag(cloud->tags, tb->names[t], tag_size);
+    for (int i = 0, k = 0; i < cloud->num_points; ++i)
+    {
+      if (tb->bits[tb->stride*i + t/32] & bit)
+        tag[k++] = i;
+    }
+  }
+  if (tb->bits != NULL)
+    polymec_free(tb->bits);
+  polymec_free(tb->names);
+  polymec_free(tb->name_buf);
+}
+
+// Replaces the points of the given cloud with the given (newly-allocated) 
+// locally-owned points, which it consumes, and fills in its num_ghosts 
+// ghost points using the given exchanger. The cloud keeps its tags and 
+// properties.
+static void replace_points(point_cloud_t* cloud, int num_points, 
+                           point_t* points, int num_ghosts, exchanger_t* ex)
+{
+  polymec_free(cloud->points);
+  cloud->points = points;
+  cloud->num_points = num_points;
+  cloud->num_ghosts = 0;
+  point_cloud_set_num_ghosts(cloud, num_ghosts);
+  exchanger_exchange(ex, cloud->points, 3, 0, MPI_REAL_T);
+}
+
+static int int_cmp(const void* l, const void* r)
+{
+  int a = *((const int*)l), b = *((const int*)r);
+  return (a < b) ? -1 : (a > b) ? 1 : 0;
+}
+
+static int int_pair_cmp(const void* l, const void* r)
+{
+  const int* a = l;
+  const int* b = r;
+  int c = int_cmp(&a[0], &b[0]);
+  return (c != 0) ? c : int_cmp(&a[1], &b[1]);
+}
+
+#ifndef NDEBUG
+// Returns true if each pair in the given distributed pairing involves a 
+// locally-owned point, and if each pair of points on different processes 
+// appears on both of them, given the owner of each (owned and ghost) point. 
+// Since a pair between two processes is seen on both exactly when each of 
+// them has as many such pairs as the other, only the numbers of pairs are 
+// compared.
+static bool pairing_is_two_sided(MPI_Comm comm,
+                                 neighbor_pairing_t* pairing, 
+                                 int num_owned,
+                                 int* owners)
+{
+  int nprocs;
+  MPI_Comm_size(comm, &nprocs);
+  int num_cross_pairs[nprocs], their_num_cross_pairs[nprocs];
+  memset(num_cross_pairs, 0, sizeof(int) * nprocs);
+  bool owned = true;
+  int pos = 0, i, j;
+  while (neighbor_pairing_next(pairing, &pos, &i, &j, NULL))
+  {
+    if ((i >= num_owned) && (j >= num_owned))
+      owned = false;
+    else if (i >= num_owned)
+      ++num_cross_pairs[owners[i]];
+    else if (j >= num_owned)
+      ++num_cross_pairs[owners[j]];
+  }
+  MPI_Alltoall(num_cross_pairs, 1, MPI_INT, their_num_cross_pairs, 1, MPI_INT, comm);
+  int agree = owned && 
+              (memcmp(num_cross_pairs, their_num_cross_pairs, sizeof(int) * nprocs) == 0);
+  MPI_Allreduce(MPI_IN_PLACE, &agree, 1, MPI_INT, MPI_LAND, comm);
+  return (agree != 0);
+}
+#endif
+
+// Computes the quality of a partition that assigns each of the locally-owned
+// points in the given cloud to the given part (process), without moving 
+// anything. The parts of the ghost points are obtained from the pairing's 
+// exchanger. Each pair between points on different processes must appear on
+// both of them, as it does in the pairings produced by the partitioners 
+// here: such a pair is counted only by the process with the lower rank, and
+// each process finds the ghosts of its own points from its own pairs.
+static void compute_partition_quality(point_cloud_t* cloud,
+                                      neighbor_pairing_t* pairing,
+                                      real_t* costs,
+                                      int* parts,
+                                      partition_quality_t* quality)
+{
+  START_FUNCTION_TIMER();
+  MPI_Comm comm = cloud->comm;
+  int nprocs, rank;
+  MPI_Comm_size(comm, &nprocs);
+  MPI_Comm_rank(comm, &rank);
+  int num_owned = cloud->num_points;
+  int N = num_owned + cloud->num_ghosts;
+
+  // Find the part and the current owner of each point.
+  int* info = polymec_malloc(sizeof(int) * 2 * MAX(N, 1));
+  for (int i = 0; i < num_owned; ++i)
+  {
+    info[2*i] = parts[i];
+    info[2*i+1] = rank;
+  }
+  exchanger_exchange(pairing->ex, info, 2, 0, MPI_INT);
+#ifndef NDEBUG
+  {
+    int* owners = polymec_malloc(sizeof(int) * MAX(N, 1));
+    for (int k = 0; k < N; ++k)
+      owners[k] = info[2*k+1];
+    ASSERT(pairing_is_two_sided(comm, pairing, num_owned, owners));
+    polymec_free(owners);
+  }
+#endif
+
+  // Tally the owned points, pairs, ghosts, sent values, and load for each 
+  // part.
+  enum { OWNED, PAIRS, GHOSTS, SENDS, LOAD, NUM_TALLIES };
+  real_t* tallies = polymec_malloc(sizeof(real_t) * NUM_TALLIES * nprocs);
+  memset(tallies, 0, sizeof(real_t) * NUM_TALLIES * nprocs);
+  for (int i = 0; i < num_owned; ++i)
+  {
+    tallies[NUM_TALLIES*parts[i]+OWNED] += 1.0;
+    tallies[NUM_TALLIES*parts[i]+LOAD] += (costs != NULL) ? costs[i] : 1.0;
+  }
+
+  // Count each pair once, and gather the partners of each owned point.
+  int64_t counts[2] = {0, 0}; // pairs, edge cut
+  int* offsets = polymec_malloc(sizeof(int) * (num_owned + 1));
+  memset(offsets, 0, sizeof(int) * (num_owned + 1));
+  int pos = 0, i, j;
+  while (neighbor_pairing_next(pairing, &pos, &i, &j, NULL))
+  {
+    if (i < num_owned) ++offsets[i+1];
+    if (j < num_owned) ++offsets[j+1];
+    bool counted = ((i < num_owned) && (j < num_owned)) || 
+                   ((i >= num_owned) && (j < num_owned) && (rank < info[2*i+1])) || 
+                   ((j >= num_owned) && (i < num_owned) && (rank < info[2*j+1]));
+    if (counted)
+    {
+      int pi = info[2*i], pj = info[2*j];
+      ++counts[0];
+      tallies[NUM_TALLIES*pi+PAIRS] += 1.0;
+      if (pj != pi)
       {
-        // This here's our local pairing.
-        local_pairing = p_pairing;
+        tallies[NUM_TALLIES*pj+PAIRS] += 1.0;
+        ++counts[1];
       }
-      else
+    }
+  }
+  for (int k = 0; k < num_owned; ++k)
+    offsets[k+1] += offsets[k];
+  int* partner_parts = polymec_malloc(sizeof(int) * MAX(offsets[num_owned], 1));
+  int* next = polymec_malloc(sizeof(int) * MAX(num_owned, 1));
+  memcpy(next, offsets, sizeof(int) * num_owned);
+  pos = 0;
+  while (neighbor_pairing_next(pairing, &pos, &i, &j, NULL))
+  {
+    if (i < num_owned) partner_parts[next[i]++] = info[2*j];
+    if (j < num_owned) partner_parts[next[j]++] = info[2*i];
+  }
+  polymec_free(next);
+
+  // Each owned point is a ghost on every other part containing one of its 
+  // partners. Each such relationship makes the two parts neighbors.
+  int num_edges = 0, edge_capacity = 16;
+  int* edges = polymec_malloc(sizeof(int) * 2 * edge_capacity);
+  for (int k = 0; k < num_owned; ++k)
+  {
+    int* pp = &partner_parts[offsets[k]];
+    int n = offsets[k+1] - offsets[k];
+    qsort(pp, n, sizeof(int), int_cmp);
+    for (int l = 0; l < n; ++l)
+    {
+      int q = pp[l];
+      if ((q == parts[k]) || ((l > 0) && (q == pp[l-1])))
+        continue;
+      tallies[NUM_TALLIES*q+GHOSTS] += 1.0;
+      tallies[NUM_TALLIES*parts[k]+SENDS] += 1.0;
+      if (num_edges + 2 > edge_capacity)
       {
-        // Send the pairing to process p.
-        size_t offset = 0;
-        serializer_write(ser, p_pairing, bytes, &offset);
-        MPI_Send(&bytes->size, 1, MPI_INT, p, p, comm);
-        MPI_Send(bytes->data, bytes->size, MPI_BYTE, p, p, comm);
-
-        // Clean up.
-        byte_array_clear(bytes);
-        neighbor_pairing_free(p_pairing);
+        edge_capacity *= 2;
+        edges = polymec_realloc(edges, sizeof(int) * 2 * edge_capacity);
       }
+      edges[2*num_edges] = parts[k];
+      edges[2*num_edges+1] = q;
+      edges[2*num_edges+2] = q;
+      edges[2*num_edges+3] = parts[k];
+      num_edges += 2;
     }
+  }
+  polymec_free(partner_parts);
+  polymec_free(offsets);
+  polymec_free(info);
 
-    ser = NULL;
-    byte_array_free(bytes);
+  // Sum the tallies for our part.
+  real_t my_tallies[NUM_TALLIES];
+  MPI_Reduce_scatter_block(tallies, my_tallies, NUM_TALLIES, MPI_REAL_T, MPI_SUM, comm);
+  polymec_free(tallies);
+
+  // Send each edge (p, q) to p, which counts its distinct neighbors q.
+  qsort(edges, num_edges, 2*sizeof(int), int_pair_cmp);
+  int num_unique = 0;
+  for (int e = 0; e < num_edges; ++e)
+  {
+    if ((num_unique == 0) || (int_pair_cmp(&edges[2*e], &edges[2*(num_unique-1)]) != 0))
+    {
+      edges[2*num_unique] = edges[2*e];
+      edges[2*num_unique+1] = edges[2*e+1];
+      ++num_unique;
+    }
   }
-  else
+  int send_counts[nprocs], recv_counts[nprocs], num_received;
+  memset(send_counts, 0, sizeof(int) * nprocs);
+  for (int e = 0; e < num_unique; ++e)
+    send_counts[edges[2*e]] += 2;
+  int* my_edges = alltoallv(comm, edges, send_counts, MPI_INT, sizeof(int), 
+                            recv_counts, &num_received);
+  polymec_free(edges);
+  qsort(my_edges, num_received/2, 2*sizeof(int), int_pair_cmp);
+  int num_neighbors = 0;
+  for (int e = 0; e < num_received/2; ++e)
   {
-    // Receive the vertex distribution of the incoming pairing.
-    MPI_Status status;
-    MPI_Recv(vtx_dist, nprocs+1, MPI_UINT64_T, 0, rank, comm, &status);
+    if ((e == 0) || (my_edges[2*e+1] != my_edges[2*(e-1)+1]))
+      ++num_neighbors;
+  }
+  polymec_free(my_edges);
 
-    // Receive the size of the incoming pairing.
-    int pairing_size;
-    MPI_Recv(&pairing_size, 1, MPI_INT, 0, rank, comm, &status);
+  // Compute statistics over the parts.
+  enum { NUM_STATS = 8 };
+  real_t values[NUM_STATS] = 
+    {my_tallies[OWNED], my_tallies[GHOSTS], 
+     (my_tallies[OWNED] > 0.0) ? my_tallies[GHOSTS] / my_tallies[OWNED] : 0.0,
+     my_tallies[PAIRS], 1.0 * num_neighbors, 
+     my_tallies[SENDS] * sizeof(real_t), my_tallies[GHOSTS] * sizeof(real_t),
+     my_tallies[LOAD]};
+  real_t mins[NUM_STATS], maxs[NUM_STATS], sums[NUM_STATS];
+  MPI_Allreduce(values, mins, NUM_STATS, MPI_REAL_T, MPI_MIN, comm);
+  MPI_Allreduce(values, maxs, NUM_STATS, MPI_REAL_T, MPI_MAX, comm);
+  MPI_Allreduce(values, sums, NUM_STATS, MPI_REAL_T, MPI_SUM, comm);
+  MPI_Allreduce(MPI_IN_PLACE, counts, 2, MPI_INT64_T, MPI_SUM, comm);
+  partition_stat_t* stats[NUM_STATS] = 
+    {&quality->owned_points, &quality->ghost_points, &quality->ghost_ratio, 
+     &quality->pairs, &quality->neighbor_processes, &quality->send_bytes, 
+     &quality->receive_bytes, &quality->load};
+  for (int k = 0; k < NUM_STATS; ++k)
+  {
+    stats[k]->min = mins[k];
+    stats[k]->max = maxs[k];
+    stats[k]->avg = sums[k] / nprocs;
+  }
+  quality->num_processes = nprocs;
+  quality->num_points = (int64_t)sums[0];
+  quality->num_pairs = counts[0];
+  quality->edge_cut = counts[1];
+  quality->imbalance = (quality->load.avg > 0.0) ? quality->load.max / quality->load.avg - 1.0 : 0.0;
+  STOP_FUNCTION_TIMER();
+}
+
+// Logs the quality of the partition of the given cloud. Since computing it 
+// is a collective operation, it is skipped entirely unless the "detail" log
+// level is enabled (which it is on all processes, or none).
+static void log_partition_quality(point_cloud_t* cloud, 
+                                  neighbor_pairing_t* pairing)
+{
+  if (log_level() < LOG_DETAIL)
+    return;
+
+  partition_quality_t quality;
+  int* parts = polymec_malloc(sizeof(int) * MAX(cloud->num_points, 1));
+  int rank;
+  MPI_Comm_rank(cloud->comm, &rank);
+  for (int i = 0; i < cloud->num_points; ++i)
+    parts[i] = rank;
+  compute_partition_quality(cloud, pairing, NULL, parts, &quality);
+  polymec_free(parts);
+  log_detail("Partition: %d processes, %d points, %d pairs, edge cut %d.", 
+             quality.num_processes, (int)quality.num_points, 
+             (int)quality.num_pairs, (int)quality.edge_cut);
+  log_detail("Partition: owned points per process: %g min, %g max, %g avg.", 
+             quality.owned_points.min, quality.owned_points.max, 
+             quality.owned_points.avg);
+  log_detail("Partition: ghosts per owned point: %g min, %g max, %g avg.", 
+             quality.ghost_ratio.min, quality.ghost_ratio.max, 
+             quality.ghost_ratio.avg);
+  log_detail("Partition: neighbor processes: %g min, %g max, %g avg.", 
+             quality.neighbor_processes.min, quality.neighbor_processes.max, 
+             quality.neighbor_processes.avg);
+}
+
+// Distributes the values of the given fields on rank 0 according to the 
+// given global partition vector, sending each process one message. On each 
+// process, the fields are resized to hold values for the num_points 
+// locally-owned points (in order of their global indices) and the 
+// num_ghosts ghost points, whose values are filled in with the given 
+// exchanger.
+static void distribute_fields(point_field_set_t* fields,
+                              MPI_Comm comm,
+                              int64_t* global_partition,
+                              int num_indices,
+                              int num_points,
+                              int num_ghosts,
+                              exchanger_t* ex)
+{
+  START_FUNCTION_TIMER();
+  int nprocs, rank;
+  MPI_Comm_size(comm, &nprocs);
+  MPI_Comm_rank(comm, &rank);
 
-    // Now receive the pairing.
-    byte_array_t* bytes = byte_array_new();
-    byte_array_resize(bytes, pairing_size);
-    MPI_Recv(bytes->data, pairing_size, MPI_BYTE, 0, rank, comm, &status);
-    serializer_t* ser = neighbor_pairing_serializer();
-    size_t offset = 0;
-    local_pairing = serializer_read(ser, bytes, &offset);
-    
-    byte_array_free(bytes);
-    ser = NULL;
+  // Pack the records for each process, in order.
+  size_t size = point_field_set_record_size(fields);
+  int counts[nprocs], displs[nprocs];
+  char* records = NULL;
+  if (rank == 0)
+  {
+    memset(counts, 0, sizeof(int) * nprocs);
+    for (int i = 0; i < num_indices; ++i)
+      counts[global_partition[i]]++;
+    displs[0] = 0;
+    for (int p = 1; p < nprocs; ++p)
+      displs[p] = displs[p-1] + counts[p-1];
+    int offsets[nprocs];
+    memcpy(offsets, displs, sizeof(int) * nprocs);
+    records = polymec_malloc(MAX(size * num_indices, 1));
+    for (int i = 0; i < num_indices; ++i)
+    {
+      int p = (int)global_partition[i];
+      point_field_set_pack(fields, i, &records[size * offsets[p]]);
+      ++offsets[p];
+    }
   }
 
-  *neighbors = local_pairing;
+  // Hand them out (counting them in records) and unpack them.
+  MPI_Datatype record_type = record_type_new((int)size, MPI_BYTE);
+  char* my_records = polymec_malloc(MAX(size * num_points, 1));
+  MPI_Scatterv(records, counts, displs, record_type, 
+               my_records, num_points, record_type, 0, comm);
+  MPI_Type_free(&record_type);
+  if (records != NULL)
+    polymec_free(records);
+  point_field_set_resize(fields, num_points + num_ghosts);
+  for (int i = 0; i < num_points; ++i)
+    point_field_set_unpack(fields, i, &my_records[size*i]);
+  polymec_free(my_records);
+  point_field_set_exchange(fields, ex, num_points, num_ghosts);
+  STOP_FUNCTION_TIMER();
+}
 
-  // Clean up.
-  if (global_pairing != NULL)
-    neighbor_pairing_free(global_pairing);
+// Distributes the point cloud, the neighbor pairing, and the given fields 
+// (if any) on rank 0 according to the given global partition vector, 
+// returning an exchanger that distributes field data in the same way.
+static exchanger_t* distribute_with_partition(point_cloud_t** points,
+                                              neighbor_pairing_t** neighbors,
+                                              point_field_set_t* fields,
+                                              MPI_Comm comm,
+                                              int64_t* global_partition,
+                                              int num_indices)
+{
+  // Break the neighbor pairing into chunks and send them to the other processes.
+  int num_ghosts = neighbor_pairing_distribute(neighbors, comm, global_partition, 
+                                               num_indices);
+
+  // Distribute the point cloud, and fill in its ghost points.
+  distribute_point_cloud(points, comm, global_partition);
+  point_cloud_set_num_ghosts(*points, num_ghosts);
+  exchanger_exchange((*neighbors)->ex, (*points)->points, 3, 0, MPI_REAL_T);
+
+  // Distribute the fields, if any.
+  if (fields != NULL)
+  {
+    distribute_fields(fields, comm, global_partition, num_indices, 
+                      (*points)->num_points, num_ghosts, (*neighbors)->ex);
+  }
+
+  log_partition_quality(*points, *neighbors);
+
+  // Set up an exchanger to distribute field data.
+  return create_distributor(comm, global_partition, num_indices);
 }
 
+#endif
+
 exchanger_t* partition_point_cloud_with_neighbors(point_cloud_t** points, 
                                                   neighbor_pairing_t** neighbors, 
                                                   MPI_Comm comm, 
                                                   int* weights, 
-                                                  real_t imbalance_tol)
+                                                  real_t imbalance_tol,
+                                                  point_field_set_t* fields)
 {
   ASSERT(imbalance_tol > 0.0);
   ASSERT(imbalance_tol <= 1.0);
@@ -267,16 +1252,11 @@ exchanger_t* partition_point_cloud_with_neighbors(point_cloud_t** points,
   // Map the graph to the different domains, producing a local partition vector.
   int64_t* global_partition = (rank == 0) ? partition_graph(global_graph, comm, weights, imbalance_tol): NULL;
 
-  // Break the neighbor pairing into chunks and send them to the other processes.
-  neighbor_pairing_distribute(neighbors, comm, global_partition, 
-                              (*points != NULL) ? (*points)->num_points : 0);
-
-  // Distribute the point cloud.
-  distribute_point_cloud(points, comm, global_partition);
-
-  // Set up an exchanger to distribute field data.
+  // Distribute the points and their neighbors.
   int num_vertices = (cloud != NULL) ? adj_graph_num_vertices(global_graph) : 0;
-  exchanger_t* distributor = create_distributor(comm, global_partition, num_vertices);
+  exchanger_t* distributor = distribute_with_partition(points, neighbors, fields, comm, 
+                                                       global_partition, 
+                                                       num_vertices);
 
   // Clean up.
   if (global_graph != NULL)
@@ -291,3 +1271,608 @@ exchanger_t* partition_point_cloud_with_neighbors(point_cloud_t** points,
 #endif
 }
 
+exchanger_t* partition_point_cloud_with_neighbors_geometrically(point_cloud_t** points, 
+                                                                neighbor_pairing_t** neighbors, 
+                                                                MPI_Comm comm, 
+                                                                int* weights, 
+                                                                real_t imbalance_tol,
+                                                                point_field_set_t* fields)
+{
+  ASSERT(imbalance_tol > 0.0);
+  ASSERT(imbalance_tol <= 1.0);
+
+#if POLYMEC_HAVE_MPI
+  ASSERT((*points == NULL) || ((*points)->comm == MPI_COMM_SELF));
+
+  int nprocs, rank;
+  MPI_Comm_size(comm, &nprocs);
+  MPI_Comm_rank(comm, &rank);
+
+  // On a single process, partitioning has no meaning.
+  if (nprocs == 1)
+    return exchanger_new(comm);
+
+  // If points on rank != 0 are not NULL, we delete them.
+  point_cloud_t* cloud = *points;
+  if ((rank != 0) && (cloud != NULL))
+  {
+    point_cloud_free(cloud);
+    *points = cloud = NULL; 
+  }
+
+  // Share the number of points, and whether they are weighted.
+  int64_t sizes[2] = {0, 0};
+  if (rank == 0)
+  {
+    ASSERT(cloud->num_points > nprocs);
+    sizes[0] = cloud->num_points;
+    sizes[1] = (weights != NULL);
+  }
+  MPI_Bcast(sizes, 2, MPI_INT64_T, 0, comm);
+  int num_indices = (int)sizes[0];
+
+  // Hand out the points (and their weights) in contiguous chunks.
+  int64_t dist[nprocs+1];
+  get_chunks(num_indices, nprocs, dist);
+  int counts[nprocs], displs[nprocs];
+  for (int p = 0; p < nprocs; ++p)
+  {
+    counts[p] = (int)(dist[p+1] - dist[p]);
+    displs[p] = (int)dist[p];
+  }
+  int num_points = counts[rank];
+  real_t* my_weights = NULL;
+  if (sizes[1] != 0)
+  {
+    int* int_weights = polymec_malloc(sizeof(int) * MAX(num_points, 1));
+    MPI_Scatterv(weights, counts, displs, MPI_INT, 
+                 int_weights, num_points, MPI_INT, 0, comm);
+    my_weights = polymec_malloc(sizeof(real_t) * MAX(num_points, 1));
+    for (int i = 0; i < num_points; ++i)
+      my_weights[i] = 1.0 * int_weights[i];
+    polymec_free(int_weights);
+  }
+  MPI_Datatype point_type = record_type_new(3, MPI_REAL_T);
+  point_t* my_points = polymec_malloc(sizeof(point_t) * MAX(num_points, 1));
+  MPI_Scatterv((cloud != NULL) ? cloud->points : NULL, counts, displs, 
+               point_type, my_points, num_points, point_type, 0, comm);
+  MPI_Type_free(&point_type);
+
+  // Bisect the points, and gather the resulting partition vector on rank 0.
+  int* parts = rcb_partition(comm, num_points, my_points, my_weights, 
+                             imbalance_tol);
+  polymec_free(my_points);
+  if (my_weights != NULL)
+    polymec_free(my_weights);
+  int64_t* my_partition = polymec_malloc(sizeof(int64_t) * MAX(num_points, 1));
+  for (int i = 0; i < num_points; ++i)
+    my_partition[i] = parts[i];
+  polymec_free(parts);
+  int64_t* global_partition = (rank == 0) ? polymec_malloc(sizeof(int64_t) * num_indices) : NULL;
+  MPI_Gatherv(my_partition, num_points, MPI_INT64_T, 
+              global_partition, counts, displs, MPI_INT64_T, 0, comm);
+  polymec_free(my_partition);
+
+  // Distribute the points and their neighbors.
+  exchanger_t* distributor = distribute_with_partition(points, neighbors, fields, comm, 
+                                                       global_partition, 
+                                                       (rank == 0) ? num_indices : 0);
+
+  // Clean up.
+  if (global_partition != NULL)
+    polymec_free(global_partition);
+
+  return distributor;
+#else
+  return exchanger_new(comm);
+#endif
+}
+
+exchanger_t* repartition_point_cloud_with_neighbors(point_cloud_t** points,
+                                                    neighbor_pairing_t** neighbors,
+                                                    real_t* costs,
+                                                    real_t imbalance_tol,
+                                                    point_field_set_t* fields)
+{
+  ASSERT(imbalance_tol > 0.0);
+  ASSERT(imbalance_tol <= 1.0);
+
+#if POLYMEC_HAVE_MPI
+  START_FUNCTION_TIMER();
+  point_cloud_t* cloud = *points;
+  neighbor_pairing_t* pairing = *neighbors;
+  MPI_Comm comm = cloud->comm;
+  int nprocs, rank;
+  MPI_Comm_size(comm, &nprocs);
+  MPI_Comm_rank(comm, &rank);
+
+  // On a single process, there's nothing to do.
+  if (nprocs == 1)
+  {
+    STOP_FUNCTION_TIMER();
+    return pairing->ex;
+  }
+
+  int num_owned = cloud->num_points;
+  int N = num_owned + cloud->num_ghosts;
+
+  // Find the current distribution of points.
+  int64_t old_dist[nprocs+1], num_owned64 = num_owned;
+  old_dist[0] = 0;
+  MPI_Allgather(&num_owned64, 1, MPI_INT64_T, &old_dist[1], 1, MPI_INT64_T, comm);
+  for (int p = 1; p <= nprocs; ++p)
+    old_dist[p] += old_dist[p-1];
+
+  // Compute the new partition.
+  int* parts = rcb_partition(comm, num_owned, cloud->points, costs, imbalance_tol);
+
+  // Gather the points' fields and tags so that they move together.
+  point_field_set_t* migrating = point_field_set_new();
+  if (fields != NULL)
+    point_field_set_add_set(migrating, fields);
+  tag_bits_t tag_bits;
+  tag_bits_init(&tag_bits, cloud, migrating);
+
+  // Migrate the points, their fields, and their tags.
+  int64_t new_dist[nprocs+1];
+  int64_t* new_ids = polymec_malloc(sizeof(int64_t) * MAX(num_owned, 1));
+  int num_new_owned;
+  point_t* new_x;
+  int num_moved = migrate_points(comm, num_owned, cloud->points, parts, 
+                                 migrating, &num_new_owned, &new_x, new_dist, 
+                                 new_ids);
+  point_field_set_free(migrating);
+  polymec_free(parts);
+
+  // Share the old and new global indices of our points with the processes
+  // that have them as ghosts.
+  int64_t* ids = polymec_malloc(sizeof(int64_t) * 2 * MAX(N, 1));
+  for (int i = 0; i < num_owned; ++i)
+  {
+    ids[2*i] = old_dist[rank] + i;
+    ids[2*i+1] = new_ids[i];
+  }
+  polymec_free(new_ids);
+  exchanger_exchange(pairing->ex, ids, 2, 0, MPI_INT64_T);
+
+  // Route each pair to its new owners. Each pair is contributed by the 
+  // process that owned the point with the smaller old global index.
+  int has_weights = (pairing->weights != NULL);
+  MPI_Allreduce(MPI_IN_PLACE, &has_weights, 1, MPI_INT, MPI_MAX, comm);
+  int64_t* global_pairs = polymec_malloc(sizeof(int64_t) * 2 * MAX(pairing->num_pairs, 1));
+  real_t* weights = (has_weights) ? polymec_malloc(sizeof(real_t) * MAX(pairing->num_pairs, 1)) : NULL;
+  int num_pairs = 0, pos = 0, i, j;
+  real_t w;
+  while (neighbor_pairing_next(pairing, &pos, &i, &j, &w))
+  {
+    int64_t first = MIN(ids[2*i], ids[2*j]);
+    if ((first < old_dist[rank]) || (first >= old_dist[rank+1]))
+      continue;
+    global_pairs[2*num_pairs]   = ids[2*i+1];
+    global_pairs[2*num_pairs+1] = ids[2*j+1];
+    if (has_weights)
+      weights[num_pairs] = w;
+    ++num_pairs;
+  }
+  polymec_free(ids);
+  int num_ghosts;
+  neighbor_pairing_t* new_pairing = 
+    neighbor_pairing_from_global_pairs(comm, pairing->name, new_dist, 
+                                       num_pairs, global_pairs, 
+                                       (has_weights != 0), weights, &num_ghosts);
+  neighbor_pairing_free(pairing);
+  *neighbors = new_pairing;
+
+  // Replace the points in the cloud, keeping its properties, fill in the 
+  // ghost points, and rebuild its tags.
+  replace_points(cloud, num_new_owned, new_x, num_ghosts, new_pairing->ex);
+  tag_bits_finish(&tag_bits, cloud);
+
+  // Fill in the ghost values of the fields.
+  if (fields != NULL)
+  {
+    point_field_set_resize(fields, num_new_owned + num_ghosts);
+    point_field_set_exchange(fields, new_pairing->ex, num_new_owned, num_ghosts);
+  }
+
+  int total_moved = num_moved;
+  MPI_Allreduce(MPI_IN_PLACE, &total_moved, 1, MPI_INT, MPI_SUM, comm);
+  log_debug("repartition_point_cloud_with_neighbors: moved %d of %d points.", 
+            total_moved, (int)old_dist[nprocs]);
+  log_partition_quality(cloud, new_pairing);
+  STOP_FUNCTION_TIMER();
+  return new_pairing->ex;
+#else
+  return (*neighbors)->ex;
+#endif
+}
+
+point_cloud_t* read_distributed_point_cloud(MPI_Comm comm, const char* filename)
+{
+  START_FUNCTION_TIMER();
+#if POLYMEC_HAVE_MPI
+  int nprocs, rank;
+  MPI_Comm_size(comm, &nprocs);
+  MPI_Comm_rank(comm, &rank);
+
+  MPI_File file;
+  int err = MPI_File_open(comm, (char*)filename, MPI_MODE_RDONLY, 
+                          MPI_INFO_NULL, &file);
+  if (err != MPI_SUCCESS)
+    polymec_error("read_distributed_point_cloud: Could not open %s.", filename);
+
+  // Read the number of points, and then our chunk of them.
+  int64_t N;
+  MPI_Status status;
+  MPI_File_read_at_all(file, 0, &N, 1, MPI_INT64_T, &status);
+  int64_t dist[nprocs+1];
+  get_chunks(N, nprocs, dist);
+  int num_points = (int)(dist[rank+1] - dist[rank]);
+  double* coords = polymec_malloc(sizeof(double) * 3 * MAX(num_points, 1));
+  MPI_Offset offset = (MPI_Offset)(sizeof(int64_t) + 3 * sizeof(double) * dist[rank]);
+  MPI_File_read_at_all(file, offset, coords, 3*num_points, MPI_DOUBLE, &status);
+  MPI_File_close(&file);
+#else
+  FILE* file = fopen(filename, "rb");
+  if (file == NULL)
+    polymec_error("read_distributed_point_cloud: Could not open %s.", filename);
+  int64_t N;
+  if (fread(&N, sizeof(int64_t), 1, file) != 1)
+    polymec_error("read_distributed_point_cloud: Could not read %s.", filename);
+  int num_points = (int)N;
+  double* coords = polymec_malloc(sizeof(double) * 3 * MAX(num_points, 1));
+  if (fread(coords, sizeof(double), 3*num_points, file) != (size_t)(3*num_points))
+    polymec_error("read_distributed_point_cloud: Could not read %s.", filename);
+  fclose(file);
+#endif
+
+  point_cloud_t* cloud = point_cloud_new(comm, num_points);
+  for (int i = 0; i < num_points; ++i)
+  {
+    cloud->points[i].x = (real_t)coords[3*i];
+    cloud->points[i].y = (real_t)coords[3*i+1];
+    cloud->points[i].z = (real_t)coords[3*i+2];
+  }
+  polymec_free(coords);
+  STOP_FUNCTION_TIMER();
+  return cloud;
+}
+
+#if POLYMEC_HAVE_MPI
+
+// A ghost candidate is a point that is sent to another process because it 
+// may be paired with one of that process's points.
+typedef struct
+{
+  point_t x;
+  real_t R;
+  int64_t index;
+} ghost_candidate_t;
+
+// Returns the square of the distance between a point and the bounding box 
+// with the given bounds (x1, x2, y1, y2, z1, z2).
+static real_t square_distance_to_box(point_t* x, real_t* box)
+{
+  real_t dx = MAX(0.0, MAX(box[0] - x->x, x->x - box[1]));
+  real_t dy = MAX(0.0, MAX(box[2] - x->y, x->y - box[3]));
+  real_t dz = MAX(0.0, MAX(box[4] - x->z, x->z - box[5]));
+  return dx*dx + dy*dy + dz*dz;
+}
+
+// Returns true if the point x with support radius R may be paired with one 
+// of the points on process p, given the bounding boxes (and largest radii) 
+// of the points on all processes.
+static bool may_be_paired(point_t* x, real_t R, int p, int rank, 
+                          int64_t* vtx_dist, real_t* boxes)
+{
+  if ((p == rank) || (vtx_dist[p+1] == vtx_dist[p]))
+    return false;
+  real_t* box = &boxes[7*p];
+  real_t r = MAX(R, box[6]);
+  return (square_distance_to_box(x, box) <= r*r);
+}
+
+// Given the points on each process (numbered globally according to 
+// vtx_dist) and their support radii R, this function exchanges ghost 
+// candidates among the processes and finds the pairs (i, j) of points with
+// |xi - xj| <= max(Ri, Rj), returning a neighbor pairing with the given 
+// name for the points on this process. The number of ghosts in the pairing
+// is stored in num_ghosts.
+static neighbor_pairing_t* find_distributed_pairs(MPI_Comm comm,
+                                                  const char* name,
+                                                  int64_t* vtx_dist,
+                                                  point_t* points,
+                                                  real_t* R,
+                                                  int* num_ghosts)
+{
+  START_FUNCTION_TIMER();
+  int nprocs, rank;
+  MPI_Comm_size(comm, &nprocs);
+  MPI_Comm_rank(comm, &rank);
+  int num_owned = (int)(vtx_dist[rank+1] - vtx_dist[rank]);
+
+  // Share the bounding box of our points and the largest of their radii.
+  real_t box[7] = {REAL_MAX, -REAL_MAX, REAL_MAX, -REAL_MAX, REAL_MAX, -REAL_MAX, 0.0};
+  for (int i = 0; i < num_owned; ++i)
+  {
+    box[0] = MIN(box[0], points[i].x);
+    box[1] = MAX(box[1], points[i].x);
+    box[2] = MIN(box[2], points[i].y);
+    box[3] = MAX(box[3], points[i].y);
+    box[4] = MIN(box[4], points[i].z);
+    box[5] = MAX(box[5], points[i].z);
+    box[6] = MAX(box[6], R[i]);
+  }
+  real_t* boxes = polymec_malloc(sizeof(real_t) * 7 * nprocs);
+  MPI_Allgather(box, 7, MPI_REAL_T, boxes, 7, MPI_REAL_T, comm);
+
+  // Send each of our points to every process whose points it may be paired
+  // with.
+  int send_counts[nprocs], offsets[nprocs];
+  memset(send_counts, 0, sizeof(int) * nprocs);
+  for (int i = 0; i < num_owned; ++i)
+    for (int p = 0; p < nprocs; ++p)
+      if (may_be_paired(&points[i], R[i], p, rank, vtx_dist, boxes))
+        ++send_counts[p];
+  offsets[0] = 0;
+  for (int p = 1; p < nprocs; ++p)
+    offsets[p] = offsets[p-1] + send_counts[p-1];
+  int num_sent = offsets[nprocs-1] + send_counts[nprocs-1];
+  ghost_candidate_t* send_buf = polymec_malloc(sizeof(ghost_candidate_t) * MAX(num_sent, 1));
+  for (int i = 0; i < num_owned; ++i)
+  {
+    for (int p = 0; p < nprocs; ++p)
+    {
+      if (may_be_paired(&points[i], R[i], p, rank, vtx_dist, boxes))
+      {
+        ghost_candidate_t* g = &send_buf[offsets[p]++];
+        g->x = points[i];
+        g->R = R[i];
+        g->index = vtx_dist[rank] + i;
+      }
+    }
+  }
+  polymec_free(boxes);
+  MPI_Datatype candidate_type = record_type_new((int)sizeof(ghost_candidate_t), MPI_BYTE);
+  int recv_counts[nprocs], num_candidates;
+  ghost_candidate_t* candidates = alltoallv(comm, send_buf, send_counts, 
+                                            candidate_type, 
+                                            sizeof(ghost_candidate_t), 
+                                            recv_counts, &num_candidates);
+  MPI_Type_free(&candidate_type);
+  polymec_free(send_buf);
+
+  // Gather the candidates with our own points.
+  int N = num_owned + num_candidates;
+  point_t* x = polymec_malloc(sizeof(point_t) * MAX(N, 1));
+  real_t* RR = polymec_malloc(sizeof(real_t) * MAX(N, 1));
+  int64_t* index = polymec_malloc(sizeof(int64_t) * MAX(N, 1));
+  for (int i = 0; i < num_owned; ++i)
+  {
+    x[i] = points[i];
+    RR[i] = R[i];
+    index[i] = vtx_dist[rank] + i;
+  }
+  for (int c = 0; c < num_candidates; ++c)
+  {
+    x[num_owned+c] = candidates[c].x;
+    RR[num_owned+c] = candidates[c].R;
+    index[num_owned+c] = candidates[c].index;
+  }
+  polymec_free(candidates);
+
+  // Each pair is found by a search about the point with the larger 
+  // support radius (or the smaller global index, if the radii are 
+  // equal), and is contributed by the process that owns the point with 
+  // the smaller global index.
+  kd_tree_t* tree = kd_tree_new(x, N);
+  int num_pairs = 0, capacity = MAX(N, 1);
+  int64_t* pairs = polymec_malloc(sizeof(int64_t) * 2 * capacity);
+  for (int i = 0; i < N; ++i)
+  {
+    int_array_t* neighbors = kd_tree_within_radius(tree, &x[i], RR[i]);
+    for (int n = 0; n < neighbors->size; ++n)
+    {
+      int j = neighbors->data[n];
+      if ((j == i) || (RR[j] > RR[i]) || ((RR[j] == RR[i]) && (index[j] < index[i])))
+        continue;
+      int64_t first = MIN(index[i], index[j]);
+      if ((first < vtx_dist[rank]) || (first >= vtx_dist[rank+1]))
+        continue;
+      if (num_pairs == capacity)
+      {
+        capacity *= 2;
+        pairs = polymec_realloc(pairs, sizeof(int64_t) * 2 * capacity);
+      }
+      pairs[2*num_pairs]   = first;
+      pairs[2*num_pairs+1] = MAX(index[i], index[j]);
+      ++num_pairs;
+    }
+    int_array_free(neighbors);
+  }
+  kd_tree_free(tree);
+  polymec_free(x);
+  polymec_free(RR);
+  polymec_free(index);
+
+  neighbor_pairing_t* pairing = 
+    neighbor_pairing_from_global_pairs(comm, name, vtx_dist, num_pairs, 
+                                       pairs, false, NULL, num_ghosts);
+  STOP_FUNCTION_TIMER();
+  return pairing;
+}
+
+#endif
+
+exchanger_t* partition_distributed_point_cloud_with_neighbors(point_cloud_t** points,
+                                                              real_t** R,
+                                                              neighbor_pairing_t** neighbors,
+                                                              real_t* costs,
+                                                              real_t imbalance_tol,
+                                                              point_field_set_t* fields)
+{
+  ASSERT(imbalance_tol > 0.0);
+  ASSERT(imbalance_tol <= 1.0);
+  ASSERT((*points)->num_ghosts == 0);
+
+#if POLYMEC_HAVE_MPI
+  START_FUNCTION_TIMER();
+  point_cloud_t* cloud = *points;
+  MPI_Comm comm = cloud->comm;
+  int num_owned = cloud->num_points;
+
+  // Partition the points, and migrate them with their radii, fields, and 
+  // tags.
+  int* parts = rcb_partition(comm, num_owned, cloud->points, costs, imbalance_tol);
+  point_field_set_t* all_fields = point_field_set_new();
+  point_field_set_add_reals(all_fields, R, 1);
+  if (fields != NULL)
+    point_field_set_add_set(all_fields, fields);
+  point_field_set_t* migrating = point_field_set_new();
+  point_field_set_add_set(migrating, all_fields);
+  tag_bits_t tag_bits;
+  tag_bits_init(&tag_bits, cloud, migrating);
+  int nprocs;
+  MPI_Comm_size(comm, &nprocs);
+  int64_t vtx_dist[nprocs+1];
+  int64_t* new_ids = polymec_malloc(sizeof(int64_t) * MAX(num_owned, 1));
+  int num_new_owned;
+  point_t* new_x;
+  migrate_points(comm, num_owned, cloud->points, parts, migrating, 
+                 &num_new_owned, &new_x, vtx_dist, new_ids);
+  point_field_set_free(migrating);
+  polymec_free(new_ids);
+  polymec_free(parts);
+
+  // Find the pairs of neighboring points.
+  int num_ghosts;
+  neighbor_pairing_t* pairing = find_distributed_pairs(comm, "neighbor pairs", 
+                                                       vtx_dist, new_x, *R, 
+                                                       &num_ghosts);
+  *neighbors = pairing;
+
+  // Replace the points in the cloud, keeping its properties, and rebuild 
+  // its tags. Then fill in the ghost points, radii, and field values.
+  replace_points(cloud, num_new_owned, new_x, num_ghosts, pairing->ex);
+  tag_bits_finish(&tag_bits, cloud);
+  point_field_set_resize(all_fields, num_new_owned + num_ghosts);
+  point_field_set_exchange(all_fields, pairing->ex, num_new_owned, num_ghosts);
+  point_field_set_free(all_fields);
+  log_partition_quality(cloud, pairing);
+
+  STOP_FUNCTION_TIMER();
+  return pairing->ex;
+#else
+  // The points stay where they are, and we find the pairs among them as in 
+  // find_distributed_pairs: each pair is found by a search about the point
+  // with the larger support radius (or the smaller index, if the radii are
+  // equal).
+  START_FUNCTION_TIMER();
+  point_cloud_t* cloud = *points;
+  real_t* radii = *R;
+  kd_tree_t* tree = kd_tree_new(cloud->points, cloud->num_points);
+  int_array_t* pairs = int_array_new();
+  for (int i = 0; i < cloud->num_points; ++i)
+  {
+    int_array_t* nbrs = kd_tree_within_radius(tree, &cloud->points[i], radii[i]);
+    for (int n = 0; n < nbrs->size; ++n)
+    {
+      int j = nbrs->data[n];
+      if ((j == i) || (radii[j] > radii[i]) || ((radii[j] == radii[i]) && (j < i)))
+        continue;
+      int_array_append(pairs, MIN(i, j));
+      int_array_append(pairs, MAX(i, j));
+    }
+    int_array_free(nbrs);
+  }
+  kd_tree_free(tree);
+  *neighbors = neighbor_pairing_new("neighbor pairs", (int)(pairs->size/2), 
+                                    pairs->data, NULL, 
+                                    exchanger_new(cloud->comm));
+  int_array_release_data_and_free(pairs);
+  STOP_FUNCTION_TIMER();
+  return NULL;
+#endif
+}
+
+void partition_quality_compute(point_cloud_t* points,
+                               neighbor_pairing_t* pairing,
+                               real_t* costs,
+                               int* parts,
+                               partition_quality_t* quality)
+{
+#if POLYMEC_HAVE_MPI
+  int* my_parts = parts;
+  if (parts == NULL)
+  {
+    int rank;
+    MPI_Comm_rank(points->comm, &rank);
+    my_parts = polymec_malloc(sizeof(int) * MAX(points->num_points, 1));
+    for (int i = 0; i < points->num_points; ++i)
+      my_parts[i] = rank;
+  }
+  compute_partition_quality(points, pairing, costs, my_parts, quality);
+  if (parts == NULL)
+    polymec_free(my_parts);
+#else
+  // Everything is on one process.
+  memset(quality, 0, sizeof(partition_quality_t));
+  quality->num_processes = 1;
+  quality->num_points = points->num_points;
+  quality->num_pairs = pairing->num_pairs;
+  real_t load = 0.0;
+  for (int i = 0; i < points->num_points; ++i)
+    load += (costs != NULL) ? costs[i] : 1.0;
+  partition_stat_t owned = {.min = 1.0 * points->num_points, 
+                            .max = 1.0 * points->num_points, 
+                            .avg = 1.0 * points->num_points};
+  partition_stat_t pairs = {.min = 1.0 * pairing->num_pairs, 
+                            .max = 1.0 * pairing->num_pairs, 
+                            .avg = 1.0 * pairing->num_pairs};
+  partition_stat_t loads = {.min = load, .max = load, .avg = load};
+  quality->owned_points = owned;
+  quality->pairs = pairs;
+  quality->load = loads;
+#endif
+}
+
+void repartition_point_cloud_with_neighbors_dry_run(point_cloud_t* points,
+                                                    neighbor_pairing_t* pairing,
+                                                    real_t* costs,
+                                                    real_t imbalance_tol,
+                                                    partition_quality_t* quality)
+{
+  ASSERT(imbalance_tol > 0.0);
+  ASSERT(imbalance_tol <= 1.0);
+#if POLYMEC_HAVE_MPI
+  int* parts = rcb_partition(points->comm, points->num_points, points->points, 
+                             costs, imbalance_tol);
+  compute_partition_quality(points, pairing, costs, parts, quality);
+  polymec_free(parts);
+#else
+  partition_quality_compute(points, pairing, costs, NULL, quality);
+#endif
+}
+
+void partition_quality_fprintf(partition_quality_t* quality, FILE* stream)
+{
+  fprintf(stream, "Partition quality (%d processes):\n", quality->num_processes);
+  fprintf(stream, "  Points: %lld\n", (long long)quality->num_points);
+  fprintf(stream, "  Pairs: %lld\n", (long long)quality->num_pairs);
+  fprintf(stream, "  Edge cut: %lld pairs (%g%%)\n", (long long)quality->edge_cut,
+          (quality->num_pairs > 0) ? 100.0 * quality->edge_cut / quality->num_pairs : 0.0);
+  fprintf(stream, "  Load imbalance: %g%%\n", 100.0 * quality->imbalance);
+  fprintf(stream, "  Per process:            min          max          avg\n");
+  const char* names[8] = {"Owned points", "Ghost points", "Ghosts/owned", 
+                          "Pairs", "Neighbor procs", "Bytes sent", 
+                          "Bytes received", "Load"};
+  partition_stat_t* stats[8] = 
+    {&quality->owned_points, &quality->ghost_points, &quality->ghost_ratio, 
+     &quality->pairs, &quality->neighbor_processes, &quality->send_bytes, 
+     &quality->receive_bytes, &quality->load};
+  for (int k = 0; k < 8; ++k)
+  {
+    fprintf(stream, "    %-16s %12g %12g %12g\n", names[k], stats[k]->min, 
+            stats[k]->max, stats[k]->avg);
+  }
+}
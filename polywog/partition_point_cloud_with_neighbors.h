@@ -11,13 +11,18 @@
 #include "core/point_cloud.h"
 #include "core/exchanger.h"
 #include "model/neighbor_pairing.h"
+#include "polywog/point_field_set.h"
 
 // Given a global point cloud and a neighbor pairing connecting its points on 
 // rank 0, this function partitions the points onto the processes on the given 
 // communicator, replacing the point cloud and the stencil on each process 
 // with the newly partitioned data. Each point can have a weight alloted to 
 // it that characterizes its workload, and the load will be balanced within
-// the given imbalance tolerance. 
+// the given imbalance tolerance. If fields is non-NULL, the values of its 
+// fields on rank 0 are distributed along with the points (one message per
+// process), and their ghost values are filled in. Every process must 
+// register the same fields, in the same order. The returned exchanger can 
+// be used to distribute other data from rank 0.
 // NOTE: partitioning of point clouds using stencils instead of neighbor 
 // NOTE: pairings is NOT supported, since stencils generally represent 
 // NOTE: asymmetric neighbor relations, which produce directed graphs, and 
@@ -26,6 +31,139 @@ exchanger_t* partition_point_cloud_with_neighbors(point_cloud_t** points,
                                                   neighbor_pairing_t** neighbors, 
                                                   MPI_Comm comm, 
                                                   int* weights, 
-                                                  real_t imbalance_tol);
+                                                  real_t imbalance_tol,
+                                                  point_field_set_t* fields);
+
+// This function partitions the points in the same way as 
+// partition_point_cloud_with_neighbors, but uses a parallel recursive 
+// coordinate bisection of the points instead of a partitioning of their 
+// adjacency graph. Rank 0 hands out the coordinates of the points in chunks,
+// and the processes bisect them together, so no global graph is built. The
+// cut is generally larger than that produced by a graph partitioner, but 
+// the partitioning is much faster. The weights of the points are balanced 
+// at each bisection within the given imbalance tolerance (relative to the 
+// weight of a single process), or as closely as 50 bisection steps allow.
+// Fields are distributed as in partition_point_cloud_with_neighbors.
+exchanger_t* partition_point_cloud_with_neighbors_geometrically(point_cloud_t** points, 
+                                                                neighbor_pairing_t** neighbors, 
+                                                                MPI_Comm comm, 
+                                                                int* weights, 
+                                                                real_t imbalance_tol,
+                                                                point_field_set_t* fields);
+
+// Given a point cloud and a neighbor pairing that have already been 
+// distributed among the processes on the cloud's communicator (with ghost 
+// points following the locally-owned points, and each pair of points on 
+// different processes appearing on both), this function computes a new
+// partition of the points by recursive coordinate bisection that balances 
+// the given per-point costs (or the numbers of points, if costs is NULL) 
+// within the given imbalance tolerance. Points that change owners are 
+// migrated, along with their values for the fields in the given set (if 
+// non-NULL) and their tags, all packed into one message per process. The 
+// points of the cloud are replaced in place, so the cloud keeps its 
+// properties, and its tags are rebuilt from the points that arrive (ghost 
+// points are dropped from them). The pairing is replaced, and the fields 
+// reallocated, on each process, with their ghost values filled in. Points 
+// that stay on a process come first (in their previous order), followed by
+// those that arrive. Returns the exchanger for the new pairing, which is 
+// owned by the pairing.
+exchanger_t* repartition_point_cloud_with_neighbors(point_cloud_t** points,
+                                                    neighbor_pairing_t** neighbors,
+                                                    real_t* costs,
+                                                    real_t imbalance_tol,
+                                                    point_field_set_t* fields);
+
+// The following functions partition point clouds that are read or generated
+// in slices on each process, so that no process ever holds more than its 
+// share of the points.
+
+// Reads a slice of the points in the given binary file on each process on 
+// the given communicator, returning a point cloud (without ghosts) 
+// containing the slice. The file contains the number of points as a 64-bit
+// integer, followed by the coordinates (x, y, z) of each point as 64-bit 
+// floating point numbers. Each process reads a contiguous chunk of the 
+// points using collective MPI I/O.
+point_cloud_t* read_distributed_point_cloud(MPI_Comm comm, const char* filename);
+
+// Given a point cloud whose points are distributed arbitrarily among the 
+// processes on its communicator (without ghosts), and the support radius R 
+// of each point, this function partitions the points by recursive coordinate
+// bisection, balancing the given per-point costs (or the numbers of points, 
+// if costs is NULL) within the given imbalance tolerance. The points are 
+// migrated to their new processes with their radii, their tags, and their
+// values for the fields in the given set (if non-NULL), in one message per 
+// process. The processes then exchange the points near their boundaries, 
+// and together find the pairs (i, j) of points with |xi - xj| <= max(Ri, Rj),
+// storing the resulting neighbor pairing in neighbors. The points of the 
+// cloud are replaced in place (keeping its properties), and R and the 
+// fields are reallocated, on each process, with their ghost values filled 
+// in. Returns the exchanger for the new pairing, which 
+// is owned by the pairing. Without MPI, the points are left in place, the 
+// pairing is found among them, and NULL is returned.
+exchanger_t* partition_distributed_point_cloud_with_neighbors(point_cloud_t** points,
+                                                              real_t** R,
+                                                              neighbor_pairing_t** neighbors,
+                                                              real_t* costs,
+                                                              real_t imbalance_tol,
+                                                              point_field_set_t* fields);
+
+// Statistics for a quantity over the processes of a partition.
+typedef struct
+{
+  real_t min, max, avg;
+} partition_stat_t;
+
+// This type summarizes the quality of a partition of a point cloud and its
+// neighbor pairing.
+typedef struct
+{
+  // The number of processes, and the global numbers of points and (distinct)
+  // pairs.
+  int num_processes;
+  int64_t num_points, num_pairs;
+
+  // The number of pairs whose points are on different processes.
+  int64_t edge_cut;
+
+  // Statistics over the processes for the numbers of owned points, ghost 
+  // points, ghosts per owned point, pairs, and neighboring processes; the 
+  // numbers of bytes sent and received in an exchange of one real_t per 
+  // point; and the load (the sum of the costs of the owned points).
+  partition_stat_t owned_points, ghost_points, ghost_ratio, pairs, 
+                   neighbor_processes, send_bytes, receive_bytes, load;
+
+  // The load imbalance: max load / avg load - 1.
+  real_t imbalance;
+} partition_quality_t;
+
+// Computes the quality of a partition of the given distributed point cloud 
+// and neighbor pairing (with ghost points following the locally-owned 
+// points, and each pair of points on different processes appearing on both),
+// storing it in quality. If parts is NULL, the partition is the 
+// current distribution of the points; otherwise, parts gives the process 
+// to which each locally-owned point would be assigned, and nothing is moved.
+// The load of each point is its cost (or 1, if costs is NULL). This is a 
+// collective operation. The partitioning functions above log the quality of
+// the partitions they produce at the "detail" log level (and don't compute
+// it at lower levels).
+void partition_quality_compute(point_cloud_t* points,
+                               neighbor_pairing_t* pairing,
+                               real_t* costs,
+                               int* parts,
+                               partition_quality_t* quality);
+
+// Computes the quality of the partition that 
+// repartition_point_cloud_with_neighbors would produce for the given 
+// arguments, without migrating anything. This is useful for tuning 
+// imbalance tolerances and costs.
+void repartition_point_cloud_with_neighbors_dry_run(point_cloud_t* points,
+                                                    neighbor_pairing_t* pairing,
+                                                    real_t* costs,
+                                                    real_t imbalance_tol,
+                                                    partition_quality_t* quality);
+
+// Writes a human-readable report of the given partition quality to the 
+// given stream.
+void partition_quality_fprintf(partition_quality_t* quality, FILE* stream);
 
 #endif
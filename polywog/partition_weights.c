@@ -0,0 +1,132 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+// 
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "polywog/partition_weights.h"
+
+void add_sph_point_costs(neighbor_pairing_t* pairing,
+                         int num_points,
+                         real_t* costs)
+{
+  int pos = 0, i, j;
+  while (neighbor_pairing_next(pairing, &pos, &i, &j, NULL))
+  {
+    if (i < num_points)
+      costs[i] += 1.0;
+    if (j < num_points)
+      costs[j] += 1.0;
+  }
+}
+
+void add_gmls_point_costs(stencil_t* stencil,
+                          int basis_dim,
+                          int num_quad_points,
+                          int num_points,
+                          real_t* costs)
+{
+  ASSERT(basis_dim > 0);
+  ASSERT(num_quad_points >= 0);
+  ASSERT(num_points <= stencil->num_indices);
+  real_t d = 1.0 * basis_dim, q = 1.0 * num_quad_points;
+  for (int i = 0; i < num_points; ++i)
+  {
+    real_t n = 1.0 * stencil_size(stencil, i);
+    costs[i] += n*d*d + d*d*d + q*n*d;
+  }
+}
+
+void add_gmls_point_memory(stencil_t* stencil,
+                           int basis_dim,
+                           int num_points,
+                           real_t* memory)
+{
+  ASSERT(basis_dim > 0);
+  ASSERT(num_points <= stencil->num_indices);
+  real_t d = 1.0 * basis_dim;
+  for (int i = 0; i < num_points; ++i)
+  {
+    real_t n = 1.0 * stencil_size(stencil, i);
+    memory[i] += n * (sizeof(int) + sizeof(real_t)) + d * d * sizeof(real_t);
+  }
+}
+
+void calibrate_point_costs(MPI_Comm comm, 
+                           real_t elapsed_time,
+                           int num_points,
+                           real_t* costs)
+{
+  ASSERT(elapsed_time >= 0.0);
+  real_t sums[2] = {elapsed_time, 0.0};
+  for (int i = 0; i < num_points; ++i)
+    sums[1] += costs[i];
+  MPI_Allreduce(MPI_IN_PLACE, sums, 2, MPI_REAL_T, MPI_SUM, comm);
+  if (sums[1] > 0.0)
+  {
+    real_t scale = sums[0] / sums[1];
+    for (int i = 0; i < num_points; ++i)
+      costs[i] *= scale;
+  }
+}
+
+int* point_weights_from_constraints(MPI_Comm comm,
+                                    int num_points,
+                                    int num_constraints,
+                                    real_t** constraints,
+                                    int max_weight)
+{
+  ASSERT(num_constraints > 0);
+  ASSERT(max_weight >= 1);
+
+  // Normalize each constraint by its total.
+  real_t totals[num_constraints];
+  for (int c = 0; c < num_constraints; ++c)
+  {
+    totals[c] = 0.0;
+    for (int i = 0; i < num_points; ++i)
+      totals[c] += constraints[c][i];
+  }
+  MPI_Allreduce(MPI_IN_PLACE, totals, num_constraints, MPI_REAL_T, MPI_SUM, comm);
+  real_t* combined = polymec_malloc(sizeof(real_t) * MAX(num_points, 1));
+  real_t max_combined = 0.0;
+  for (int i = 0; i < num_points; ++i)
+  {
+    combined[i] = 0.0;
+    for (int c = 0; c < num_constraints; ++c)
+    {
+      if (totals[c] > 0.0)
+        combined[i] += constraints[c][i] / totals[c];
+    }
+    max_combined = MAX(max_combined, combined[i]);
+  }
+  MPI_Allreduce(MPI_IN_PLACE, &max_combined, 1, MPI_REAL_T, MPI_MAX, comm);
+
+  // Scale the combined constraints to integers.
+  int* weights = polymec_malloc(sizeof(int) * MAX(num_points, 1));
+  real_t scale = (max_combined > 0.0) ? max_weight / max_combined : 0.0;
+  for (int i = 0; i < num_points; ++i)
+    weights[i] = MAX(1, (int)lround(scale * combined[i]));
+  polymec_free(combined);
+
+  // Gather the weights on rank 0.
+  int nprocs, rank;
+  MPI_Comm_size(comm, &nprocs);
+  MPI_Comm_rank(comm, &rank);
+  int counts[nprocs], displs[nprocs];
+  MPI_Gather(&num_points, 1, MPI_INT, counts, 1, MPI_INT, 0, comm);
+  int* all_weights = NULL;
+  if (rank == 0)
+  {
+    displs[0] = 0;
+    for (int p = 1; p < nprocs; ++p)
+      displs[p] = displs[p-1] + counts[p-1];
+    all_weights = polymec_malloc(sizeof(int) * MAX(displs[nprocs-1] + counts[nprocs-1], 1));
+  }
+  MPI_Gatherv(weights, num_points, MPI_INT, 
+              all_weights, counts, displs, MPI_INT, 0, comm);
+  polymec_free(weights);
+  return all_weights;
+}
+
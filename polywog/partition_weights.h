@@ -0,0 +1,77 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+// 
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef POLYWOG_PARTITION_WEIGHTS_H
+#define POLYWOG_PARTITION_WEIGHTS_H
+
+#include "model/stencil.h"
+#include "model/neighbor_pairing.h"
+
+// These functions estimate the work (and memory) associated with each point 
+// in a meshless calculation, so that point clouds can be partitioned to 
+// balance it. Each estimate is accumulated into an array of per-point costs,
+// so estimates for several parts of a calculation can be summed. Costs are 
+// computed for the first num_points points, which are normally the 
+// locally-owned points.
+
+// Adds the cost of the SPH pair interactions for each point to costs. The 
+// cost of a point is the number of pairs in the given pairing in which it 
+// appears.
+void add_sph_point_costs(neighbor_pairing_t* pairing,
+                         int num_points,
+                         real_t* costs);
+
+// Adds the cost of constructing the GMLS shape functions and functionals 
+// for each point to costs. For a point with n neighbors in the given 
+// stencil, a polynomial basis of dimension d, and q quadrature points in its
+// subdomain, the cost is n * d^2 (assembling the moment matrix) + d^3 
+// (factoring it) + q * n * d (evaluating the functional at the quadrature 
+// points).
+void add_gmls_point_costs(stencil_t* stencil,
+                          int basis_dim,
+                          int num_quad_points,
+                          int num_points,
+                          real_t* costs);
+
+// Adds an estimate of the memory (in bytes) used by each point in a GMLS 
+// calculation to memory: its stencil entries and moment matrix, for a 
+// polynomial basis of the given dimension.
+void add_gmls_point_memory(stencil_t* stencil,
+                           int basis_dim,
+                           int num_points,
+                           real_t* memory);
+
+// Scales the given per-point costs on the processes on the given 
+// communicator so that their sum is the sum of the given elapsed times 
+// (measured on each process for the work the costs model). This expresses 
+// the costs in seconds, so that costs calibrated for different parts of a 
+// calculation can be added meaningfully.
+void calibrate_point_costs(MPI_Comm comm, 
+                           real_t elapsed_time,
+                           int num_points,
+                           real_t* costs);
+
+// Combines the given num_constraints arrays of per-point constraints (for 
+// example, compute costs and memory) for the num_points locally-owned points
+// on each process into integer weights suitable for the partitioners in 
+// partition_point_cloud_with_neighbors.h. Since those partitioners balance
+// a single weight per point, each constraint is normalized by its total over
+// all processes on the given communicator, and the normalized constraints 
+// are summed, so each constraint counts equally. The weights are scaled so 
+// that the largest is max_weight (and the smallest is at least 1). Since the
+// partitioners take the weights of all points on rank 0, the weights are 
+// gathered there, in order of rank (and of the points on each process). 
+// Returns a newly-allocated array of the weights of all points on rank 0, 
+// and NULL on the other processes. This is a collective operation.
+int* point_weights_from_constraints(MPI_Comm comm,
+                                    int num_points,
+                                    int num_constraints,
+                                    real_t** constraints,
+                                    int max_weight);
+
+#endif
+
@@ -0,0 +1,149 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "core/timer.h"
+#include "polywog/point_field_set.h"
+
+typedef struct
+{
+  void** data;
+  size_t point_size;
+} point_field_t;
+
+struct point_field_set_t
+{
+  int num_fields, capacity;
+  point_field_t* fields;
+  size_t record_size;
+};
+
+point_field_set_t* point_field_set_new()
+{
+  point_field_set_t* fields = polymec_malloc(sizeof(point_field_set_t));
+  fields->num_fields = 0;
+  fields->capacity = 4;
+  fields->fields = polymec_malloc(sizeof(point_field_t) * fields->capacity);
+  fields->record_size = 0;
+  return fields;
+}
+
+void point_field_set_free(point_field_set_t* fields)
+{
+  polymec_free(fields->fields);
+  polymec_free(fields);
+}
+
+void point_field_set_add(point_field_set_t* fields,
+                         void** data,
+                         size_t point_size)
+{
+  ASSERT(data != NULL);
+  ASSERT(point_size > 0);
+  if (fields->num_fields == fields->capacity)
+  {
+    fields->capacity *= 2;
+    fields->fields = polymec_realloc(fields->fields, sizeof(point_field_t) * fields->capacity);
+  }
+  fields->fields[fields->num_fields].data = data;
+  fields->fields[fields->num_fields].point_size = point_size;
+  ++fields->num_fields;
+  fields->record_size += point_size;
+}
+
+void point_field_set_add_reals(point_field_set_t* fields,
+                               real_t** data,
+                               int stride)
+{
+  ASSERT(stride > 0);
+  point_field_set_add(fields, (void**)data, sizeof(real_t) * stride);
+}
+
+void point_field_set_add_ints(point_field_set_t* fields,
+                              int** data,
+                              int stride)
+{
+  ASSERT(stride > 0);
+  point_field_set_add(fields, (void**)data, sizeof(int) * stride);
+}
+
+void point_field_set_add_set(point_field_set_t* fields,
+                             point_field_set_t* other)
+{
+  for (int f = 0; f < other->num_fields; ++f)
+    point_field_set_add(fields, other->fields[f].data, other->fields[f].point_size);
+}
+
+int point_field_set_num_fields(point_field_set_t* fields)
+{
+  return fields->num_fields;
+}
+
+size_t point_field_set_record_size(point_field_set_t* fields)
+{
+  return fields->record_size;
+}
+
+void point_field_set_pack(point_field_set_t* fields, int i, void* record)
+{
+  char* r = record;
+  for (int f = 0; f < fields->num_fields; ++f)
+  {
+    size_t size = fields->fields[f].point_size;
+    char* data = *(fields->fields[f].data);
+    memcpy(r, &data[size*i], size);
+    r += size;
+  }
+}
+
+void point_field_set_unpack(point_field_set_t* fields, int i, void* record)
+{
+  char* r = record;
+  for (int f = 0; f < fields->num_fields; ++f)
+  {
+    size_t size = fields->fields[f].point_size;
+    char* data = *(fields->fields[f].data);
+    memcpy(&data[size*i], r, size);
+    r += size;
+  }
+}
+
+void point_field_set_resize(point_field_set_t* fields, int num_points)
+{
+  ASSERT(num_points >= 0);
+  for (int f = 0; f < fields->num_fields; ++f)
+  {
+    void** data = fields->fields[f].data;
+    *data = polymec_realloc(*data, fields->fields[f].point_size * MAX(num_points, 1));
+  }
+}
+
+void point_field_set_exchange(point_field_set_t* fields,
+                              exchanger_t* ex,
+                              int num_points,
+                              int num_ghosts)
+{
+  if (fields->num_fields == 0) return;
+  if (fields->num_fields == 1)
+  {
+    // No packing is needed.
+    exchanger_exchange(ex, *(fields->fields[0].data),
+                       (int)fields->fields[0].point_size, 0, MPI_CHAR);
+    return;
+  }
+
+  START_FUNCTION_TIMER();
+  size_t size = fields->record_size;
+  char* records = polymec_malloc(size * MAX(num_points + num_ghosts, 1));
+  for (int i = 0; i < num_points; ++i)
+    point_field_set_pack(fields, i, &records[size*i]);
+  exchanger_exchange(ex, records, (int)size, 0, MPI_CHAR);
+  for (int i = num_points; i < num_points + num_ghosts; ++i)
+    point_field_set_unpack(fields, i, &records[size*i]);
+  polymec_free(records);
+  STOP_FUNCTION_TIMER();
+}
+
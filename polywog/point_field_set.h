@@ -0,0 +1,77 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef POLYWOG_POINT_FIELD_SET_H
+#define POLYWOG_POINT_FIELD_SET_H
+
+#include "core/exchanger.h"
+
+// A point field set is a collection of per-point data arrays (of any type
+// and stride) that travel with the points of a point cloud. The partitioning
+// functions in partition_point_cloud_with_neighbors.h migrate all of the
+// fields in a set along with the points, packing the values of every field
+// for a point into a single record, so that one message is sent to each
+// process no matter how many fields there are. A set refers to its fields
+// through the addresses of their arrays, and replaces the arrays in place
+// when the points move. It does not assert ownership over the arrays.
+typedef struct point_field_set_t point_field_set_t;
+
+// Creates a new, empty point field set.
+point_field_set_t* point_field_set_new(void);
+
+// Destroys the given point field set (but not its fields).
+void point_field_set_free(point_field_set_t* fields);
+
+// Adds a field to the set whose values for each point occupy point_size
+// bytes in the array *data. The array must be allocated with polymec_malloc,
+// since the set may reallocate it.
+void point_field_set_add(point_field_set_t* fields,
+                         void** data,
+                         size_t point_size);
+
+// Adds a real-valued field with the given number of components per point.
+void point_field_set_add_reals(point_field_set_t* fields,
+                               real_t** data,
+                               int stride);
+
+// Adds an integer-valued field with the given number of components per
+// point.
+void point_field_set_add_ints(point_field_set_t* fields,
+                              int** data,
+                              int stride);
+
+// Adds all of the fields in the set other to the set fields.
+void point_field_set_add_set(point_field_set_t* fields,
+                             point_field_set_t* other);
+
+// Returns the number of fields in the set.
+int point_field_set_num_fields(point_field_set_t* fields);
+
+// Returns the size in bytes of the values of all the fields for one point.
+size_t point_field_set_record_size(point_field_set_t* fields);
+
+// Packs the values of all of the fields for the ith point into record,
+// which must hold at least point_field_set_record_size(fields) bytes.
+void point_field_set_pack(point_field_set_t* fields, int i, void* record);
+
+// Unpacks the values of all of the fields for the ith point from record.
+void point_field_set_unpack(point_field_set_t* fields, int i, void* record);
+
+// Resizes all of the fields in the set to hold values for num_points points.
+void point_field_set_resize(point_field_set_t* fields, int num_points);
+
+// Fills in the values of all of the fields for the num_ghosts ghost points
+// (following the num_points locally-owned points) using the given exchanger,
+// in a single exchange. The fields must already hold values for
+// num_points + num_ghosts points.
+void point_field_set_exchange(point_field_set_t* fields,
+                              exchanger_t* ex,
+                              int num_points,
+                              int num_ghosts);
+
+#endif
+
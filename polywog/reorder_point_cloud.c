@@ -0,0 +1,440 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdint.h>
+#include "core/timer.h"
+#include "polywog/reorder_point_cloud.h"
+
+// Number of bits per coordinate in our space-filling curve keys.
+#define SFC_BITS 21
+
+// Quantizes the locally-owned points of the cloud onto a 2^SFC_BITS lattice 
+// spanning their bounding box.
+static void quantize_points(point_cloud_t* cloud, uint32_t* coords)
+{
+  int N = cloud->num_points;
+  real_t x1 = REAL_MAX, x2 = -REAL_MAX, y1 = REAL_MAX, y2 = -REAL_MAX, 
+         z1 = REAL_MAX, z2 = -REAL_MAX;
+  for (int i = 0; i < N; ++i)
+  {
+    point_t* x = &cloud->points[i];
+    x1 = MIN(x1, x->x); x2 = MAX(x2, x->x);
+    y1 = MIN(y1, x->y); y2 = MAX(y2, x->y);
+    z1 = MIN(z1, x->z); z2 = MAX(z2, x->z);
+  }
+
+  // We use the same scale in each direction so that the curve isn't 
+  // distorted in flat domains.
+  real_t L = MAX(x2 - x1, MAX(y2 - y1, z2 - z1));
+  real_t scale = (L > 0.0) ? ((1 << SFC_BITS) - 1) / L : 0.0;
+  for (int i = 0; i < N; ++i)
+  {
+    point_t* x = &cloud->points[i];
+    coords[3*i]   = (uint32_t)((x->x - x1) * scale);
+    coords[3*i+1] = (uint32_t)((x->y - y1) * scale);
+    coords[3*i+2] = (uint32_t)((x->z - z1) * scale);
+  }
+}
+
+// Interleaves the bits of the three given coordinates, with those of X[0] 
+// most significant at each level.
+static uint64_t interleave(uint32_t* X)
+{
+  uint64_t key = 0;
+  for (int b = SFC_BITS-1; b >= 0; --b)
+  {
+    key = (key << 3) | (((X[0] >> b) & 1) << 2) | 
+                       (((X[1] >> b) & 1) << 1) | 
+                        ((X[2] >> b) & 1);
+  }
+  return key;
+}
+
+static uint64_t morton_key(uint32_t* coords)
+{
+  uint32_t X[3] = {coords[0], coords[1], coords[2]};
+  return interleave(X);
+}
+
+// Computes the Hilbert key for the given coordinates by transforming them 
+// into the "transposed" Hilbert index (Skilling, AIP Conf. Proc. 707, 2004) 
+// and interleaving its bits.
+static uint64_t hilbert_key(uint32_t* coords)
+{
+  uint32_t X[3] = {coords[0], coords[1], coords[2]};
+  uint32_t M = 1u << (SFC_BITS-1), P, Q, t;
+
+  // Inverse undo.
+  for (Q = M; Q > 1; Q >>= 1)
+  {
+    P = Q - 1;
+    for (int i = 0; i < 3; ++i)
+    {
+      if (X[i] & Q)
+        X[0] ^= P;
+      else
+      {
+        t = (X[0] ^ X[i]) & P;
+        X[0] ^= t;
+        X[i] ^= t;
+      }
+    }
+  }
+
+  // Gray encode.
+  X[1] ^= X[0];
+  X[2] ^= X[1];
+  t = 0;
+  for (Q = M; Q > 1; Q >>= 1)
+  {
+    if (X[2] & Q)
+      t ^= Q - 1;
+  }
+  X[0] ^= t;
+  X[1] ^= t;
+  X[2] ^= t;
+
+  return interleave(X);
+}
+
+typedef struct
+{
+  uint64_t key;
+  int index;
+} keyed_index_t;
+
+static int keyed_index_cmp(const void* l, const void* r)
+{
+  const keyed_index_t* li = l;
+  const keyed_index_t* ri = r;
+  if (li->key != ri->key)
+    return (li->key < ri->key) ? -1 : 1;
+  return li->index - ri->index;
+}
+
+static int* sfc_permutation(point_cloud_t* cloud, 
+                            uint64_t (*key)(uint32_t* coords))
+{
+  START_FUNCTION_TIMER();
+  int N = cloud->num_points;
+  uint32_t* coords = polymec_malloc(sizeof(uint32_t) * 3 * MAX(N, 1));
+  quantize_points(cloud, coords);
+  keyed_index_t* keys = polymec_malloc(sizeof(keyed_index_t) * MAX(N, 1));
+  for (int i = 0; i < N; ++i)
+  {
+    keys[i].key = key(&coords[3*i]);
+    keys[i].index = i;
+  }
+  polymec_free(coords);
+  qsort(keys, N, sizeof(keyed_index_t), keyed_index_cmp);
+  int* perm = polymec_malloc(sizeof(int) * MAX(N, 1));
+  for (int i = 0; i < N; ++i)
+    perm[i] = keys[i].index;
+  polymec_free(keys);
+  STOP_FUNCTION_TIMER();
+  return perm;
+}
+
+int* point_cloud_hilbert_permutation(point_cloud_t* cloud)
+{
+  return sfc_permutation(cloud, hilbert_key);
+}
+
+int* point_cloud_morton_permutation(point_cloud_t* cloud)
+{
+  return sfc_permutation(cloud, morton_key);
+}
+
+typedef struct
+{
+  void* data;
+  size_t elem_size;
+} registered_array_t;
+
+// An array of data for the pairs in a pairing.
+typedef struct
+{
+  neighbor_pairing_t* pairing;
+  void* data;
+  size_t elem_size;
+} registered_pair_array_t;
+
+struct point_cloud_reorderer_t
+{
+  point_cloud_t* cloud;
+  ptr_array_t* arrays;
+  ptr_array_t* stencils;
+  ptr_array_t* pairings;
+  ptr_array_t* pair_arrays;
+  ptr_array_t* exchangers;
+};
+
+point_cloud_reorderer_t* point_cloud_reorderer_new(point_cloud_t* cloud)
+{
+  point_cloud_reorderer_t* reorderer = polymec_malloc(sizeof(point_cloud_reorderer_t));
+  reorderer->cloud = cloud;
+  reorderer->arrays = ptr_array_new();
+  reorderer->stencils = ptr_array_new();
+  reorderer->pairings = ptr_array_new();
+  reorderer->pair_arrays = ptr_array_new();
+  reorderer->exchangers = ptr_array_new();
+  return reorderer;
+}
+
+void point_cloud_reorderer_free(point_cloud_reorderer_t* reorderer)
+{
+  for (int a = 0; a < reorderer->arrays->size; ++a)
+    polymec_free(reorderer->arrays->data[a]);
+  ptr_array_free(reorderer->arrays);
+  ptr_array_free(reorderer->stencils);
+  ptr_array_free(reorderer->pairings);
+  for (int a = 0; a < reorderer->pair_arrays->size; ++a)
+    polymec_free(reorderer->pair_arrays->data[a]);
+  ptr_array_free(reorderer->pair_arrays);
+  ptr_array_free(reorderer->exchangers);
+  polymec_free(reorderer);
+}
+
+void point_cloud_reorderer_add_array(point_cloud_reorderer_t* reorderer,
+                                     void* array,
+                                     size_t element_size)
+{
+  ASSERT(array != NULL);
+  ASSERT(element_size > 0);
+  registered_array_t* a = polymec_malloc(sizeof(registered_array_t));
+  a->data = array;
+  a->elem_size = element_size;
+  ptr_array_append(reorderer->arrays, a);
+}
+
+// Adds the exchanger to our list if it isn't already there.
+static void add_exchanger(point_cloud_reorderer_t* reorderer,
+                          exchanger_t* exchanger)
+{
+  if (exchanger == NULL) return;
+  for (int e = 0; e < reorderer->exchangers->size; ++e)
+  {
+    if (reorderer->exchangers->data[e] == exchanger)
+      return;
+  }
+  ptr_array_append(reorderer->exchangers, exchanger);
+}
+
+void point_cloud_reorderer_add_stencil(point_cloud_reorderer_t* reorderer,
+                                       stencil_t* stencil)
+{
+  ptr_array_append(reorderer->stencils, stencil);
+  add_exchanger(reorderer, stencil->ex);
+}
+
+void point_cloud_reorderer_add_pairing(point_cloud_reorderer_t* reorderer,
+                                       neighbor_pairing_t* pairing)
+{
+  ptr_array_append(reorderer->pairings, pairing);
+  add_exchanger(reorderer, pairing->ex);
+}
+
+void point_cloud_reorderer_add_pair_array(point_cloud_reorderer_t* reorderer,
+                                          neighbor_pairing_t* pairing,
+                                          void* array,
+                                          size_t element_size)
+{
+  ASSERT(array != NULL);
+  ASSERT(element_size > 0);
+#ifndef NDEBUG
+  bool registered = false;
+  for (int p = 0; p < reorderer->pairings->size; ++p)
+    registered = registered || (reorderer->pairings->data[p] == pairing);
+  ASSERT(registered);
+#endif
+  registered_pair_array_t* a = polymec_malloc(sizeof(registered_pair_array_t));
+  a->pairing = pairing;
+  a->data = array;
+  a->elem_size = element_size;
+  ptr_array_append(reorderer->pair_arrays, a);
+}
+
+void point_cloud_reorderer_add_exchanger(point_cloud_reorderer_t* reorderer,
+                                         exchanger_t* exchanger)
+{
+  add_exchanger(reorderer, exchanger);
+}
+
+// Maps an old point index to a new one. Ghost indices don't change.
+static inline int new_index(int* inv_perm, int num_owned, int old_index)
+{
+  return (old_index < num_owned) ? inv_perm[old_index] : old_index;
+}
+
+static void permute_array(void* data, size_t elem_size, int N, int* perm)
+{
+  char* old_data = polymec_malloc(elem_size * N);
+  memcpy(old_data, data, elem_size * N);
+  char* new_data = data;
+  for (int i = 0; i < N; ++i)
+    memcpy(&new_data[elem_size*i], &old_data[elem_size*perm[i]], elem_size);
+  polymec_free(old_data);
+}
+
+static void reorder_stencil(stencil_t* stencil, int num_owned, 
+                            int* perm, int* inv_perm)
+{
+  ASSERT(stencil->num_indices == num_owned);
+  int* offsets = polymec_malloc(sizeof(int) * (num_owned+1));
+  int* indices = polymec_malloc(sizeof(int) * stencil->offsets[num_owned]);
+  real_t* weights = (stencil->weights != NULL) ? 
+    polymec_malloc(sizeof(real_t) * stencil->offsets[num_owned]) : NULL;
+  offsets[0] = 0;
+  for (int i = 0; i < num_owned; ++i)
+  {
+    int old_i = perm[i];
+    int begin = stencil->offsets[old_i], end = stencil->offsets[old_i+1];
+    offsets[i+1] = offsets[i] + (end - begin);
+    for (int k = begin; k < end; ++k)
+    {
+      indices[offsets[i] + k - begin] = 
+        new_index(inv_perm, num_owned, stencil->indices[k]);
+      if (weights != NULL)
+        weights[offsets[i] + k - begin] = stencil->weights[k];
+    }
+  }
+  polymec_free(stencil->offsets);
+  polymec_free(stencil->indices);
+  stencil->offsets = offsets;
+  stencil->indices = indices;
+  if (weights != NULL)
+  {
+    polymec_free(stencil->weights);
+    stencil->weights = weights;
+  }
+}
+
+// A pair (i, j), keyed by its smaller and larger indices, and its index in 
+// the original pairing.
+typedef struct
+{
+  int i, j, lo, hi, index;
+} keyed_pair_t;
+
+static int keyed_pair_cmp(const void* l, const void* r)
+{
+  const keyed_pair_t* lp = l;
+  const keyed_pair_t* rp = r;
+  if (lp->lo != rp->lo)
+    return lp->lo - rp->lo;
+  if (lp->hi != rp->hi)
+    return lp->hi - rp->hi;
+  return lp->index - rp->index;
+}
+
+// Renumbers the points in the given pairing and sorts its pairs by their 
+// smaller and then larger indices, keeping the orientation of each pair. 
+// Returns a newly-allocated permutation of the pairs, mapping new pair 
+// indices to old ones.
+static int* reorder_pairing(neighbor_pairing_t* pairing, int num_owned, 
+                            int* inv_perm)
+{
+  int num_pairs = pairing->num_pairs;
+  keyed_pair_t* pairs = polymec_malloc(sizeof(keyed_pair_t) * MAX(num_pairs, 1));
+  for (int p = 0; p < num_pairs; ++p)
+  {
+    int i = new_index(inv_perm, num_owned, pairing->pairs[2*p]);
+    int j = new_index(inv_perm, num_owned, pairing->pairs[2*p+1]);
+    pairs[p].i = i;
+    pairs[p].j = j;
+    pairs[p].lo = MIN(i, j);
+    pairs[p].hi = MAX(i, j);
+    pairs[p].index = p;
+  }
+  qsort(pairs, num_pairs, sizeof(keyed_pair_t), keyed_pair_cmp);
+  int* pair_perm = polymec_malloc(sizeof(int) * MAX(num_pairs, 1));
+  for (int p = 0; p < num_pairs; ++p)
+  {
+    pairing->pairs[2*p] = pairs[p].i;
+    pairing->pairs[2*p+1] = pairs[p].j;
+    pair_perm[p] = pairs[p].index;
+  }
+  polymec_free(pairs);
+  if (pairing->weights != NULL)
+    permute_array(pairing->weights, sizeof(real_t), num_pairs, pair_perm);
+  return pair_perm;
+}
+
+static void reorder_exchanger(exchanger_t* ex, int num_owned, int* inv_perm)
+{
+  int pos = 0, proc, num_indices, *indices;
+  while (exchanger_next_send(ex, &pos, &proc, &indices, &num_indices))
+  {
+    for (int k = 0; k < num_indices; ++k)
+      indices[k] = new_index(inv_perm, num_owned, indices[k]);
+  }
+}
+
+void point_cloud_reorderer_apply(point_cloud_reorderer_t* reorderer,
+                                 int* permutation)
+{
+  START_FUNCTION_TIMER();
+  point_cloud_t* cloud = reorderer->cloud;
+  int N = cloud->num_points;
+  int* perm = permutation;
+  int* inv_perm = polymec_malloc(sizeof(int) * MAX(N, 1));
+  for (int i = 0; i < N; ++i)
+    inv_perm[perm[i]] = i;
+
+  // Points and tags.
+  permute_array(cloud->points, sizeof(point_t), N, perm);
+  int pos = 0;
+  char* tag_name;
+  int* tag;
+  size_t tag_size;
+  while (tagger_next_tag(cloud->tags, &pos, &tag_name, &tag, &tag_size))
+  {
+    for (size_t k = 0; k < tag_size; ++k)
+      tag[k] = new_index(inv_perm, N, tag[k]);
+  }
+
+  // Registered arrays, stencils, pairings, and exchangers.
+  for (int a = 0; a < reorderer->arrays->size; ++a)
+  {
+    registered_array_t* array = reorderer->arrays->data[a];
+    permute_array(array->data, array->elem_size, N, perm);
+  }
+  for (int s = 0; s < reorderer->stencils->size; ++s)
+    reorder_stencil(reorderer->stencils->data[s], N, perm, inv_perm);
+  for (int p = 0; p < reorderer->pairings->size; ++p)
+  {
+    neighbor_pairing_t* pairing = reorderer->pairings->data[p];
+    int* pair_perm = reorder_pairing(pairing, N, inv_perm);
+    for (int a = 0; a < reorderer->pair_arrays->size; ++a)
+    {
+      registered_pair_array_t* array = reorderer->pair_arrays->data[a];
+      if (array->pairing == pairing)
+        permute_array(array->data, array->elem_size, pairing->num_pairs, pair_perm);
+    }
+    polymec_free(pair_perm);
+  }
+  for (int e = 0; e < reorderer->exchangers->size; ++e)
+    reorder_exchanger(reorderer->exchangers->data[e], N, inv_perm);
+
+  polymec_free(inv_perm);
+  STOP_FUNCTION_TIMER();
+}
+
+void point_cloud_reorder_hilbert(point_cloud_reorderer_t* reorderer)
+{
+  int* perm = point_cloud_hilbert_permutation(reorderer->cloud);
+  point_cloud_reorderer_apply(reorderer, perm);
+  polymec_free(perm);
+}
+
+void point_cloud_reorder_morton(point_cloud_reorderer_t* reorderer)
+{
+  int* perm = point_cloud_morton_permutation(reorderer->cloud);
+  point_cloud_reorderer_apply(reorderer, perm);
+  polymec_free(perm);
+}
+
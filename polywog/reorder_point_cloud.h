@@ -0,0 +1,92 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef POLYWOG_REORDER_POINT_CLOUD_H
+#define POLYWOG_REORDER_POINT_CLOUD_H
+
+#include "core/point_cloud.h"
+#include "core/exchanger.h"
+#include "model/stencil.h"
+#include "model/neighbor_pairing.h"
+
+// Returns a newly-allocated permutation of the locally-owned points in the 
+// given cloud that orders them along a 3D Hilbert curve through their 
+// bounding box. The permutation maps new indices to old ones: the point 
+// with new index i is the point with old index perm[i].
+int* point_cloud_hilbert_permutation(point_cloud_t* cloud);
+
+// Returns a newly-allocated permutation of the locally-owned points in the 
+// given cloud that orders them along a 3D Morton (Z-order) curve. Morton 
+// ordering is cheaper to compute than Hilbert ordering, but gives somewhat 
+// less locality.
+int* point_cloud_morton_permutation(point_cloud_t* cloud);
+
+// A point cloud reorderer applies a permutation of the locally-owned points 
+// in a point cloud to the cloud (its points and tags), and to every array of
+// point data, stencil, neighbor pairing, and exchanger that has been 
+// registered with it, so that loops over points and their neighbors access 
+// memory nearly sequentially. Ghost points keep their indices. Since the 
+// layout of a point cloud's properties is unknown, properties must be 
+// registered as arrays in order to be reordered.
+typedef struct point_cloud_reorderer_t point_cloud_reorderer_t;
+
+// Creates a reorderer for the given point cloud. The reorderer does not 
+// assert ownership over the cloud or anything registered with it.
+point_cloud_reorderer_t* point_cloud_reorderer_new(point_cloud_t* cloud);
+
+// Destroys the given reorderer.
+void point_cloud_reorderer_free(point_cloud_reorderer_t* reorderer);
+
+// Registers an array of point data with elements of the given size (in 
+// bytes) for each point. The array must remain valid for as long as it is 
+// registered.
+void point_cloud_reorderer_add_array(point_cloud_reorderer_t* reorderer,
+                                     void* array,
+                                     size_t element_size);
+
+// Registers a stencil whose rows correspond to the locally-owned points.
+// The stencil's exchanger is remapped as well.
+void point_cloud_reorderer_add_stencil(point_cloud_reorderer_t* reorderer,
+                                       stencil_t* stencil);
+
+// Registers a neighbor pairing. After reordering, its pairs are sorted by 
+// their smaller and then larger indices. Each pair keeps its orientation 
+// (the point that was first in a pair is still first), so antisymmetric 
+// data for the pairs remains valid, but the pairs generally change places.
+// Arrays of data indexed by the pairs must be registered with 
+// point_cloud_reorderer_add_pair_array to follow them. Its exchanger is 
+// remapped as well.
+void point_cloud_reorderer_add_pairing(point_cloud_reorderer_t* reorderer,
+                                       neighbor_pairing_t* pairing);
+
+// Registers an array of data with elements of the given size (in bytes) for
+// each pair in the given (registered) pairing, which is permuted along with
+// the pairs. The array must remain valid for as long as it is registered.
+void point_cloud_reorderer_add_pair_array(point_cloud_reorderer_t* reorderer,
+                                          neighbor_pairing_t* pairing,
+                                          void* array,
+                                          size_t element_size);
+
+// Registers an exchanger whose send indices refer to locally-owned points.
+// Exchangers belonging to registered stencils and pairings need not be 
+// registered separately.
+void point_cloud_reorderer_add_exchanger(point_cloud_reorderer_t* reorderer,
+                                         exchanger_t* exchanger);
+
+// Applies the given permutation (mapping new indices to old ones) of the 
+// locally-owned points to the cloud and everything registered.
+void point_cloud_reorderer_apply(point_cloud_reorderer_t* reorderer,
+                                 int* permutation);
+
+// Reorders the cloud and everything registered along a Hilbert curve.
+void point_cloud_reorder_hilbert(point_cloud_reorderer_t* reorderer);
+
+// Reorders the cloud and everything registered along a Morton curve.
+void point_cloud_reorder_morton(point_cloud_reorderer_t* reorderer);
+
+#endif
+
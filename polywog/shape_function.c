@@ -157,6 +157,12 @@ void shape_function_free(shape_function_t* phi)
   polymec_free(phi);
 }
 
+void shape_function_finish_exchange(shape_function_t* phi)
+{
+  if (phi->vtable.finish_exchange != NULL)
+    phi->vtable.finish_exchange(phi->context);
+}
+
 void shape_function_set_neighborhood(shape_function_t* phi, int point_index)
 {
   ASSERT(point_index >= 0);
@@ -62,6 +62,10 @@ typedef struct
   // the gradient argument is non-NULL, the gradient of the shape function is 
   // also computed at these points.
   void (*compute)(void* context, int i, point_t* x, real_t* values, vector_t* gradients);
+  // This (optional) method finishes any communication of ghost data begun 
+  // when the shape function was created. It must be safe to call more than 
+  // once.
+  void (*finish_exchange)(void* context);
   // This destructor destroys the context.
   void (*dtor)(void* context);
 } shape_function_vtable;
@@ -75,6 +79,16 @@ shape_function_t* shape_function_new(const char* name,
 // Destroys the shape function.
 void shape_function_free(shape_function_t* phi);
 
+// Finishes any exchange of ghost data (points, smoothing lengths) that the 
+// shape function started when it was created, so that ghost values in the 
+// domain are current and no messages remain outstanding. Shape functions 
+// finish this exchange themselves when a neighborhood that includes ghost 
+// points is first set, and when they are destroyed, so that the 
+// neighborhoods of interior points can be processed while it is in flight. 
+// Callers that read ghost data from the domain or its fields directly 
+// must call this first. Calling it more than once has no effect.
+void shape_function_finish_exchange(shape_function_t* phi);
+
 // Sets the point within the domain in whose vicinity the shape function 
 // will be defined, using the stencil for that point to define the neighborhood.
 void shape_function_set_neighborhood(shape_function_t* phi, int point_index);
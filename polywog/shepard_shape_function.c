@@ -18,8 +18,29 @@ typedef struct
   int N;
   point_t* xj;
   real_t* hj;
+
+  // Tokens for the exchanges of ghost points and smoothing lengths, which 
+  // are finished when a neighborhood first needs ghost data.
+  bool exchange_pending;
+  int points_token, h_token;
+
+  // has_ghosts[i] is true if the neighborhood of point i includes ghost 
+  // points.
+  bool* has_ghosts;
 } shepard_t;
 
+// Finishes the exchange of ghost data begun in the constructor, if needed.
+static void shepard_finish_exchange(void* context)
+{
+  shepard_t* shepard = context;
+  if (shepard->exchange_pending)
+  {
+    stencil_finish_exchange(shepard->neighborhoods, shepard->points_token);
+    stencil_finish_exchange(shepard->neighborhoods, shepard->h_token);
+    shepard->exchange_pending = false;
+  }
+}
+
 static int shepard_neighborhood_size(void* context, int i)
 {
   shepard_t* shepard = context;
@@ -29,6 +50,8 @@ static int shepard_neighborhood_size(void* context, int i)
 static void shepard_get_neighborhood_points(void* context, int i, point_t* points)
 {
   shepard_t* shepard = context;
+  if (shepard->has_ghosts[i])
+    shepard_finish_exchange(shepard);
   int pos = 0, j, k = 0;
   points[k++] = shepard->domain->points[i];
   while (stencil_next(shepard->neighborhoods, i, &pos, &j, NULL))
@@ -40,7 +63,9 @@ static void shepard_set_neighborhood(void* context, int i)
   shepard_t* shepard = context;
   ASSERT(i < shepard->domain->num_points); 
 
-  // Extract the points.
+  // Extract the points, making sure any ghost points have arrived.
+  if (shepard->has_ghosts[i])
+    shepard_finish_exchange(shepard);
   shepard->N = stencil_size(shepard->neighborhoods, i);
   int pos = 0, j, k = 0;
   while (stencil_next(shepard->neighborhoods, i, &pos, &j, NULL))
@@ -106,8 +131,10 @@ static void shepard_compute(void* context,
 static void shepard_dtor(void* context)
 {
   shepard_t* shepard = context;
+  shepard_finish_exchange(shepard);
   polymec_free(shepard->xj);
   polymec_free(shepard->hj);
+  polymec_free(shepard->has_ghosts);
   polymec_free(shepard);
 }
 
@@ -122,21 +149,39 @@ shape_function_t* shepard_shape_function_new(shape_function_kernel_t* kernel,
   shepard->neighborhoods = neighborhoods;
   shepard->smoothing_lengths = smoothing_lengths;
 
-  // Count up the maximum neighborhood size and allocate storage.
+  // Count up the maximum neighborhood size and allocate storage, and find 
+  // the neighborhoods that include ghost points.
   int max_neighborhood_size = -1;
+  shepard->has_ghosts = polymec_malloc(sizeof(bool) * MAX(shepard->domain->num_points, 1));
   for (int i = 0; i < shepard->domain->num_points; ++i)
+  {
     max_neighborhood_size = MAX(max_neighborhood_size, stencil_size(shepard->neighborhoods, i));
+    shepard->has_ghosts[i] = false;
+    int pos = 0, j;
+    while (stencil_next(shepard->neighborhoods, i, &pos, &j, NULL))
+    {
+      if (j >= shepard->domain->num_points)
+      {
+        shepard->has_ghosts[i] = true;
+        break;
+      }
+    }
+  }
   shepard->xj = polymec_malloc(sizeof(point_t) * max_neighborhood_size);
   shepard->hj = polymec_malloc(sizeof(real_t) * max_neighborhood_size);
 
-  // Make sure our ghost points are consistent a representation of ghost points.
-  stencil_exchange(shepard->neighborhoods, shepard->domain->points, 3, 0, MPI_REAL_T);
-  stencil_exchange(shepard->neighborhoods, shepard->smoothing_lengths, 1, 0, MPI_REAL_T);
+  // Begin making our ghost points consistent. We only wait for the ghost 
+  // data when a neighborhood that includes ghost points is first used, so 
+  // that neighborhoods of interior points can be processed in the meantime.
+  shepard->points_token = stencil_start_exchange(shepard->neighborhoods, shepard->domain->points, 3, 0, MPI_REAL_T);
+  shepard->h_token = stencil_start_exchange(shepard->neighborhoods, shepard->smoothing_lengths, 1, 1, MPI_REAL_T);
+  shepard->exchange_pending = true;
 
   shape_function_vtable vtable = {.neighborhood_size = shepard_neighborhood_size,
                                   .get_neighborhood_points = shepard_get_neighborhood_points,
                                   .set_neighborhood = shepard_set_neighborhood,
                                   .compute = shepard_compute,
+                                  .finish_exchange = shepard_finish_exchange,
                                   .dtor = shepard_dtor};
   return shape_function_new("Shepard", shepard, vtable);
 }
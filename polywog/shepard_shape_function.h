@@ -16,6 +16,12 @@
 // neighborhoods given by the given stencil. Here, smoothing_lengths is a 
 // field (array) assigning a characteristic extent, h, to each point in the 
 // domain, and must have enough storage for ghost points.
+// The shape function starts exchanging the ghost points and smoothing 
+// lengths when it is created and returns without waiting for them. The 
+// domain's ghost points and the ghost entries in smoothing_lengths are 
+// current only after shape_function_finish_exchange has been called (or a 
+// neighborhood that includes ghost points has been set), and neither may be 
+// modified until then.
 shape_function_t* shepard_shape_function_new(shape_function_kernel_t* kernel,
                                              point_cloud_t* domain,
                                              stencil_t* neighborhoods,
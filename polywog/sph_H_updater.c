@@ -5,7 +5,9 @@
 // License, v. 2.0. If a copy of the MPL was not distributed with this
 // file, You can obtain one at http://mozilla.org/MPL/2.0/.
 
+#include "core/timer.h"
 #include "polywog/sph_H_updater.h"
+#include "polywog/sph_pair_loop.h"
 
 struct sph_H_updater_t 
 {
@@ -36,11 +38,12 @@ static sph_H_updater_t* sph_H_updater_new(sph_kernel_t* W,
   int table_size = 500;
   real_t min_nh = 0.0, max_nh = 10.0;
   real_t sumWijs[table_size];
+  real_t self_W = sph_kernel_sum(W, 0.0);
   for (int i = 0; i < table_size; ++i)
   {
     real_t nh = i * (max_nh - min_nh) / table_size;
     // Our sums for kernels exclude the self contribution.
-    sumWijs[i] = sph_kernel_sum(W, nh) - sph_kernel_sum(W, 0.0);
+    sumWijs[i] = sph_kernel_sum(W, nh) - self_W;
   }
   updater->table = lookup1_new(min_nh, max_nh, table_size, sumWijs, LOOKUP1_LINEAR);
 
@@ -142,3 +145,319 @@ void sph_H_updater_update(sph_H_updater_t* updater,
   sym_tensor2_scale(new_H, (real_t)pow(new_det_H, 1.0/3.0));
 }
 
+// Number of points processed in each structure-of-arrays block by 
+// sph_H_updater_update_batch.
+#define H_BATCH_SIZE 64
+
+// Computes the factor by which the number of neighbors per smoothing length
+// should be scaled, given the zeroth moment (as in sph_H_updater_update).
+static inline real_t nh_ratio(sph_H_updater_t* updater, real_t zeroth_moment)
+{
+  if (zeroth_moment < 1e-5)
+    return 2.0;
+  real_t min_nh, max_nh;
+  lookup1_get_bounds(updater->table, &min_nh, &max_nh);
+  if (zeroth_moment > max_nh)
+    return 0.5;
+  real_t nh = lookup1_value(updater->table, zeroth_moment);
+  return MIN(4.0, MAX(0.25, updater->n_per_h / nh));
+}
+
+// Updates a block of n <= H_BATCH_SIZE points whose tensors have been 
+// transposed into structure-of-arrays form. Tensor components are stored 
+// in the order xx, xy, xz, yy, yz, zz, each in its own row of H_BATCH_SIZE
+// values.
+static void update_block(sph_H_updater_t* updater, 
+                         int n, 
+                         real_t H[6][H_BATCH_SIZE], 
+                         real_t* zeroth_moments, 
+                         real_t M[6][H_BATCH_SIZE], 
+                         real_t new_H[6][H_BATCH_SIZE])
+{
+  enum { XX = 0, XY = 1, XZ = 2, YY = 3, YZ = 4, ZZ = 5 };
+
+  // The table lookups don't vectorize, so we compute the ratios separately.
+  real_t s[H_BATCH_SIZE];
+  for (int p = 0; p < n; ++p)
+    s[p] = nh_ratio(updater, zeroth_moments[p]);
+
+  // Compute the new determinants of H, following Thakar et al (2000).
+  real_t scale[H_BATCH_SIZE];
+#pragma omp simd
+  for (int p = 0; p < n; ++p)
+  {
+    real_t sp = s[p];
+    real_t a = (sp <= 1.0) ? 0.4 * (1.0 + sp*sp) : 0.4 * (1.0 + 1.0/(sp*sp*sp));
+    real_t det_H = H[XX][p] * (H[YY][p]*H[ZZ][p] - H[YZ][p]*H[YZ][p]) - 
+                   H[XY][p] * (H[XY][p]*H[ZZ][p] - H[YZ][p]*H[XZ][p]) + 
+                   H[XZ][p] * (H[XY][p]*H[YZ][p] - H[YY][p]*H[XZ][p]);
+    real_t b = 1.0 - a + a*sp;
+    scale[p] = cbrt(det_H / (b*b*b));
+  }
+
+  if (!updater->anisotropic)
+  {
+#pragma omp simd
+    for (int p = 0; p < n; ++p)
+    {
+      new_H[XX][p] = new_H[YY][p] = new_H[ZZ][p] = scale[p];
+      new_H[XY][p] = new_H[XZ][p] = new_H[YZ][p] = 0.0;
+    }
+    return;
+  }
+
+#pragma omp simd
+  for (int p = 0; p < n; ++p)
+  {
+    real_t mxx = M[XX][p], mxy = M[XY][p], mxz = M[XZ][p], 
+           myy = M[YY][p], myz = M[YZ][p], mzz = M[ZZ][p];
+
+    // Find the minimum eigenvalue of the second moment in closed form.
+    real_t p1 = mxy*mxy + mxz*mxz + myz*myz;
+    real_t q = (mxx + myy + mzz) / 3.0;
+    real_t p2 = (mxx-q)*(mxx-q) + (myy-q)*(myy-q) + (mzz-q)*(mzz-q) + 2.0*p1;
+    real_t r6 = sqrt(p2 / 6.0);
+    real_t r6_inv = (r6 > 0.0) ? 1.0 / r6 : 0.0;
+    real_t bxx = (mxx-q)*r6_inv, byy = (myy-q)*r6_inv, bzz = (mzz-q)*r6_inv,
+           bxy = mxy*r6_inv, bxz = mxz*r6_inv, byz = myz*r6_inv;
+    real_t half_det_B = 0.5 * (bxx * (byy*bzz - byz*byz) - 
+                               bxy * (bxy*bzz - byz*bxz) + 
+                               bxz * (bxy*byz - byy*bxz));
+    half_det_B = MIN(1.0, MAX(-1.0, half_det_B));
+    real_t phi = acos(half_det_B) / 3.0;
+    real_t lambda_min = q + 2.0 * r6 * cos(phi + 2.0*M_PI/3.0);
+    real_t det_M = mxx * (myy*mzz - myz*myz) - 
+                   mxy * (mxy*mzz - myz*mxz) + 
+                   mxz * (mxy*myz - myy*mxz);
+
+    // Compute a weighting that articulates the importance of the second
+    // moment as a function of s.
+    real_t weight = MAX(0.0, MIN(1.0, 2.0/s[p] - 1.0));
+    bool use_M = ((weight > 0.0) && (det_M > 0.0) && (lambda_min > 0.0));
+
+    // Compute the normalized "psi" tensor, falling back to the identity 
+    // where it's degenerate.
+    real_t max_elem = MAX(mxx, MAX(mxy, MAX(mxz, MAX(myy, MAX(myz, mzz)))));
+    real_t c = use_M ? 1.0 / max_elem : 0.0;
+    real_t det_psi = c*c*c * det_M;
+    use_M = use_M && (det_psi >= 1e-10);
+    real_t pxx = use_M ? c*mxx : 1.0, pxy = use_M ? c*mxy : 0.0, 
+           pxz = use_M ? c*mxz : 0.0, pyy = use_M ? c*myy : 1.0, 
+           pyz = use_M ? c*myz : 0.0, pzz = use_M ? c*mzz : 1.0;
+    det_psi = use_M ? det_psi : 1.0;
+
+    // The new shape of H is the inverse of psi, computed from cofactors.
+    real_t f = scale[p] / det_psi;
+    new_H[XX][p] = f * (pyy*pzz - pyz*pyz);
+    new_H[XY][p] = f * (pxz*pyz - pxy*pzz);
+    new_H[XZ][p] = f * (pxy*pyz - pxz*pyy);
+    new_H[YY][p] = f * (pxx*pzz - pxz*pxz);
+    new_H[YZ][p] = f * (pxy*pxz - pxx*pyz);
+    new_H[ZZ][p] = f * (pxx*pyy - pxy*pxy);
+  }
+}
+
+void sph_H_updater_update_batch(sph_H_updater_t* updater, 
+                                int n,
+                                sym_tensor2_t* H, 
+                                real_t* zeroth_moments, 
+                                sym_tensor2_t* second_moments,
+                                sym_tensor2_t* new_H)
+{
+  real_t H_soa[6][H_BATCH_SIZE], M_soa[6][H_BATCH_SIZE], 
+         new_H_soa[6][H_BATCH_SIZE];
+  for (int p0 = 0; p0 < n; p0 += H_BATCH_SIZE)
+  {
+    int m = MIN(H_BATCH_SIZE, n - p0);
+
+    // Transpose the block into structure-of-arrays form.
+    for (int p = 0; p < m; ++p)
+    {
+      sym_tensor2_t* Hp = &H[p0+p];
+      sym_tensor2_t* Mp = &second_moments[p0+p];
+      H_soa[0][p] = Hp->xx; H_soa[1][p] = Hp->xy; H_soa[2][p] = Hp->xz;
+      H_soa[3][p] = Hp->yy; H_soa[4][p] = Hp->yz; H_soa[5][p] = Hp->zz;
+      M_soa[0][p] = Mp->xx; M_soa[1][p] = Mp->xy; M_soa[2][p] = Mp->xz;
+      M_soa[3][p] = Mp->yy; M_soa[4][p] = Mp->yz; M_soa[5][p] = Mp->zz;
+    }
+
+    update_block(updater, m, H_soa, &zeroth_moments[p0], M_soa, new_H_soa);
+
+    // Transpose the results back.
+    for (int p = 0; p < m; ++p)
+    {
+      sym_tensor2_t* Hp = &new_H[p0+p];
+      Hp->xx = new_H_soa[0][p]; Hp->xy = new_H_soa[1][p]; 
+      Hp->xz = new_H_soa[2][p]; Hp->yy = new_H_soa[3][p]; 
+      Hp->yz = new_H_soa[4][p]; Hp->zz = new_H_soa[5][p];
+    }
+  }
+}
+
+void sph_H_updater_set_max_iters(sph_H_updater_t* updater, int max_iters)
+{
+  ASSERT(max_iters > 0);
+  updater->max_iters = max_iters;
+}
+
+void sph_H_updater_set_frac_change(sph_H_updater_t* updater, 
+                                   real_t frac_change)
+{
+  ASSERT(frac_change > 0.0);
+  updater->frac_change = frac_change;
+}
+
+// Returns the square of the Frobenius norm of the symmetric tensor A.
+static inline real_t frobenius_norm2(sym_tensor2_t* A)
+{
+  return A->xx*A->xx + A->yy*A->yy + A->zz*A->zz + 
+         2.0 * (A->xy*A->xy + A->xz*A->xz + A->yz*A->yz);
+}
+
+// Computes the radius of the support of the kernel W with smoothing tensor H.
+static inline real_t support_radius(sph_kernel_t* W, sym_tensor2_t* H)
+{
+  real_t lambdas[3];
+  sym_tensor2_get_eigenvalues(H, lambdas);
+  real_t lambda_min = MIN(lambdas[0], MIN(lambdas[1], lambdas[2]));
+  ASSERT(lambda_min > 0.0);
+  return sph_kernel_extent(W) / lambda_min;
+}
+
+int sph_H_updater_iterate_cloud(sph_H_updater_t* updater,
+                                point_cloud_t* cloud,
+                                sph_neighbor_list_t* neighbors,
+                                exchanger_t* ex,
+                                sym_tensor2_t* H)
+{
+  START_FUNCTION_TIMER();
+  int num_owned = cloud->num_points;
+  int N = cloud->num_points + cloud->num_ghosts;
+  real_t frac_change2 = updater->frac_change * updater->frac_change;
+
+  bool* active = polymec_malloc(sizeof(bool) * N);
+  for (int i = 0; i < N; ++i)
+    active[i] = (i < num_owned);
+  sph_node_data_t* node_data = polymec_malloc(sizeof(sph_node_data_t) * N);
+  real_t* R = polymec_malloc(sizeof(real_t) * N);
+  int* indices = polymec_malloc(sizeof(int) * num_owned);
+  real_t* zeroth_moments = polymec_malloc(sizeof(real_t) * num_owned);
+  sym_tensor2_t* second_moments = polymec_malloc(sizeof(sym_tensor2_t) * num_owned);
+  sym_tensor2_t* old_H = polymec_malloc(sizeof(sym_tensor2_t) * num_owned);
+  sym_tensor2_t* new_H = polymec_malloc(sizeof(sym_tensor2_t) * num_owned);
+  neighbor_pairing_t* pairing = sph_neighbor_list_pairing(neighbors);
+  sph_pair_loop_t* loop = sph_pair_loop_new(updater->W, pairing, 1);
+
+  int iter = 0, num_active = num_owned;
+  while (iter < updater->max_iters)
+  {
+    // Visit only those pairs that involve an active point.
+    int_array_t* pairs = int_array_new();
+    int pos = 0, i, j;
+    while (neighbor_pairing_next(pairing, &pos, &i, &j, NULL))
+    {
+      if (active[i] || active[j])
+      {
+        int_array_append(pairs, i);
+        int_array_append(pairs, j);
+      }
+    }
+    neighbor_pairing_t* active_pairing = 
+      neighbor_pairing_new("Active SPH pairs", (int)(pairs->size/2), 
+                           pairs->data, NULL, exchanger_new(cloud->comm));
+    int_array_release_data_and_free(pairs);
+
+    // Compute the moments.
+    memset(node_data, 0, sizeof(sph_node_data_t) * N);
+    sph_pair_loop_set_pairing(loop, active_pairing);
+    sph_pair_loop_compute(loop, 0.0, cloud->points, H, NULL, NULL, node_data);
+    neighbor_pairing_free(active_pairing);
+
+    // Update H for the active points, gathering them into contiguous 
+    // arrays so that they can be updated in batches.
+    int num_updated = 0;
+    for (int i = 0; i < num_owned; ++i)
+    {
+      if (!active[i]) continue;
+      indices[num_updated] = i;
+      old_H[num_updated] = H[i];
+      zeroth_moments[num_updated] = node_data[i].zeroth_moment;
+      second_moments[num_updated] = node_data[i].second_moment;
+      ++num_updated;
+    }
+    num_active = 0;
+#pragma omp parallel for reduction(+:num_active)
+    for (int b = 0; b < num_updated; b += H_BATCH_SIZE)
+    {
+      int m = MIN(H_BATCH_SIZE, num_updated - b);
+      sph_H_updater_update_batch(updater, m, &old_H[b], &zeroth_moments[b],
+                                 &second_moments[b], &new_H[b]);
+      for (int k = b; k < b + m; ++k)
+      {
+        int i = indices[k];
+        sym_tensor2_t dH = {.xx = new_H[k].xx - old_H[k].xx, 
+                            .xy = new_H[k].xy - old_H[k].xy,
+                            .xz = new_H[k].xz - old_H[k].xz, 
+                            .yy = new_H[k].yy - old_H[k].yy,
+                            .yz = new_H[k].yz - old_H[k].yz, 
+                            .zz = new_H[k].zz - old_H[k].zz};
+        if (frobenius_norm2(&dH) < frac_change2 * frobenius_norm2(&old_H[k]))
+          active[i] = false;
+        else
+          ++num_active;
+        H[i] = new_H[k];
+      }
+    }
+    ++iter;
+
+    // Update ghost values of H and their activity (using R as scratch space).
+    if (ex != NULL)
+    {
+      exchanger_exchange(ex, H, 6, 0, MPI_REAL_T);
+      for (int i = 0; i < num_owned; ++i)
+        R[i] = active[i] ? 1.0 : 0.0;
+      exchanger_exchange(ex, R, 1, 0, MPI_REAL_T);
+      for (int i = num_owned; i < N; ++i)
+        active[i] = (R[i] != 0.0);
+    }
+
+    // Have all points everywhere converged?
+    int num_active_anywhere = num_active;
+    MPI_Allreduce(&num_active, &num_active_anywhere, 1, MPI_INT, MPI_SUM, 
+                  cloud->comm);
+    log_debug("sph_H_updater_iterate_cloud: iteration %d: %d active points.", 
+              iter, num_active_anywhere);
+    if (num_active_anywhere == 0)
+      break;
+
+    // Extend the neighbor search for points whose supports have grown.
+#pragma omp parallel for
+    for (int i = 0; i < N; ++i)
+      R[i] = support_radius(updater->W, &H[i]);
+    sph_neighbor_list_extend(neighbors, R);
+  }
+
+  // Make sure the neighbor list reflects the final values of H.
+  for (int i = 0; i < N; ++i)
+    R[i] = support_radius(updater->W, &H[i]);
+  sph_neighbor_list_extend(neighbors, R);
+  sph_neighbor_list_update(neighbors, R);
+
+  if (num_active > 0)
+  {
+    log_detail("sph_H_updater_iterate_cloud: %d points did not converge in "
+               "%d iterations.", num_active, iter);
+  }
+
+  sph_pair_loop_free(loop);
+  polymec_free(new_H);
+  polymec_free(old_H);
+  polymec_free(second_moments);
+  polymec_free(zeroth_moments);
+  polymec_free(indices);
+  polymec_free(R);
+  polymec_free(node_data);
+  polymec_free(active);
+  STOP_FUNCTION_TIMER();
+  return iter;
+}
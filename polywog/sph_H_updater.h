@@ -8,7 +8,9 @@
 #ifndef POLYWOG_SPH_H_UPDATER_H
 #define POLYWOG_SPH_H_UPDATER_H
 
+#include "core/exchanger.h"
 #include "polywog/sph_kernel.h"
+#include "polywog/sph_neighbor_list.h"
 
 // The SPH dynamics "H updater" is an object that computes the computes of 
 // the smoothing tensor field H by examining the neighborhoods surrounding 
@@ -41,4 +43,44 @@ void sph_H_updater_update(sph_H_updater_t* updater,
                           sym_tensor2_t* second_moment,
                           sym_tensor2_t* new_H);
 
+// Updates the values of H at n points at once, given arrays of their 
+// normalized zeroth moments and second moments, and placing the updated 
+// values in new_H. The tensors are transposed internally into 
+// structure-of-arrays blocks, and the anisotropic update uses a closed-form
+// (trigonometric) eigensolver and a cofactor inverse, so that each step 
+// is a single vectorizable sweep over a block. Results agree with those 
+// of sph_H_updater_update up to roundoff.
+void sph_H_updater_update_batch(sph_H_updater_t* updater, 
+                                int n,
+                                sym_tensor2_t* H, 
+                                real_t* zeroth_moments, 
+                                sym_tensor2_t* second_moments,
+                                sym_tensor2_t* new_H);
+
+// Sets the maximum number of iterations performed by 
+// sph_H_updater_iterate_cloud. By default, this is 100.
+void sph_H_updater_set_max_iters(sph_H_updater_t* updater, int max_iters);
+
+// Sets the fractional change in H below which a point is considered 
+// converged by sph_H_updater_iterate_cloud. By default, this is 0.05.
+void sph_H_updater_set_frac_change(sph_H_updater_t* updater, 
+                                   real_t frac_change);
+
+// Iterates on the smoothing tensors H for all points in the given cloud, 
+// alternating between a (threaded) computation of the moments of each point's 
+// neighborhood and an update of H for each locally-owned point. A point stops
+// iterating once its H changes by less than the updater's fractional change 
+// (measured in the Frobenius norm), and only pairs involving points that 
+// are still iterating are visited. The given neighbor list (which must be 
+// built on the same cloud) is extended only for those points whose supports 
+// have grown beyond its skin. If ex is non-NULL, it is used to exchange 
+// values of H for ghost points after each update. Iteration continues until
+// all points on all processes have converged, or until the maximum number 
+// of iterations has been reached. Returns the number of iterations performed.
+int sph_H_updater_iterate_cloud(sph_H_updater_t* updater,
+                                point_cloud_t* cloud,
+                                sph_neighbor_list_t* neighbors,
+                                exchanger_t* ex,
+                                sym_tensor2_t* H);
+
 #endif
@@ -0,0 +1,362 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "core/timer.h"
+#include "polywog/sph_block_integrator.h"
+
+struct sph_block_integrator_t
+{
+  sph_pair_loop_t* loop;
+  point_cloud_t* cloud;
+  sym_tensor2_t* H;
+  int num_comp, vel_offset, max_bins;
+  void* context;
+  real_t (*compute_dt)(void* context, real_t t, int i, real_t* Ui, real_t* dUidt);
+  void (*dtor)(void* context);
+  exchanger_t* ex;
+
+  // Time step bins and step start times for locally-owned points.
+  int* bins;
+  real_t* t_start;
+
+  // Time derivatives of the solution (valid if have_dUdt is true), 
+  // predicted solution, and work space, for all points.
+  bool have_dUdt;
+  real_t* dUdt;
+  real_t* U_pred;
+  real_t* work;
+  bool* active;
+
+  // The pairs involving locally-owned points, sorted in descending order of
+  // their levels (the largest bin of their locally-owned points), so that 
+  // the pairs whose level is at least b, which are those that involve the 
+  // points in bins b and above, are the first level_starts[b] of them. 
+  // These are built at the start of each top-level step, and rebuilt if a 
+  // point moves to a larger bin.
+  neighbor_pairing_t* active_pairing;
+  int* level_starts;
+
+  long num_evals;
+};
+
+sph_block_integrator_t* sph_block_integrator_new(sph_pair_loop_t* loop,
+                                                 point_cloud_t* cloud,
+                                                 sym_tensor2_t* H,
+                                                 int num_components,
+                                                 int velocity_offset,
+                                                 void* context,
+                                                 real_t (*compute_dt)(void* context, real_t t, int i, real_t* Ui, real_t* dUidt),
+                                                 void (*dtor)(void* context),
+                                                 int max_bins,
+                                                 exchanger_t* ex)
+{
+  ASSERT(num_components >= 3);
+  ASSERT(velocity_offset >= 0);
+  ASSERT(velocity_offset + 3 <= num_components);
+  ASSERT(compute_dt != NULL);
+  ASSERT(max_bins > 0);
+  ASSERT(max_bins < 31);
+
+  sph_block_integrator_t* integ = polymec_malloc(sizeof(sph_block_integrator_t));
+  integ->loop = loop;
+  integ->cloud = cloud;
+  integ->H = H;
+  integ->num_comp = num_components;
+  integ->vel_offset = velocity_offset;
+  integ->max_bins = max_bins;
+  integ->context = context;
+  integ->compute_dt = compute_dt;
+  integ->dtor = dtor;
+  integ->ex = ex;
+
+  int N = cloud->num_points + cloud->num_ghosts;
+  integ->bins = polymec_malloc(sizeof(int) * cloud->num_points);
+  memset(integ->bins, 0, sizeof(int) * cloud->num_points);
+  integ->t_start = polymec_malloc(sizeof(real_t) * cloud->num_points);
+  integ->have_dUdt = false;
+  integ->dUdt = polymec_malloc(sizeof(real_t) * num_components * N);
+  integ->U_pred = polymec_malloc(sizeof(real_t) * num_components * N);
+  integ->work = polymec_malloc(sizeof(real_t) * num_components * N);
+  integ->active = polymec_malloc(sizeof(bool) * N);
+  integ->active_pairing = NULL;
+  integ->level_starts = polymec_malloc(sizeof(int) * (max_bins + 1));
+  integ->num_evals = 0;
+  return integ;
+}
+
+void sph_block_integrator_free(sph_block_integrator_t* integ)
+{
+  if ((integ->dtor != NULL) && (integ->context != NULL))
+    integ->dtor(integ->context);
+  polymec_free(integ->level_starts);
+  polymec_free(integ->active);
+  polymec_free(integ->work);
+  polymec_free(integ->U_pred);
+  polymec_free(integ->dUdt);
+  polymec_free(integ->t_start);
+  polymec_free(integ->bins);
+  polymec_free(integ);
+}
+
+void sph_block_integrator_reset(sph_block_integrator_t* integ)
+{
+  integ->have_dUdt = false;
+}
+
+int* sph_block_integrator_bins(sph_block_integrator_t* integ)
+{
+  return integ->bins;
+}
+
+long sph_block_integrator_num_evaluations(sph_block_integrator_t* integ)
+{
+  return integ->num_evals;
+}
+
+// Returns the bin for a point with the given stable time step, within a 
+// top-level step of size max_dt.
+static int bin_for_dt(sph_block_integrator_t* integ, real_t max_dt, real_t dt)
+{
+  if (dt >= max_dt)
+    return 0;
+  int bin = (dt > 0.0) ? (int)ceil(log2(max_dt / dt)) : integ->max_bins - 1;
+  return MIN(bin, integ->max_bins - 1);
+}
+
+// Brings the positions of ghost points and the given ghost solution data 
+// up to date.
+static void exchange_ghosts(sph_block_integrator_t* integ, real_t* U)
+{
+  if (integ->ex != NULL)
+  {
+    exchanger_exchange(integ->ex, integ->cloud->points, 3, 0, MPI_REAL_T);
+    exchanger_exchange(integ->ex, U, integ->num_comp, 0, MPI_REAL_T);
+  }
+}
+
+// Sorts the pairs in the given pairing that involve locally-owned points by 
+// their levels, storing them in integ->active_pairing, and traverses them 
+// with the integrator's pair loop.
+static void build_active_pairs(sph_block_integrator_t* integ,
+                               neighbor_pairing_t* pairing)
+{
+  START_FUNCTION_TIMER();
+  int num_owned = integ->cloud->num_points;
+  int num_levels = integ->max_bins;
+  int* bins = integ->bins;
+
+  // Count the pairs in each level, and find where each level starts.
+  int* level_starts = integ->level_starts;
+  memset(level_starts, 0, sizeof(int) * (num_levels + 1));
+  int pos = 0, i, j;
+  while (neighbor_pairing_next(pairing, &pos, &i, &j, NULL))
+  {
+    int level = MAX((i < num_owned) ? bins[i] : -1, (j < num_owned) ? bins[j] : -1);
+    if (level >= 0)
+      ++level_starts[level];
+  }
+  for (int b = num_levels - 1; b >= 0; --b)
+    level_starts[b] += level_starts[b+1];
+
+  // Place the pairs in descending order of level.
+  int num_pairs = level_starts[0];
+  int* pairs = polymec_malloc(sizeof(int) * 2 * MAX(num_pairs, 1));
+  int next[num_levels];
+  for (int b = 0; b < num_levels; ++b)
+    next[b] = level_starts[b+1];
+  pos = 0;
+  while (neighbor_pairing_next(pairing, &pos, &i, &j, NULL))
+  {
+    int level = MAX((i < num_owned) ? bins[i] : -1, (j < num_owned) ? bins[j] : -1);
+    if (level >= 0)
+    {
+      int p = next[level]++;
+      pairs[2*p] = i;
+      pairs[2*p+1] = j;
+    }
+  }
+
+  if (integ->active_pairing != NULL)
+    neighbor_pairing_free(integ->active_pairing);
+  integ->active_pairing = neighbor_pairing_new("Active SPH pairs", num_pairs, 
+                                               pairs, NULL, 
+                                               exchanger_new(integ->cloud->comm));
+  sph_pair_loop_set_pairing(integ->loop, integ->active_pairing);
+  STOP_FUNCTION_TIMER();
+}
+
+// Evaluates the time derivatives of the active points at time t using the 
+// given solution, placing them in integ->dUdt. The pair loop must be 
+// traversing (at least) all of the pairs involving active locally-owned 
+// points.
+static void evaluate_active(sph_block_integrator_t* integ, real_t t, real_t* U)
+{
+  START_FUNCTION_TIMER();
+  int num_owned = integ->cloud->num_points;
+  int N = num_owned + integ->cloud->num_ghosts;
+  int nc = integ->num_comp;
+  bool* active = integ->active;
+
+  memset(integ->work, 0, sizeof(real_t) * nc * N);
+  sph_pair_loop_compute(integ->loop, t, integ->cloud->points, integ->H, 
+                        U, integ->work, NULL);
+
+  // The derivatives of inactive points are incomplete, so we only keep 
+  // those of the active ones.
+  int num_active = 0;
+  for (int i = 0; i < num_owned; ++i)
+  {
+    if (!active[i]) continue;
+    memcpy(&integ->dUdt[nc*i], &integ->work[nc*i], sizeof(real_t) * nc);
+    ++num_active;
+  }
+  integ->num_evals += num_active;
+  STOP_FUNCTION_TIMER();
+}
+
+real_t sph_block_integrator_step(sph_block_integrator_t* integ, 
+                                 real_t max_dt,
+                                 real_t t, 
+                                 real_t* U)
+{
+  ASSERT(max_dt > 0.0);
+  START_FUNCTION_TIMER();
+  point_cloud_t* cloud = integ->cloud;
+  int num_owned = cloud->num_points;
+  int N = num_owned + cloud->num_ghosts;
+  int nc = integ->num_comp, v = integ->vel_offset;
+  real_t* dUdt = integ->dUdt;
+  bool* active = integ->active;
+  neighbor_pairing_t* pairing = sph_pair_loop_pairing(integ->loop);
+
+  // Make sure we have time derivatives for all points.
+  if (!integ->have_dUdt)
+  {
+    exchange_ghosts(integ, U);
+    for (int i = 0; i < N; ++i)
+      active[i] = (i < num_owned);
+    evaluate_active(integ, t, U);
+    integ->have_dUdt = true;
+  }
+
+  // Assign each point to a bin. This is the only place where all 
+  // processes synchronize. We count the points whose stable time steps are 
+  // smaller than those of the bins they are assigned to.
+  int max_bin = 0, num_unstable = 0;
+  real_t smallest_dt = max_dt / (1 << (integ->max_bins - 1));
+  for (int i = 0; i < num_owned; ++i)
+  {
+    real_t dt = integ->compute_dt(integ->context, t, i, &U[nc*i], &dUdt[nc*i]);
+    integ->bins[i] = bin_for_dt(integ, max_dt, dt);
+    max_bin = MAX(max_bin, integ->bins[i]);
+    if (dt < smallest_dt)
+      ++num_unstable;
+  }
+  int global_max_bin = max_bin;
+  MPI_Allreduce(&max_bin, &global_max_bin, 1, MPI_INT, MPI_MAX, cloud->comm);
+  max_bin = global_max_bin;
+  int num_substeps = 1 << max_bin;
+  real_t dt_min = max_dt / num_substeps;
+  log_debug("sph_block_integrator_step: %d bins, %d sub-steps.", 
+            max_bin + 1, num_substeps);
+  build_active_pairs(integ, pairing);
+
+  for (int k = 0; k < num_substeps; ++k)
+  {
+    // Points that start their steps get their first half kick.
+    for (int i = 0; i < num_owned; ++i)
+    {
+      int stride = 1 << (max_bin - integ->bins[i]);
+      if ((k % stride) == 0)
+      {
+        real_t half_dt = 0.5 * stride * dt_min;
+        integ->t_start[i] = t + k * dt_min;
+        for (int c = 0; c < nc; ++c)
+          U[nc*i+c] += half_dt * dUdt[nc*i+c];
+      }
+    }
+
+    // All points drift with their (half-kicked) velocities.
+    for (int i = 0; i < num_owned; ++i)
+    {
+      cloud->points[i].x += dt_min * U[nc*i+v];
+      cloud->points[i].y += dt_min * U[nc*i+v+1];
+      cloud->points[i].z += dt_min * U[nc*i+v+2];
+    }
+
+    // Find the points that finish their steps at the end of this sub-step,
+    // and predict the states of all points there.
+    int k1 = k + 1;
+    real_t t1 = t + k1 * dt_min;
+    for (int i = 0; i < num_owned; ++i)
+    {
+      int stride = 1 << (max_bin - integ->bins[i]);
+      active[i] = ((k1 % stride) == 0);
+      real_t dt_pred = t1 - integ->t_start[i] - 0.5 * stride * dt_min;
+      for (int c = 0; c < nc; ++c)
+        integ->U_pred[nc*i+c] = U[nc*i+c] + dt_pred * dUdt[nc*i+c];
+    }
+    for (int i = num_owned; i < N; ++i)
+      active[i] = false;
+    exchange_ghosts(integ, integ->U_pred);
+
+    // The active points are those in bins max_bin - z and above, where z is
+    // the number of trailing zero bits in k1. Evaluate the pairs involving 
+    // them and give them their second half kick.
+    int first_bin = max_bin;
+    for (int m = k1; (first_bin > 0) && ((m % 2) == 0); m /= 2)
+      --first_bin;
+    integ->active_pairing->num_pairs = integ->level_starts[first_bin];
+    evaluate_active(integ, t1, integ->U_pred);
+    bool rebuild = false;
+    for (int i = 0; i < num_owned; ++i)
+    {
+      if (!active[i]) continue;
+      int stride = 1 << (max_bin - integ->bins[i]);
+      real_t half_dt = 0.5 * stride * dt_min;
+      for (int c = 0; c < nc; ++c)
+        U[nc*i+c] += half_dt * dUdt[nc*i+c];
+
+      // Move the point to a new bin if it needs one. It can only move to 
+      // a larger time step if its new step begins at a multiple of that 
+      // step.
+      if (k1 < num_substeps)
+      {
+        real_t dt = integ->compute_dt(integ->context, t1, i, &U[nc*i], &dUdt[nc*i]);
+        int bin = MIN(bin_for_dt(integ, max_dt, dt), max_bin);
+        if (dt < dt_min)
+          ++num_unstable;
+        while ((k1 % (1 << (max_bin - bin))) != 0)
+          ++bin;
+
+        // A point moving to a larger bin raises the levels of its pairs. 
+        // (One moving to a smaller bin lowers them, which only means that 
+        // some of its pairs may be visited needlessly.)
+        if (bin > integ->bins[i])
+          rebuild = true;
+        integ->bins[i] = bin;
+      }
+    }
+    if (rebuild)
+      build_active_pairs(integ, pairing);
+  }
+
+  if (num_unstable > 0)
+  {
+    log_urgent("sph_block_integrator_step: %d points took steps larger than "
+               "their stable time steps.", num_unstable);
+  }
+
+  // Restore the loop's own pairing.
+  sph_pair_loop_set_pairing(integ->loop, pairing);
+  neighbor_pairing_free(integ->active_pairing);
+  integ->active_pairing = NULL;
+  exchange_ghosts(integ, U);
+  STOP_FUNCTION_TIMER();
+  return t + max_dt;
+}
+
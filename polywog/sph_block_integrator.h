@@ -0,0 +1,80 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef POLYWOG_SPH_BLOCK_INTEGRATOR_H
+#define POLYWOG_SPH_BLOCK_INTEGRATOR_H
+
+#include "core/point_cloud.h"
+#include "core/exchanger.h"
+#include "polywog/sph_pair_loop.h"
+
+// The SPH block integrator advances an SPH solution in time using a 
+// kick-drift-kick (leapfrog) scheme with individual ("block") time steps. 
+// Within a top-level step of size dt_max, each particle is assigned to a 
+// time step bin b, in which it takes steps of size dt_max / 2^b. At each 
+// sub-step, only the interactions of the particles that finish their steps 
+// are evaluated, using predicted states for their neighbors that are in the 
+// middle of theirs. Global communication occurs only at the beginning of 
+// each top-level step.
+typedef struct sph_block_integrator_t sph_block_integrator_t;
+
+// Creates a block integrator that evaluates time derivatives using the given
+// pair loop (whose dynamics and pairing must already be set) for the points 
+// in the given cloud with smoothing tensors H, and a solution with the given
+// number of components per point. The three components of each point's 
+// solution starting at velocity_offset are its velocity, which is used to 
+// move the points in the cloud. The compute_dt function returns the largest 
+// stable time step for the point i given its solution Ui and its time 
+// derivative dUidt at time t. Particles are assigned to at most max_bins 
+// bins. If ex is non-NULL, it is used to exchange positions and solution 
+// data for ghost points. The integrator does not assert ownership over the 
+// pair loop, the cloud, H, or ex.
+sph_block_integrator_t* sph_block_integrator_new(sph_pair_loop_t* loop,
+                                                 point_cloud_t* cloud,
+                                                 sym_tensor2_t* H,
+                                                 int num_components,
+                                                 int velocity_offset,
+                                                 void* context,
+                                                 real_t (*compute_dt)(void* context, real_t t, int i, real_t* Ui, real_t* dUidt),
+                                                 void (*dtor)(void* context),
+                                                 int max_bins,
+                                                 exchanger_t* ex);
+
+// Destroys the given block integrator.
+void sph_block_integrator_free(sph_block_integrator_t* integ);
+
+// Advances the solution U (and the positions of the points in the 
+// integrator's cloud) from time t by a top-level step of size max_dt, 
+// returning the new time. The smallest sub-step within the top-level step 
+// is fixed when the step begins, by the smallest stable time step of any 
+// point at that time (but it is never smaller than max_dt / 2^(max_bins-1)).
+// A point whose stable time step falls below the smallest sub-step during 
+// the top-level step keeps taking the smallest sub-step, which is unstable
+// for it. Such points are counted and reported with a warning in the log. 
+// If this happens, max_dt should be reduced.
+real_t sph_block_integrator_step(sph_block_integrator_t* integ, 
+                                 real_t max_dt,
+                                 real_t t, 
+                                 real_t* U);
+
+// Tells the integrator that the solution or the positions of the points 
+// have been changed outside of the integrator, so that their time 
+// derivatives must be recomputed before the next step.
+void sph_block_integrator_reset(sph_block_integrator_t* integ);
+
+// Returns an internal pointer to the array of time step bins for the 
+// locally-owned points, as assigned during the last step.
+int* sph_block_integrator_bins(sph_block_integrator_t* integ);
+
+// Returns the number of point evaluations (the number of times the time 
+// derivative of any one point has been computed) performed by the 
+// integrator so far. For a simulation with uniform time steps, this grows 
+// by the number of points in each step.
+long sph_block_integrator_num_evaluations(sph_block_integrator_t* integ);
+
+#endif
+
@@ -18,6 +18,12 @@ struct sph_dynamics_t
                   vector_t* grad_Wi, vector_t* grad_Wj,
                   real_t* dUidt, real_t* dUjdt,
                   sph_node_data_t* node_data);
+  void (*compute_batch)(void* context, real_t t,
+                        sph_pair_block_t* block,
+                        int num_components,
+                        real_t* U,
+                        real_t* dUidt, real_t* dUjdt,
+                        sph_node_data_t* node_data);
   void (*dtor)(void* context);
 };
 
@@ -37,6 +43,7 @@ sph_dynamics_t* sph_dynamics_new(const char* name,
   dyn->name = string_dup(name);
   dyn->context = context;
   dyn->compute = compute;
+  dyn->compute_batch = NULL;
   dyn->dtor = dtor;
   return dyn;
 }
@@ -60,3 +67,61 @@ void sph_dynamics_compute(sph_dynamics_t* dyn, real_t t,
   dyn->compute(dyn->context, t, i, j, Ui, Uj, Wi, Wj, grad_Wi, grad_Wj, dUidt, dUjdt, node_data);
 }
 
+void sph_dynamics_set_batch_compute(sph_dynamics_t* dyn,
+                                    void (*compute_batch)(void* context, real_t t,
+                                                          sph_pair_block_t* block,
+                                                          int num_components,
+                                                          real_t* U,
+                                                          real_t* dUidt, real_t* dUjdt,
+                                                          sph_node_data_t* node_data))
+{
+  dyn->compute_batch = compute_batch;
+}
+
+bool sph_dynamics_has_batch_compute(sph_dynamics_t* dyn)
+{
+  return (dyn->compute_batch != NULL);
+}
+
+void sph_dynamics_compute_batch(sph_dynamics_t* dyn, real_t t,
+                                sph_pair_block_t* block,
+                                int num_components,
+                                real_t* U,
+                                real_t* dUidt, real_t* dUjdt,
+                                sph_node_data_t* node_data)
+{
+  ASSERT(block->num_pairs <= SPH_PAIR_BLOCK_MAX_SIZE);
+  if (dyn->compute_batch != NULL)
+  {
+    dyn->compute_batch(dyn->context, t, block, num_components, U, 
+                       dUidt, dUjdt, node_data);
+  }
+  else
+  {
+    // Fall back to the scalar compute function, scattering its results 
+    // into the component-major arrays.
+    int nc = num_components;
+    real_t dUi[nc], dUj[nc];
+    for (int p = 0; p < block->num_pairs; ++p)
+    {
+      int i = block->i[p], j = block->j[p];
+      vector_t grad_Wi = {.x = block->grad_Wi_x[p], 
+                          .y = block->grad_Wi_y[p],
+                          .z = block->grad_Wi_z[p]};
+      vector_t grad_Wj = {.x = block->grad_Wj_x[p], 
+                          .y = block->grad_Wj_y[p],
+                          .z = block->grad_Wj_z[p]};
+      memset(dUi, 0, sizeof(real_t) * nc);
+      memset(dUj, 0, sizeof(real_t) * nc);
+      dyn->compute(dyn->context, t, i, j, &U[nc*i], &U[nc*j], 
+                   block->Wi[p], block->Wj[p], &grad_Wi, &grad_Wj, 
+                   dUi, dUj, node_data);
+      for (int c = 0; c < nc; ++c)
+      {
+        dUidt[SPH_PAIR_BLOCK_MAX_SIZE*c+p] = dUi[c];
+        dUjdt[SPH_PAIR_BLOCK_MAX_SIZE*c+p] = dUj[c];
+      }
+    }
+  }
+}
+
@@ -48,4 +48,64 @@ void sph_dynamics_compute(sph_dynamics_t* dyn, real_t t,
                           real_t* dUidt, real_t* dUjdt,
                           sph_node_data_t* node_data);
 
+// This is the maximum number of pairs in a block of pairs handed to the 
+// batch compute function of an SPH dynamics object.
+#define SPH_PAIR_BLOCK_MAX_SIZE 16
+
+// A block of pairs holds the data needed to evaluate the interactions of 
+// several pairs (i, j) at once, in structure-of-arrays form. Only the first 
+// num_pairs entries of each array are meaningful.
+typedef struct
+{
+  int num_pairs;
+
+  // Indices of the points in each pair.
+  int i[SPH_PAIR_BLOCK_MAX_SIZE], j[SPH_PAIR_BLOCK_MAX_SIZE];
+
+  // Values of the SPH kernel computed with H_i and H_j.
+  real_t Wi[SPH_PAIR_BLOCK_MAX_SIZE], Wj[SPH_PAIR_BLOCK_MAX_SIZE];
+
+  // Components of the gradients of the SPH kernel computed with H_i and H_j.
+  real_t grad_Wi_x[SPH_PAIR_BLOCK_MAX_SIZE], 
+         grad_Wi_y[SPH_PAIR_BLOCK_MAX_SIZE], 
+         grad_Wi_z[SPH_PAIR_BLOCK_MAX_SIZE];
+  real_t grad_Wj_x[SPH_PAIR_BLOCK_MAX_SIZE], 
+         grad_Wj_y[SPH_PAIR_BLOCK_MAX_SIZE], 
+         grad_Wj_z[SPH_PAIR_BLOCK_MAX_SIZE];
+} sph_pair_block_t;
+
+// Gives the SPH dynamics object a function that computes the contributions 
+// of a whole block of pairs at once, given the time t, the solution U for 
+// all points (in point-major order with num_components components), and the 
+// block of pair data. The contributions to the time derivatives for i and j 
+// are placed in dUidt and dUjdt, which are stored in component-major order:
+// the contribution to component c for the pth pair in the block is stored 
+// in dUidt[SPH_PAIR_BLOCK_MAX_SIZE*c + p]. These arrays are zeroed before 
+// the function is called. node_data has the same meaning as it does in the 
+// scalar compute function. The scalar compute function is used if no batch 
+// compute function is given.
+void sph_dynamics_set_batch_compute(sph_dynamics_t* dyn,
+                                    void (*compute_batch)(void* context, real_t t,
+                                                          sph_pair_block_t* block,
+                                                          int num_components,
+                                                          real_t* U,
+                                                          real_t* dUidt, real_t* dUjdt,
+                                                          sph_node_data_t* node_data));
+
+// Returns true if the given SPH dynamics object has a batch compute function, 
+// false if not.
+bool sph_dynamics_has_batch_compute(sph_dynamics_t* dyn);
+
+// Computes the contributions of the given block of pairs to the time 
+// derivatives of the solution U (with num_components components) at time t, 
+// placing them in the component-major arrays dUidt and dUjdt as described 
+// for sph_dynamics_set_batch_compute. If the dynamics object has no batch 
+// compute function, its scalar compute function is called for each pair.
+void sph_dynamics_compute_batch(sph_dynamics_t* dyn, real_t t,
+                                sph_pair_block_t* block,
+                                int num_components,
+                                real_t* U,
+                                real_t* dUidt, real_t* dUjdt,
+                                sph_node_data_t* node_data);
+
 #endif
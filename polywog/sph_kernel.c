@@ -15,6 +15,21 @@ struct sph_kernel_t
   void* context;
   void (*compute)(void* context, real_t eta, real_t det_H, real_t* W, real_t* dWdeta);
   void (*dtor)(void* context);
+
+  // Kernel type, dimension, and normalization (for inlined evaluation).
+  sph_kernel_type_t type;
+  int dim;
+  real_t sigma;
+
+  // Optional functions that evaluate W and (dW/d|eta|)/|eta| given |eta|^2, 
+  // one point at a time or in batches.
+  void (*compute_eta2)(void* context, real_t eta2, real_t det_H, real_t* W, real_t* dWdeta_over_eta);
+  void (*compute_eta2_batch)(void* context, int n, real_t* eta2, real_t* det_H, real_t* W, real_t* dWdeta_over_eta);
+
+  // Cached lattice sums for 1, 2, and 3 dimensions, indexed by the number 
+  // of lattice steps (NAN where not yet computed).
+  int num_sums[3];
+  real_t* sums[3];
 };
 
 static void sph_kernel_free(void* ctx, void* dummy)
@@ -22,6 +37,11 @@ static void sph_kernel_free(void* ctx, void* dummy)
   sph_kernel_t* kernel = ctx;
   if ((kernel->dtor != NULL) && (kernel->context != NULL))
     kernel->dtor(kernel->context);
+  for (int d = 0; d < 3; ++d)
+  {
+    if (kernel->sums[d] != NULL)
+      polymec_free(kernel->sums[d]);
+  }
   string_free(kernel->name);
 }
 
@@ -39,6 +59,16 @@ sph_kernel_t* sph_kernel_new(const char* name,
   kernel->context = context;
   kernel->compute = compute;
   kernel->dtor = dtor;
+  kernel->type = SPH_KERNEL_GENERIC;
+  kernel->dim = 3;
+  kernel->sigma = 1.0;
+  kernel->compute_eta2 = NULL;
+  kernel->compute_eta2_batch = NULL;
+  for (int d = 0; d < 3; ++d)
+  {
+    kernel->num_sums[d] = 0;
+    kernel->sums[d] = NULL;
+  }
   GC_register_finalizer(kernel, sph_kernel_free, kernel, NULL, NULL);
   return kernel;
 }
@@ -53,11 +83,80 @@ real_t sph_kernel_extent(sph_kernel_t* kernel)
   return kernel->extent;
 }
 
+sph_kernel_type_t sph_kernel_type(sph_kernel_t* kernel)
+{
+  return kernel->type;
+}
+
+int sph_kernel_dimension(sph_kernel_t* kernel)
+{
+  return kernel->dim;
+}
+
+real_t sph_kernel_normalization(sph_kernel_t* kernel)
+{
+  return kernel->sigma;
+}
+
+bool sph_kernel_has_eta2_compute(sph_kernel_t* kernel)
+{
+  return (kernel->compute_eta2 != NULL);
+}
+
+void sph_kernel_compute_eta2_batch(sph_kernel_t* kernel, 
+                                   int n, 
+                                   real_t* eta2, 
+                                   real_t* det_H, 
+                                   real_t* W, 
+                                   real_t* dWdeta_over_eta)
+{
+  if (kernel->compute_eta2_batch != NULL)
+    kernel->compute_eta2_batch(kernel->context, n, eta2, det_H, W, dWdeta_over_eta);
+  else
+  {
+    for (int p = 0; p < n; ++p)
+    {
+      real_t eta_mag = sqrt(eta2[p]), dWdeta;
+      if (eta_mag <= kernel->extent)
+      {
+        kernel->compute(kernel->context, eta_mag, det_H[p], &W[p], &dWdeta);
+        dWdeta_over_eta[p] = (eta_mag > 0.0) ? dWdeta / eta_mag : 0.0;
+      }
+      else
+        W[p] = dWdeta_over_eta[p] = 0.0;
+    }
+  }
+}
+
+// Computes W and grad W = H o (eta * (dW/d|eta|)/|eta|) using the kernel's 
+// |eta|^2 compute function, which needs no square roots.
+static inline void compute_eta2(sph_kernel_t* kernel, vector_t* eta, sym_tensor2_t* H, real_t det_H, real_t* W, vector_t* grad_W)
+{
+  real_t eta2 = vector_dot(eta, eta);
+  if (eta2 <= kernel->extent * kernel->extent)
+  {
+    real_t dWe;
+    kernel->compute_eta2(kernel->context, eta2, det_H, W, &dWe);
+    vector_t w = {.x = eta->x * dWe, .y = eta->y * dWe, .z = eta->z * dWe};
+    sym_tensor2_dot_vector(H, &w, grad_W);
+  }
+  else
+  {
+    *W = 0.0;
+    grad_W->x = grad_W->y = grad_W->z = 0.0;
+  }
+}
+
 void sph_kernel_compute(sph_kernel_t* kernel, vector_t* x, sym_tensor2_t* H, real_t* W, vector_t* grad_W)
 {
   // Compute eta = H o x.
   vector_t eta;
   sym_tensor2_dot_vector(H, x, &eta);
+  if (kernel->compute_eta2 != NULL)
+  {
+    compute_eta2(kernel, &eta, H, sym_tensor2_det(H), W, grad_W);
+    return;
+  }
   real_t eta_mag = vector_mag(&eta);
 
   if (eta_mag <= kernel->extent)
@@ -67,11 +166,17 @@ void sph_kernel_compute(sph_kernel_t* kernel, vector_t* x, sym_tensor2_t* H, rea
     real_t dWdeta; 
     kernel->compute(kernel->context, eta_mag, det_H, W, &dWdeta);
 
-    // Compute grad W.
-    vector_t w = {.x = eta.x * dWdeta / eta_mag, 
-                  .y = eta.y * dWdeta / eta_mag,
-                  .z = eta.z * dWdeta / eta_mag};
-    sym_tensor2_dot_vector(H, &w, grad_W);
+    // Compute grad W. Coincident points have no well-defined direction, 
+    // and the gradient vanishes there for smooth kernels.
+    if (eta_mag > 0.0)
+    {
+      vector_t w = {.x = eta.x * dWdeta / eta_mag, 
+                    .y = eta.y * dWdeta / eta_mag,
+                    .z = eta.z * dWdeta / eta_mag};
+      sym_tensor2_dot_vector(H, &w, grad_W);
+    }
+    else
+      grad_W->x = grad_W->y = grad_W->z = 0.0;
   }
   else
   {
@@ -80,66 +185,268 @@ void sph_kernel_compute(sph_kernel_t* kernel, vector_t* x, sym_tensor2_t* H, rea
   }
 }
 
-real_t sph_kernel_sum(sph_kernel_t* kernel, real_t n_per_h)
+void sph_H_data_compute(sym_tensor2_t* H, sph_H_data_t* H_data)
 {
-  ASSERT(n_per_h >= 0.0);
-
-  // Self contribution.
-  real_t sum, dWdeta;
-  kernel->compute(kernel->context, 0.0, 1.0, &sum, &dWdeta);
+  H_data->isotropic = ((H->xy == 0.0) && (H->xz == 0.0) && (H->yz == 0.0) &&
+                       (H->xx == H->yy) && (H->xx == H->zz));
+  if (H_data->isotropic)
+  {
+    H_data->h_inv = H->xx;
+    H_data->det_H = H->xx * H->xx * H->xx;
+  }
+  else
+  {
+    H_data->h_inv = 0.0;
+    H_data->det_H = sym_tensor2_det(H);
+  }
+}
 
-  // Neighbors.
-  if (n_per_h > 0.0)
+void sph_kernel_compute_with_H_data(sph_kernel_t* kernel, vector_t* x, sym_tensor2_t* H, sph_H_data_t* H_data, real_t* W, vector_t* grad_W)
+{
+  if (!H_data->isotropic)
   {
-    int n_steps = (int)round(kernel->extent * n_per_h);
+    // Anisotropic H: we still need H o x, but we can reuse det(H).
     vector_t eta;
-    real_t deta = 1.0 / n_steps;
-    for (int i = 0; i <= n_steps; ++i)
+    sym_tensor2_dot_vector(H, x, &eta);
+    if (kernel->compute_eta2 != NULL)
+    {
+      compute_eta2(kernel, &eta, H, H_data->det_H, W, grad_W);
+      return;
+    }
+    real_t eta_mag = vector_mag(&eta);
+    if (eta_mag <= kernel->extent)
     {
-      eta.x = i * deta;
-      for (int j = 0; j <= n_steps; ++j)
+      real_t dWdeta; 
+      kernel->compute(kernel->context, eta_mag, H_data->det_H, W, &dWdeta);
+      if (eta_mag > 0.0)
       {
-        eta.y = j * deta;
-        for (int k = 0; k <= n_steps; ++k)
-        {
-          if ((i == 0) && (j == 0) && (k == 0)) 
-            continue;
-          eta.z = k * deta;
-          real_t eta_mag = vector_mag(&eta);
-          real_t W, dW;
-          kernel->compute(kernel->context, eta_mag, 1.0, &W, &dW);
-          sum += 2.0 * W;
-        }
+        vector_t w = {.x = eta.x * dWdeta / eta_mag, 
+                      .y = eta.y * dWdeta / eta_mag,
+                      .z = eta.z * dWdeta / eta_mag};
+        sym_tensor2_dot_vector(H, &w, grad_W);
       }
+      else
+        grad_W->x = grad_W->y = grad_W->z = 0.0;
     }
+    else
+    {
+      *W = 0.0;
+      grad_W->x = grad_W->y = grad_W->z = 0.0;
+    }
+    return;
   }
 
-  return sum;
+  // Isotropic H: eta = x/h, and grad W = (dW/deta) * eta / (|eta| * h).
+  real_t h_inv = H_data->h_inv;
+  if (kernel->compute_eta2 != NULL)
+  {
+    real_t eta2 = h_inv * h_inv * vector_dot(x, x);
+    if (eta2 <= kernel->extent * kernel->extent)
+    {
+      real_t dWe;
+      kernel->compute_eta2(kernel->context, eta2, H_data->det_H, W, &dWe);
+      real_t factor = h_inv * h_inv * dWe;
+      grad_W->x = factor * x->x;
+      grad_W->y = factor * x->y;
+      grad_W->z = factor * x->z;
+    }
+    else
+    {
+      *W = 0.0;
+      grad_W->x = grad_W->y = grad_W->z = 0.0;
+    }
+    return;
+  }
+  real_t eta_mag = h_inv * vector_mag(x);
+  if (eta_mag <= kernel->extent)
+  {
+    real_t dWdeta; 
+    kernel->compute(kernel->context, eta_mag, H_data->det_H, W, &dWdeta);
+    if (eta_mag > 0.0)
+    {
+      real_t factor = h_inv * h_inv * dWdeta / eta_mag;
+      grad_W->x = factor * x->x;
+      grad_W->y = factor * x->y;
+      grad_W->z = factor * x->z;
+    }
+    else
+      grad_W->x = grad_W->y = grad_W->z = 0.0;
+  }
+  else
+  {
+    *W = 0.0;
+    grad_W->x = grad_W->y = grad_W->z = 0.0;
+  }
+}
+
+// Computes the number of sites in the lattice [0, n]^dim with each squared 
+// (integer) distance m from the origin, for 0 <= m <= dim * n * n. We build 
+// this up one dimension at a time by convolving with the squares in [0, n].
+static int* lattice_shell_counts(int dim, int n)
+{
+  int max_m = dim * n * n;
+  int* counts = polymec_malloc(sizeof(int) * (max_m + 1));
+  int* work = polymec_malloc(sizeof(int) * (max_m + 1));
+  memset(counts, 0, sizeof(int) * (max_m + 1));
+  for (int i = 0; i <= n; ++i)
+    counts[i*i] = 1;
+  for (int d = 1; d < dim; ++d)
+  {
+    int prev_max_m = d * n * n;
+    memset(work, 0, sizeof(int) * (max_m + 1));
+    for (int m = 0; m <= prev_max_m; ++m)
+    {
+      if (counts[m] == 0) continue;
+      for (int i = 0; i <= n; ++i)
+        work[m + i*i] += counts[m];
+    }
+    memcpy(counts, work, sizeof(int) * (max_m + 1));
+  }
+  polymec_free(work);
+  return counts;
 }
 
-static void b_spline_compute(void* context, real_t eta_mag, real_t det_H, real_t* W, real_t* dWdeta)
+// Sums the kernel over the sites eta = (i, j, k) / n, 0 <= i, j, k <= n, 
+// in the given number of dimensions, counting each site other than the 
+// origin twice. Since the kernel depends only on |eta|, we evaluate it 
+// once per distinct radius.
+static real_t lattice_sum(sph_kernel_t* kernel, int dim, int n)
 {
-  if (eta_mag <= 1.0)
+  real_t sum, dWdeta;
+  kernel->compute(kernel->context, 0.0, 1.0, &sum, &dWdeta);
+  if (n == 0)
+    return sum;
+
+  int* counts = lattice_shell_counts(dim, n);
+  real_t deta = 1.0 / n;
+  for (int m = 1; m <= dim * n * n; ++m)
   {
-    real_t eta2 = eta_mag * eta_mag;
-    *W = (1.0 - 1.5*eta2 + 0.75*eta2*eta_mag) / M_PI;
-    *dWdeta = (-1.5 + 2.25*eta2) / M_PI;
+    if (counts[m] == 0) continue;
+    real_t eta_mag = sqrt((real_t)m) * deta;
+    if (eta_mag > kernel->extent) break;
+    real_t W, dW;
+    kernel->compute(kernel->context, eta_mag, 1.0, &W, &dW);
+    sum += 2.0 * counts[m] * W;
   }
-  else if (eta_mag <= 2.0)
+  polymec_free(counts);
+  return sum;
+}
+
+// Returns the lattice sum for the given dimension and n_per_h, computing it
+// only if it isn't already in the kernel's cache.
+static real_t cached_lattice_sum(sph_kernel_t* kernel, int dim, real_t n_per_h)
+{
+  ASSERT(n_per_h >= 0.0);
+  ASSERT((dim >= 1) && (dim <= 3));
+
+  int n = (int)round(kernel->extent * n_per_h);
+  real_t sum;
+#pragma omp critical (sph_kernel_sum)
   {
-    real_t term = 2.0 - eta_mag;
-    *W = 0.25 * term * term * term / M_PI;
-    *dWdeta = -0.75 * term * term / M_PI;
+    int d = dim - 1;
+    if (n >= kernel->num_sums[d])
+    {
+      int new_num_sums = MAX(n + 1, 2 * kernel->num_sums[d]);
+      kernel->sums[d] = polymec_realloc(kernel->sums[d], sizeof(real_t) * new_num_sums);
+      for (int i = kernel->num_sums[d]; i < new_num_sums; ++i)
+        kernel->sums[d][i] = NAN;
+      kernel->num_sums[d] = new_num_sums;
+    }
+    if (isnan(kernel->sums[d][n]))
+      kernel->sums[d][n] = lattice_sum(kernel, dim, n);
+    sum = kernel->sums[d][n];
   }
+  return sum;
+}
+
+real_t sph_kernel_sum(sph_kernel_t* kernel, real_t n_per_h)
+{
+  return cached_lattice_sum(kernel, 3, n_per_h);
+}
+
+real_t sph_kernel_sum_2d(sph_kernel_t* kernel, real_t n_per_h)
+{
+  return cached_lattice_sum(kernel, 2, n_per_h);
+}
+
+real_t sph_kernel_sum_1d(sph_kernel_t* kernel, real_t n_per_h)
+{
+  return cached_lattice_sum(kernel, 1, n_per_h);
+}
+
+// Kernels of the inlineable types store their type, dimension, and 
+// normalization in their contexts as well as in the kernels themselves.
+typedef struct
+{
+  sph_kernel_type_t type;
+  int dim;
+  real_t sigma, extent;
+} typed_kernel_t;
+
+static void typed_kernel_compute(void* context, real_t eta_mag, real_t det_H, real_t* W, real_t* dWdeta)
+{
+  typed_kernel_t* k = context;
+  if (eta_mag < k->extent)
+    sph_kernel_eval(k->type, k->dim, k->sigma, eta_mag, det_H, W, dWdeta);
   else
-  {
     *W = *dWdeta = 0.0;
-  }
+}
+
+static sph_kernel_t* typed_kernel_new(const char* name,
+                                      sph_kernel_type_t type,
+                                      int dimension,
+                                      real_t sigma,
+                                      real_t extent)
+{
+  ASSERT((dimension >= 1) && (dimension <= 3));
+  typed_kernel_t* k = polymec_malloc(sizeof(typed_kernel_t));
+  k->type = type;
+  k->dim = dimension;
+  k->sigma = sigma;
+  k->extent = extent;
+  sph_kernel_t* kernel = sph_kernel_new(name, extent, k, typed_kernel_compute, 
+                                        polymec_free);
+  kernel->type = type;
+  kernel->dim = dimension;
+  kernel->sigma = sigma;
+  return kernel;
 }
 
 sph_kernel_t* b_spline_sph_kernel_new()
 {
-  return sph_kernel_new("B-spline", 2.0, NULL, b_spline_compute, NULL);
+  return typed_kernel_new("B-spline", SPH_KERNEL_B_SPLINE, 3, 1.0/M_PI, 2.0);
+}
+
+sph_kernel_t* wendland_c2_sph_kernel_new(int dimension)
+{
+  ASSERT((dimension >= 1) && (dimension <= 3));
+  static const real_t sigmas[] = {5.0/8.0, 7.0/(4.0*M_PI), 21.0/(16.0*M_PI)};
+  return typed_kernel_new("Wendland C2", SPH_KERNEL_WENDLAND_C2, dimension, 
+                          sigmas[dimension-1], 2.0);
+}
+
+sph_kernel_t* wendland_c4_sph_kernel_new(int dimension)
+{
+  ASSERT((dimension >= 1) && (dimension <= 3));
+  static const real_t sigmas[] = {3.0/4.0, 9.0/(4.0*M_PI), 495.0/(256.0*M_PI)};
+  return typed_kernel_new("Wendland C4", SPH_KERNEL_WENDLAND_C4, dimension, 
+                          sigmas[dimension-1], 2.0);
+}
+
+sph_kernel_t* wendland_c6_sph_kernel_new(int dimension)
+{
+  ASSERT((dimension >= 1) && (dimension <= 3));
+  static const real_t sigmas[] = {55.0/64.0, 39.0/(14.0*M_PI), 1365.0/(512.0*M_PI)};
+  return typed_kernel_new("Wendland C6", SPH_KERNEL_WENDLAND_C6, dimension, 
+                          sigmas[dimension-1], 2.0);
+}
+
+sph_kernel_t* quintic_spline_sph_kernel_new(int dimension)
+{
+  ASSERT((dimension >= 1) && (dimension <= 3));
+  static const real_t sigmas[] = {1.0/120.0, 7.0/(478.0*M_PI), 1.0/(120.0*M_PI)};
+  return typed_kernel_new("quintic spline", SPH_KERNEL_QUINTIC_SPLINE, 
+                          dimension, sigmas[dimension-1], 3.0);
 }
 
 typedef struct
@@ -186,3 +493,129 @@ sph_kernel_t* tabular_sph_kernel_new(sph_kernel_t* kernel,
   return sph_kernel_new(name, extent, tabular, tabular_compute, tabular_free);
 }
 
+// This kernel stores W and (dW/d|eta|)/|eta| interleaved in a single table 
+// that is uniformly spaced in |eta|^2.
+typedef struct
+{
+  real_t eta2_max, inv_deta2;
+  int resolution;
+  real_t* table; // 2 * resolution entries, aligned to a cache line.
+} eta2_tabular_t;
+
+static inline void eta2_tabular_lookup(eta2_tabular_t* tabular, real_t eta2, real_t det_H, real_t* W, real_t* dWe)
+{
+  if (eta2 >= tabular->eta2_max)
+  {
+    *W = *dWe = 0.0;
+    return;
+  }
+  real_t u = eta2 * tabular->inv_deta2;
+  int k = (int)u;
+  real_t f = u - k;
+  real_t* t = &tabular->table[2*k];
+  *W = det_H * ((1.0 - f) * t[0] + f * t[2]);
+  *dWe = det_H * ((1.0 - f) * t[1] + f * t[3]);
+}
+
+static void eta2_tabular_compute_eta2(void* context, real_t eta2, real_t det_H, real_t* W, real_t* dWdeta_over_eta)
+{
+  eta2_tabular_lookup(context, eta2, det_H, W, dWdeta_over_eta);
+}
+
+static void eta2_tabular_compute_eta2_batch(void* context, int n, real_t* eta2, real_t* det_H, real_t* W, real_t* dWdeta_over_eta)
+{
+  eta2_tabular_t* tabular = context;
+  real_t* restrict table = tabular->table;
+  real_t eta2_max = tabular->eta2_max, inv_deta2 = tabular->inv_deta2;
+  int k_max = tabular->resolution - 2;
+#pragma omp simd
+  for (int p = 0; p < n; ++p)
+  {
+    // Points outside the support are clamped into the table and then 
+    // zeroed, which keeps this loop free of branches.
+    real_t u = MIN(eta2[p], eta2_max) * inv_deta2;
+    int k = MIN((int)u, k_max);
+    real_t f = u - k;
+    real_t inside = (eta2[p] < eta2_max) ? det_H[p] : 0.0;
+    W[p] = inside * ((1.0 - f) * table[2*k] + f * table[2*k+2]);
+    dWdeta_over_eta[p] = inside * ((1.0 - f) * table[2*k+1] + f * table[2*k+3]);
+  }
+}
+
+static void eta2_tabular_compute(void* context, real_t eta_mag, real_t det_H, real_t* W, real_t* dWdeta)
+{
+  real_t dWe;
+  eta2_tabular_lookup(context, eta_mag * eta_mag, det_H, W, &dWe);
+  *dWdeta = dWe * eta_mag;
+}
+
+static void eta2_tabular_free(void* context)
+{
+  eta2_tabular_t* tabular = context;
+  free(tabular->table);
+  polymec_free(tabular);
+}
+
+sph_kernel_t* eta2_tabular_sph_kernel_new(sph_kernel_t* kernel, 
+                                          int resolution)
+{
+  ASSERT(resolution > 2);
+  eta2_tabular_t* tabular = polymec_malloc(sizeof(eta2_tabular_t));
+  real_t extent = sph_kernel_extent(kernel);
+  tabular->resolution = resolution;
+  tabular->eta2_max = extent * extent;
+  real_t deta2 = tabular->eta2_max / (resolution - 1);
+  tabular->inv_deta2 = 1.0 / deta2;
+
+  // Tabulate the (normalized) values of W and (dW/d|eta|)/|eta|. At the 
+  // origin, we take the latter from a point very close by.
+  void* table;
+  int err = posix_memalign(&table, 64, sizeof(real_t) * 2 * resolution);
+  if (err != 0)
+    polymec_error("eta2_tabular_sph_kernel_new: could not allocate table.");
+  tabular->table = table;
+  for (int k = 0; k < resolution; ++k)
+  {
+    real_t eta_mag = sqrt(k * deta2), dWdeta;
+    if (k == 0) 
+    {
+      real_t W0;
+      kernel->compute(kernel->context, 0.0, 1.0, &tabular->table[0], &dWdeta);
+      eta_mag = 1e-6 * extent;
+      kernel->compute(kernel->context, eta_mag, 1.0, &W0, &dWdeta);
+    }
+    else
+      kernel->compute(kernel->context, eta_mag, 1.0, &tabular->table[2*k], &dWdeta);
+    tabular->table[2*k+1] = dWdeta / eta_mag;
+  }
+
+  // Measure the largest errors in W and dW/d|eta| between table points.
+  real_t W_max = 0.0, W_err = 0.0, dW_max = 0.0, dW_err = 0.0;
+  int num_samples = 4 * resolution;
+  for (int s = 0; s < num_samples; ++s)
+  {
+    real_t eta_mag = (s + 0.5) * extent / num_samples;
+    real_t W_exact, dW_exact, W_table, dW_table;
+    kernel->compute(kernel->context, eta_mag, 1.0, &W_exact, &dW_exact);
+    eta2_tabular_compute(tabular, eta_mag, 1.0, &W_table, &dW_table);
+    W_max = MAX(W_max, fabs(W_exact));
+    dW_max = MAX(dW_max, fabs(dW_exact));
+    W_err = MAX(W_err, fabs(W_table - W_exact));
+    dW_err = MAX(dW_err, fabs(dW_table - dW_exact));
+  }
+  log_detail("eta2_tabular_sph_kernel_new: max relative errors for %s "
+             "with %d entries: W: %g, dW/deta: %g", kernel->name, resolution,
+             (W_max > 0.0) ? W_err / W_max : W_err, 
+             (dW_max > 0.0) ? dW_err / dW_max : dW_err);
+
+  // Now create our proper SPH kernel.
+  int name_len = strlen(kernel->name);
+  char name[name_len+128];
+  snprintf(name, name_len+127, "eta2_table(%s)", kernel->name);
+  sph_kernel_t* eta2_kernel = sph_kernel_new(name, extent, tabular, 
+                                             eta2_tabular_compute, 
+                                             eta2_tabular_free);
+  eta2_kernel->compute_eta2 = eta2_tabular_compute_eta2;
+  eta2_kernel->compute_eta2_batch = eta2_tabular_compute_eta2_batch;
+  return eta2_kernel;
+}
@@ -17,6 +17,19 @@
 // Hydrodynamics calculation. Objects of this type are garbage-collected.
 typedef struct sph_kernel_t sph_kernel_t;
 
+// These are the types of SPH kernel whose evaluation can be inlined (see 
+// sph_kernel_eval below). Kernels created with sph_kernel_new are of type 
+// SPH_KERNEL_GENERIC, and are only evaluated through their compute functions.
+typedef enum
+{
+  SPH_KERNEL_GENERIC,
+  SPH_KERNEL_B_SPLINE,
+  SPH_KERNEL_WENDLAND_C2,
+  SPH_KERNEL_WENDLAND_C4,
+  SPH_KERNEL_WENDLAND_C6,
+  SPH_KERNEL_QUINTIC_SPLINE
+} sph_kernel_type_t;
+
 // Creates an SPH kernel object with the given name, extent (in number of 
 // smoothing lengths), context, compute function, and destructor.
 sph_kernel_t* sph_kernel_new(const char* name,
@@ -32,17 +45,89 @@ char* sph_kernel_name(sph_kernel_t* kernel);
 // smoothing lengths.
 real_t sph_kernel_extent(sph_kernel_t* kernel);
 
+// Returns the type of the SPH kernel.
+sph_kernel_type_t sph_kernel_type(sph_kernel_t* kernel);
+
+// Returns the number of spatial dimensions for which the kernel is 
+// normalized. For generic kernels, this is 3.
+int sph_kernel_dimension(sph_kernel_t* kernel);
+
+// Returns the normalization constant sigma of the kernel, which multiplies 
+// its dimensionless shape function. For generic kernels, this is 1.
+real_t sph_kernel_normalization(sph_kernel_t* kernel);
+
 // Computes the value and gradient of the kernel at a displacement of x from 
 // center, given the symmetric smoothing tensor H.
 void sph_kernel_compute(sph_kernel_t* kernel, vector_t* x, sym_tensor2_t* H, real_t* W, vector_t* grad_W);
 
+// This type holds quantities that depend only on a particle's smoothing 
+// tensor H, so that they can be computed once per particle instead of once
+// per pair.
+typedef struct
+{
+  real_t det_H;   // Determinant of H.
+  bool isotropic; // True if H = I/h for a scalar smoothing length h.
+  real_t h_inv;   // 1/h if H is isotropic, 0 otherwise.
+} sph_H_data_t;
+
+// Fills H_data with the quantities derived from the smoothing tensor H.
+void sph_H_data_compute(sym_tensor2_t* H, sph_H_data_t* H_data);
+
+// Computes the value and gradient of the kernel at a displacement of x from
+// center, given the smoothing tensor H and the data precomputed from it by 
+// sph_H_data_compute. If H is isotropic, this skips the tensor algebra 
+// entirely. The result agrees with that of sph_kernel_compute up to roundoff.
+void sph_kernel_compute_with_H_data(sph_kernel_t* kernel, vector_t* x, sym_tensor2_t* H, sph_H_data_t* H_data, real_t* W, vector_t* grad_W);
+
+// Returns true if the kernel can be evaluated directly in terms of the 
+// squared magnitude |eta|^2, false if not.
+bool sph_kernel_has_eta2_compute(sph_kernel_t* kernel);
+
+// Evaluates the kernel W and the quantity (dW/d|eta|)/|eta| for n squared 
+// magnitudes eta2 with the corresponding smoothing tensor determinants 
+// det_H. The gradient of W is then H o (eta * (dW/d|eta|)/|eta|). Kernels 
+// with an |eta|^2 compute function evaluate these in a vectorizable loop;
+// others fall back to their ordinary compute function.
+void sph_kernel_compute_eta2_batch(sph_kernel_t* kernel, 
+                                   int n, 
+                                   real_t* eta2, 
+                                   real_t* det_H, 
+                                   real_t* W, 
+                                   real_t* dWdeta_over_eta);
+
 // Returns the sum of the contributions from this kernel in a neighborhood
-// about a point with n_per_h neighbors per SPH smoothing scale.
+// about a point with n_per_h neighbors per SPH smoothing scale, on a 3D 
+// lattice. Sums are computed one radial shell at a time and cached within 
+// the kernel, so repeated calls with similar n_per_h are cheap.
 real_t sph_kernel_sum(sph_kernel_t* kernel, real_t n_per_h);
 
+// Returns the analog of sph_kernel_sum on a 2D lattice.
+real_t sph_kernel_sum_2d(sph_kernel_t* kernel, real_t n_per_h);
+
+// Returns the analog of sph_kernel_sum on a 1D lattice.
+real_t sph_kernel_sum_1d(sph_kernel_t* kernel, real_t n_per_h);
+
 // Creates and returns a cubic B-spline SPH kernel.
 sph_kernel_t* b_spline_sph_kernel_new();
 
+// Creates and returns a Wendland C2 SPH kernel normalized for the given 
+// number of dimensions (1, 2, or 3), with a support of 2 smoothing lengths.
+// Wendland kernels are not subject to the pairing instability, so they can 
+// be used with fewer neighbors than the B-spline kernel.
+sph_kernel_t* wendland_c2_sph_kernel_new(int dimension);
+
+// Creates and returns a Wendland C4 SPH kernel normalized for the given 
+// number of dimensions, with a support of 2 smoothing lengths.
+sph_kernel_t* wendland_c4_sph_kernel_new(int dimension);
+
+// Creates and returns a Wendland C6 SPH kernel normalized for the given 
+// number of dimensions, with a support of 2 smoothing lengths.
+sph_kernel_t* wendland_c6_sph_kernel_new(int dimension);
+
+// Creates and returns a quintic spline SPH kernel normalized for the given 
+// number of dimensions, with a support of 3 smoothing lengths.
+sph_kernel_t* quintic_spline_sph_kernel_new(int dimension);
+
 // Creates a kernel that uses a lookup table with linear or quadratic 
 // interpolation with the given resolution to quickly evaluate values 
 // precomputed by the given kernel.
@@ -50,4 +135,116 @@ sph_kernel_t* tabular_sph_kernel_new(sph_kernel_t* kernel,
                                      lookup1_interpolation_t interpolation,
                                      int resolution);
 
+// Creates a kernel that uses a lookup table with linear interpolation to 
+// quickly evaluate values precomputed by the given kernel. Unlike the 
+// table in tabular_sph_kernel_new, this table is indexed by |eta|^2 and 
+// stores W and (dW/d|eta|)/|eta| interleaved in a single aligned array, so 
+// neither a square root nor a second lookup is needed per evaluation. The 
+// table has the given number of entries, and its maximum errors relative 
+// to the given kernel are logged (at the detail level) on construction.
+sph_kernel_t* eta2_tabular_sph_kernel_new(sph_kernel_t* kernel, 
+                                          int resolution);
+
+// Evaluates W and dW/d|eta| for the dimensionless distance eta_mag (which 
+// must lie within the kernel's support) for a kernel of the given type, 
+// dimension, and normalization, given the determinant of H. This function 
+// is inlined, so when the type is known at compile time, the selection of 
+// the kernel costs nothing.
+static inline void sph_kernel_eval(sph_kernel_type_t type, 
+                                   int dimension,
+                                   real_t sigma,
+                                   real_t eta_mag, 
+                                   real_t det_H, 
+                                   real_t* W, 
+                                   real_t* dWdeta)
+{
+  real_t norm = sigma * det_H;
+  switch (type)
+  {
+    case SPH_KERNEL_B_SPLINE:
+      if (eta_mag <= 1.0)
+      {
+        real_t eta2 = eta_mag * eta_mag;
+        *W = norm * (1.0 - 1.5*eta2 + 0.75*eta2*eta_mag);
+        *dWdeta = norm * (-3.0*eta_mag + 2.25*eta2);
+      }
+      else
+      {
+        real_t term = 2.0 - eta_mag;
+        *W = norm * 0.25 * term * term * term;
+        *dWdeta = -norm * 0.75 * term * term;
+      }
+      break;
+    case SPH_KERNEL_WENDLAND_C2:
+    {
+      // Wendland kernels are polynomials in u = |eta|/2, so dW/d|eta| is 
+      // half of dW/du.
+      real_t u = 0.5 * eta_mag, v = 1.0 - u, v2 = v * v;
+      if (dimension == 1)
+      {
+        *W = norm * v2 * v * (1.0 + 3.0*u);
+        *dWdeta = -norm * 6.0 * u * v2;
+      }
+      else
+      {
+        *W = norm * v2 * v2 * (1.0 + 4.0*u);
+        *dWdeta = -norm * 10.0 * u * v2 * v;
+      }
+      break;
+    }
+    case SPH_KERNEL_WENDLAND_C4:
+    {
+      real_t u = 0.5 * eta_mag, v = 1.0 - u, v2 = v * v, v4 = v2 * v2;
+      if (dimension == 1)
+      {
+        *W = norm * v4 * v * (1.0 + 5.0*u + 8.0*u*u);
+        *dWdeta = -norm * 7.0 * u * (1.0 + 4.0*u) * v4;
+      }
+      else
+      {
+        *W = norm * v4 * v2 * (1.0 + 6.0*u + 35.0*u*u/3.0);
+        *dWdeta = -norm * 28.0 * u * (1.0 + 5.0*u) * v4 * v / 3.0;
+      }
+      break;
+    }
+    case SPH_KERNEL_WENDLAND_C6:
+    {
+      real_t u = 0.5 * eta_mag, v = 1.0 - u, v2 = v * v, v4 = v2 * v2;
+      if (dimension == 1)
+      {
+        *W = norm * v4 * v2 * v * (1.0 + 7.0*u + 19.0*u*u + 21.0*u*u*u);
+        *dWdeta = -norm * 3.0 * u * (3.0 + 18.0*u + 35.0*u*u) * v4 * v2;
+      }
+      else
+      {
+        *W = norm * v4 * v4 * (1.0 + 8.0*u + 25.0*u*u + 32.0*u*u*u);
+        *dWdeta = -norm * 11.0 * u * (1.0 + 7.0*u + 16.0*u*u) * v4 * v2 * v;
+      }
+      break;
+    }
+    case SPH_KERNEL_QUINTIC_SPLINE:
+    {
+      real_t t3 = 3.0 - eta_mag, t3_2 = t3 * t3, t3_4 = t3_2 * t3_2;
+      real_t w = t3_4 * t3, dw = -5.0 * t3_4;
+      if (eta_mag < 2.0)
+      {
+        real_t t2 = 2.0 - eta_mag, t2_2 = t2 * t2, t2_4 = t2_2 * t2_2;
+        w -= 6.0 * t2_4 * t2;
+        dw += 30.0 * t2_4;
+        if (eta_mag < 1.0)
+        {
+          real_t t1 = 1.0 - eta_mag, t1_2 = t1 * t1, t1_4 = t1_2 * t1_2;
+          w += 15.0 * t1_4 * t1;
+          dw -= 75.0 * t1_4;
+        }
+      }
+      *W = norm * w;
+      *dWdeta = norm * dw;
+      break;
+    }
+    default:
+      *W = *dWdeta = 0.0;
+  }
+}
+
 #endif
@@ -0,0 +1,325 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "core/timer.h"
+#include "core/kd_tree.h"
+#include "polywog/sph_neighbor_list.h"
+
+struct sph_neighbor_list_t
+{
+  point_cloud_t* cloud;
+  real_t skin;
+  int num_builds;
+
+  // The exchanger that fills in the cloud's ghost points (our own copy), 
+  // copies of which are given to our pairings.
+  exchanger_t* ex;
+
+  // Positions and support radii of the points at the last build.
+  int num_points;
+  point_t* x0;
+  real_t* R0;
+
+  // Candidate pairs (with skin) and filtered pairs (without).
+  neighbor_pairing_t* candidates;
+  neighbor_pairing_t* pairing;
+  int pairing_capacity;
+};
+
+static int num_cloud_points(point_cloud_t* cloud)
+{
+  return cloud->num_points + cloud->num_ghosts;
+}
+
+// Returns a new exchanger with the same sends and receives as ex.
+static exchanger_t* copy_exchanger(MPI_Comm comm, exchanger_t* ex)
+{
+  exchanger_t* copy = exchanger_new(comm);
+  if (ex != NULL)
+  {
+    int pos = 0, proc, num_indices, *indices;
+    while (exchanger_next_send(ex, &pos, &proc, &indices, &num_indices))
+      exchanger_set_send(copy, proc, indices, num_indices, true);
+    pos = 0;
+    while (exchanger_next_receive(ex, &pos, &proc, &indices, &num_indices))
+      exchanger_set_receive(copy, proc, indices, num_indices, true);
+  }
+  return copy;
+}
+
+static void build_candidates(sph_neighbor_list_t* list, real_t* R)
+{
+  START_FUNCTION_TIMER();
+  point_cloud_t* cloud = list->cloud;
+  int N = num_cloud_points(cloud);
+
+  // Record the state of the points at this build.
+  if (N != list->num_points)
+  {
+    list->num_points = N;
+    list->x0 = polymec_realloc(list->x0, sizeof(point_t) * N);
+    list->R0 = polymec_realloc(list->R0, sizeof(real_t) * N);
+  }
+  memcpy(list->x0, cloud->points, sizeof(point_t) * N);
+  memcpy(list->R0, R, sizeof(real_t) * N);
+
+  // Each pair (i, j) is found by a search about the point with the larger
+  // support radius (or the smaller index, if the radii are equal), and we
+  // only keep pairs that involve at least one locally-owned point.
+  kd_tree_t* tree = kd_tree_new(cloud->points, N);
+  int_array_t* pairs = int_array_new();
+  for (int i = 0; i < N; ++i)
+  {
+    int_array_t* neighbors = kd_tree_within_radius(tree, &cloud->points[i],
+                                                   R[i] + list->skin);
+    for (int n = 0; n < neighbors->size; ++n)
+    {
+      int j = neighbors->data[n];
+      if ((j == i) || (R[j] > R[i]) || ((R[j] == R[i]) && (j < i)))
+        continue;
+      if ((i >= cloud->num_points) && (j >= cloud->num_points))
+        continue;
+      int_array_append(pairs, MIN(i, j));
+      int_array_append(pairs, MAX(i, j));
+    }
+    int_array_free(neighbors);
+  }
+  kd_tree_free(tree);
+
+  if (list->candidates != NULL)
+    neighbor_pairing_free(list->candidates);
+  int num_pairs = (int)(pairs->size/2);
+  list->candidates = neighbor_pairing_new("SPH candidate pairs", num_pairs,
+                                          pairs->data, NULL,
+                                          copy_exchanger(cloud->comm, list->ex));
+  int_array_release_data_and_free(pairs);
+
+  // Make sure the filtered pairing has room for all the candidates.
+  if (num_pairs > list->pairing_capacity)
+  {
+    list->pairing_capacity = num_pairs;
+    list->pairing->pairs = polymec_realloc(list->pairing->pairs,
+                                           sizeof(int) * 2 * num_pairs);
+  }
+
+  ++list->num_builds;
+  log_debug("sph_neighbor_list: built %d candidate pairs (build %d).",
+            num_pairs, list->num_builds);
+  STOP_FUNCTION_TIMER();
+}
+
+static void filter_candidates(sph_neighbor_list_t* list, real_t* R)
+{
+  START_FUNCTION_TIMER();
+  point_t* x = list->cloud->points;
+  int* pairs = list->pairing->pairs;
+  int num_pairs = 0, pos = 0, i, j;
+  while (neighbor_pairing_next(list->candidates, &pos, &i, &j, NULL))
+  {
+    real_t R_max = MAX(R[i], R[j]);
+    if (point_square_distance(&x[i], &x[j]) <= R_max * R_max)
+    {
+      pairs[2*num_pairs]   = i;
+      pairs[2*num_pairs+1] = j;
+      ++num_pairs;
+    }
+  }
+  list->pairing->num_pairs = num_pairs;
+  STOP_FUNCTION_TIMER();
+}
+
+sph_neighbor_list_t* sph_neighbor_list_new(point_cloud_t* cloud,
+                                           real_t* R,
+                                           real_t skin,
+                                           exchanger_t* ex)
+{
+  ASSERT(skin >= 0.0);
+
+  sph_neighbor_list_t* list = polymec_malloc(sizeof(sph_neighbor_list_t));
+  list->cloud = cloud;
+  list->skin = skin;
+  list->ex = copy_exchanger(cloud->comm, ex);
+  list->num_builds = 0;
+  list->num_points = 0;
+  list->x0 = NULL;
+  list->R0 = NULL;
+  list->candidates = NULL;
+  list->pairing = neighbor_pairing_new("SPH neighbor pairs", 0,
+                                       polymec_malloc(sizeof(int) * 2), NULL,
+                                       copy_exchanger(cloud->comm, ex));
+  list->pairing_capacity = 1;
+  build_candidates(list, R);
+  filter_candidates(list, R);
+  return list;
+}
+
+void sph_neighbor_list_free(sph_neighbor_list_t* list)
+{
+  neighbor_pairing_free(list->pairing);
+  neighbor_pairing_free(list->candidates);
+  exchanger_free(list->ex);
+  polymec_free(list->x0);
+  polymec_free(list->R0);
+  polymec_free(list);
+}
+
+bool sph_neighbor_list_update(sph_neighbor_list_t* list, real_t* R)
+{
+  START_FUNCTION_TIMER();
+  point_cloud_t* cloud = list->cloud;
+  int N = num_cloud_points(cloud);
+
+  // Find the largest displacement and support growth since the last build.
+  int rebuild = (N != list->num_points);
+  if (!rebuild)
+  {
+    real_t max_disp2 = 0.0, max_growth = 0.0;
+    for (int i = 0; i < N; ++i)
+    {
+      max_disp2 = MAX(max_disp2, point_square_distance(&cloud->points[i], &list->x0[i]));
+      max_growth = MAX(max_growth, R[i] - list->R0[i]);
+    }
+    rebuild = (2.0 * sqrt(max_disp2) + max_growth > list->skin);
+  }
+
+  // All processes must agree on whether to rebuild.
+  int rebuild_anywhere = rebuild;
+  MPI_Allreduce(&rebuild, &rebuild_anywhere, 1, MPI_INT, MPI_MAX, cloud->comm);
+  if (rebuild_anywhere)
+    build_candidates(list, R);
+  filter_candidates(list, R);
+  STOP_FUNCTION_TIMER();
+  return (rebuild_anywhere != 0);
+}
+
+int sph_neighbor_list_extend(sph_neighbor_list_t* list, real_t* R)
+{
+  START_FUNCTION_TIMER();
+  point_cloud_t* cloud = list->cloud;
+  int N = list->num_points;
+  ASSERT(num_cloud_points(cloud) == N);
+
+  // Find the points whose supports have outgrown their candidates, and 
+  // assign each of these an index.
+  int* grown_index = polymec_malloc(sizeof(int) * MAX(N, 1));
+  int num_grown = 0;
+  for (int i = 0; i < N; ++i)
+  {
+    if (R[i] > list->R0[i] + list->skin)
+      grown_index[i] = num_grown++;
+    else
+      grown_index[i] = -1;
+  }
+  if (num_grown == 0)
+  {
+    polymec_free(grown_index);
+    STOP_FUNCTION_TIMER();
+    return 0;
+  }
+
+  // Gather the existing candidate partners of the grown points.
+  int_array_t** partners = polymec_malloc(sizeof(int_array_t*) * num_grown);
+  for (int g = 0; g < num_grown; ++g)
+    partners[g] = int_array_new();
+  int pos = 0, i, j;
+  while (neighbor_pairing_next(list->candidates, &pos, &i, &j, NULL))
+  {
+    if (grown_index[i] != -1)
+      int_array_append(partners[grown_index[i]], j);
+    if (grown_index[j] != -1)
+      int_array_append(partners[grown_index[j]], i);
+  }
+
+  // Search about each grown point for new candidates. A pair of grown points
+  // that find each other is added only by the one with the smaller index.
+  kd_tree_t* tree = kd_tree_new(cloud->points, N);
+  int_array_t* new_pairs = int_array_new();
+  for (int i = 0; i < N; ++i)
+  {
+    int g = grown_index[i];
+    if (g == -1) continue;
+    int_array_t* neighbors = kd_tree_within_radius(tree, &cloud->points[i],
+                                                   R[i] + list->skin);
+    for (int n = 0; n < neighbors->size; ++n)
+    {
+      int j = neighbors->data[n];
+      if (j == i)
+        continue;
+      if ((grown_index[j] != -1) && (j < i))
+      {
+        real_t Rj = R[j] + list->skin;
+        if (point_square_distance(&cloud->points[i], &cloud->points[j]) <= Rj * Rj)
+          continue;
+      }
+      if ((i >= cloud->num_points) && (j >= cloud->num_points))
+        continue;
+      bool found = false;
+      for (int p = 0; p < partners[g]->size; ++p)
+      {
+        if (partners[g]->data[p] == j)
+        {
+          found = true;
+          break;
+        }
+      }
+      if (!found)
+      {
+        int_array_append(new_pairs, MIN(i, j));
+        int_array_append(new_pairs, MAX(i, j));
+      }
+    }
+    int_array_free(neighbors);
+    list->R0[i] = R[i];
+  }
+  kd_tree_free(tree);
+  for (int g = 0; g < num_grown; ++g)
+    int_array_free(partners[g]);
+  polymec_free(partners);
+  polymec_free(grown_index);
+
+  // Append the new candidates.
+  int num_new_pairs = (int)(new_pairs->size/2);
+  if (num_new_pairs > 0)
+  {
+    neighbor_pairing_t* candidates = list->candidates;
+    int num_pairs = candidates->num_pairs + num_new_pairs;
+    candidates->pairs = polymec_realloc(candidates->pairs, 
+                                        sizeof(int) * 2 * num_pairs);
+    memcpy(&candidates->pairs[2*candidates->num_pairs], new_pairs->data, 
+           sizeof(int) * 2 * num_new_pairs);
+    candidates->num_pairs = num_pairs;
+    if (num_pairs > list->pairing_capacity)
+    {
+      list->pairing_capacity = num_pairs;
+      list->pairing->pairs = polymec_realloc(list->pairing->pairs,
+                                             sizeof(int) * 2 * num_pairs);
+    }
+  }
+  int_array_free(new_pairs);
+  log_debug("sph_neighbor_list: extended candidates for %d points (%d new pairs).",
+            num_grown, num_new_pairs);
+
+  filter_candidates(list, R);
+  STOP_FUNCTION_TIMER();
+  return num_grown;
+}
+
+neighbor_pairing_t* sph_neighbor_list_pairing(sph_neighbor_list_t* list)
+{
+  return list->pairing;
+}
+
+neighbor_pairing_t* sph_neighbor_list_candidates(sph_neighbor_list_t* list)
+{
+  return list->candidates;
+}
+
+int sph_neighbor_list_num_builds(sph_neighbor_list_t* list)
+{
+  return list->num_builds;
+}
+
@@ -0,0 +1,75 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef POLYWOG_SPH_NEIGHBOR_LIST_H
+#define POLYWOG_SPH_NEIGHBOR_LIST_H
+
+#include "core/point_cloud.h"
+#include "model/neighbor_pairing.h"
+
+// An SPH neighbor list is a "Verlet list" that manages the neighbor pairing
+// for a set of moving SPH particles. It finds candidate pairs whose
+// separation falls within the support of either particle plus an extra
+// "skin" distance, and tracks the displacement of each particle and the
+// growth of its support since then. Candidate pairs are only rebuilt when
+// particles have moved far enough that some interacting pair could be
+// missing from the list. Between rebuilds, the list filters its candidates
+// down to the pairs that actually interact.
+typedef struct sph_neighbor_list_t sph_neighbor_list_t;
+
+// Creates a neighbor list for the points (locally-owned and ghost) in the
+// given point cloud, given the radius R of the support of the SPH kernel for
+// each of these points, and the given skin distance. The list borrows the
+// point cloud and reads the current positions of its points whenever it is
+// updated. The support of a point is a sphere of radius R, so for an SPH
+// kernel with extent eta_max and an anisotropic smoothing tensor H, R is
+// eta_max divided by the smallest eigenvalue of H. The positions of ghost
+// points must be kept current by the caller. The exchanger ex fills in the
+// ghost points of the cloud (or is NULL if it has none); the list copies it
+// into its neighbor pairings, so that their exchangers fill in ghost values
+// of point data. The list does not assert ownership over ex.
+sph_neighbor_list_t* sph_neighbor_list_new(point_cloud_t* cloud,
+                                           real_t* R,
+                                           real_t skin,
+                                           exchanger_t* ex);
+
+// Destroys the given neighbor list, including its neighbor pairings.
+void sph_neighbor_list_free(sph_neighbor_list_t* list);
+
+// Updates the neighbor list to reflect the current positions of the points
+// in its cloud and the given support radii R. The candidate pairs are
+// rebuilt (across all processes) if, on any process, twice the maximum
+// displacement of any point since the last rebuild plus the maximum growth
+// of any support radius exceeds the skin distance. Returns true if the
+// candidate pairs were rebuilt, false if not. In either case, the neighbor
+// pairing returned by sph_neighbor_list_pairing is refiltered.
+bool sph_neighbor_list_update(sph_neighbor_list_t* list, real_t* R);
+
+// Extends the candidate pairs of only those points whose support radii R 
+// have grown by more than the skin distance since their candidates were last
+// found, leaving the candidates of all other points alone, and refilters 
+// the neighbor pairing. This is useful when points' supports change but the
+// points themselves have not moved since the last update (for example, 
+// while iterating on the smoothing tensor H). Returns the number of points 
+// whose candidates were extended.
+int sph_neighbor_list_extend(sph_neighbor_list_t* list, real_t* R);
+
+// Returns an internal pointer to the neighbor pairing that contains only
+// those pairs of points that fall within the support of one another at the
+// time of the last update. The pairing object remains valid for the
+// lifetime of the list, but its pairs change with each update.
+neighbor_pairing_t* sph_neighbor_list_pairing(sph_neighbor_list_t* list);
+
+// Returns an internal pointer to the neighbor pairing containing all of the
+// candidate pairs found in the last rebuild (including the skin).
+neighbor_pairing_t* sph_neighbor_list_candidates(sph_neighbor_list_t* list);
+
+// Returns the number of times the candidate pairs have been built.
+int sph_neighbor_list_num_builds(sph_neighbor_list_t* list);
+
+#endif
+
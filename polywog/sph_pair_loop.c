@@ -0,0 +1,673 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include "core/timer.h"
+#include "polywog/sph_pair_loop.h"
+#include "polywog/pair_loop_threads.h"
+
+struct sph_pair_loop_t
+{
+  sph_kernel_t* W;
+  neighbor_pairing_t* pairing;
+  int num_comp, num_points;
+  int block_size;
+  ptr_array_t* dynamics;
+
+  // Accumulation buffers for threads other than the first (which
+  // accumulates directly into the output arrays).
+  pair_loop_buffers_t dUdt_bufs, node_data_bufs;
+
+  // Per-point data derived from the smoothing tensors, with room for 
+  // H_data_size points.
+  int H_data_size;
+  sph_H_data_t* H_data;
+
+  // Interior and boundary pairs (and ghost flags for points) for the 
+  // pairing split_pairing, used when overlapping ghost exchanges.
+  neighbor_pairing_t* split_pairing;
+  neighbor_pairing_t* interior;
+  neighbor_pairing_t* boundary;
+  bool* ghosts;
+};
+
+static void allocate_thread_buffers(sph_pair_loop_t* loop)
+{
+  pair_loop_buffers_reserve(&loop->dUdt_bufs, loop->num_points);
+  pair_loop_buffers_reserve(&loop->node_data_bufs, loop->num_points);
+}
+
+sph_pair_loop_t* sph_pair_loop_new(sph_kernel_t* W,
+                                   neighbor_pairing_t* pairing,
+                                   int num_components)
+{
+  ASSERT(num_components > 0);
+
+  sph_pair_loop_t* loop = polymec_malloc(sizeof(sph_pair_loop_t));
+  loop->W = W;
+  loop->pairing = pairing;
+  loop->num_comp = num_components;
+  loop->num_points = pair_loop_num_points(pairing);
+  loop->block_size = 512;
+  loop->dynamics = ptr_array_new();
+  pair_loop_buffers_init(&loop->dUdt_bufs, sizeof(real_t) * num_components);
+  pair_loop_buffers_init(&loop->node_data_bufs, sizeof(sph_node_data_t));
+  loop->H_data_size = 0;
+  loop->H_data = NULL;
+  loop->split_pairing = NULL;
+  loop->interior = NULL;
+  loop->boundary = NULL;
+  loop->ghosts = NULL;
+  return loop;
+}
+
+void sph_pair_loop_free(sph_pair_loop_t* loop)
+{
+  pair_loop_buffers_free(&loop->dUdt_bufs);
+  pair_loop_buffers_free(&loop->node_data_bufs);
+  if (loop->H_data != NULL)
+    polymec_free(loop->H_data);
+  if (loop->interior != NULL)
+    neighbor_pairing_free(loop->interior);
+  if (loop->boundary != NULL)
+    neighbor_pairing_free(loop->boundary);
+  if (loop->ghosts != NULL)
+    polymec_free(loop->ghosts);
+  ptr_array_free(loop->dynamics);
+  loop->W = NULL;
+  polymec_free(loop);
+}
+
+void sph_pair_loop_add_dynamics(sph_pair_loop_t* loop,
+                                sph_dynamics_t* dynamics)
+{
+  ptr_array_append(loop->dynamics, dynamics);
+}
+
+void sph_pair_loop_set_pairing(sph_pair_loop_t* loop,
+                               neighbor_pairing_t* pairing)
+{
+  loop->pairing = pairing;
+  loop->num_points = pair_loop_num_points(pairing);
+  loop->split_pairing = NULL;
+}
+
+neighbor_pairing_t* sph_pair_loop_pairing(sph_pair_loop_t* loop)
+{
+  return loop->pairing;
+}
+
+void sph_pair_loop_set_block_size(sph_pair_loop_t* loop, int block_size)
+{
+  ASSERT(block_size > 0);
+  loop->block_size = block_size;
+}
+
+int sph_pair_loop_num_points(sph_pair_loop_t* loop)
+{
+  return loop->num_points;
+}
+
+static inline void accumulate_moments(sym_tensor2_t* H,
+                                      sph_H_data_t* H_data,
+                                      vector_t* x,
+                                      real_t W,
+                                      sph_node_data_t* data)
+{
+  real_t det_H = H_data->det_H;
+  if (det_H <= 0.0)
+    return;
+
+  vector_t eta;
+  if (H_data->isotropic)
+  {
+    eta.x = H_data->h_inv * x->x;
+    eta.y = H_data->h_inv * x->y;
+    eta.z = H_data->h_inv * x->z;
+  }
+  else
+    sym_tensor2_dot_vector(H, x, &eta);
+  real_t Wn = W / det_H;
+  data->zeroth_moment += Wn;
+  data->first_moment.x += Wn * eta.x;
+  data->first_moment.y += Wn * eta.y;
+  data->first_moment.z += Wn * eta.z;
+  data->second_moment.xx += Wn * eta.x * eta.x;
+  data->second_moment.xy += Wn * eta.x * eta.y;
+  data->second_moment.xz += Wn * eta.x * eta.z;
+  data->second_moment.yy += Wn * eta.y * eta.y;
+  data->second_moment.yz += Wn * eta.y * eta.z;
+  data->second_moment.zz += Wn * eta.z * eta.z;
+}
+
+// Hands a gathered block of pairs to each of the dynamics objects and 
+// accumulates their contributions.
+static void compute_dynamics(sph_pair_loop_t* loop,
+                             real_t t,
+                             sph_pair_block_t* block,
+                             real_t* U,
+                             real_t* dUdt,
+                             sph_node_data_t* node_data)
+{
+  int nc = loop->num_comp;
+  int num_dynamics = (int)loop->dynamics->size;
+  sph_dynamics_t** dynamics = (sph_dynamics_t**)loop->dynamics->data;
+  real_t dUidt[SPH_PAIR_BLOCK_MAX_SIZE*nc], dUjdt[SPH_PAIR_BLOCK_MAX_SIZE*nc];
+  for (int d = 0; d < num_dynamics; ++d)
+  {
+    memset(dUidt, 0, sizeof(real_t) * SPH_PAIR_BLOCK_MAX_SIZE * nc);
+    memset(dUjdt, 0, sizeof(real_t) * SPH_PAIR_BLOCK_MAX_SIZE * nc);
+    sph_dynamics_compute_batch(dynamics[d], t, block, nc, U, 
+                               dUidt, dUjdt, node_data);
+    for (int c = 0; c < nc; ++c)
+    {
+      for (int p = 0; p < block->num_pairs; ++p)
+      {
+        dUdt[nc*block->i[p]+c] += dUidt[SPH_PAIR_BLOCK_MAX_SIZE*c+p];
+        dUdt[nc*block->j[p]+c] += dUjdt[SPH_PAIR_BLOCK_MAX_SIZE*c+p];
+      }
+    }
+  }
+}
+
+// Accumulates the moments for an evaluated pair and adds it to the given 
+// block of pairs, evaluating the block's dynamics when it's full.
+static inline void add_pair(sph_pair_loop_t* loop,
+                            real_t t,
+                            int i, int j,
+                            vector_t* xij,
+                            real_t Wi, vector_t* grad_Wi,
+                            real_t Wj, vector_t* grad_Wj,
+                            sym_tensor2_t* H,
+                            sph_pair_block_t* block,
+                            real_t* U,
+                            real_t* dUdt,
+                            sph_node_data_t* node_data)
+{
+  // Pairs that fall outside both supports don't interact.
+  if ((Wi == 0.0) && (Wj == 0.0))
+    return;
+
+  if (node_data != NULL)
+  {
+    accumulate_moments(&H[i], &loop->H_data[i], xij, Wi, &node_data[i]);
+    vector_t xji = {.x = -xij->x, .y = -xij->y, .z = -xij->z};
+    accumulate_moments(&H[j], &loop->H_data[j], &xji, Wj, &node_data[j]);
+  }
+
+  if ((dUdt != NULL) && (loop->dynamics->size > 0))
+  {
+    int p = block->num_pairs;
+    block->i[p] = i;
+    block->j[p] = j;
+    block->Wi[p] = Wi;
+    block->Wj[p] = Wj;
+    block->grad_Wi_x[p] = grad_Wi->x;
+    block->grad_Wi_y[p] = grad_Wi->y;
+    block->grad_Wi_z[p] = grad_Wi->z;
+    block->grad_Wj_x[p] = grad_Wj->x;
+    block->grad_Wj_y[p] = grad_Wj->y;
+    block->grad_Wj_z[p] = grad_Wj->z;
+    ++block->num_pairs;
+    if (block->num_pairs == SPH_PAIR_BLOCK_MAX_SIZE)
+    {
+      compute_dynamics(loop, t, block, U, dUdt, node_data);
+      block->num_pairs = 0;
+    }
+  }
+}
+
+// Computes eta = H o x, using the isotropic shortcut where possible.
+static inline void compute_eta(sym_tensor2_t* H, 
+                               sph_H_data_t* H_data, 
+                               vector_t* x, 
+                               vector_t* eta)
+{
+  if (H_data->isotropic)
+  {
+    eta->x = H_data->h_inv * x->x;
+    eta->y = H_data->h_inv * x->y;
+    eta->z = H_data->h_inv * x->z;
+  }
+  else
+    sym_tensor2_dot_vector(H, x, eta);
+}
+
+// Evaluates pairs one at a time.
+static void compute_block(sph_pair_loop_t* loop,
+                          neighbor_pairing_t* pairing,
+                          real_t t,
+                          int begin, int end,
+                          point_t* points,
+                          sym_tensor2_t* H,
+                          real_t* U,
+                          real_t* dUdt,
+                          sph_node_data_t* node_data)
+{
+  sph_pair_block_t block;
+  block.num_pairs = 0;
+  for (int k = begin; k < end; ++k)
+  {
+    int i, j;
+    neighbor_pairing_get(pairing, k, &i, &j, NULL);
+
+    // Evaluate the kernel in the frames of i and j.
+    vector_t xij, grad_Wi, grad_Wj;
+    point_displacement(&points[j], &points[i], &xij);
+    real_t Wi, Wj;
+    sph_kernel_compute_with_H_data(loop->W, &xij, &H[i], &loop->H_data[i], 
+                                   &Wi, &grad_Wi);
+    sph_kernel_compute_with_H_data(loop->W, &xij, &H[j], &loop->H_data[j], 
+                                   &Wj, &grad_Wj);
+    add_pair(loop, t, i, j, &xij, Wi, &grad_Wi, Wj, &grad_Wj, H, 
+             &block, U, dUdt, node_data);
+  }
+
+  // Take care of any remaining pairs.
+  if (block.num_pairs > 0)
+    compute_dynamics(loop, t, &block, U, dUdt, node_data);
+}
+
+// Evaluates a kernel of a known type inline in the frame defined by H.
+static inline void eval_typed_kernel(sph_kernel_type_t type,
+                                     int dim,
+                                     real_t sigma,
+                                     real_t extent,
+                                     vector_t* x,
+                                     sym_tensor2_t* H,
+                                     sph_H_data_t* H_data,
+                                     real_t* W,
+                                     vector_t* grad_W)
+{
+  vector_t eta;
+  compute_eta(H, H_data, x, &eta);
+  real_t eta_mag = vector_mag(&eta);
+  if (eta_mag < extent)
+  {
+    real_t dWdeta;
+    sph_kernel_eval(type, dim, sigma, eta_mag, H_data->det_H, W, &dWdeta);
+    if (eta_mag > 0.0)
+    {
+      real_t f = dWdeta / eta_mag;
+      vector_t w = {.x = f * eta.x, .y = f * eta.y, .z = f * eta.z};
+      compute_eta(H, H_data, &w, grad_W);
+    }
+    else
+      grad_W->x = grad_W->y = grad_W->z = 0.0;
+  }
+  else
+  {
+    *W = 0.0;
+    grad_W->x = grad_W->y = grad_W->z = 0.0;
+  }
+}
+
+// Evaluates pairs one at a time for a kernel of the given type. This is 
+// instantiated below for each kernel type, so that the type is a constant 
+// and the kernel evaluation is inlined.
+static inline void compute_typed_block(sph_pair_loop_t* loop,
+                                       neighbor_pairing_t* pairing,
+                                       sph_kernel_type_t type,
+                                       real_t t,
+                                       int begin, int end,
+                                       point_t* points,
+                                       sym_tensor2_t* H,
+                                       real_t* U,
+                                       real_t* dUdt,
+                                       sph_node_data_t* node_data)
+{
+  int dim = sph_kernel_dimension(loop->W);
+  real_t sigma = sph_kernel_normalization(loop->W);
+  real_t extent = sph_kernel_extent(loop->W);
+  sph_pair_block_t block;
+  block.num_pairs = 0;
+  for (int k = begin; k < end; ++k)
+  {
+    int i, j;
+    neighbor_pairing_get(pairing, k, &i, &j, NULL);
+    vector_t xij, grad_Wi, grad_Wj;
+    point_displacement(&points[j], &points[i], &xij);
+    real_t Wi, Wj;
+    eval_typed_kernel(type, dim, sigma, extent, &xij, &H[i], 
+                      &loop->H_data[i], &Wi, &grad_Wi);
+    eval_typed_kernel(type, dim, sigma, extent, &xij, &H[j], 
+                      &loop->H_data[j], &Wj, &grad_Wj);
+    add_pair(loop, t, i, j, &xij, Wi, &grad_Wi, Wj, &grad_Wj, H, 
+             &block, U, dUdt, node_data);
+  }
+  if (block.num_pairs > 0)
+    compute_dynamics(loop, t, &block, U, dUdt, node_data);
+}
+
+#define DEFINE_TYPED_BLOCK(name, type) \
+static void compute_block_##name(sph_pair_loop_t* loop, \
+                                 neighbor_pairing_t* pairing, \
+                                 real_t t, \
+                                 int begin, int end, \
+                                 point_t* points, \
+                                 sym_tensor2_t* H, \
+                                 real_t* U, \
+                                 real_t* dUdt, \
+                                 sph_node_data_t* node_data) \
+{ \
+  compute_typed_block(loop, pairing, type, t, begin, end, points, H, U, \
+                      dUdt, node_data); \
+}
+
+DEFINE_TYPED_BLOCK(b_spline, SPH_KERNEL_B_SPLINE)
+DEFINE_TYPED_BLOCK(wendland_c2, SPH_KERNEL_WENDLAND_C2)
+DEFINE_TYPED_BLOCK(wendland_c4, SPH_KERNEL_WENDLAND_C4)
+DEFINE_TYPED_BLOCK(wendland_c6, SPH_KERNEL_WENDLAND_C6)
+DEFINE_TYPED_BLOCK(quintic_spline, SPH_KERNEL_QUINTIC_SPLINE)
+
+// Evaluates pairs SPH_PAIR_BLOCK_MAX_SIZE at a time using the kernel's 
+// batch |eta|^2 compute function.
+static void compute_block_eta2(sph_pair_loop_t* loop,
+                               neighbor_pairing_t* pairing,
+                               real_t t,
+                               int begin, int end,
+                               point_t* points,
+                               sym_tensor2_t* H,
+                               real_t* U,
+                               real_t* dUdt,
+                               sph_node_data_t* node_data)
+{
+  int n = SPH_PAIR_BLOCK_MAX_SIZE;
+  sph_pair_block_t block;
+  block.num_pairs = 0;
+  for (int k0 = begin; k0 < end; k0 += n)
+  {
+    // Gather the squared magnitudes of eta in the frames of i and j. The 
+    // first n entries belong to i, the second n to j.
+    int num_pairs = MIN(n, end - k0);
+    int i[n], j[n];
+    vector_t xij[n], eta[2*n];
+    real_t eta2[2*n], det_H[2*n], W[2*n], dWe[2*n];
+    for (int p = 0; p < num_pairs; ++p)
+    {
+      neighbor_pairing_get(pairing, k0+p, &i[p], &j[p], NULL);
+      point_displacement(&points[j[p]], &points[i[p]], &xij[p]);
+      sph_H_data_t* H_i = &loop->H_data[i[p]];
+      sph_H_data_t* H_j = &loop->H_data[j[p]];
+      compute_eta(&H[i[p]], H_i, &xij[p], &eta[p]);
+      compute_eta(&H[j[p]], H_j, &xij[p], &eta[n+p]);
+      eta2[p] = vector_dot(&eta[p], &eta[p]);
+      eta2[n+p] = vector_dot(&eta[n+p], &eta[n+p]);
+      det_H[p] = H_i->det_H;
+      det_H[n+p] = H_j->det_H;
+    }
+    for (int p = num_pairs; p < n; ++p)
+    {
+      eta2[p] = eta2[n+p] = 0.0;
+      det_H[p] = det_H[n+p] = 0.0;
+    }
+    sph_kernel_compute_eta2_batch(loop->W, 2*n, eta2, det_H, W, dWe);
+
+    // Form the gradients and add the pairs.
+    for (int p = 0; p < num_pairs; ++p)
+    {
+      vector_t grad_Wi, grad_Wj;
+      vector_t wi = {.x = dWe[p] * eta[p].x, 
+                     .y = dWe[p] * eta[p].y, 
+                     .z = dWe[p] * eta[p].z};
+      compute_eta(&H[i[p]], &loop->H_data[i[p]], &wi, &grad_Wi);
+      vector_t wj = {.x = dWe[n+p] * eta[n+p].x, 
+                     .y = dWe[n+p] * eta[n+p].y, 
+                     .z = dWe[n+p] * eta[n+p].z};
+      compute_eta(&H[j[p]], &loop->H_data[j[p]], &wj, &grad_Wj);
+      add_pair(loop, t, i[p], j[p], &xij[p], W[p], &grad_Wi, W[n+p], &grad_Wj, 
+               H, &block, U, dUdt, node_data);
+    }
+  }
+
+  // Take care of any remaining pairs.
+  if (block.num_pairs > 0)
+    compute_dynamics(loop, t, &block, U, dUdt, node_data);
+}
+
+// This is the type of the functions that evaluate blocks of pairs.
+typedef void (*block_function_t)(sph_pair_loop_t* loop, 
+                                 neighbor_pairing_t* pairing,
+                                 real_t t, 
+                                 int begin, int end, 
+                                 point_t* points, 
+                                 sym_tensor2_t* H, 
+                                 real_t* U, 
+                                 real_t* dUdt, 
+                                 sph_node_data_t* node_data);
+
+// Selects the function that evaluates blocks of pairs for the loop's kernel.
+static block_function_t block_function(sph_pair_loop_t* loop)
+{
+  switch (sph_kernel_type(loop->W))
+  {
+    case SPH_KERNEL_B_SPLINE: return compute_block_b_spline;
+    case SPH_KERNEL_WENDLAND_C2: return compute_block_wendland_c2;
+    case SPH_KERNEL_WENDLAND_C4: return compute_block_wendland_c4;
+    case SPH_KERNEL_WENDLAND_C6: return compute_block_wendland_c6;
+    case SPH_KERNEL_QUINTIC_SPLINE: return compute_block_quintic_spline;
+    default: 
+      return sph_kernel_has_eta2_compute(loop->W) ? compute_block_eta2 
+                                                  : compute_block;
+  }
+}
+
+// Computes the determinants (and detects isotropy) of the smoothing tensors
+// once per point instead of once per pair. If ghosts is non-NULL, this is 
+// only done for those points i for which ghosts[i] == for_ghosts.
+static void compute_H_data(sph_pair_loop_t* loop, 
+                           sym_tensor2_t* H, 
+                           bool* ghosts,
+                           bool for_ghosts)
+{
+  int N = loop->num_points;
+  if (N > loop->H_data_size)
+  {
+    loop->H_data_size = N;
+    loop->H_data = polymec_realloc(loop->H_data, sizeof(sph_H_data_t) * N);
+  }
+#pragma omp parallel for
+  for (int i = 0; i < N; ++i)
+  {
+    if ((ghosts == NULL) || (ghosts[i] == for_ghosts))
+      sph_H_data_compute(&H[i], &loop->H_data[i]);
+  }
+}
+
+// Traverses the pairs in the given pairing, with each thread accumulating 
+// into its own buffers. Threads whose indices are at least num_zeroed zero 
+// their buffers first. Returns the number of threads whose buffers have 
+// been zeroed (during this or a previous traversal).
+static int traverse_pairs(sph_pair_loop_t* loop,
+                          neighbor_pairing_t* pairing,
+                          int num_zeroed,
+                          real_t t,
+                          point_t* points,
+                          sym_tensor2_t* H,
+                          real_t* U,
+                          real_t* dUdt,
+                          sph_node_data_t* node_data)
+{
+  int N = loop->num_points, nc = loop->num_comp;
+  int num_pairs = pairing->num_pairs;
+  int block_size = loop->block_size;
+  int num_blocks = (num_pairs + block_size - 1) / block_size;
+  block_function_t compute = block_function(loop);
+  int num_threads = 1;
+
+#pragma omp parallel
+  {
+#pragma omp master
+    num_threads = pair_loop_team_size();
+
+    // Each thread accumulates into its own buffers.
+    int tid = pair_loop_thread_index();
+    real_t* thread_dUdt = NULL;
+    if (dUdt != NULL)
+    {
+      thread_dUdt = (tid == 0) ? dUdt : loop->dUdt_bufs.bufs[tid];
+      if (tid >= num_zeroed)
+        memset(thread_dUdt, 0, sizeof(real_t) * nc * N);
+    }
+    sph_node_data_t* thread_node_data = NULL;
+    if (node_data != NULL)
+    {
+      thread_node_data = (tid == 0) ? node_data : loop->node_data_bufs.bufs[tid];
+      if (tid >= num_zeroed)
+        memset(thread_node_data, 0, sizeof(sph_node_data_t) * N);
+    }
+
+#pragma omp for schedule(dynamic)
+    for (int b = 0; b < num_blocks; ++b)
+    {
+      int begin = b * block_size;
+      int end = MIN(num_pairs, begin + block_size);
+      compute(loop, pairing, t, begin, end, points, H, U, 
+              thread_dUdt, thread_node_data);
+    }
+  }
+  return MAX(num_zeroed, num_threads);
+}
+
+// Reduces the contributions from threads other than the first.
+static void reduce_thread_buffers(sph_pair_loop_t* loop,
+                                  int num_threads,
+                                  real_t* dUdt,
+                                  sph_node_data_t* node_data)
+{
+  if (num_threads <= 1) return;
+  int N = loop->num_points, nc = loop->num_comp;
+#pragma omp parallel for
+  for (int i = 0; i < N; ++i)
+  {
+    for (int tid = 1; tid < num_threads; ++tid)
+    {
+      if (dUdt != NULL)
+      {
+        real_t* thread_dUdt = loop->dUdt_bufs.bufs[tid];
+        for (int c = 0; c < nc; ++c)
+          dUdt[nc*i+c] += thread_dUdt[nc*i+c];
+      }
+      if (node_data != NULL)
+      {
+        sph_node_data_t* thread_node_data = loop->node_data_bufs.bufs[tid];
+        sph_node_data_t* src = &thread_node_data[i];
+        sph_node_data_t* dest = &node_data[i];
+        dest->zeroth_moment += src->zeroth_moment;
+        dest->first_moment.x += src->first_moment.x;
+        dest->first_moment.y += src->first_moment.y;
+        dest->first_moment.z += src->first_moment.z;
+        dest->second_moment.xx += src->second_moment.xx;
+        dest->second_moment.xy += src->second_moment.xy;
+        dest->second_moment.xz += src->second_moment.xz;
+        dest->second_moment.yy += src->second_moment.yy;
+        dest->second_moment.yz += src->second_moment.yz;
+        dest->second_moment.zz += src->second_moment.zz;
+      }
+    }
+  }
+}
+
+void sph_pair_loop_compute(sph_pair_loop_t* loop,
+                           real_t t,
+                           point_t* points,
+                           sym_tensor2_t* H,
+                           real_t* U,
+                           real_t* dUdt,
+                           sph_node_data_t* node_data)
+{
+  START_FUNCTION_TIMER();
+  allocate_thread_buffers(loop);
+  compute_H_data(loop, H, NULL, false);
+  int num_threads = traverse_pairs(loop, loop->pairing, 0, t, points, H, U, 
+                                   dUdt, node_data);
+  reduce_thread_buffers(loop, num_threads, dUdt, node_data);
+  STOP_FUNCTION_TIMER();
+}
+
+// Splits the loop's pairing into interior pairs (involving no ghost points)
+// and boundary pairs (involving at least one), identifying ghost points as 
+// those received by the pairing's exchanger.
+static void split_pairing(sph_pair_loop_t* loop)
+{
+  int N = loop->num_points;
+  loop->ghosts = polymec_realloc(loop->ghosts, sizeof(bool) * MAX(N, 1));
+  memset(loop->ghosts, 0, sizeof(bool) * MAX(N, 1));
+  int pos = 0, proc, num_indices, *indices;
+  while (exchanger_next_receive(loop->pairing->ex, &pos, &proc, &indices, &num_indices))
+  {
+    for (int k = 0; k < num_indices; ++k)
+    {
+      if (indices[k] < N)
+        loop->ghosts[indices[k]] = true;
+    }
+  }
+
+  int_array_t* interior = int_array_new();
+  int_array_t* boundary = int_array_new();
+  pos = 0;
+  int i, j;
+  while (neighbor_pairing_next(loop->pairing, &pos, &i, &j, NULL))
+  {
+    int_array_t* pairs = (loop->ghosts[i] || loop->ghosts[j]) ? boundary : interior;
+    int_array_append(pairs, i);
+    int_array_append(pairs, j);
+  }
+
+  if (loop->interior != NULL)
+    neighbor_pairing_free(loop->interior);
+  if (loop->boundary != NULL)
+    neighbor_pairing_free(loop->boundary);
+  MPI_Comm comm = exchanger_comm(loop->pairing->ex);
+  loop->interior = neighbor_pairing_new("Interior SPH pairs", 
+                                        (int)(interior->size/2), interior->data, 
+                                        NULL, exchanger_new(comm));
+  loop->boundary = neighbor_pairing_new("Boundary SPH pairs", 
+                                        (int)(boundary->size/2), boundary->data, 
+                                        NULL, exchanger_new(comm));
+  int_array_release_data_and_free(interior);
+  int_array_release_data_and_free(boundary);
+  loop->split_pairing = loop->pairing;
+}
+
+void sph_pair_loop_compute_with_exchange(sph_pair_loop_t* loop,
+                                         real_t t,
+                                         point_t* points,
+                                         sym_tensor2_t* H,
+                                         real_t* U,
+                                         real_t* dUdt,
+                                         sph_node_data_t* node_data)
+{
+  START_FUNCTION_TIMER();
+  allocate_thread_buffers(loop);
+  if (loop->split_pairing != loop->pairing)
+    split_pairing(loop);
+
+  // Start exchanging ghost data.
+  exchanger_t* ex = loop->pairing->ex;
+  int points_token = exchanger_start_exchange(ex, points, 3, 0, MPI_REAL_T);
+  int H_token = exchanger_start_exchange(ex, H, 6, 1, MPI_REAL_T);
+  int U_token = -1;
+  if (U != NULL)
+    U_token = exchanger_start_exchange(ex, U, loop->num_comp, 2, MPI_REAL_T);
+
+  // Traverse the interior pairs while the messages are in flight.
+  compute_H_data(loop, H, loop->ghosts, false);
+  int num_threads = traverse_pairs(loop, loop->interior, 0, t, points, H, U, 
+                                   dUdt, node_data);
+
+  // Finish the exchanges and traverse the boundary pairs.
+  exchanger_finish_exchange(ex, points_token);
+  exchanger_finish_exchange(ex, H_token);
+  if (U != NULL)
+    exchanger_finish_exchange(ex, U_token);
+  compute_H_data(loop, H, loop->ghosts, true);
+  num_threads = traverse_pairs(loop, loop->boundary, num_threads, t, points, 
+                               H, U, dUdt, node_data);
+
+  reduce_thread_buffers(loop, num_threads, dUdt, node_data);
+  STOP_FUNCTION_TIMER();
+}
@@ -0,0 +1,110 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#ifndef POLYWOG_SPH_PAIR_LOOP_H
+#define POLYWOG_SPH_PAIR_LOOP_H
+
+#include "model/neighbor_pairing.h"
+#include "polywog/sph_kernel.h"
+#include "polywog/sph_dynamics.h"
+
+// The SPH pair loop drives the pairwise interactions in a Smoothed Particle
+// Hydrodynamics calculation. It traverses the pairs (i, j) of a neighbor
+// pairing in blocks, evaluates the SPH kernel and its gradient using the
+// smoothing tensors H_i and H_j, and hands these to one or more SPH dynamics
+// objects, accumulating their contributions to the time derivatives of the
+// solution. It also accumulates the moments of each point's neighborhood.
+// If polywog is built with OpenMP, blocks of pairs are distributed among
+// threads, each of which accumulates into its own buffers. These buffers
+// are summed when the loop is finished.
+typedef struct sph_pair_loop_t sph_pair_loop_t;
+
+// Creates a pair loop that evaluates the SPH kernel W over the pairs in the
+// given neighbor pairing for a solution with the given number of components
+// per point. The loop does not assert ownership over the kernel or the
+// pairing.
+sph_pair_loop_t* sph_pair_loop_new(sph_kernel_t* W,
+                                   neighbor_pairing_t* pairing,
+                                   int num_components);
+
+// Destroys the given pair loop.
+void sph_pair_loop_free(sph_pair_loop_t* loop);
+
+// Adds the given SPH dynamics object to the set of those that are evaluated
+// for each pair. Dynamics objects are evaluated in the order in which they
+// are added. The loop does not assert ownership over the dynamics object.
+void sph_pair_loop_add_dynamics(sph_pair_loop_t* loop,
+                                sph_dynamics_t* dynamics);
+
+// Sets the neighbor pairing whose pairs are traversed by the loop. This must
+// be called whenever the pairs in the loop's pairing change (for example,
+// after an update of an sph_neighbor_list), since the loop takes stock of
+// the points spanned by the pairs.
+void sph_pair_loop_set_pairing(sph_pair_loop_t* loop,
+                               neighbor_pairing_t* pairing);
+
+// Returns the neighbor pairing whose pairs are traversed by the loop.
+neighbor_pairing_t* sph_pair_loop_pairing(sph_pair_loop_t* loop);
+
+// Sets the number of pairs in a block, which is the unit of work that is
+// handed to a thread. By default, this is 512.
+void sph_pair_loop_set_block_size(sph_pair_loop_t* loop, int block_size);
+
+// Returns the number of points (locally-owned and ghost) that are spanned
+// by the pairs in the loop's neighbor pairing and by its exchanger. Arrays of point data handed
+// to sph_pair_loop_compute must be at least this long.
+int sph_pair_loop_num_points(sph_pair_loop_t* loop);
+
+// Evaluates all pairwise interactions at time t, given the positions of the
+// points, their smoothing tensors H, and the solution U (in point-major
+// order). The time derivatives of the solution are summed into dUdt, which
+// is zeroed first. If dUdt is NULL, no SPH dynamics are evaluated, and U may
+// also be NULL; this is useful for computing moments alone. If node_data is
+// non-NULL, it is also zeroed and the moments of each point's neighborhood
+// are accumulated there:
+//   zeroth_moment_i = sum_j Wn_ij,
+//   first_moment_i  = sum_j Wn_ij * eta_ij,
+//   second_moment_i = sum_j Wn_ij * eta_ij (x) eta_ij,
+// where eta_ij = H_i o (x_i - x_j) and Wn_ij is the value of the kernel at
+// eta_ij, normalized by det(H_i).
+// For each pair, W_i and grad W_i are computed using H_i, and W_j and
+// grad W_j using H_j, both at the displacement x_i - x_j, so that both
+// gradients are taken with respect to x_i. The node_data argument handed to
+// each SPH dynamics object is an array (indexed by point) of node data
+// private to the calling thread, or NULL if node_data is NULL here.
+// Interacting pairs are gathered into blocks of up to SPH_PAIR_BLOCK_MAX_SIZE
+// pairs, which are handed to each dynamics object's batch compute function
+// (or its scalar compute function, pair by pair, if it has none). If the 
+// kernel can be evaluated in terms of |eta|^2 (see 
+// sph_kernel_has_eta2_compute), it is evaluated for these blocks in batches.
+// Kernels of the built-in types (see sph_kernel_type) are evaluated inline.
+void sph_pair_loop_compute(sph_pair_loop_t* loop,
+                           real_t t,
+                           point_t* points,
+                           sym_tensor2_t* H,
+                           real_t* U,
+                           real_t* dUdt,
+                           sph_node_data_t* node_data);
+
+// Behaves like sph_pair_loop_compute, but first fills in the ghost values
+// of points, H, and U (if non-NULL) using the exchanger of the loop's
+// neighbor pairing, overlapping this exchange with the evaluation of the
+// interior pairs (those that involve no ghost points, which are the points
+// received by the exchanger). The boundary pairs are evaluated once the
+// exchange finishes. The split of the pairing into interior and boundary
+// pairs is computed when first needed and reused until the loop's pairing
+// is next set.
+void sph_pair_loop_compute_with_exchange(sph_pair_loop_t* loop,
+                                         real_t t,
+                                         point_t* points,
+                                         sym_tensor2_t* H,
+                                         real_t* U,
+                                         real_t* dUdt,
+                                         sph_node_data_t* node_data);
+
+#endif
+
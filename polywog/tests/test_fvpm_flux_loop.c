@@ -0,0 +1,177 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include "cmocka.h"
+#include "geometry/create_point_lattice.h"
+#include "polywog/fvpm_interparticle_area.h"
+#include "polywog/fvpm_flux_loop.h"
+#include "polywog/partition_point_cloud_with_neighbors.h"
+
+// This creates a neighbor pairing using a hat function.
+extern neighbor_pairing_t* create_simple_pairing(point_cloud_t* cloud, real_t h);
+
+// This is a central flux for linear advection along x.
+static void advective_flux(void* context, real_t t,
+                           int i, int j,
+                           real_t* Ui, real_t* Uj,
+                           vector_t* beta_ij,
+                           real_t* F)
+{
+  F[0] = 0.5 * (Ui[0] + Uj[0]) * beta_ij->x;
+}
+
+// This is the same flux, evaluated a block of pairs at a time.
+static void advective_flux_batch(void* context, real_t t,
+                                 fvpm_pair_block_t* block,
+                                 int num_components,
+                                 real_t* U,
+                                 real_t* F)
+{
+  for (int p = 0; p < block->num_pairs; ++p)
+    F[p] = 0.5 * (U[block->i[p]] + U[block->j[p]]) * block->beta_x[p];
+}
+
+void test_fvpm_flux_loop_conservation(void** state)
+{
+  bbox_t bbox = {.x1 = 0.0, .x2 = 1.0, .y1 = 0.0, .y2 = 1.0, .z1 = 0.0, .z2 = 1.0};
+  int n = 8;
+  point_cloud_t* cloud = create_uniform_point_lattice(MPI_COMM_SELF, n, n, n, &bbox);
+  real_t h0 = 1.2 / n;
+  neighbor_pairing_t* pairing = create_simple_pairing(cloud, 2.0*h0);
+  int N = cloud->num_points;
+  real_t h[N], U[N], sums1[N], sums2[N];
+  for (int i = 0; i < N; ++i)
+  {
+    h[i] = h0;
+    U[i] = 1.0 + cloud->points[i].x * cloud->points[i].y;
+  }
+
+  fvpm_interparticle_area_t* area = sphere_fvpm_interparticle_area_new(cloud, h, 1.2, NULL);
+  vector_t betas[pairing->num_pairs];
+  fvpm_interparticle_area_compute_pairs(area, pairing, betas);
+
+  fvpm_flux_loop_t* loop1 = fvpm_flux_loop_new(pairing, 1, NULL, advective_flux, NULL);
+  fvpm_flux_loop_set_block_size(loop1, 64);
+  fvpm_flux_loop_compute(loop1, 0.0, betas, N, U, sums1);
+  fvpm_flux_loop_t* loop2 = fvpm_flux_loop_new(pairing, 1, NULL, advective_flux, NULL);
+  fvpm_flux_loop_set_batch_compute(loop2, advective_flux_batch);
+  fvpm_flux_loop_compute(loop2, 0.0, betas, N, U, sums2);
+
+  // The fluxes should sum to zero, and the scalar and batch paths should 
+  // agree.
+  real_t sum = 0.0, max_mag = 0.0;
+  for (int i = 0; i < fvpm_flux_loop_num_points(loop1); ++i)
+  {
+    sum += sums1[i];
+    max_mag = MAX(max_mag, fabs(sums1[i]));
+    assert_true(fabs(sums1[i] - sums2[i]) < 1e-12 * (1.0 + fabs(sums1[i])));
+  }
+  assert_true(max_mag > 0.0);
+  assert_true(fabs(sum) < 1e-10 * max_mag * N);
+
+  // Clean up.
+  fvpm_flux_loop_free(loop1);
+  fvpm_flux_loop_free(loop2);
+  fvpm_interparticle_area_free(area);
+  neighbor_pairing_free(pairing);
+  point_cloud_free(cloud);
+}
+
+// Computes the flux sums for an n x n x n lattice with the given pairing, 
+// whose points (and ghosts) are in the given cloud.
+static void compute_lattice_fluxes(point_cloud_t* cloud, 
+                                   neighbor_pairing_t* pairing,
+                                   real_t h0,
+                                   real_t* sums)
+{
+  int N = cloud->num_points + cloud->num_ghosts;
+  real_t h[N], U[N];
+  for (int i = 0; i < N; ++i)
+  {
+    h[i] = h0;
+    U[i] = 1.0 + cloud->points[i].x * cloud->points[i].y;
+  }
+  fvpm_interparticle_area_t* area = sphere_fvpm_interparticle_area_new(cloud, h, 1.2, NULL);
+  vector_t betas[MAX(pairing->num_pairs, 1)];
+  fvpm_interparticle_area_compute_pairs(area, pairing, betas);
+  fvpm_flux_loop_t* loop = fvpm_flux_loop_new(pairing, 1, NULL, advective_flux, NULL);
+  fvpm_flux_loop_compute(loop, 0.0, betas, N, U, sums);
+  fvpm_flux_loop_free(loop);
+  fvpm_interparticle_area_free(area);
+}
+
+void test_fvpm_flux_loop_distributed(void** state)
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+
+  // Compute the fluxes for the whole lattice on every process.
+  bbox_t bbox = {.x1 = 0.0, .x2 = 1.0, .y1 = 0.0, .y2 = 1.0, .z1 = 0.0, .z2 = 1.0};
+  int n = 8;
+  real_t h0 = 1.2 / n;
+  point_cloud_t* global_cloud = create_uniform_point_lattice(MPI_COMM_SELF, n, n, n, &bbox);
+  neighbor_pairing_t* global_pairing = create_simple_pairing(global_cloud, 2.0*h0);
+  int N_global = global_cloud->num_points;
+  real_t global_sums[N_global];
+  compute_lattice_fluxes(global_cloud, global_pairing, h0, global_sums);
+
+  // Distribute the lattice, and compute the fluxes on each process.
+  point_cloud_t* cloud = NULL;
+  neighbor_pairing_t* pairing = NULL;
+  if (rank == 0)
+  {
+    cloud = create_uniform_point_lattice(MPI_COMM_SELF, n, n, n, &bbox);
+    pairing = create_simple_pairing(cloud, 2.0*h0);
+  }
+  exchanger_t* distributor = partition_point_cloud_with_neighbors_geometrically(&cloud, &pairing, comm, NULL, 0.05, NULL);
+  exchanger_free(distributor);
+  int N = cloud->num_points + cloud->num_ghosts;
+  real_t sums[N];
+  compute_lattice_fluxes(cloud, pairing, h0, sums);
+
+  // The sums for the locally-owned points match those for the whole 
+  // lattice, so each flux is counted exactly once.
+  real_t local_sum = 0.0, max_mag = 0.0;
+  for (int i = 0; i < cloud->num_points; ++i)
+  {
+    int I = 0;
+    while (point_distance(&cloud->points[i], &global_cloud->points[I]) > 1e-12)
+      ++I;
+    assert_true(fabs(sums[i] - global_sums[I]) < 1e-12 * (1.0 + fabs(global_sums[I])));
+    local_sum += sums[i];
+  }
+  for (int I = 0; I < N_global; ++I)
+    max_mag = MAX(max_mag, fabs(global_sums[I]));
+
+  // The fluxes sum to zero over all processes.
+  real_t sum;
+  MPI_Allreduce(&local_sum, &sum, 1, MPI_REAL_T, MPI_SUM, comm);
+  assert_true(max_mag > 0.0);
+  assert_true(fabs(sum) < 1e-10 * max_mag * N_global);
+
+  // Clean up.
+  neighbor_pairing_free(pairing);
+  point_cloud_free(cloud);
+  neighbor_pairing_free(global_pairing);
+  point_cloud_free(global_cloud);
+}
+
+int main(int argc, char* argv[])
+{
+  polymec_init(argc, argv);
+  const struct CMUnitTest tests[] =
+  {
+    cmocka_unit_test(test_fvpm_flux_loop_conservation),
+    cmocka_unit_test(test_fvpm_flux_loop_distributed)
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
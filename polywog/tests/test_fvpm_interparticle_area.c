@@ -0,0 +1,196 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include "cmocka.h"
+#include "geometry/create_point_lattice.h"
+#include "polywog/fvpm_interparticle_area.h"
+
+// This creates a neighbor pairing using a hat function.
+extern neighbor_pairing_t* create_simple_pairing(point_cloud_t* cloud, real_t h);
+
+static point_cloud_t* make_pair(real_t d)
+{
+  point_cloud_t* cloud = point_cloud_new(MPI_COMM_SELF, 2);
+  cloud->points[0].x = cloud->points[0].y = cloud->points[0].z = 0.0;
+  cloud->points[1].x = d;
+  cloud->points[1].y = cloud->points[1].z = 0.0;
+  return cloud;
+}
+
+void test_sphere_interparticle_area(void** state)
+{
+  point_cloud_t* cloud = make_pair(1.0);
+  real_t h[2] = {1.0, 1.0};
+  fvpm_interparticle_area_t* area = sphere_fvpm_interparticle_area_new(cloud, h, 1.0, NULL);
+
+  // Equal spheres at unit separation meet in a circle of radius sqrt(3)/2.
+  vector_t beta_ij, beta_ji;
+  fvpm_interparticle_area_compute(area, 0, 1, &beta_ij);
+  fvpm_interparticle_area_compute(area, 1, 0, &beta_ji);
+  assert_true(fabs(beta_ij.x - 0.75 * M_PI) < 1e-12);
+  assert_true(fabs(beta_ij.y) < 1e-12);
+  assert_true(fabs(beta_ij.z) < 1e-12);
+  assert_true(fabs(beta_ij.x + beta_ji.x) < 1e-12);
+
+  // A sphere inside another has no interparticle area.
+  h[1] = 2.5;
+  fvpm_interparticle_area_compute(area, 0, 1, &beta_ij);
+  assert_true(vector_mag(&beta_ij) == 0.0);
+
+  fvpm_interparticle_area_free(area);
+  point_cloud_free(cloud);
+}
+
+void test_cube_interparticle_area(void** state)
+{
+  point_cloud_t* cloud = make_pair(0.5);
+  real_t h[2] = {1.0, 1.0};
+  fvpm_interparticle_area_t* area = cube_fvpm_interparticle_area_new(cloud, h, 1.0, NULL);
+
+  // Equal cubes offset along x share a full face.
+  vector_t beta_ij, beta_ji;
+  fvpm_interparticle_area_compute(area, 0, 1, &beta_ij);
+  fvpm_interparticle_area_compute(area, 1, 0, &beta_ji);
+  assert_true(fabs(beta_ij.x - 1.0) < 1e-12);
+  assert_true(fabs(beta_ij.y) < 1e-12);
+  assert_true(fabs(beta_ij.z) < 1e-12);
+  assert_true(fabs(beta_ij.x + beta_ji.x) < 1e-12);
+
+  // A cube inside another has no interparticle area.
+  h[0] = 3.0;
+  fvpm_interparticle_area_compute(area, 0, 1, &beta_ij);
+  assert_true(vector_mag(&beta_ij) == 0.0);
+
+  fvpm_interparticle_area_free(area);
+  point_cloud_free(cloud);
+}
+
+void test_interparticle_area_pairs(void** state)
+{
+  bbox_t bbox = {.x1 = 0.0, .x2 = 1.0, .y1 = 0.0, .y2 = 1.0, .z1 = 0.0, .z2 = 1.0};
+  int n = 6;
+  point_cloud_t* cloud = create_uniform_point_lattice(MPI_COMM_SELF, n, n, n, &bbox);
+  real_t h0 = 1.5 / n;
+  neighbor_pairing_t* pairing = create_simple_pairing(cloud, 2.0*h0);
+  int N = cloud->num_points;
+  real_t h[N];
+  for (int i = 0; i < N; ++i)
+    h[i] = h0;
+  fvpm_interparticle_area_t* area = sphere_fvpm_interparticle_area_new(cloud, h, 1.5, NULL);
+
+  // The bulk computation should match the pairwise one.
+  int num_pairs = pairing->num_pairs;
+  vector_t betas[num_pairs];
+  fvpm_interparticle_area_compute_pairs(area, pairing, betas);
+  for (int k = 0; k < num_pairs; ++k)
+  {
+    int i, j;
+    neighbor_pairing_get(pairing, k, &i, &j, NULL);
+    vector_t beta_ij;
+    fvpm_interparticle_area_compute(area, i, j, &beta_ij);
+    assert_true(fabs(beta_ij.x - betas[k].x) < 1e-14);
+    assert_true(fabs(beta_ij.y - betas[k].y) < 1e-14);
+    assert_true(fabs(beta_ij.z - betas[k].z) < 1e-14);
+  }
+
+  // Moving the points invalidates the cached areas.
+  for (int i = 0; i < N; ++i)
+    cloud->points[i].x *= 0.9;
+  vector_t new_betas[num_pairs];
+  fvpm_interparticle_area_compute_pairs(area, pairing, new_betas);
+  for (int k = 0; k < num_pairs; ++k)
+  {
+    int i, j;
+    neighbor_pairing_get(pairing, k, &i, &j, NULL);
+    vector_t beta_ij;
+    fvpm_interparticle_area_compute(area, i, j, &beta_ij);
+    assert_true(fabs(beta_ij.x - new_betas[k].x) < 1e-14);
+  }
+
+  fvpm_interparticle_area_free(area);
+  neighbor_pairing_free(pairing);
+  point_cloud_free(cloud);
+}
+
+// A deterministic "random" number in [-1, 1).
+static real_t pseudo_random(int i)
+{
+  real_t x = sin(12.9898 * i + 78.233) * 43758.5453;
+  return 2.0 * (x - floor(x)) - 1.0;
+}
+
+void test_cube_interparticle_area_consistency(void** state)
+{
+  // Jitter a lattice of points and give them cubes of varying size.
+  bbox_t bbox = {.x1 = 0.0, .x2 = 1.0, .y1 = 0.0, .y2 = 1.0, .z1 = 0.0, .z2 = 1.0};
+  int n = 6;
+  real_t dx = 1.0 / n;
+  point_cloud_t* cloud = create_uniform_point_lattice(MPI_COMM_SELF, n, n, n, &bbox);
+  int N = cloud->num_points;
+  real_t h[N];
+  for (int i = 0; i < N; ++i)
+  {
+    cloud->points[i].x += 0.1 * dx * pseudo_random(4*i);
+    cloud->points[i].y += 0.1 * dx * pseudo_random(4*i+1);
+    cloud->points[i].z += 0.1 * dx * pseudo_random(4*i+2);
+    h[i] = (1.5 + 0.1 * pseudo_random(4*i+3)) * dx;
+  }
+
+  // Cubes of side at most 1.6*dx overlap only if their centers are within 
+  // sqrt(3)*1.6*dx of one another.
+  neighbor_pairing_t* pairing = create_simple_pairing(cloud, 2.8*dx);
+  fvpm_interparticle_area_t* area = cube_fvpm_interparticle_area_new(cloud, h, 1.5, NULL);
+  int num_pairs = pairing->num_pairs;
+  vector_t betas[num_pairs];
+  fvpm_interparticle_area_compute_pairs(area, pairing, betas);
+
+  // Sum the areas for each point.
+  vector_t sums[N];
+  memset(sums, 0, sizeof(vector_t) * N);
+  real_t max_beta = 0.0;
+  for (int k = 0; k < num_pairs; ++k)
+  {
+    int i, j;
+    neighbor_pairing_get(pairing, k, &i, &j, NULL);
+    sums[i].x += betas[k].x; sums[i].y += betas[k].y; sums[i].z += betas[k].z;
+    sums[j].x -= betas[k].x; sums[j].y -= betas[k].y; sums[j].z -= betas[k].z;
+    max_beta = MAX(max_beta, vector_mag(&betas[k]));
+  }
+  assert_true(max_beta > 0.0);
+
+  // The areas of each interior point (whose cube is covered by those of its
+  // neighbors) sum to zero.
+  for (int i = 0; i < N; ++i)
+  {
+    int ix = i / (n*n), iy = (i / n) % n, iz = i % n;
+    if ((ix == 0) || (ix == n-1) || (iy == 0) || (iy == n-1) || 
+        (iz == 0) || (iz == n-1))
+      continue;
+    assert_true(vector_mag(&sums[i]) < 1e-12 * max_beta);
+  }
+
+  fvpm_interparticle_area_free(area);
+  neighbor_pairing_free(pairing);
+  point_cloud_free(cloud);
+}
+
+int main(int argc, char* argv[])
+{
+  polymec_init(argc, argv);
+  const struct CMUnitTest tests[] =
+  {
+    cmocka_unit_test(test_sphere_interparticle_area),
+    cmocka_unit_test(test_cube_interparticle_area),
+    cmocka_unit_test(test_interparticle_area_pairs),
+    cmocka_unit_test(test_cube_interparticle_area_consistency)
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,182 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include "cmocka.h"
+#include "polywog/fvpm_quadrature.h"
+
+// This creates a neighbor pairing using a hat function.
+extern neighbor_pairing_t* create_simple_pairing(point_cloud_t* cloud, real_t h);
+
+static point_cloud_t* make_pair(real_t dx, real_t dy, real_t dz)
+{
+  point_cloud_t* cloud = point_cloud_new(MPI_COMM_SELF, 2);
+  cloud->points[0].x = cloud->points[0].y = cloud->points[0].z = 0.0;
+  cloud->points[1].x = dx;
+  cloud->points[1].y = dy;
+  cloud->points[1].z = dz;
+  return cloud;
+}
+
+// Sums the weights of the surface rule for the 0th pair.
+static real_t surface_area(surface_integral_t* integral)
+{
+  surface_integral_set_domain(integral, 0);
+  int n = surface_integral_num_points(integral);
+  point_t points[n];
+  real_t weights[n];
+  vector_t normals[n];
+  surface_integral_get_quadrature(integral, points, weights, normals);
+  real_t A = 0.0;
+  for (int q = 0; q < n; ++q)
+    A += weights[q];
+  return A;
+}
+
+// Sums the weights of the volume rule for the 0th pair.
+static real_t volume(volume_integral_t* integral)
+{
+  volume_integral_set_domain(integral, 0);
+  int n = volume_integral_num_points(integral);
+  point_t points[n];
+  real_t weights[n];
+  volume_integral_get_quadrature(integral, points, weights);
+  real_t V = 0.0;
+  for (int q = 0; q < n; ++q)
+    V += weights[q];
+  return V;
+}
+
+void test_fvpm_cube_rules(void** state)
+{
+  // Cubes of sides 2 and 1 offset along x and y intersect in a 
+  // 0.75 x 0.75 x 1 box.
+  point_cloud_t* cloud = make_pair(0.75, 0.75, 0.0);
+  neighbor_pairing_t* pairing = create_simple_pairing(cloud, 2.0);
+  assert_int_equal(1, pairing->num_pairs);
+  real_t h[2] = {1.0, 0.5};
+
+  volume_integral_t* vol = fvpm_cube_volume_integral_new(cloud, pairing, h, 3, 2.0);
+  assert_true(fabs(volume(vol) - 0.75*0.75*1.0) < 1e-14);
+  surface_integral_t* surf = fvpm_cube_surface_integral_new(cloud, pairing, h, 3, 2.0);
+  assert_true(fabs(surface_area(surf) - 2.0*(0.75*0.75 + 0.75*1.0 + 1.0*0.75)) < 1e-14);
+
+  surface_integral_free(surf);
+  volume_integral_free(vol);
+  neighbor_pairing_free(pairing);
+  point_cloud_free(cloud);
+}
+
+void test_fvpm_sphere_rules(void** state)
+{
+  // Spheres of radii 1 and 0.75 whose centers are 1.25 apart intersect in a
+  // lens bounded by caps of heights t1 and t2.
+  point_cloud_t* cloud = make_pair(0.0, 0.0, 1.25);
+  neighbor_pairing_t* pairing = create_simple_pairing(cloud, 2.0);
+  real_t h[2] = {2.0, 1.5};
+  real_t d = 1.25, r1 = 1.0, r2 = 0.75;
+  real_t s = 0.5 * (d*d + r1*r1 - r2*r2) / d;
+  real_t t1 = r1 - s, t2 = r2 - (d - s);
+  real_t V = M_PI * t1*t1 * (3.0*r1 - t1) / 3.0 + M_PI * t2*t2 * (3.0*r2 - t2) / 3.0;
+  real_t A = 2.0 * M_PI * (r1*t1 + r2*t2);
+
+  volume_integral_t* vol = fvpm_sphere_volume_integral_new(cloud, pairing, h, 4, 0.5);
+  assert_true(fabs(volume(vol) - V) < 1e-14);
+  surface_integral_t* surf = fvpm_sphere_surface_integral_new(cloud, pairing, h, 4, 0.5);
+  assert_true(fabs(surface_area(surf) - A) < 1e-14);
+
+  // A sphere within another.
+  h[1] = 0.25;
+  cloud->points[1].z = 0.5;
+  assert_true(fabs(volume(vol) - 4.0*M_PI*0.125*0.125*0.125/3.0) < 1e-14);
+  assert_true(fabs(surface_area(surf) - 4.0*M_PI*0.125*0.125) < 1e-14);
+
+  surface_integral_free(surf);
+  volume_integral_free(vol);
+  neighbor_pairing_free(pairing);
+  point_cloud_free(cloud);
+}
+
+void test_fvpm_pair_rules(void** state)
+{
+  // A row of spheres with a few different overlaps.
+  int N = 5;
+  point_cloud_t* cloud = point_cloud_new(MPI_COMM_SELF, N);
+  real_t h[N];
+  for (int i = 0; i < N; ++i)
+  {
+    cloud->points[i].x = 0.4 * i + 0.05 * i * i;
+    cloud->points[i].y = cloud->points[i].z = 0.0;
+    h[i] = 0.5 + 0.1 * i;
+  }
+  neighbor_pairing_t* pairing = create_simple_pairing(cloud, 1.0);
+  int num_pairs = pairing->num_pairs;
+  surface_integral_t* surf = fvpm_sphere_surface_integral_new(cloud, pairing, h, 3, 1.0);
+  volume_integral_t* vol = fvpm_sphere_volume_integral_new(cloud, pairing, h, 3, 1.0);
+
+  // The precomputed rules should be laid out in pair-CSR form, and served
+  // back exactly as the original rules generate them.
+  fvpm_pair_rules_t* surf_rules = fvpm_pair_rules_from_surface_integral(surf, num_pairs);
+  fvpm_pair_rules_t* vol_rules = fvpm_pair_rules_from_volume_integral(vol, num_pairs);
+  assert_int_equal(num_pairs, surf_rules->num_pairs);
+  assert_true(surf_rules->offsets[0] == 0);
+  assert_true(vol_rules->offsets[0] == 0);
+  surface_integral_t* surf2 = fvpm_pair_rules_surface_integral_new(surf_rules);
+  volume_integral_t* vol2 = fvpm_pair_rules_volume_integral_new(vol_rules);
+  for (int k = 0; k < num_pairs; ++k)
+  {
+    surface_integral_set_domain(surf, k);
+    surface_integral_set_domain(surf2, k);
+    int n = surface_integral_num_points(surf);
+    assert_int_equal(n, surface_integral_num_points(surf2));
+    assert_true(surf_rules->offsets[k+1] - surf_rules->offsets[k] == (size_t)n);
+    point_t p1[n], p2[n];
+    real_t w1[n], w2[n];
+    vector_t n1[n], n2[n];
+    surface_integral_get_quadrature(surf, p1, w1, n1);
+    surface_integral_get_quadrature(surf2, p2, w2, n2);
+    assert_true(memcmp(p1, p2, sizeof(point_t) * n) == 0);
+    assert_true(memcmp(w1, w2, sizeof(real_t) * n) == 0);
+    assert_true(memcmp(n1, n2, sizeof(vector_t) * n) == 0);
+
+    volume_integral_set_domain(vol, k);
+    volume_integral_set_domain(vol2, k);
+    int m = volume_integral_num_points(vol);
+    assert_int_equal(m, volume_integral_num_points(vol2));
+    assert_true(vol_rules->offsets[k+1] - vol_rules->offsets[k] == (size_t)m);
+    point_t q1[m], q2[m];
+    real_t v1[m], v2[m];
+    volume_integral_get_quadrature(vol, q1, v1);
+    volume_integral_get_quadrature(vol2, q2, v2);
+    assert_true(memcmp(q1, q2, sizeof(point_t) * m) == 0);
+    assert_true(memcmp(v1, v2, sizeof(real_t) * m) == 0);
+  }
+
+  surface_integral_free(surf2);
+  volume_integral_free(vol2);
+  fvpm_pair_rules_free(surf_rules);
+  fvpm_pair_rules_free(vol_rules);
+  surface_integral_free(surf);
+  volume_integral_free(vol);
+  neighbor_pairing_free(pairing);
+  point_cloud_free(cloud);
+}
+
+int main(int argc, char* argv[])
+{
+  polymec_init(argc, argv);
+  const struct CMUnitTest tests[] =
+  {
+    cmocka_unit_test(test_fvpm_cube_rules),
+    cmocka_unit_test(test_fvpm_sphere_rules),
+    cmocka_unit_test(test_fvpm_pair_rules)
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -12,6 +12,7 @@
 #include "cmocka.h"
 #include "make_mlpg_lattice.h"
 #include "poisson_gmls_functional.h"
+#include "polywog/mlpg_quadrature.h"
 
 void test_gmls_functional_ctor(void** state, int p)
 {
@@ -44,6 +45,124 @@ void test_gmls_functional_ctor_4(void** state)
   test_gmls_functional_ctor(state, 4);
 }
 
+static void zero_integrands(void* context, real_t t, 
+                            multicomp_poly_basis_t* basis, 
+                            point_t* x, vector_t* n, real_t* solution,
+                            real_t* integrands)
+{
+  integrands[0] = 0.0;
+}
+
+void test_adaptive_gmls_functional_ctor(void** state)
+{
+  point_cloud_t* points;
+  real_t* subdomain_extents;
+  bbox_t bbox = {.x1 = 0.0, .x2 = 1.0, .y1 = 0.0, .y2 = 1.0, .z1 = 0.0, .z2 = 1.0};
+  make_mlpg_lattice(&bbox, 10, 10, 10, 2.0, &points, &subdomain_extents, NULL);
+  real_t delta = 0.5;
+  surface_integral_t* Q[3];
+  for (int r = 0; r < 3; ++r)
+    Q[r] = mlpg_cube_surface_integral_new(points, subdomain_extents, 2+r, delta);
+  gmls_functional_vtable vtable = {.eval_integrands = zero_integrands};
+  gmls_functional_t* functional = adaptive_surface_gmls_functional_new("Adaptive", NULL, vtable, 1, 3, Q, 1e-8);
+  assert_int_equal(1, gmls_functional_num_components(functional));
+
+  // No rules have been selected yet.
+  for (int i = 0; i < points->num_points; ++i)
+    assert_int_equal(-1, gmls_functional_quad_rule(functional, i));
+  gmls_functional_reset_quad_rules(functional);
+  assert_int_equal(-1, gmls_functional_quad_rule(functional, 0));
+
+  // Clean up.
+  gmls_functional_free(functional);
+  for (int r = 0; r < 3; ++r)
+    surface_integral_free(Q[r]);
+  point_cloud_free(points);
+  polymec_free(subdomain_extents);
+}
+
+// Context for an integrand x**power that counts its evaluations.
+typedef struct
+{
+  int power;
+  int num_evals;
+} power_context_t;
+
+static void power_integrands(void* context, real_t t, 
+                             multicomp_poly_basis_t* basis, 
+                             point_t* x, vector_t* n, real_t* solution,
+                             real_t* integrands)
+{
+  power_context_t* ctx = context;
+  integrands[0] = pow(x->x, ctx->power);
+  ++(ctx->num_evals);
+}
+
+void test_adaptive_gmls_functional_selection(void** state)
+{
+  // A single cube subdomain of half-side h centered at x0.
+  real_t x0 = 0.3, h = 0.7;
+  point_cloud_t* points = point_cloud_new(MPI_COMM_SELF, 1);
+  points->points[0].x = x0;
+  points->points[0].y = -0.2;
+  points->points[0].z = 0.5;
+
+  // Rules that are exact for polynomials of degree 1, 3, and 5.
+  volume_integral_t* Q[3];
+  int num_quad_points[3];
+  for (int r = 0; r < 3; ++r)
+  {
+    Q[r] = mlpg_cube_symmetric_volume_integral_new(points, &h, 1+2*r, 2.0);
+    volume_integral_set_domain(Q[r], 0);
+    num_quad_points[r] = volume_integral_num_points(Q[r]);
+  }
+  power_context_t context = {.power = 1, .num_evals = 0};
+  gmls_functional_vtable vtable = {.eval_integrands = power_integrands};
+  gmls_functional_t* functional = adaptive_volume_gmls_functional_new("Adaptive", &context, vtable, 1, 3, Q, 1e-8);
+  multicomp_poly_basis_t* P = standard_multicomp_poly_basis_new(1, 0);
+  assert_int_equal(1, multicomp_poly_basis_dim(P));
+  real_t V = 8.0*h*h*h, lambda;
+
+  // The lowest-order rule integrates x exactly, so it agrees with the next 
+  // rule and is selected.
+  gmls_functional_compute(functional, 0, 0.0, P, NULL, &lambda);
+  assert_int_equal(0, gmls_functional_quad_rule(functional, 0));
+  assert_int_equal(num_quad_points[0] + num_quad_points[1], context.num_evals);
+  assert_true(fabs(lambda - V*x0) < 1e-12);
+
+  // Once selected, only that rule is used.
+  context.num_evals = 0;
+  gmls_functional_compute(functional, 0, 0.0, P, NULL, &lambda);
+  assert_int_equal(0, gmls_functional_quad_rule(functional, 0));
+  assert_int_equal(num_quad_points[0], context.num_evals);
+  assert_true(fabs(lambda - V*x0) < 1e-12);
+
+  // The lowest-order rule doesn't integrate x**2 exactly, but the next 
+  // one does, and it agrees with the last.
+  gmls_functional_reset_quad_rules(functional);
+  assert_int_equal(-1, gmls_functional_quad_rule(functional, 0));
+  context.power = 2;
+  context.num_evals = 0;
+  real_t I = V * (x0*x0 + h*h/3.0);
+  gmls_functional_compute(functional, 0, 0.0, P, NULL, &lambda);
+  assert_int_equal(1, gmls_functional_quad_rule(functional, 0));
+  assert_int_equal(num_quad_points[0] + num_quad_points[1] + num_quad_points[2], 
+                   context.num_evals);
+  assert_true(fabs(lambda - I) < 1e-12);
+
+  context.num_evals = 0;
+  gmls_functional_compute(functional, 0, 0.0, P, NULL, &lambda);
+  assert_int_equal(1, gmls_functional_quad_rule(functional, 0));
+  assert_int_equal(num_quad_points[1], context.num_evals);
+  assert_true(fabs(lambda - I) < 1e-12);
+
+  // Clean up.
+  gmls_functional_free(functional);
+  for (int r = 0; r < 3; ++r)
+    volume_integral_free(Q[r]);
+  point_cloud_free(points);
+}
+
 int main(int argc, char* argv[]) 
 {
   polymec_init(argc, argv);
@@ -51,7 +170,9 @@ int main(int argc, char* argv[])
   {
     cmocka_unit_test(test_gmls_functional_ctor_2),
     cmocka_unit_test(test_gmls_functional_ctor_3),
-    cmocka_unit_test(test_gmls_functional_ctor_4)
+    cmocka_unit_test(test_gmls_functional_ctor_4),
+    cmocka_unit_test(test_adaptive_gmls_functional_ctor),
+    cmocka_unit_test(test_adaptive_gmls_functional_selection)
   };
   return cmocka_run_group_tests(tests, NULL, NULL);
 }
@@ -437,11 +437,28 @@ void test_gmls_matrix_with_cantileaver_beam(void** state)
     int_unordered_set_insert(boundary_nodes, bnode);
   }
 
-  // Now interior nodes.
-  for (int i = 0; i < points->num_points; ++i)
+  // Now interior nodes. We exchange the extents of ghost points while we 
+  // assemble the subdomains that don't involve them, and then assemble the 
+  // rest.
+  int_array_t* local_subdomains = int_array_new();
+  int_array_t* ghost_subdomains = int_array_new();
+  gmls_matrix_split_subdomains(matrix, points->num_points, points->num_points, 
+                               local_subdomains, ghost_subdomains);
+  assert_int_equal(points->num_points, local_subdomains->size + ghost_subdomains->size);
+  int token = stencil_start_exchange(stencil, extents, 1, 0, MPI_REAL_T);
+  for (int phase = 0; phase < 2; ++phase)
   {
-    if (!int_unordered_set_contains(boundary_nodes, i))
+    int_array_t* subdomains = local_subdomains;
+    if (phase == 1)
     {
+      stencil_finish_exchange(stencil, token);
+      subdomains = ghost_subdomains;
+    }
+    for (size_t s = 0; s < subdomains->size; ++s)
+    {
+      int i = subdomains->data[s];
+      if (int_unordered_set_contains(boundary_nodes, i)) continue;
+
       int num_coeffs = gmls_matrix_num_coeffs(matrix, i);
       int rows[num_coeffs], cols[num_coeffs];
       real_t coeffs[num_coeffs];
@@ -466,6 +483,8 @@ void test_gmls_matrix_with_cantileaver_beam(void** state)
       volume_integral_compute(Qv, F, &B[3*i]);
     }
   }
+  int_array_free(local_subdomains);
+  int_array_free(ghost_subdomains);
 //  real_t diag_A[3*N];
 //  local_matrix_get_diagonal(A, diag_A);
 //printf("diag A = [");
@@ -0,0 +1,286 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include "cmocka.h"
+#include "polywog/mlpg_quadrature.h"
+
+// The center of the subdomain and the extent of the point.
+static const real_t x0[3] = {0.3, -0.2, 0.5};
+static real_t extent = 0.7;
+
+static point_cloud_t* make_point()
+{
+  point_cloud_t* cloud = point_cloud_new(MPI_COMM_SELF, 1);
+  cloud->points[0].x = x0[0];
+  cloud->points[0].y = x0[1];
+  cloud->points[0].z = x0[2];
+  return cloud;
+}
+
+// Returns the integral of x**p over [a, b].
+static real_t power_integral(real_t a, real_t b, int p)
+{
+  return (pow(b, p+1) - pow(a, p+1)) / (p+1);
+}
+
+// Returns the integral of x**p[0] * y**p[1] * z**p[2] over the cube of
+// half-side h centered at x0.
+static real_t cube_volume_moment(real_t h, int* p)
+{
+  real_t I = 1.0;
+  for (int d = 0; d < 3; ++d)
+    I *= power_integral(x0[d] - h, x0[d] + h, p[d]);
+  return I;
+}
+
+// Returns the integral of x**p[0] * y**p[1] * z**p[2] over the surface of
+// the cube of half-side h centered at x0.
+static real_t cube_surface_moment(real_t h, int* p)
+{
+  real_t I = 0.0;
+  for (int d = 0; d < 3; ++d)
+  {
+    int d1 = (d+1)%3, d2 = (d+2)%3;
+    real_t face = power_integral(x0[d1] - h, x0[d1] + h, p[d1]) *
+                  power_integral(x0[d2] - h, x0[d2] + h, p[d2]);
+    I += (pow(x0[d] - h, p[d]) + pow(x0[d] + h, p[d])) * face;
+  }
+  return I;
+}
+
+// Returns the integral of (x-x0)**p[0] * (y-y0)**p[1] * (z-z0)**p[2] over
+// the sphere of radius R centered at x0.
+static real_t sphere_surface_moment(real_t R, int* p)
+{
+  if ((p[0] % 2) || (p[1] % 2) || (p[2] % 2))
+    return 0.0;
+  int n = p[0] + p[1] + p[2];
+  return 2.0 * tgamma(0.5*(p[0]+1)) * tgamma(0.5*(p[1]+1)) * tgamma(0.5*(p[2]+1)) /
+         tgamma(0.5*(n+3)) * pow(R, n+2);
+}
+
+// Evaluates the monomial with the given powers at x, relative to the
+// given origin.
+static real_t monomial(point_t* x, const real_t* origin, int* p)
+{
+  return pow(x->x - origin[0], p[0]) * pow(x->y - origin[1], p[1]) *
+         pow(x->z - origin[2], p[2]);
+}
+
+static void test_volume_rule(volume_integral_t* integral, int degree, real_t h)
+{
+  static const real_t zero[3] = {0.0, 0.0, 0.0};
+  volume_integral_set_domain(integral, 0);
+  int n = volume_integral_num_points(integral);
+  point_t points[n];
+  real_t weights[n];
+  volume_integral_get_quadrature(integral, points, weights);
+  int p[3];
+  for (p[0] = 0; p[0] <= degree; ++p[0])
+  {
+    for (p[1] = 0; p[0] + p[1] <= degree; ++p[1])
+    {
+      for (p[2] = 0; p[0] + p[1] + p[2] <= degree; ++p[2])
+      {
+        real_t I = 0.0;
+        for (int q = 0; q < n; ++q)
+          I += weights[q] * monomial(&points[q], zero, p);
+        real_t I_exact = cube_volume_moment(h, p);
+        assert_true(fabs(I - I_exact) < 1e-12 * MAX(1.0, fabs(I_exact)));
+      }
+    }
+  }
+}
+
+static void test_surface_rule(surface_integral_t* integral, int degree,
+                              bool sphere, real_t h)
+{
+  static const real_t zero[3] = {0.0, 0.0, 0.0};
+  surface_integral_set_domain(integral, 0);
+  int n = surface_integral_num_points(integral);
+  point_t points[n];
+  real_t weights[n];
+  vector_t normals[n];
+  surface_integral_get_quadrature(integral, points, weights, normals);
+  int p[3];
+  for (p[0] = 0; p[0] <= degree; ++p[0])
+  {
+    for (p[1] = 0; p[0] + p[1] <= degree; ++p[1])
+    {
+      for (p[2] = 0; p[0] + p[1] + p[2] <= degree; ++p[2])
+      {
+        real_t I = 0.0, I_exact;
+        if (sphere)
+        {
+          for (int q = 0; q < n; ++q)
+            I += weights[q] * monomial(&points[q], x0, p);
+          I_exact = sphere_surface_moment(h, p);
+        }
+        else
+        {
+          for (int q = 0; q < n; ++q)
+            I += weights[q] * monomial(&points[q], zero, p);
+          I_exact = cube_surface_moment(h, p);
+        }
+        assert_true(fabs(I - I_exact) < 1e-12 * MAX(1.0, fabs(I_exact)));
+      }
+    }
+  }
+}
+
+void test_mlpg_cube_symmetric_volume_integral(void** state)
+{
+  point_cloud_t* cloud = make_point();
+  for (int degree = 0; degree <= 9; ++degree)
+  {
+    // Cubes of side 2*extent.
+    volume_integral_t* integral = mlpg_cube_symmetric_volume_integral_new(cloud, &extent, degree, 2.0);
+    test_volume_rule(integral, degree, extent);
+    volume_integral_free(integral);
+  }
+  point_cloud_free(cloud);
+}
+
+void test_mlpg_cube_symmetric_surface_integral(void** state)
+{
+  point_cloud_t* cloud = make_point();
+  for (int degree = 0; degree <= 9; ++degree)
+  {
+    surface_integral_t* integral = mlpg_cube_symmetric_surface_integral_new(cloud, &extent, degree, 2.0);
+    test_surface_rule(integral, degree, false, extent);
+    surface_integral_free(integral);
+  }
+  point_cloud_free(cloud);
+}
+
+void test_mlpg_sphere_lebedev_surface_integral(void** state)
+{
+  point_cloud_t* cloud = make_point();
+  for (int degree = 0; degree <= 13; ++degree)
+  {
+    // Spheres of radius 1.5*extent.
+    surface_integral_t* integral = mlpg_sphere_lebedev_surface_integral_new(cloud, &extent, degree, 1.5);
+    test_surface_rule(integral, degree, true, 1.5*extent);
+    surface_integral_free(integral);
+  }
+  point_cloud_free(cloud);
+}
+
+// Sums the weights of the volume rule for the 0th point.
+static real_t volume(volume_integral_t* integral)
+{
+  volume_integral_set_domain(integral, 0);
+  int n = volume_integral_num_points(integral);
+  point_t points[n];
+  real_t weights[n];
+  volume_integral_get_quadrature(integral, points, weights);
+  real_t V = 0.0;
+  for (int q = 0; q < n; ++q)
+    V += weights[q];
+  return V;
+}
+
+// Sums the weights of the surface rule for the 0th point.
+static real_t surface_area(surface_integral_t* integral)
+{
+  surface_integral_set_domain(integral, 0);
+  int n = surface_integral_num_points(integral);
+  point_t points[n];
+  real_t weights[n];
+  vector_t normals[n];
+  surface_integral_get_quadrature(integral, points, weights, normals);
+  real_t A = 0.0;
+  for (int q = 0; q < n; ++q)
+    A += weights[q];
+  return A;
+}
+
+// The region below the plane z = 0.5.
+static void below_plane(void* context, point_t* x, real_t* phi)
+{
+  phi[0] = x->z - 0.5;
+}
+
+// The slab 0.2 < z < 0.4.
+static void slab(void* context, point_t* x, real_t* phi)
+{
+  phi[0] = fabs(x->z - 0.3) - 0.1;
+}
+
+void test_mlpg_clipped_cube_integrals(void** state)
+{
+  // The cube about the point is [-0.4, 1.0] x [-0.9, 0.5] x [-0.2, 1.2].
+  point_cloud_t* cloud = make_point();
+
+  // Clipped to the unit box, it is [0, 1] x [0, 0.5] x [0, 1], of whose 
+  // faces only the one at y = 0.5 lies within the box.
+  bbox_t box = {.x1 = 0.0, .x2 = 1.0, .y1 = 0.0, .y2 = 1.0, .z1 = 0.0, .z2 = 1.0};
+  volume_integral_t* vol = mlpg_clipped_cube_volume_integral_new(cloud, &extent, 3, 2.0, &box, NULL);
+  surface_integral_t* surf = mlpg_clipped_cube_surface_integral_new(cloud, &extent, 3, 2.0, &box, NULL);
+  assert_true(fabs(volume(vol) - 0.5) < 1e-14);
+  assert_true(fabs(surface_area(surf) - 1.0) < 1e-14);
+  volume_integral_free(vol);
+  surface_integral_free(surf);
+
+  // If the point and its extent change, the rule changes with them. Here 
+  // the cube [0.25, 0.75]^3 lies entirely within the box.
+  point_cloud_t* moving_cloud = make_point();
+  real_t h = extent;
+  vol = mlpg_clipped_cube_volume_integral_new(moving_cloud, &h, 3, 2.0, &box, NULL);
+  assert_true(fabs(volume(vol) - 0.5) < 1e-14);
+  moving_cloud->points[0].x = moving_cloud->points[0].y = moving_cloud->points[0].z = 0.5;
+  h = 0.25;
+  assert_true(fabs(volume(vol) - 0.125) < 1e-14);
+  volume_integral_free(vol);
+  point_cloud_free(moving_cloud);
+
+  // Clipped to a slab much thinner than the cube, only the four sides 
+  // remain within it.
+  bbox_t thin_slab = {.x1 = -1.0, .x2 = 2.0, .y1 = -1.0, .y2 = 2.0, .z1 = 0.1, .z2 = 0.12};
+  vol = mlpg_clipped_cube_volume_integral_new(cloud, &extent, 3, 2.0, &thin_slab, NULL);
+  surf = mlpg_clipped_cube_surface_integral_new(cloud, &extent, 3, 2.0, &thin_slab, NULL);
+  assert_true(fabs(volume(vol) - 1.4*1.4*0.02) < 1e-14);
+  assert_true(fabs(surface_area(surf) - 4.0*1.4*0.02) < 1e-14);
+  volume_integral_free(vol);
+  surface_integral_free(surf);
+
+  // Clipped to implicit functions whose boundaries cross the lines of the 
+  // volume rule, the volume is exact to within the tolerance of the roots.
+  sp_func_t* plane = sp_func_from_func("plane", below_plane, SP_FUNC_HETEROGENEOUS, 1);
+  vol = mlpg_clipped_cube_volume_integral_new(cloud, &extent, 3, 2.0, NULL, plane);
+  assert_true(fabs(volume(vol) - 1.4*1.4*0.7) < 1e-10);
+  volume_integral_free(vol);
+  sp_func_t* implicit_slab = sp_func_from_func("slab", slab, SP_FUNC_HETEROGENEOUS, 1);
+  vol = mlpg_clipped_cube_volume_integral_new(cloud, &extent, 3, 2.0, NULL, implicit_slab);
+  assert_true(fabs(volume(vol) - 1.4*1.4*0.2) < 1e-10);
+  volume_integral_free(vol);
+
+  // Clipped to the unit box and then to the plane, the cube is 
+  // [0, 1] x [0, 0.5] x [0, 0.5].
+  vol = mlpg_clipped_cube_volume_integral_new(cloud, &extent, 3, 2.0, &box, plane);
+  assert_true(fabs(volume(vol) - 0.25) < 1e-10);
+  volume_integral_free(vol);
+
+  point_cloud_free(cloud);
+}
+
+int main(int argc, char* argv[])
+{
+  polymec_init(argc, argv);
+  const struct CMUnitTest tests[] =
+  {
+    cmocka_unit_test(test_mlpg_cube_symmetric_volume_integral),
+    cmocka_unit_test(test_mlpg_cube_symmetric_surface_integral),
+    cmocka_unit_test(test_mlpg_sphere_lebedev_surface_integral),
+    cmocka_unit_test(test_mlpg_clipped_cube_integrals)
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
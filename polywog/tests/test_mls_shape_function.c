@@ -56,6 +56,10 @@ void test_mls_shape_function_ctor(void** state, int p)
   for (int i = 0; i < domain->num_points; ++i)
     shape_function_set_neighborhood(phi, i);
 
+  // Finishing the ghost exchange explicitly is harmless once it's done.
+  shape_function_finish_exchange(phi);
+  shape_function_finish_exchange(phi);
+
   // Clean up.
   shape_function_free(phi);
   point_cloud_free(domain);
@@ -38,11 +38,11 @@ void test_partition_linear_cloud(void** state, int N)
   }
 
   // Partition it.
-  exchanger_t* distributor = partition_point_cloud_with_neighbors(&cloud, &pairing, comm, NULL, 0.05);
+  exchanger_t* distributor = partition_point_cloud_with_neighbors(&cloud, &pairing, comm, NULL, 0.05, NULL);
   exchanger_free(distributor);
 
-  // Now check data. Points should all fall on dx tick marks.
-  for (int i = 0; i < cloud->num_points; ++i)
+  // Now check data. Points (including ghosts) should all fall on dx tick marks.
+  for (int i = 0; i < cloud->num_points + cloud->num_ghosts; ++i)
   {
     real_t x = cloud->points[i].x;
     real_t y = cloud->points[i].y;
@@ -53,6 +53,17 @@ void test_partition_linear_cloud(void** state, int N)
     assert_true(fabs(z - 0.5) < 1e-6);
   }
 
+  // Check the quality of the partition.
+  partition_quality_t quality;
+  partition_quality_compute(cloud, pairing, NULL, NULL, &quality);
+  assert_int_equal(nprocs, quality.num_processes);
+  assert_int_equal(N, (int)quality.num_points);
+  assert_true(quality.edge_cut >= 0);
+
+  // A dry run of a repartitioning should see all of the same points.
+  repartition_point_cloud_with_neighbors_dry_run(cloud, pairing, NULL, 0.05, &quality);
+  assert_int_equal(N, (int)quality.num_points);
+
   // Plot it.
   double p[cloud->num_points];
   for (int i = 0; i < cloud->num_points; ++i)
@@ -75,6 +86,64 @@ void test_partition_linear_cloud(void** state, int N)
   assert_int_equal(nprocs, num_procs);
 }
 
+void test_partition_linear_cloud_geometrically(void** state, int N)
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int rank, nprocs;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nprocs);
+
+  // Create an Nx1x1 uniform point cloud and a neighbor pairing for it.
+  real_t dx = 1.0/N;
+  point_cloud_t* cloud = NULL;
+  neighbor_pairing_t* pairing = NULL;
+  if (rank == 0)
+  {
+    bbox_t bbox = {.x1 = 0.0, .x2 = 1.0, .y1 = 0.0, .y2 = 1.0, .z1 = 0.0, .z2 = 1.0};
+    cloud = create_uniform_point_lattice(MPI_COMM_SELF, N, 1, 1, &bbox);
+    pairing = create_simple_pairing(cloud, 1.2*dx);
+  }
+
+  // Partition it by recursive coordinate bisection.
+  exchanger_t* distributor = partition_point_cloud_with_neighbors_geometrically(&cloud, &pairing, comm, NULL, 0.05, NULL);
+  exchanger_free(distributor);
+
+  // Make sure we haven't lost any points, and that they (and their ghosts)
+  // all fall on dx tick marks.
+  int num_points = cloud->num_points;
+  MPI_Allreduce(MPI_IN_PLACE, &num_points, 1, MPI_INT, MPI_SUM, comm);
+  assert_int_equal(N, num_points);
+  for (int i = 0; i < cloud->num_points + cloud->num_ghosts; ++i)
+  {
+    real_t x = cloud->points[i].x;
+    int j = lround(x/dx - 0.5);
+    assert_true(fabs(x - (0.5+j)*dx) < 1e-6);
+    assert_true(fabs(cloud->points[i].y - 0.5) < 1e-6);
+    assert_true(fabs(cloud->points[i].z - 0.5) < 1e-6);
+  }
+
+  // A line cut into slabs is only cut between neighboring slabs.
+  partition_quality_t quality;
+  partition_quality_compute(cloud, pairing, NULL, NULL, &quality);
+  assert_true(quality.edge_cut <= nprocs - 1);
+  assert_true(quality.neighbor_processes.max <= 2.0);
+
+  // Plot it.
+  double p[cloud->num_points];
+  for (int i = 0; i < cloud->num_points; ++i)
+    p[i] = 1.0*rank;
+  char filename[FILENAME_MAX];
+  snprintf(filename, FILENAME_MAX, "linear_cloud_rcb_partition_with_neighbors_%d", N);
+  silo_file_t* silo = silo_file_new(comm, filename, filename, 1, 0, 0, 0.0);
+  silo_file_write_point_cloud(silo, "cloud", cloud);
+  silo_file_write_scalar_point_field(silo, "rank", "cloud", p, NULL);
+  silo_file_close(silo);
+
+  // Clean up.
+  neighbor_pairing_free(pairing);
+  point_cloud_free(cloud);
+}
+
 void test_partition_planar_cloud(void** state, int nx, int ny)
 {
   MPI_Comm comm = MPI_COMM_WORLD;
@@ -96,7 +165,7 @@ void test_partition_planar_cloud(void** state, int nx, int ny)
   }
 
   // Partition it.
-  exchanger_t* distributor = partition_point_cloud_with_neighbors(&cloud, &pairing, comm, NULL, 0.05);
+  exchanger_t* distributor = partition_point_cloud_with_neighbors(&cloud, &pairing, comm, NULL, 0.05, NULL);
   exchanger_free(distributor);
 
 #if 0
@@ -156,7 +225,7 @@ void test_partition_cubic_cloud(void** state, int nx, int ny, int nz)
   }
 
   // Partition it.
-  exchanger_t* distributor = partition_point_cloud_with_neighbors(&cloud, &pairing, comm, NULL, 0.05);
+  exchanger_t* distributor = partition_point_cloud_with_neighbors(&cloud, &pairing, comm, NULL, 0.05, NULL);
   exchanger_free(distributor);
 
 #if 0
@@ -195,6 +264,147 @@ void test_partition_cubic_cloud(void** state, int nx, int ny, int nz)
   assert_int_equal(nprocs, num_procs);
 }
 
+void test_repartition_linear_cloud(void** state)
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int rank, nprocs;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nprocs);
+
+  // Create and partition a uniform Nx1x1 point cloud.
+  int N = 1000;
+  real_t dx = 1.0/N;
+  point_cloud_t* cloud = NULL;
+  neighbor_pairing_t* pairing = NULL;
+  if (rank == 0)
+  {
+    bbox_t bbox = {.x1 = 0.0, .x2 = 1.0, .y1 = 0.0, .y2 = 1.0, .z1 = 0.0, .z2 = 1.0};
+    cloud = create_uniform_point_lattice(MPI_COMM_SELF, N, 1, 1, &bbox);
+    pairing = create_simple_pairing(cloud, 1.2*dx);
+  }
+  exchanger_t* distributor = partition_point_cloud_with_neighbors_geometrically(&cloud, &pairing, comm, NULL, 0.05, NULL);
+  exchanger_free(distributor);
+
+  // Tag the points in the left half of the cloud.
+  int num_left = 0;
+  for (int i = 0; i < cloud->num_points; ++i)
+  {
+    if (cloud->points[i].x < 0.5)
+      ++num_left;
+  }
+  int* left = tagger_create_tag(cloud->tags, "left", num_left);
+  for (int i = 0, k = 0; i < cloud->num_points; ++i)
+  {
+    if (cloud->points[i].x < 0.5)
+      left[k++] = i;
+  }
+
+  // Repartition it with costs that grow with x, carrying x and the index 
+  // of each point along as fields.
+  real_t* costs = polymec_malloc(sizeof(real_t) * cloud->num_points);
+  real_t* x = polymec_malloc(sizeof(real_t) * cloud->num_points);
+  int* index = polymec_malloc(sizeof(int) * cloud->num_points);
+  for (int i = 0; i < cloud->num_points; ++i)
+  {
+    costs[i] = 1.0 + 10.0 * cloud->points[i].x;
+    x[i] = cloud->points[i].x;
+    index[i] = (int)lround(cloud->points[i].x/dx - 0.5);
+  }
+  point_field_set_t* fields = point_field_set_new();
+  point_field_set_add_reals(fields, &x, 1);
+  point_field_set_add_ints(fields, &index, 1);
+  repartition_point_cloud_with_neighbors(&cloud, &pairing, costs, 0.05, fields);
+  point_field_set_free(fields);
+  polymec_free(costs);
+
+  // Make sure we haven't lost any points, and that the fields moved with 
+  // them.
+  int num_points = cloud->num_points;
+  MPI_Allreduce(MPI_IN_PLACE, &num_points, 1, MPI_INT, MPI_SUM, comm);
+  assert_int_equal(N, num_points);
+  for (int i = 0; i < cloud->num_points + cloud->num_ghosts; ++i)
+  {
+    assert_true(fabs(x[i] - cloud->points[i].x) < 1e-12);
+    assert_int_equal(index[i], (int)lround(cloud->points[i].x/dx - 0.5));
+  }
+
+  // Make sure the tag moved with the points, too.
+  size_t left_size;
+  left = tagger_tag(cloud->tags, "left", &left_size);
+  assert_true(left != NULL);
+  num_left = 0;
+  for (int i = 0; i < cloud->num_points; ++i)
+  {
+    if (cloud->points[i].x < 0.5)
+      ++num_left;
+  }
+  assert_int_equal(num_left, (int)left_size);
+  for (size_t k = 0; k < left_size; ++k)
+  {
+    assert_true(left[k] < cloud->num_points);
+    assert_true(cloud->points[left[k]].x < 0.5);
+  }
+  MPI_Allreduce(MPI_IN_PLACE, &num_left, 1, MPI_INT, MPI_SUM, comm);
+  assert_int_equal(N/2, num_left);
+
+  // Clean up.
+  polymec_free(index);
+  polymec_free(x);
+  neighbor_pairing_free(pairing);
+  point_cloud_free(cloud);
+}
+
+void test_partition_distributed_linear_cloud(void** state)
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int rank, nprocs;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nprocs);
+
+  // Deal the points of a uniform Nx1x1 point cloud out to the processes 
+  // like cards, so that each process gets points from all over.
+  int N = 1000;
+  real_t dx = 1.0/N;
+  int num_points = 0;
+  for (int i = rank; i < N; i += nprocs)
+    ++num_points;
+  point_cloud_t* cloud = point_cloud_new(comm, num_points);
+  real_t* R = polymec_malloc(sizeof(real_t) * num_points);
+  for (int i = rank, k = 0; i < N; i += nprocs, ++k)
+  {
+    cloud->points[k].x = (0.5+i)*dx;
+    cloud->points[k].y = 0.5;
+    cloud->points[k].z = 0.5;
+    R[k] = 1.2*dx;
+  }
+
+  // Partition it.
+  neighbor_pairing_t* pairing = NULL;
+  partition_distributed_point_cloud_with_neighbors(&cloud, &R, &pairing, NULL, 0.05, NULL);
+
+  // Make sure we haven't lost any points, and that each point has its 
+  // nearest neighbors.
+  num_points = cloud->num_points;
+  MPI_Allreduce(MPI_IN_PLACE, &num_points, 1, MPI_INT, MPI_SUM, comm);
+  assert_int_equal(N, num_points);
+  int num_neighbors = 0, pos = 0, i, j;
+  while (neighbor_pairing_next(pairing, &pos, &i, &j, NULL))
+  {
+    assert_true(fabs(fabs(cloud->points[i].x - cloud->points[j].x) - dx) < 1e-12);
+    if (i < cloud->num_points) ++num_neighbors;
+    if (j < cloud->num_points) ++num_neighbors;
+  }
+  MPI_Allreduce(MPI_IN_PLACE, &num_neighbors, 1, MPI_INT, MPI_SUM, comm);
+  assert_int_equal(2*(N-1), num_neighbors);
+  for (int i = 0; i < cloud->num_points + cloud->num_ghosts; ++i)
+    assert_true(fabs(R[i] - 1.2*dx) < 1e-12);
+
+  // Clean up.
+  polymec_free(R);
+  neighbor_pairing_free(pairing);
+  point_cloud_free(cloud);
+}
+
 void test_partition_small_linear_cloud(void** state)
 {
   test_partition_linear_cloud(state, 10);
@@ -205,6 +415,16 @@ void test_partition_large_linear_cloud(void** state)
   test_partition_linear_cloud(state, 1000);
 }
 
+void test_partition_small_linear_cloud_geometrically(void** state)
+{
+  test_partition_linear_cloud_geometrically(state, 10);
+}
+
+void test_partition_large_linear_cloud_geometrically(void** state)
+{
+  test_partition_linear_cloud_geometrically(state, 1000);
+}
+
 void test_partition_small_planar_cloud(void** state)
 {
   test_partition_planar_cloud(state, 10, 10);
@@ -232,6 +452,10 @@ int main(int argc, char* argv[])
   {
     cmocka_unit_test(test_partition_small_linear_cloud),
     cmocka_unit_test(test_partition_large_linear_cloud),
+    cmocka_unit_test(test_partition_small_linear_cloud_geometrically),
+    cmocka_unit_test(test_partition_large_linear_cloud_geometrically),
+    cmocka_unit_test(test_repartition_linear_cloud),
+    cmocka_unit_test(test_partition_distributed_linear_cloud),
     cmocka_unit_test(test_partition_small_planar_cloud),
     cmocka_unit_test(test_partition_large_planar_cloud),
     cmocka_unit_test(test_partition_small_cubic_cloud),
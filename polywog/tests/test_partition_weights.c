@@ -0,0 +1,65 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+// 
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include "cmocka.h"
+#include "polywog/partition_weights.h"
+
+void test_point_weights_from_constraints(void** state)
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int rank, nprocs;
+  MPI_Comm_rank(comm, &rank);
+  MPI_Comm_size(comm, &nprocs);
+
+  // Process p owns p+1 points, whose global indices follow those of the 
+  // points on the processes before it. The first constraint is uniform, and 
+  // the second grows with the global index.
+  int N = nprocs * (nprocs + 1) / 2;
+  int num_points = rank + 1, first = rank * (rank + 1) / 2;
+  real_t c0[num_points], c1[num_points];
+  for (int i = 0; i < num_points; ++i)
+  {
+    c0[i] = 1.0;
+    c1[i] = 1.0 + first + i;
+  }
+  real_t* constraints[2] = {c0, c1};
+  int max_weight = 1000;
+  int* weights = point_weights_from_constraints(comm, num_points, 2, constraints, max_weight);
+
+  // The weights of all the points are gathered on rank 0, in order of their
+  // global indices. (They may differ by 1 from those computed here, since 
+  // the normalized constraints are summed in a different order.)
+  if (rank == 0)
+  {
+    assert_true(weights != NULL);
+    real_t max_combined = 1.0/N + 2.0/(N+1);
+    for (int g = 0; g < N; ++g)
+    {
+      real_t combined = 1.0/N + 2.0*(g+1)/(N*(N+1.0));
+      int weight = MAX(1, (int)lround(max_weight * combined / max_combined));
+      assert_true(abs(weight - weights[g]) <= 1);
+    }
+    assert_int_equal(max_weight, weights[N-1]);
+    polymec_free(weights);
+  }
+  else
+    assert_true(weights == NULL);
+}
+
+int main(int argc, char* argv[])
+{
+  polymec_init(argc, argv);
+  const struct CMUnitTest tests[] =
+  {
+    cmocka_unit_test(test_point_weights_from_constraints)
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,99 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include "cmocka.h"
+#include "geometry/create_point_lattice.h"
+#include "polywog/reorder_point_cloud.h"
+
+// This creates a neighbor pairing using a hat function.
+extern neighbor_pairing_t* create_simple_pairing(point_cloud_t* cloud, real_t h);
+
+static void test_reorder(void (*reorder)(point_cloud_reorderer_t* reorderer))
+{
+  bbox_t bbox = {.x1 = 0.0, .x2 = 1.0, .y1 = 0.0, .y2 = 1.0, .z1 = 0.0, .z2 = 1.0};
+  int n = 10;
+  point_cloud_t* cloud = create_uniform_point_lattice(MPI_COMM_SELF, n, n, n, &bbox);
+  real_t h = 1.5 / n;
+  neighbor_pairing_t* pairing = create_simple_pairing(cloud, h);
+  int num_pairs = pairing->num_pairs;
+
+  // Attach a copy of the points as a field, and tag a couple of points.
+  int N = cloud->num_points;
+  point_t x[N];
+  memcpy(x, cloud->points, sizeof(point_t) * N);
+  int* tag = tagger_create_tag(cloud->tags, "corners", 2);
+  tag[0] = 0;
+  tag[1] = N-1;
+  point_t corners[2] = {cloud->points[0], cloud->points[N-1]};
+
+  // Attach the displacement from the first to the second point of each 
+  // pair, which changes sign if the pair is flipped.
+  vector_t y[num_pairs];
+  for (int p = 0; p < num_pairs; ++p)
+  {
+    point_displacement(&cloud->points[pairing->pairs[2*p]], 
+                       &cloud->points[pairing->pairs[2*p+1]], &y[p]);
+  }
+
+  point_cloud_reorderer_t* reorderer = point_cloud_reorderer_new(cloud);
+  point_cloud_reorderer_add_array(reorderer, x, sizeof(point_t));
+  point_cloud_reorderer_add_pairing(reorderer, pairing);
+  point_cloud_reorderer_add_pair_array(reorderer, pairing, y, sizeof(vector_t));
+  reorder(reorderer);
+  point_cloud_reorderer_free(reorderer);
+
+  // The field should follow the points, the tags should still point to the 
+  // corners, and the pairs should still connect neighbors, in the same 
+  // orientation, with their data following them.
+  for (int i = 0; i < N; ++i)
+    assert_true(point_distance(&x[i], &cloud->points[i]) == 0.0);
+  size_t tag_size;
+  tag = tagger_tag(cloud->tags, "corners", &tag_size);
+  assert_true(point_distance(&cloud->points[tag[0]], &corners[0]) == 0.0);
+  assert_true(point_distance(&cloud->points[tag[1]], &corners[1]) == 0.0);
+  assert_int_equal(num_pairs, pairing->num_pairs);
+  real_t max_dist = 0.0;
+  for (int p = 0; p < num_pairs; ++p)
+  {
+    int i = pairing->pairs[2*p], j = pairing->pairs[2*p+1];
+    max_dist = MAX(max_dist, point_distance(&cloud->points[i], &cloud->points[j]));
+    vector_t yp;
+    point_displacement(&cloud->points[i], &cloud->points[j], &yp);
+    assert_true(yp.x == y[p].x);
+    assert_true(yp.y == y[p].y);
+    assert_true(yp.z == y[p].z);
+  }
+  assert_true(max_dist < h);
+
+  neighbor_pairing_free(pairing);
+  point_cloud_free(cloud);
+}
+
+void test_reorder_hilbert(void** state)
+{
+  test_reorder(point_cloud_reorder_hilbert);
+}
+
+void test_reorder_morton(void** state)
+{
+  test_reorder(point_cloud_reorder_morton);
+}
+
+int main(int argc, char* argv[])
+{
+  polymec_init(argc, argv);
+  const struct CMUnitTest tests[] =
+  {
+    cmocka_unit_test(test_reorder_hilbert),
+    cmocka_unit_test(test_reorder_morton)
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
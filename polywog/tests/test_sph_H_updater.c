@@ -0,0 +1,113 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include "cmocka.h"
+#include "polywog/sph_H_updater.h"
+
+// A deterministic "random" number in [0, 1).
+static real_t pseudo_random(int i)
+{
+  real_t x = sin(12.9898 * i + 78.233) * 43758.5453;
+  return x - floor(x);
+}
+
+// Fills in smoothing tensors, zeroth moments and second moments for n
+// points, covering all of the branches of the update: vanishing and huge
+// zeroth moments, and degenerate and well-conditioned second moments.
+static void make_moments(int n, sym_tensor2_t* H, real_t* zeroth_moments,
+                         sym_tensor2_t* second_moments)
+{
+  for (int i = 0; i < n; ++i)
+  {
+    // H is a diagonally-dominant (hence positive definite) tensor.
+    real_t h = 0.05 + 0.1 * pseudo_random(6*i);
+    H[i].xx = 1.0/h; H[i].yy = 1.2/h; H[i].zz = 0.9/h;
+    H[i].xy = 0.1/h * pseudo_random(6*i+1);
+    H[i].xz = 0.1/h * pseudo_random(6*i+2);
+    H[i].yz = 0.1/h * pseudo_random(6*i+3);
+
+    if (i % 17 == 0)
+      zeroth_moments[i] = 0.0;
+    else if (i % 19 == 0)
+      zeroth_moments[i] = 1e6;
+    else
+      zeroth_moments[i] = 0.5 + 2.0 * pseudo_random(6*i+4);
+
+    sym_tensor2_t* M = &second_moments[i];
+    if (i % 13 == 0)
+    {
+      // Degenerate.
+      M->xx = M->xy = M->xz = M->yy = M->yz = M->zz = 0.0;
+    }
+    else
+    {
+      // M = A*A^T + I/2 for a lower-triangular A.
+      real_t a11 = pseudo_random(6*i+5), a21 = pseudo_random(7*i),
+             a22 = pseudo_random(7*i+1), a31 = pseudo_random(7*i+2),
+             a32 = pseudo_random(7*i+3), a33 = pseudo_random(7*i+4);
+      M->xx = a11*a11 + 0.5;
+      M->xy = a11*a21;
+      M->xz = a11*a31;
+      M->yy = a21*a21 + a22*a22 + 0.5;
+      M->yz = a21*a31 + a22*a32;
+      M->zz = a31*a31 + a32*a32 + a33*a33 + 0.5;
+    }
+  }
+}
+
+static void test_batch_update(sph_H_updater_t* updater)
+{
+  // Use enough points to span several blocks, with a partial one at the end.
+  int n = 203;
+  sym_tensor2_t H[n], M[n], new_H1[n], new_H2[n];
+  real_t m0[n];
+  make_moments(n, H, m0, M);
+
+  sph_H_updater_update_batch(updater, n, H, m0, M, new_H2);
+  for (int i = 0; i < n; ++i)
+  {
+    sph_H_updater_update(updater, &H[i], m0[i], &M[i], &new_H1[i]);
+    real_t* A = (real_t*)&new_H1[i];
+    real_t* B = (real_t*)&new_H2[i];
+    real_t norm = 0.0;
+    for (int c = 0; c < 6; ++c)
+      norm = MAX(norm, fabs(A[c]));
+    for (int c = 0; c < 6; ++c)
+      assert_true(fabs(A[c] - B[c]) < 1e-10 * norm);
+  }
+}
+
+void test_isotropic_batch_update(void** state)
+{
+  sph_kernel_t* W = b_spline_sph_kernel_new();
+  sph_H_updater_t* updater = isotropic_sph_H_updater_new(W, 2.0);
+  test_batch_update(updater);
+  sph_H_updater_free(updater);
+}
+
+void test_anisotropic_batch_update(void** state)
+{
+  sph_kernel_t* W = b_spline_sph_kernel_new();
+  sph_H_updater_t* updater = anisotropic_sph_H_updater_new(W, 2.0);
+  test_batch_update(updater);
+  sph_H_updater_free(updater);
+}
+
+int main(int argc, char* argv[])
+{
+  polymec_init(argc, argv);
+  const struct CMUnitTest tests[] =
+  {
+    cmocka_unit_test(test_isotropic_batch_update),
+    cmocka_unit_test(test_anisotropic_batch_update)
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,183 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include "cmocka.h"
+#include "geometry/create_point_lattice.h"
+#include "polywog/sph_block_integrator.h"
+
+// This creates a neighbor pairing using a hat function.
+extern neighbor_pairing_t* create_simple_pairing(point_cloud_t* cloud, real_t h);
+
+// This dynamics object exerts equal and opposite velocity-dependent "forces"
+// on i and j.
+static void repulsive_compute(void* context, real_t t,
+                              int i, int j,
+                              real_t* Ui, real_t* Uj,
+                              real_t Wi, real_t Wj,
+                              vector_t* grad_Wi, vector_t* grad_Wj,
+                              real_t* dUidt, real_t* dUjdt,
+                              sph_node_data_t* node_data)
+{
+  real_t a = 1e-3 * (1.0 + Ui[0] * Uj[0]);
+  dUidt[0] = -a * (grad_Wi->x + grad_Wj->x);
+  dUidt[1] = -a * (grad_Wi->y + grad_Wj->y);
+  dUidt[2] = -a * (grad_Wi->z + grad_Wj->z);
+  for (int c = 0; c < 3; ++c)
+    dUjdt[c] = -dUidt[c];
+}
+
+// Every point has the same stable time step.
+static real_t uniform_dt(void* context, real_t t, int i, real_t* Ui, real_t* dUidt)
+{
+  return *((real_t*)context);
+}
+
+static void make_lattice(int n, real_t h_over_dx,
+                         point_cloud_t** cloud,
+                         neighbor_pairing_t** pairing,
+                         sym_tensor2_t** H,
+                         real_t** U)
+{
+  bbox_t bbox = {.x1 = 0.0, .x2 = 1.0, .y1 = 0.0, .y2 = 1.0, .z1 = 0.0, .z2 = 1.0};
+  *cloud = create_uniform_point_lattice(MPI_COMM_SELF, n, n, n, &bbox);
+  real_t h = h_over_dx / n;
+  *pairing = create_simple_pairing(*cloud, 2.0*h);
+  int N = (*cloud)->num_points;
+  *H = polymec_malloc(sizeof(sym_tensor2_t) * N);
+  *U = polymec_malloc(sizeof(real_t) * 3 * N);
+  for (int i = 0; i < N; ++i)
+  {
+    sym_tensor2_set_identity(&(*H)[i], 1.0/h);
+    point_t* x = &(*cloud)->points[i];
+    (*U)[3*i]   = 0.1 * sin(2.0 * M_PI * x->y);
+    (*U)[3*i+1] = 0.1 * cos(2.0 * M_PI * x->z);
+    (*U)[3*i+2] = 0.1 * x->x;
+  }
+}
+
+// Takes a kick-drift-kick step of size dt with the given pair loop, given
+// the time derivative dUdt at the start of the step, and leaving the time
+// derivative at the end of the step there.
+static void kick_drift_kick(sph_pair_loop_t* loop, point_cloud_t* cloud,
+                            sym_tensor2_t* H, real_t t, real_t dt,
+                            real_t* U, real_t* dUdt)
+{
+  int N = cloud->num_points;
+  real_t U_pred[3*N];
+  for (int i = 0; i < 3*N; ++i)
+    U[i] += 0.5 * dt * dUdt[i];
+  for (int i = 0; i < N; ++i)
+  {
+    cloud->points[i].x += dt * U[3*i];
+    cloud->points[i].y += dt * U[3*i+1];
+    cloud->points[i].z += dt * U[3*i+2];
+  }
+  for (int i = 0; i < 3*N; ++i)
+    U_pred[i] = U[i] + 0.5 * dt * dUdt[i];
+  sph_pair_loop_compute(loop, t + dt, cloud->points, H, U_pred, dUdt, NULL);
+  for (int i = 0; i < 3*N; ++i)
+    U[i] += 0.5 * dt * dUdt[i];
+}
+
+static void test_block_step(int num_substeps)
+{
+  point_cloud_t *cloud1, *cloud2;
+  neighbor_pairing_t *pairing1, *pairing2;
+  sym_tensor2_t *H1, *H2;
+  real_t *U1, *U2;
+  make_lattice(6, 1.2, &cloud1, &pairing1, &H1, &U1);
+  make_lattice(6, 1.2, &cloud2, &pairing2, &H2, &U2);
+  int N = cloud1->num_points;
+
+  sph_kernel_t* W = wendland_c2_sph_kernel_new(3);
+  sph_dynamics_t* dyn = sph_dynamics_new("repulsive", NULL, repulsive_compute, NULL);
+  sph_pair_loop_t* loop1 = sph_pair_loop_new(W, pairing1, 3);
+  sph_pair_loop_add_dynamics(loop1, dyn);
+  sph_pair_loop_t* loop2 = sph_pair_loop_new(W, pairing2, 3);
+  sph_pair_loop_add_dynamics(loop2, dyn);
+
+  // Take one top-level step with the block integrator, with every point in
+  // the same bin.
+  real_t max_dt = 0.01, dt = max_dt / num_substeps;
+  sph_block_integrator_t* integ =
+    sph_block_integrator_new(loop1, cloud1, H1, 3, 0, &dt, uniform_dt, NULL,
+                             4, NULL);
+  real_t t = sph_block_integrator_step(integ, max_dt, 0.0, U1);
+  assert_true(fabs(t - max_dt) < 1e-15);
+  for (int i = 0; i < N; ++i)
+    assert_int_equal(num_substeps/2, sph_block_integrator_bins(integ)[i]);
+  assert_int_equal((long)(1 + num_substeps) * N,
+                   sph_block_integrator_num_evaluations(integ));
+
+  // Take the same steps directly with the pair loop.
+  real_t dUdt[3*N];
+  sph_pair_loop_compute(loop2, 0.0, cloud2->points, H2, U2, dUdt, NULL);
+  for (int k = 0; k < num_substeps; ++k)
+    kick_drift_kick(loop2, cloud2, H2, k*dt, dt, U2, dUdt);
+
+  // The states should agree.
+  real_t max_U = 0.0;
+  for (int i = 0; i < 3*N; ++i)
+    max_U = MAX(max_U, fabs(U2[i]));
+  for (int i = 0; i < N; ++i)
+  {
+    assert_true(point_distance(&cloud1->points[i], &cloud2->points[i]) < 1e-12);
+    for (int c = 0; c < 3; ++c)
+      assert_true(fabs(U1[3*i+c] - U2[3*i+c]) < 1e-12 * max_U);
+  }
+
+  // The integrator begins its next step with the derivatives it computed at
+  // the end of this one, so a second step checks that those agree, too.
+  sph_block_integrator_step(integ, max_dt, t, U1);
+  for (int k = 0; k < num_substeps; ++k)
+    kick_drift_kick(loop2, cloud2, H2, t + k*dt, dt, U2, dUdt);
+  for (int i = 0; i < N; ++i)
+  {
+    assert_true(point_distance(&cloud1->points[i], &cloud2->points[i]) < 1e-12);
+    for (int c = 0; c < 3; ++c)
+      assert_true(fabs(U1[3*i+c] - U2[3*i+c]) < 1e-12 * max_U);
+  }
+
+  // Clean up.
+  sph_block_integrator_free(integ);
+  sph_pair_loop_free(loop1);
+  sph_pair_loop_free(loop2);
+  sph_dynamics_free(dyn);
+  neighbor_pairing_free(pairing1);
+  neighbor_pairing_free(pairing2);
+  point_cloud_free(cloud1);
+  point_cloud_free(cloud2);
+  polymec_free(H1);
+  polymec_free(H2);
+  polymec_free(U1);
+  polymec_free(U2);
+}
+
+void test_block_integrator_single_step(void** state)
+{
+  test_block_step(1);
+}
+
+void test_block_integrator_substeps(void** state)
+{
+  test_block_step(2);
+}
+
+int main(int argc, char* argv[])
+{
+  polymec_init(argc, argv);
+  const struct CMUnitTest tests[] =
+  {
+    cmocka_unit_test(test_block_integrator_single_step),
+    cmocka_unit_test(test_block_integrator_substeps)
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,198 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include "cmocka.h"
+#include "geometry/create_point_lattice.h"
+#include "polywog/partition_point_cloud_with_neighbors.h"
+#include "polywog/sph_neighbor_list.h"
+
+// This creates a neighbor pairing using a hat function.
+extern neighbor_pairing_t* create_simple_pairing(point_cloud_t* cloud, real_t h);
+
+// Creates an n x n x n lattice distributed over the processes, with ghost
+// points within h of each process's points.
+static void make_lattice(int n, real_t h,
+                         point_cloud_t** cloud,
+                         neighbor_pairing_t** pairing)
+{
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  *cloud = NULL;
+  *pairing = NULL;
+  if (rank == 0)
+  {
+    bbox_t bbox = {.x1 = 0.0, .x2 = 1.0, .y1 = 0.0, .y2 = 1.0, .z1 = 0.0, .z2 = 1.0};
+    *cloud = create_uniform_point_lattice(MPI_COMM_SELF, n, n, n, &bbox);
+    *pairing = create_simple_pairing(*cloud, h);
+  }
+  exchanger_t* distributor = partition_point_cloud_with_neighbors_geometrically(cloud, pairing, comm, NULL, 0.05, NULL);
+  exchanger_free(distributor);
+}
+
+// Counts the pairs (i, j) with at least one locally-owned point whose
+// separation is within the larger of their support radii.
+static int count_interacting_pairs(point_cloud_t* cloud, real_t* R)
+{
+  int N = cloud->num_points + cloud->num_ghosts, num_pairs = 0;
+  for (int i = 0; i < cloud->num_points; ++i)
+  {
+    for (int j = i+1; j < N; ++j)
+    {
+      real_t R_max = MAX(R[i], R[j]);
+      if (point_square_distance(&cloud->points[i], &cloud->points[j]) <= R_max * R_max)
+        ++num_pairs;
+    }
+  }
+  return num_pairs;
+}
+
+void test_sph_neighbor_list_filter(void** state)
+{
+  int n = 8;
+  real_t dx = 1.0/n, h = 1.5*dx;
+  point_cloud_t* cloud;
+  neighbor_pairing_t* source;
+  make_lattice(n, h, &cloud, &source);
+
+  // Build a list with a generous skin.
+  int N = cloud->num_points + cloud->num_ghosts;
+  real_t R[N];
+  for (int i = 0; i < N; ++i)
+    R[i] = h;
+  sph_neighbor_list_t* list = sph_neighbor_list_new(cloud, R, 0.5*dx, source->ex);
+  neighbor_pairing_t* candidates = sph_neighbor_list_candidates(list);
+  neighbor_pairing_t* pairing = sph_neighbor_list_pairing(list);
+  assert_true(pairing->num_pairs <= candidates->num_pairs);
+
+  // The filtered pairs are exactly the interacting ones.
+  assert_int_equal(count_interacting_pairs(cloud, R), pairing->num_pairs);
+  int pos = 0, i, j;
+  while (neighbor_pairing_next(pairing, &pos, &i, &j, NULL))
+  {
+    assert_true((i < cloud->num_points) || (j < cloud->num_points));
+    assert_true(point_distance(&cloud->points[i], &cloud->points[j]) <= h);
+  }
+
+  // The exchanger of the filtered pairing fills in ghost values.
+  real_t x[N];
+  for (int i = 0; i < N; ++i)
+    x[i] = (i < cloud->num_points) ? cloud->points[i].x : -1.0;
+  exchanger_exchange(pairing->ex, x, 1, 0, MPI_REAL_T);
+  for (int i = 0; i < N; ++i)
+    assert_true(fabs(x[i] - cloud->points[i].x) < 1e-14);
+
+  // After the supports shrink, the filtered pairs are still exact, and the 
+  // candidates' exchanger works, too.
+  for (int i = 0; i < N; ++i)
+    R[i] = 1.2*dx;
+  sph_neighbor_list_update(list, R);
+  assert_int_equal(count_interacting_pairs(cloud, R), sph_neighbor_list_pairing(list)->num_pairs);
+  for (int i = 0; i < N; ++i)
+    x[i] = (i < cloud->num_points) ? cloud->points[i].y : -1.0;
+  exchanger_exchange(sph_neighbor_list_candidates(list)->ex, x, 1, 0, MPI_REAL_T);
+  for (int i = 0; i < N; ++i)
+    assert_true(fabs(x[i] - cloud->points[i].y) < 1e-14);
+
+  // Clean up.
+  sph_neighbor_list_free(list);
+  neighbor_pairing_free(source);
+  point_cloud_free(cloud);
+}
+
+static int pair_cmp(const void* l, const void* r)
+{
+  const int* a = l;
+  const int* b = r;
+  if (a[0] != b[0]) return (a[0] < b[0]) ? -1 : 1;
+  if (a[1] != b[1]) return (a[1] < b[1]) ? -1 : 1;
+  return 0;
+}
+
+// Returns the pairs of the given pairing as sorted (min, max) index pairs.
+static int* sorted_pairs(neighbor_pairing_t* pairing)
+{
+  int* pairs = polymec_malloc(sizeof(int) * 2 * MAX(pairing->num_pairs, 1));
+  int pos = 0, i, j, k = 0;
+  while (neighbor_pairing_next(pairing, &pos, &i, &j, NULL))
+  {
+    pairs[2*k] = MIN(i, j);
+    pairs[2*k+1] = MAX(i, j);
+    ++k;
+  }
+  qsort(pairs, pairing->num_pairs, 2*sizeof(int), pair_cmp);
+  return pairs;
+}
+
+void test_sph_neighbor_list_extend(void** state)
+{
+  int n = 8;
+  real_t dx = 1.0/n, h = 2.5*dx;
+  point_cloud_t* cloud;
+  neighbor_pairing_t* source;
+  make_lattice(n, h, &cloud, &source);
+
+  // Build a list with small supports and a small skin.
+  int N = cloud->num_points + cloud->num_ghosts;
+  real_t R[N];
+  for (int i = 0; i < N; ++i)
+    R[i] = 1.1*dx;
+  real_t skin = 0.1*dx;
+  sph_neighbor_list_t* list = sph_neighbor_list_new(cloud, R, skin, source->ex);
+
+  // Grow the supports of some of the points well past the skin, and extend
+  // the list.
+  int num_grown = 0;
+  for (int i = 0; i < N; ++i)
+  {
+    if ((cloud->points[i].x < 0.5) && (cloud->points[i].y < 0.5))
+    {
+      R[i] = 1.8*dx;
+      if (i < cloud->num_points) ++num_grown;
+    }
+  }
+  int num_extended = sph_neighbor_list_extend(list, R);
+  assert_true(num_extended >= num_grown);
+  assert_int_equal(1, sph_neighbor_list_num_builds(list));
+
+  // The extended list should have the same pairs as one built from scratch.
+  sph_neighbor_list_t* list2 = sph_neighbor_list_new(cloud, R, skin, source->ex);
+  neighbor_pairing_t* pairing1 = sph_neighbor_list_pairing(list);
+  neighbor_pairing_t* pairing2 = sph_neighbor_list_pairing(list2);
+  assert_int_equal(pairing2->num_pairs, pairing1->num_pairs);
+  assert_int_equal(count_interacting_pairs(cloud, R), pairing1->num_pairs);
+  int* pairs1 = sorted_pairs(pairing1);
+  int* pairs2 = sorted_pairs(pairing2);
+  for (int p = 0; p < pairing1->num_pairs; ++p)
+  {
+    assert_int_equal(pairs2[2*p], pairs1[2*p]);
+    assert_int_equal(pairs2[2*p+1], pairs1[2*p+1]);
+  }
+  polymec_free(pairs1);
+  polymec_free(pairs2);
+
+  // Clean up.
+  sph_neighbor_list_free(list);
+  sph_neighbor_list_free(list2);
+  neighbor_pairing_free(source);
+  point_cloud_free(cloud);
+}
+
+int main(int argc, char* argv[])
+{
+  polymec_init(argc, argv);
+  const struct CMUnitTest tests[] =
+  {
+    cmocka_unit_test(test_sph_neighbor_list_filter),
+    cmocka_unit_test(test_sph_neighbor_list_extend)
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,338 @@
+// Copyright (c) 2012-2016, Jeffrey N. Johnson
+// All rights reserved.
+//
+// This Source Code Form is subject to the terms of the Mozilla Public
+// License, v. 2.0. If a copy of the MPL was not distributed with this
+// file, You can obtain one at http://mozilla.org/MPL/2.0/.
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <string.h>
+#include "cmocka.h"
+#include "geometry/create_point_lattice.h"
+#include "polywog/partition_point_cloud_with_neighbors.h"
+#include "polywog/sph_pair_loop.h"
+
+// This creates a neighbor pairing using a hat function.
+extern neighbor_pairing_t* create_simple_pairing(point_cloud_t* cloud, real_t h);
+
+// This dynamics object exerts equal and opposite "forces" on i and j.
+static void antisymmetric_compute(void* context, real_t t,
+                                  int i, int j,
+                                  real_t* Ui, real_t* Uj,
+                                  real_t Wi, real_t Wj,
+                                  vector_t* grad_Wi, vector_t* grad_Wj,
+                                  real_t* dUidt, real_t* dUjdt,
+                                  sph_node_data_t* node_data)
+{
+  real_t F = 0.5 * (grad_Wi->x + grad_Wj->x) * (Ui[0] + Uj[0]);
+  dUidt[0] = -F;
+  dUjdt[0] = F;
+}
+
+// This is the same interaction, evaluated a block of pairs at a time.
+static void antisymmetric_compute_batch(void* context, real_t t,
+                                        sph_pair_block_t* block,
+                                        int num_components,
+                                        real_t* U,
+                                        real_t* dUidt, real_t* dUjdt,
+                                        sph_node_data_t* node_data)
+{
+  for (int p = 0; p < block->num_pairs; ++p)
+  {
+    real_t F = 0.5 * (block->grad_Wi_x[p] + block->grad_Wj_x[p]) * 
+               (U[block->i[p]] + U[block->j[p]]);
+    dUidt[p] = -F;
+    dUjdt[p] = F;
+  }
+}
+
+static void make_lattice(int n, real_t h_over_dx,
+                         point_cloud_t** cloud,
+                         neighbor_pairing_t** pairing,
+                         sym_tensor2_t** H)
+{
+  bbox_t bbox = {.x1 = 0.0, .x2 = 1.0, .y1 = 0.0, .y2 = 1.0, .z1 = 0.0, .z2 = 1.0};
+  *cloud = create_uniform_point_lattice(MPI_COMM_SELF, n, n, n, &bbox);
+  real_t h = h_over_dx / n;
+  *pairing = create_simple_pairing(*cloud, 2.0*h);
+  *H = polymec_malloc(sizeof(sym_tensor2_t) * (*cloud)->num_points);
+  for (int i = 0; i < (*cloud)->num_points; ++i)
+    sym_tensor2_set_identity(&(*H)[i], 1.0/h);
+}
+
+void test_sph_pair_loop_conservation(void** state)
+{
+  point_cloud_t* cloud;
+  neighbor_pairing_t* pairing;
+  sym_tensor2_t* H;
+  make_lattice(10, 1.2, &cloud, &pairing, &H);
+
+  sph_kernel_t* W = b_spline_sph_kernel_new();
+  sph_dynamics_t* dyn = sph_dynamics_new("antisymmetric", NULL, antisymmetric_compute, NULL);
+  sph_pair_loop_t* loop = sph_pair_loop_new(W, pairing, 1);
+  sph_pair_loop_add_dynamics(loop, dyn);
+  sph_pair_loop_set_block_size(loop, 64);
+  assert_true(sph_pair_loop_num_points(loop) <= cloud->num_points);
+
+  int N = cloud->num_points;
+  real_t U[N], dUdt[N];
+  sph_node_data_t node_data[N];
+  for (int i = 0; i < N; ++i)
+    U[i] = 1.0 + cloud->points[i].y;
+  sph_pair_loop_compute(loop, 0.0, cloud->points, H, U, dUdt, node_data);
+
+  // The total "momentum" change should vanish, and every point should
+  // see some neighbors.
+  real_t sum = 0.0, max_mag = 0.0;
+  for (int i = 0; i < sph_pair_loop_num_points(loop); ++i)
+  {
+    sum += dUdt[i];
+    max_mag = MAX(max_mag, fabs(dUdt[i]));
+    assert_true(node_data[i].zeroth_moment > 0.0);
+  }
+  assert_true(max_mag > 0.0);
+  assert_true(fabs(sum) < 1e-10 * max_mag * N);
+
+  // Clean up.
+  sph_pair_loop_free(loop);
+  sph_dynamics_free(dyn);
+  neighbor_pairing_free(pairing);
+  point_cloud_free(cloud);
+  polymec_free(H);
+}
+
+void test_sph_pair_loop_batch(void** state)
+{
+  point_cloud_t* cloud;
+  neighbor_pairing_t* pairing;
+  sym_tensor2_t* H;
+  make_lattice(8, 1.3, &cloud, &pairing, &H);
+
+  sph_kernel_t* W = b_spline_sph_kernel_new();
+  sph_dynamics_t* scalar_dyn = sph_dynamics_new("scalar", NULL, antisymmetric_compute, NULL);
+  sph_dynamics_t* batch_dyn = sph_dynamics_new("batch", NULL, antisymmetric_compute, NULL);
+  sph_dynamics_set_batch_compute(batch_dyn, antisymmetric_compute_batch);
+  assert_false(sph_dynamics_has_batch_compute(scalar_dyn));
+  assert_true(sph_dynamics_has_batch_compute(batch_dyn));
+
+  int N = cloud->num_points;
+  real_t U[N], dUdt1[N], dUdt2[N];
+  for (int i = 0; i < N; ++i)
+    U[i] = 1.0 + cloud->points[i].z;
+
+  sph_pair_loop_t* loop1 = sph_pair_loop_new(W, pairing, 1);
+  sph_pair_loop_add_dynamics(loop1, scalar_dyn);
+  sph_pair_loop_compute(loop1, 0.0, cloud->points, H, U, dUdt1, NULL);
+  sph_pair_loop_t* loop2 = sph_pair_loop_new(W, pairing, 1);
+  sph_pair_loop_add_dynamics(loop2, batch_dyn);
+  sph_pair_loop_compute(loop2, 0.0, cloud->points, H, U, dUdt2, NULL);
+
+  // The scalar and batch paths should agree.
+  for (int i = 0; i < sph_pair_loop_num_points(loop1); ++i)
+    assert_true(fabs(dUdt1[i] - dUdt2[i]) < 1e-12 * (1.0 + fabs(dUdt1[i])));
+
+  // Clean up.
+  sph_pair_loop_free(loop1);
+  sph_pair_loop_free(loop2);
+  sph_dynamics_free(scalar_dyn);
+  sph_dynamics_free(batch_dyn);
+  neighbor_pairing_free(pairing);
+  point_cloud_free(cloud);
+  polymec_free(H);
+}
+
+void test_sph_pair_loop_eta2_table(void** state)
+{
+  point_cloud_t* cloud;
+  neighbor_pairing_t* pairing;
+  sym_tensor2_t* H;
+  make_lattice(8, 1.3, &cloud, &pairing, &H);
+
+  sph_kernel_t* W = b_spline_sph_kernel_new();
+  sph_kernel_t* W_table = eta2_tabular_sph_kernel_new(W, 4096);
+  assert_false(sph_kernel_has_eta2_compute(W));
+  assert_true(sph_kernel_has_eta2_compute(W_table));
+  sph_dynamics_t* dyn = sph_dynamics_new("antisymmetric", NULL, antisymmetric_compute, NULL);
+
+  int N = cloud->num_points;
+  real_t U[N], dUdt1[N], dUdt2[N];
+  sph_node_data_t node_data1[N], node_data2[N];
+  for (int i = 0; i < N; ++i)
+    U[i] = 1.0 + cloud->points[i].x;
+
+  sph_pair_loop_t* loop1 = sph_pair_loop_new(W, pairing, 1);
+  sph_pair_loop_add_dynamics(loop1, dyn);
+  sph_pair_loop_compute(loop1, 0.0, cloud->points, H, U, dUdt1, node_data1);
+  sph_pair_loop_t* loop2 = sph_pair_loop_new(W_table, pairing, 1);
+  sph_pair_loop_add_dynamics(loop2, dyn);
+  sph_pair_loop_compute(loop2, 0.0, cloud->points, H, U, dUdt2, node_data2);
+
+  // The tabulated kernel should closely match the analytic one.
+  real_t max_mag = 0.0, max_err = 0.0;
+  for (int i = 0; i < sph_pair_loop_num_points(loop1); ++i)
+  {
+    max_mag = MAX(max_mag, fabs(dUdt1[i]));
+    max_err = MAX(max_err, fabs(dUdt1[i] - dUdt2[i]));
+    assert_true(fabs(node_data1[i].zeroth_moment - node_data2[i].zeroth_moment) < 
+                1e-4 * node_data1[i].zeroth_moment);
+  }
+  assert_true(max_err < 1e-4 * max_mag);
+
+  // Clean up.
+  sph_pair_loop_free(loop1);
+  sph_pair_loop_free(loop2);
+  sph_dynamics_free(dyn);
+  neighbor_pairing_free(pairing);
+  point_cloud_free(cloud);
+  polymec_free(H);
+}
+
+// This evaluates a built-in kernel through the generic compute interface.
+static void generic_compute(void* context, real_t eta_mag, real_t det_H, 
+                            real_t* W, real_t* dWdeta)
+{
+  sph_kernel_t* kernel = context;
+  if (eta_mag < sph_kernel_extent(kernel))
+  {
+    sph_kernel_eval(sph_kernel_type(kernel), sph_kernel_dimension(kernel), 
+                    sph_kernel_normalization(kernel), eta_mag, det_H, W, dWdeta);
+  }
+  else
+    *W = *dWdeta = 0.0;
+}
+
+void test_sph_pair_loop_kernel_types(void** state)
+{
+  point_cloud_t* cloud;
+  neighbor_pairing_t* pairing;
+  sym_tensor2_t* H;
+  make_lattice(8, 1.2, &cloud, &pairing, &H);
+  sph_dynamics_t* dyn = sph_dynamics_new("antisymmetric", NULL, antisymmetric_compute, NULL);
+
+  int N = cloud->num_points;
+  real_t U[N], dUdt1[N], dUdt2[N];
+  for (int i = 0; i < N; ++i)
+    U[i] = 1.0 + cloud->points[i].y;
+
+  sph_kernel_t* kernels[] = {wendland_c2_sph_kernel_new(3), 
+                             wendland_c4_sph_kernel_new(3),
+                             wendland_c6_sph_kernel_new(3)};
+  for (int k = 0; k < 3; ++k)
+  {
+    sph_kernel_t* W = kernels[k];
+    sph_kernel_t* W_generic = sph_kernel_new("generic", sph_kernel_extent(W),
+                                             W, generic_compute, NULL);
+    assert_int_equal(SPH_KERNEL_GENERIC, sph_kernel_type(W_generic));
+
+    sph_pair_loop_t* loop1 = sph_pair_loop_new(W, pairing, 1);
+    sph_pair_loop_add_dynamics(loop1, dyn);
+    sph_pair_loop_compute(loop1, 0.0, cloud->points, H, U, dUdt1, NULL);
+    sph_pair_loop_t* loop2 = sph_pair_loop_new(W_generic, pairing, 1);
+    sph_pair_loop_add_dynamics(loop2, dyn);
+    sph_pair_loop_compute(loop2, 0.0, cloud->points, H, U, dUdt2, NULL);
+
+    // The inlined and generic evaluations should agree.
+    for (int i = 0; i < sph_pair_loop_num_points(loop1); ++i)
+      assert_true(fabs(dUdt1[i] - dUdt2[i]) < 1e-12 * (1.0 + fabs(dUdt1[i])));
+
+    sph_pair_loop_free(loop1);
+    sph_pair_loop_free(loop2);
+  }
+
+  // Clean up.
+  sph_dynamics_free(dyn);
+  neighbor_pairing_free(pairing);
+  point_cloud_free(cloud);
+  polymec_free(H);
+}
+
+void test_sph_pair_loop_with_exchange(void** state)
+{
+  // Distribute a lattice over the processes, so that there are ghost points.
+  MPI_Comm comm = MPI_COMM_WORLD;
+  int rank;
+  MPI_Comm_rank(comm, &rank);
+  int n = 8;
+  real_t h = 1.2 / n;
+  point_cloud_t* cloud = NULL;
+  neighbor_pairing_t* pairing = NULL;
+  if (rank == 0)
+  {
+    bbox_t bbox = {.x1 = 0.0, .x2 = 1.0, .y1 = 0.0, .y2 = 1.0, .z1 = 0.0, .z2 = 1.0};
+    cloud = create_uniform_point_lattice(MPI_COMM_SELF, n, n, n, &bbox);
+    pairing = create_simple_pairing(cloud, 2.0*h);
+  }
+  exchanger_t* distributor = partition_point_cloud_with_neighbors_geometrically(&cloud, &pairing, comm, NULL, 0.05, NULL);
+  exchanger_free(distributor);
+  int num_owned = cloud->num_points, N = num_owned + cloud->num_ghosts;
+
+  sph_kernel_t* W = wendland_c2_sph_kernel_new(3);
+  sph_dynamics_t* dyn = sph_dynamics_new("antisymmetric", NULL, antisymmetric_compute, NULL);
+  sph_pair_loop_t* loop = sph_pair_loop_new(W, pairing, 1);
+  sph_pair_loop_add_dynamics(loop, dyn);
+  assert_true(sph_pair_loop_num_points(loop) <= N);
+
+  // Compute a reference solution with all ghost data in place.
+  sym_tensor2_t H[N];
+  real_t U[N], dUdt1[N], dUdt2[N];
+  sph_node_data_t node_data1[N], node_data2[N];
+  for (int i = 0; i < N; ++i)
+  {
+    sym_tensor2_set_identity(&H[i], (1.0 + cloud->points[i].x) / h);
+    U[i] = 1.0 + cloud->points[i].z;
+  }
+  sph_pair_loop_compute(loop, 0.0, cloud->points, H, U, dUdt1, node_data1);
+
+  // Splitting the pairs into interior and boundary pairs, and filling in 
+  // the ghost values while the interior pairs are evaluated, shouldn't 
+  // change anything (twice, to exercise the reuse of the split).
+  for (int iter = 0; iter < 2; ++iter)
+  {
+    point_t x[N];
+    sym_tensor2_t H2[N];
+    real_t U2[N];
+    memcpy(x, cloud->points, sizeof(point_t) * N);
+    memcpy(H2, H, sizeof(sym_tensor2_t) * N);
+    memcpy(U2, U, sizeof(real_t) * N);
+    for (int i = num_owned; i < N; ++i)
+    {
+      x[i].x = x[i].y = x[i].z = -10.0;
+      sym_tensor2_set_identity(&H2[i], 1e-3);
+      U2[i] = -1e10;
+    }
+    sph_pair_loop_compute_with_exchange(loop, 0.0, x, H2, U2, dUdt2, node_data2);
+    for (int i = 0; i < N; ++i)
+    {
+      assert_true(point_distance(&x[i], &cloud->points[i]) < 1e-14);
+      assert_true(fabs(U2[i] - U[i]) < 1e-14);
+    }
+    for (int i = 0; i < num_owned; ++i)
+    {
+      assert_true(fabs(dUdt1[i] - dUdt2[i]) < 1e-12 * (1.0 + fabs(dUdt1[i])));
+      assert_true(fabs(node_data1[i].zeroth_moment - node_data2[i].zeroth_moment) < 
+                  1e-12 * node_data1[i].zeroth_moment);
+    }
+  }
+
+  // Clean up.
+  sph_pair_loop_free(loop);
+  sph_dynamics_free(dyn);
+  neighbor_pairing_free(pairing);
+  point_cloud_free(cloud);
+}
+
+int main(int argc, char* argv[])
+{
+  polymec_init(argc, argv);
+  const struct CMUnitTest tests[] =
+  {
+    cmocka_unit_test(test_sph_pair_loop_conservation),
+    cmocka_unit_test(test_sph_pair_loop_batch),
+    cmocka_unit_test(test_sph_pair_loop_eta2_table),
+    cmocka_unit_test(test_sph_pair_loop_kernel_types),
+    cmocka_unit_test(test_sph_pair_loop_with_exchange)
+  };
+  return cmocka_run_group_tests(tests, NULL, NULL);
+}